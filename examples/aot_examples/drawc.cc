@@ -0,0 +1,128 @@
+// Draw语言预先编译工具
+// 解析并优化源文件，把程序映像转换为C++（见DrawLangAot.hpp）并编译为
+// 共享库。指定缓存目录时放到解释器按源码哈希查找的位置，此后
+// draw_lang_interpreter -c <dir>直接执行共享库。
+// 用法：drawc [-O0|-O1|-O2] [-c <cachedir>] [-o <out.so>] [--emit-cpp] file
+
+#include "spdlog/spdlog.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "DrawLangAST.hpp"
+#include "DrawLangAot.hpp"
+#include "DrawLangOptimizer.hpp"
+#include "DrawLangParser.hpp"
+#include "DrawLangProgramCache.hpp"
+#include "SimpleLexer.hpp"
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::parser;
+using namespace interpreter_exp::lexer;
+
+namespace {
+
+void printUsage(const char *programName) {
+  std::cout << "Usage: " << programName
+            << " [-O0|-O1|-O2] [-c <cachedir>] [-o <out.so>] [--emit-cpp] "
+               "file"
+            << std::endl;
+  std::cout << "  -O0, -O1, -O2  Optimization level, must match the "
+               "interpreter (default: -O1)"
+            << std::endl;
+  std::cout << "  -c <cachedir>  Write the module where the interpreter "
+               "looks it up"
+            << std::endl;
+  std::cout << "  -o <out.so>    Write the module to <out.so>" << std::endl;
+  std::cout << "  --emit-cpp     Print the generated C++ instead of compiling"
+            << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+  int optLevel = 1;
+  std::string cacheDir;
+  std::string outPath;
+  std::string filePath;
+  bool emitCpp = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      printUsage(argv[0]);
+      return 0;
+    } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' &&
+               argv[i][2] <= '9' && argv[i][3] == '\0') {
+      optLevel = argv[i][2] - '0';
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      cacheDir = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (strcmp(argv[i], "--emit-cpp") == 0) {
+      emitCpp = true;
+    } else if (argv[i][0] != '-') {
+      filePath = argv[i];
+    }
+  }
+  if (filePath.empty() || (!emitCpp && cacheDir.empty() && outPath.empty())) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // 缓存键与解释器相同，按文件的全部内容和优化配置计算
+  auto optConfig = optimizer::OptimizerConfig::forLevel(optLevel);
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file) {
+    spdlog::error("Cannot open {}", filePath);
+    return 1;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string source = buffer.str();
+  uint64_t sourceHash = cache::hashSource(source, optConfig.fingerprint());
+
+  DrawLangParser parser(
+      createLexerFromString(source, DFAType::HardCoded, filePath).release());
+  auto program = parser.parse();
+  if (!program || parser.hasErrors()) {
+    spdlog::error("Failed to parse {}", filePath);
+    return 1;
+  }
+  optimizer::Optimizer(optConfig, program->getExprPool())
+      .optimize(program.get());
+
+  auto image = cache::compileProgram(program.get(), sourceHash);
+  if (!image) {
+    // -O2的递推和切比雪夫逼近无法放入映像
+    spdlog::error("{} cannot be compiled to a program image{}", filePath,
+                  optConfig.recurrences || optConfig.chebyshev
+                      ? " (approximations are not supported, try -O1)"
+                      : "");
+    return 1;
+  }
+  std::string cpp = cache::transpileProgram(*image);
+  if (cpp.empty()) {
+    spdlog::error("{} uses a function without a C++ equivalent", filePath);
+    return 1;
+  }
+  if (emitCpp) {
+    std::cout << cpp;
+    return 0;
+  }
+
+  if (outPath.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDir, ec);
+    outPath = cache::aotModulePath(cacheDir, sourceHash);
+  }
+  std::string error;
+  if (!cache::compileSharedObject(cpp, outPath, &error)) {
+    spdlog::error("Failed to compile {}:\n{}", outPath, error);
+    return 1;
+  }
+  spdlog::info("{} -> {} ({} statements)", filePath, outPath,
+               image->getStmtCount());
+  return 0;
+}
@@ -0,0 +1,276 @@
+// 字节码求值与树遍历求值的性能对比
+// 对测试用例中的每条FOR-DRAW语句，在其全部采样点上分别用树遍历、
+// 逐点字节码和批量字节码求x、y，比较每个采样点的平均耗时，
+// 并检查结果逐位相同。支持的平台上
+// 同时给出本地代码（见DrawLangJit.hpp，含一次恒等坐标变换）的耗时。
+// vecmath一列是内置函数使用向量实现（见DrawLangVecMath.hpp）的批量求值，
+// float一列是单精度批量求值（Bytecode::runBatchFloat），fast一列是
+// 全部调用使用Medium等级快速近似（见vecmath::Tier）的批量求值。这三列
+// 结果不要求逐位相同，只统计与树遍历的最大误差。
+// 用法：bytecode_bench [-O0|-O1|-O2] [file...]，不指定文件时使用
+// asset/testcase下的全部测试用例
+
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DrawLangAST.hpp"
+#include "DrawLangBytecode.hpp"
+#include "DrawLangJit.hpp"
+#include "DrawLangOptimizer.hpp"
+#include "DrawLangParser.hpp"
+#include "DrawLangVecMath.hpp"
+#include "SimpleLexer.hpp"
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::ast;
+using namespace interpreter_exp::parser;
+using namespace interpreter_exp::semantic;
+using namespace interpreter_exp::lexer;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 每种求值方式至少运行的时间，采样点少的语句重复多遍
+constexpr double kMinSeconds = 0.05;
+
+// 两个double是否逐位相同（NaN与NaN视为相同）
+bool sameBits(double a, double b) {
+  return std::memcmp(&a, &b, sizeof(double)) == 0 || (a != a && b != b);
+}
+
+// 重复调用sweep直到累计时间超过kMinSeconds，返回每次调用的平均秒数
+template <typename Sweep> double timeSweeps(Sweep &&sweep) {
+  size_t rounds = 0;
+  auto begin = Clock::now();
+  double elapsed = 0.0;
+  do {
+    sweep();
+    ++rounds;
+    elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+  } while (elapsed < kMinSeconds);
+  return elapsed / static_cast<double>(rounds);
+}
+
+struct Totals {
+  size_t samples = 0;
+  double treeSeconds = 0.0;
+  double bytecodeSeconds = 0.0;
+  double batchSeconds = 0.0;
+  double vecSeconds = 0.0;
+  double vecMaxError = 0.0;
+  double floatSeconds = 0.0;
+  double floatMaxError = 0.0;
+  double fastSeconds = 0.0;
+  double fastMaxError = 0.0;
+  double nativeSeconds = 0.0; // 只统计能生成本地代码的语句
+  double nativeTreeSeconds = 0.0;
+  size_t mismatches = 0;
+};
+
+void benchStatement(const StatementNode *stmt, EvalContext &ctx,
+                    Totals &totals) {
+  const ExpressionNode *startTree = stmt->getExpression(0);
+  const ExpressionNode *endTree = stmt->getExpression(1);
+  const ExpressionNode *stepTree = stmt->getExpression(2);
+  const ExpressionNode *xTree = stmt->getExpression(3);
+  const ExpressionNode *yTree = stmt->getExpression(4);
+
+  // 与语义分析器相同的方式累加生成T
+  std::vector<double> ts;
+  double start = startTree ? startTree->evaluate(ctx) : 0.0;
+  double end = endTree ? endTree->evaluate(ctx) : 0.0;
+  double step = stepTree ? stepTree->evaluate(ctx) : 1.0;
+  if (!(step > 0.0)) {
+    return;
+  }
+  for (double t = start; t <= end; t += step) {
+    ts.push_back(t);
+  }
+  if (ts.empty()) {
+    return;
+  }
+
+  auto code = Bytecode::compile({xTree, yTree});
+  if (!code) {
+    spdlog::warn("  [{}] too many registers, skipped",
+                 stmt->getLocation().toString());
+    return;
+  }
+
+  std::vector<double> treeOut(ts.size() * 2);
+  std::vector<double> codeOut(ts.size() * 2);
+  double treeSeconds = timeSweeps([&] {
+    for (size_t i = 0; i < ts.size(); ++i) {
+      ctx.t = ts[i];
+      treeOut[2 * i] = xTree ? xTree->evaluate(ctx) : 0.0;
+      treeOut[2 * i + 1] = yTree ? yTree->evaluate(ctx) : 0.0;
+    }
+  });
+  double codeSeconds = timeSweeps([&] {
+    for (size_t i = 0; i < ts.size(); ++i) {
+      code->run(ts[i], &codeOut[2 * i], &ctx);
+    }
+  });
+
+  // 批量求值（结构数组），结果同样逐位比较
+  std::vector<double> batchX(ts.size()), batchY(ts.size());
+  double *batchOut[2] = {batchX.data(), batchY.data()};
+  double batchSeconds = timeSweeps(
+      [&] { code->runBatch(ts.data(), ts.size(), batchOut, &ctx); });
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < treeOut.size(); ++i) {
+    mismatches += !sameBits(treeOut[i], codeOut[i]);
+    mismatches += !sameBits(treeOut[i], batchOut[i % 2][i / 2]);
+  }
+
+  // 与树遍历结果的最大误差，绝对值小于1的结果按绝对误差计
+  auto relativeError = [&](double &maxError) {
+    for (size_t i = 0; i < treeOut.size(); ++i) {
+      double expected = treeOut[i];
+      double error = std::fabs(batchOut[i % 2][i / 2] - expected);
+      if (std::isfinite(expected)) {
+        maxError =
+            std::max(maxError, error / std::max(1.0, std::fabs(expected)));
+      }
+    }
+  };
+  code->setVectorMath(true);
+  double vecSeconds = timeSweeps(
+      [&] { code->runBatch(ts.data(), ts.size(), batchOut, &ctx); });
+  code->setVectorMath(false);
+  relativeError(totals.vecMaxError);
+  double floatSeconds = timeSweeps(
+      [&] { code->runBatchFloat(ts.data(), ts.size(), batchOut, &ctx); });
+  relativeError(totals.floatMaxError);
+  code->setFastMath(std::vector<std::optional<vecmath::Tier>>(
+      code->getCallSites().size(), vecmath::Tier::Medium));
+  double fastSeconds = timeSweeps(
+      [&] { code->runBatch(ts.data(), ts.size(), batchOut, &ctx); });
+  code->setFastMath({});
+  relativeError(totals.fastMaxError);
+
+  std::string native = "  native       -";
+  auto kernel = JitKernel::compile(*code, {1.0, 1.0, 1.0, 0.0, 0.0, 0.0},
+                                   "bytecode_bench");
+  if (kernel) {
+    double nativeSeconds = timeSweeps(
+        [&] { kernel->run(ts.data(), ts.size(), codeOut.data()); });
+    native = fmt::format("  native {:7.1f} ns",
+                         nativeSeconds / static_cast<double>(ts.size()) * 1e9);
+    totals.nativeSeconds += nativeSeconds;
+    totals.nativeTreeSeconds += treeSeconds;
+  }
+
+  double n = static_cast<double>(ts.size());
+  spdlog::info("  {} {:>6} samples {:>3} instrs {:>3} regs  "
+               "tree {:7.1f} ns  bytecode {:7.1f} ns  batch {:7.1f} ns  "
+               "vecmath {:7.1f} ns  float {:7.1f} ns  fast {:7.1f} ns{}{}",
+               stmt->getLocation().toString(), ts.size(),
+               code->getInstructionCount(), code->getRegisterCount(),
+               treeSeconds / n * 1e9, codeSeconds / n * 1e9,
+               batchSeconds / n * 1e9, vecSeconds / n * 1e9,
+               floatSeconds / n * 1e9, fastSeconds / n * 1e9, native,
+               mismatches ? "  MISMATCH" : "");
+
+  totals.samples += ts.size();
+  totals.treeSeconds += treeSeconds;
+  totals.bytecodeSeconds += codeSeconds;
+  totals.batchSeconds += batchSeconds;
+  totals.vecSeconds += vecSeconds;
+  totals.floatSeconds += floatSeconds;
+  totals.fastSeconds += fastSeconds;
+  totals.mismatches += mismatches;
+}
+
+bool benchFile(const std::string &path,
+               const optimizer::OptimizerConfig &optConfig, Totals &totals) {
+  auto lexer = createLexerFromFile(path, DFAType::HardCoded);
+  if (!lexer) {
+    spdlog::error("Cannot open {}", path);
+    return false;
+  }
+  DrawLangParser parser(lexer.release());
+  auto program = parser.parse();
+  if (!program || parser.hasErrors()) {
+    spdlog::error("Failed to parse {}", path);
+    return false;
+  }
+  optimizer::Optimizer(optConfig, program->getExprPool())
+      .optimize(program.get());
+
+  spdlog::info("{}", path);
+  EvalContext ctx;
+  for (size_t i = 0; i < program->getChildCount(); ++i) {
+    const StatementNode *stmt = program->getStatement(i);
+    if (stmt->getNodeType() == DrawASTNodeType::ForDrawStmt) {
+      benchStatement(stmt, ctx, totals);
+    }
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+  spdlog::set_pattern("%v");
+
+  int optLevel = 1;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' &&
+        argv[i][2] <= '9' && argv[i][3] == '\0') {
+      optLevel = argv[i][2] - '0';
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.empty()) {
+    for (const char *name : {"TaiJi.txt", "draw.txt", "draw2.txt"}) {
+      files.push_back(std::string(DRAW_LANG_TESTCASE_DIR) + "/" + name);
+    }
+  }
+
+  Totals totals;
+  auto optConfig = optimizer::OptimizerConfig::forLevel(optLevel);
+  for (const auto &file : files) {
+    if (!benchFile(file, optConfig, totals)) {
+      return 1;
+    }
+  }
+  if (totals.samples == 0) {
+    spdlog::warn("No FOR-DRAW samples");
+    return 0;
+  }
+
+  double n = static_cast<double>(totals.samples);
+  spdlog::info("total: {} samples  tree {:.1f} ns  bytecode {:.1f} ns (x{:.2f})"
+               "  batch {:.1f} ns (x{:.2f})  mismatches: {}",
+               totals.samples, totals.treeSeconds / n * 1e9,
+               totals.bytecodeSeconds / n * 1e9,
+               totals.treeSeconds / totals.bytecodeSeconds,
+               totals.batchSeconds / n * 1e9,
+               totals.treeSeconds / totals.batchSeconds, totals.mismatches);
+  spdlog::info("vecmath ({}): {:.1f} ns (x{:.2f})  max error {:.2e}",
+               vecmath::isaName(vecmath::getIsa()), totals.vecSeconds / n * 1e9,
+               totals.treeSeconds / totals.vecSeconds, totals.vecMaxError);
+  spdlog::info("float: {:.1f} ns (x{:.2f})  max error {:.2e}",
+               totals.floatSeconds / n * 1e9,
+               totals.treeSeconds / totals.floatSeconds, totals.floatMaxError);
+  spdlog::info("fast (medium): {:.1f} ns (x{:.2f})  max error {:.2e}",
+               totals.fastSeconds / n * 1e9,
+               totals.treeSeconds / totals.fastSeconds, totals.fastMaxError);
+  if (totals.nativeSeconds > 0.0) {
+    spdlog::info("native: x{:.2f} over the tree walker",
+                 totals.nativeTreeSeconds / totals.nativeSeconds);
+  }
+  return totals.mismatches == 0 ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 #include "DrawLangImGuiUI.hpp"
 #include "DrawLangInterpreter.hpp"
 #include "ErrorLog.hpp"
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -20,6 +21,31 @@ void printUsage(const char *programName) {
   std::cout << "  -h, --help     Show this help message" << std::endl;
   std::cout << "  -d, --debug    Enable debug output" << std::endl;
   std::cout << "  -t, --trace    Enable trace output" << std::endl;
+  std::cout << "  -c, --cache <dir>  Cache compiled programs in <dir>"
+            << std::endl;
+  std::cout << "  -s, --stream   Execute statements while parsing" << std::endl;
+  std::cout << "  -a, --adaptive Adapt FOR-DRAW steps to pixel-space error"
+            << std::endl;
+  std::cout << "  -r, --reverse  Draw in reverse, skip overdrawn pixels"
+            << std::endl;
+  std::cout << "  -b, --bytecode Evaluate coordinates with the bytecode VM"
+            << std::endl;
+  std::cout << "  -j, --jit      Compile FOR-DRAW loops to native code"
+            << std::endl;
+  std::cout << "  --vector-math  SIMD built-in functions in bytecode batches"
+            << std::endl;
+  std::cout << "  --precision <double|float|auto>  Bytecode batch precision"
+            << std::endl;
+  std::cout << "  --fast-math[=coarse|medium|fine]  Approximate built-in "
+               "functions within half a pixel (default: auto tier)"
+            << std::endl;
+  std::cout << "  --threads <n>  Evaluate FOR-DRAW chunks on n threads "
+               "(0: all cores, default: 1)"
+            << std::endl;
+  std::cout << "  -O0, -O1, -O2  Optimization level (default: -O1)"
+            << std::endl;
+  std::cout << "  --dump-passes  Print the AST after each optimization pass"
+            << std::endl;
   std::cout << std::endl;
   std::cout << "If no file is specified, the GUI will open for file selection."
             << std::endl;
@@ -29,6 +55,18 @@ int main(int argc, char *argv[]) {
   std::string filePath;
   bool debugMode = false;
   bool traceMode = false;
+  bool streamMode = false;
+  bool adaptiveMode = false;
+  bool reverseMode = false;
+  bool bytecodeMode = false;
+  bool jitMode = false;
+  bool vectorMath = false;
+  semantic::Precision precision = semantic::Precision::Double;
+  semantic::FastMath fastMath = semantic::FastMath::Off;
+  int threads = 1;
+  int optLevel = 1;
+  bool dumpPasses = false;
+  std::string cacheDir;
 
   // 解析命令行参数
   for (int i = 1; i < argc; ++i) {
@@ -39,6 +77,50 @@ int main(int argc, char *argv[]) {
       debugMode = true;
     } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--trace") == 0) {
       traceMode = true;
+    } else if (strcmp(argv[i], "-s") == 0 ||
+               strcmp(argv[i], "--stream") == 0) {
+      streamMode = true;
+    } else if (strcmp(argv[i], "-a") == 0 ||
+               strcmp(argv[i], "--adaptive") == 0) {
+      adaptiveMode = true;
+    } else if (strcmp(argv[i], "-r") == 0 ||
+               strcmp(argv[i], "--reverse") == 0) {
+      reverseMode = true;
+    } else if (strcmp(argv[i], "-b") == 0 ||
+               strcmp(argv[i], "--bytecode") == 0) {
+      bytecodeMode = true;
+    } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jit") == 0) {
+      jitMode = true;
+    } else if (strcmp(argv[i], "--vector-math") == 0) {
+      vectorMath = true;
+    } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+      ++i;
+      if (strcmp(argv[i], "float") == 0) {
+        precision = semantic::Precision::Float;
+      } else if (strcmp(argv[i], "auto") == 0) {
+        precision = semantic::Precision::Auto;
+      } else {
+        precision = semantic::Precision::Double;
+      }
+    } else if (strcmp(argv[i], "--fast-math") == 0) {
+      fastMath = semantic::FastMath::Auto;
+    } else if (strcmp(argv[i], "--fast-math=coarse") == 0) {
+      fastMath = semantic::FastMath::Coarse;
+    } else if (strcmp(argv[i], "--fast-math=medium") == 0) {
+      fastMath = semantic::FastMath::Medium;
+    } else if (strcmp(argv[i], "--fast-math=fine") == 0) {
+      fastMath = semantic::FastMath::Fine;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = std::atoi(argv[++i]);
+    } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' &&
+               argv[i][2] <= '9' && argv[i][3] == '\0') {
+      optLevel = argv[i][2] - '0';
+    } else if (strcmp(argv[i], "--dump-passes") == 0) {
+      dumpPasses = true;
+    } else if ((strcmp(argv[i], "-c") == 0 ||
+                strcmp(argv[i], "--cache") == 0) &&
+               i + 1 < argc) {
+      cacheDir = argv[++i];
     } else if (argv[i][0] != '-') {
       filePath = argv[i];
     }
@@ -63,6 +145,18 @@ int main(int argc, char *argv[]) {
   DrawLangApp::Config config;
   config.enableDebugOutput = debugMode;
   config.traceExecution = traceMode;
+  config.cacheDir = cacheDir;
+  config.streamExecution = streamMode;
+  config.adaptiveSampling = adaptiveMode;
+  config.reverseOverdraw = reverseMode;
+  config.bytecode = bytecodeMode;
+  config.jit = jitMode;
+  config.vectorMath = vectorMath;
+  config.precision = precision;
+  config.fastMath = fastMath;
+  config.threads = threads;
+  config.optimizer = optimizer::OptimizerConfig::forLevel(optLevel);
+  config.optimizer.dumpAfterEachPass = dumpPasses;
   app.setConfig(config);
 
   // 设置UI
@@ -0,0 +1,184 @@
+// FOR-DRAW并行求值（分块和按语句）的扩展性测试
+// 用1、2、4……直到指定的最大线程数（默认为硬件线程数）执行同一个程序，
+// 给出每种线程数的耗时和相对串行执行的加速比，并检查绘图回调收到的
+// 点序列（坐标和顺序）与串行执行逐位相同。
+// 默认程序是一条有n个采样点的曲线；--curves c时改为c条各有n/c个
+// 采样点、颜色和位置各不相同的曲线，测试语句级并行。
+// 用法：parallel_bench [-n samples] [-j maxThreads] [--curves c]
+//                      [-b|--bytecode] [--jit] [--cull] [file]
+
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DrawLangOptimizer.hpp"
+#include "DrawLangParser.hpp"
+#include "DrawLangSemantic.hpp"
+#include "SimpleLexer.hpp"
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::parser;
+using namespace interpreter_exp::semantic;
+using namespace interpreter_exp::lexer;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 点序列的摘要：点数和按顺序混合坐标位模式的哈希
+struct Digest {
+  size_t points = 0;
+  uint64_t hash = 0;
+
+  void add(double x, double y) {
+    uint64_t bits[2];
+    std::memcpy(bits, &x, sizeof(x));
+    std::memcpy(bits + 1, &y, sizeof(y));
+    for (uint64_t b : bits) {
+      hash = (hash ^ b) * 0x100000001b3ull;
+    }
+    ++points;
+  }
+
+  bool operator==(const Digest &other) const {
+    return points == other.points && hash == other.hash;
+  }
+};
+
+std::string defaultProgram(long samples) {
+  // 步长为1/4096，T的终点按采样点数计算
+  return fmt::format("ORIGIN IS (400, 300);\n"
+                     "SCALE IS (120, 120);\n"
+                     "FOR T FROM 0 TO {} STEP 1/4096 "
+                     "DRAW(cos(T)*sin(3*T) + sin(T/7)/5, "
+                     "sin(T)*sin(3*T) + cos(T/5)/5);\n",
+                     static_cast<double>(samples - 1) / 4096.0);
+}
+
+// 由许多条短曲线组成的图表，共约samples个采样点
+std::string curvesProgram(long samples, long curves) {
+  std::string source = "SCALE IS (40, 40);\n";
+  double end = static_cast<double>(samples / curves - 1) / 256.0;
+  for (long i = 0; i < curves; ++i) {
+    source += fmt::format("ORIGIN IS ({}, {});\n"
+                          "COLOR IS ({}, {}, 128);\n"
+                          "FOR T FROM 0 TO {} STEP 1/256 "
+                          "DRAW(cos(T)*sin({}*T), sin(T) + cos(T/{})/5);\n",
+                          40 + i * 7 % 720, 40 + i * 13 % 520, i * 37 % 256,
+                          i * 91 % 256, end, 1 + i % 5, 2 + i % 7);
+  }
+  return source;
+}
+
+// 执行一次，返回秒数
+double runOnce(const std::string &source, const SemanticConfig &config,
+               Digest &digest, size_t &parallelLoops,
+               size_t &parallelStatements) {
+  auto lexer = createLexerFromString(source, DFAType::HardCoded);
+  DrawLangParser parser(lexer.release());
+  auto program = parser.parse();
+  if (!program || parser.hasErrors()) {
+    spdlog::error("Failed to parse the program");
+    std::exit(1);
+  }
+  optimizer::Optimizer(optimizer::OptimizerConfig(), program->getExprPool())
+      .optimize(program.get());
+
+  DrawLangSemanticAnalyzer analyzer(&parser);
+  analyzer.setConfig(config);
+  analyzer.setDrawCallback(
+      [&digest](double x, double y, const PixelAttribute &) {
+        digest.add(x, y);
+      });
+  auto begin = Clock::now();
+  analyzer.run(program.get());
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  parallelLoops = analyzer.getParallelLoopCount();
+  parallelStatements = analyzer.getParallelStatementCount();
+  return seconds;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+  spdlog::set_pattern("%v");
+
+  long samples = 20000000;
+  long curves = 0;
+  int maxThreads =
+      static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  std::string file;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      samples = std::max(std::atol(argv[++i]), 1l);
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      maxThreads = std::max(std::atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--curves") == 0 && i + 1 < argc) {
+      curves = std::max(std::atol(argv[++i]), 1l);
+    } else if (strcmp(argv[i], "-b") == 0 ||
+               strcmp(argv[i], "--bytecode") == 0) {
+      config.bytecode = true;
+    } else if (strcmp(argv[i], "--jit") == 0) {
+      config.jit = true;
+    } else if (strcmp(argv[i], "--cull") == 0) {
+      config.canvasWidth = 800;
+      config.canvasHeight = 600;
+    } else {
+      file = argv[i];
+    }
+  }
+
+  std::string source = curves > 0
+                           ? curvesProgram(std::max(samples, curves), curves)
+                           : defaultProgram(samples);
+  if (!file.empty()) {
+    std::ifstream in(file);
+    if (!in) {
+      spdlog::error("Cannot open {}", file);
+      return 1;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    source = text.str();
+  }
+
+  std::vector<int> threadCounts;
+  for (int n = 1; n < maxThreads; n *= 2) {
+    threadCounts.push_back(n);
+  }
+  threadCounts.push_back(maxThreads);
+
+  Digest serial;
+  double serialSeconds = 0.0;
+  bool mismatch = false;
+  for (int threads : threadCounts) {
+    config.threads = threads;
+    Digest digest;
+    size_t parallelLoops = 0;
+    size_t parallelStatements = 0;
+    double seconds =
+        runOnce(source, config, digest, parallelLoops, parallelStatements);
+    if (threads == 1) {
+      serial = digest;
+      serialSeconds = seconds;
+    }
+    bool same = digest == serial;
+    mismatch |= !same;
+    spdlog::info("{:>3} threads  {:>10} points  {:8.1f} ms  x{:.2f}  "
+                 "{} chunked loops  {} parallel statements{}",
+                 threads, digest.points, seconds * 1e3,
+                 serialSeconds / seconds, parallelLoops, parallelStatements,
+                 same ? "" : "  MISMATCH");
+  }
+  return mismatch ? 1 : 0;
+}
@@ -4,6 +4,7 @@
 
 #include "Token.hpp"
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -15,6 +16,7 @@ namespace ast {
 
 // 前向声明
 class ASTVisitor;
+class ExpressionNode;
 // AST节点类型
 enum class DrawASTNodeType {
   // 程序结构
@@ -29,12 +31,15 @@ enum class DrawASTNodeType {
   SizeStmt,    // size is s; 或 size is (w, h);
 
   // 表达式类型
-  BinaryExpr,    // 二元表达式: +, -, *, /, **
-  UnaryExpr,     // 一元表达式: +, -
-  FuncCallExpr,  // 函数调用: sin(x), cos(x)等
-  ConstExpr,     // 常量: 数字、PI、E等
-  ParamExpr,     // 参数T
-  ColorNameExpr, // 颜色名称
+  BinaryExpr,     // 二元表达式: +, -, *, /, **
+  UnaryExpr,      // 一元表达式: +, -
+  FuncCallExpr,   // 函数调用: sin(x), cos(x)等
+  ConstExpr,      // 常量: 数字、PI、E等
+  ParamExpr,      // 参数T
+  ColorNameExpr,  // 颜色名称
+  MemoExpr,       // 缓存表达式（公共子表达式消除）
+  RecurrenceExpr, // 递推求值表达式（等步长采样上的增量计算）
+  ChebyshevExpr,  // 分段切比雪夫逼近表达式
 
   // 其他
   ErrorNode
@@ -55,6 +60,90 @@ struct ASTLocation {
 };
 // 函数指针类型（用于内置函数）
 using MathFunc = double (*)(double);
+// 内置函数表
+// 表中的下标即函数id，供程序缓存等需要序列化函数引用的阶段使用，
+// 因此只能在表尾追加新函数
+class BuiltinFunctions {
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  static size_t count();
+  static const char *getName(size_t id);
+  static MathFunc getFunc(size_t id);
+
+  // 按名字查找（不区分大小写），找不到返回npos
+  static size_t findByName(const std::string &name);
+  // 按函数指针查找，找不到返回npos
+  static size_t findByFunc(MathFunc func);
+};
+// 有临时状态的节点（MemoExprNode、RecurrenceExprNode）在EvalContext中的
+// 下标。节点创建时分配、析构时回收，现存节点的下标是稠密的，
+// 上下文按下标把状态保存在数组中，求值时不需要按节点地址查表。
+// 每次分配还得到一个不重复的序号，用来识别下标被回收后的旧状态
+class StateSlot {
+public:
+  StateSlot();
+  ~StateSlot();
+  StateSlot(const StateSlot &) = delete;
+  StateSlot &operator=(const StateSlot &) = delete;
+
+  size_t index() const { return index_; }
+  uint64_t serial() const { return serial_; }
+
+private:
+  size_t index_;
+  uint64_t serial_;
+};
+// 求值上下文
+// 保存参数T的当前值和求值过程中的临时状态（MemoExprNode的缓存、
+// RecurrenceExprNode的递推状态）。AST在解析和优化之后只读，求值只修改
+// 上下文，各线程使用自己的上下文即可并发求值同一个程序
+class EvalContext {
+public:
+  explicit EvalContext(double t = 0.0) : t(t) {}
+
+  // 节点在一个上下文中的临时状态
+  struct NodeState {
+    virtual ~NodeState() = default;
+  };
+
+  // 节点在下标slot处的临时状态，首次访问时创建。
+  // 下标被回收后分给了别的节点时，旧节点留下的状态被丢弃
+  template <typename State> State &getState(const StateSlot &slot) {
+    size_t index = slot.index();
+    if (index >= states_.size()) {
+      states_.resize(index + 1);
+    }
+    auto &entry = states_[index];
+    if (entry.serial != slot.serial() || !entry.state) {
+      entry.serial = slot.serial();
+      entry.state = std::make_unique<State>();
+    }
+    return static_cast<State &>(*entry.state);
+  }
+
+  // 已有的临时状态，不存在时返回nullptr
+  template <typename State>
+  const State *findState(const StateSlot &slot) const {
+    size_t index = slot.index();
+    if (index >= states_.size() || states_[index].serial != slot.serial()) {
+      return nullptr;
+    }
+    return static_cast<const State *>(states_[index].state.get());
+  }
+
+  // 丢弃全部临时状态（释放已不再使用的节点留下的状态）
+  void clearStates() { states_.clear(); }
+
+  double t; // 参数T的当前值
+
+private:
+  struct Entry {
+    uint64_t serial = 0;
+    std::unique_ptr<NodeState> state;
+  };
+  std::vector<Entry> states_;
+};
 // AST节点基类
 class DrawASTNode {
 public:
@@ -66,15 +155,21 @@ public:
   // 获取位置信息
   virtual ASTLocation getLocation() const = 0;
 
-  // 计算表达式值（对于表达式节点）
-  virtual double value() const { return 0.0; }
+  // 在上下文ctx中计算表达式值（对于表达式节点）
+  virtual double evaluate(EvalContext &ctx) const { return 0.0; }
+
+  // 在T为0的新上下文中计算表达式值，用于不依赖T的表达式（常量折叠等）
+  double value() const {
+    EvalContext ctx;
+    return evaluate(ctx);
+  }
 
   // 获取子节点
   virtual DrawASTNode *getChild(size_t index) const { return nullptr; }
   virtual size_t getChildCount() const { return 0; }
-  virtual double childValue(size_t index) const {
+  virtual double childValue(size_t index, EvalContext &ctx) const {
     auto child = getChild(index);
-    return child ? child->value() : 0.0;
+    return child ? child->evaluate(ctx) : 0.0;
   }
 
   // 获取Token信息
@@ -98,24 +193,44 @@ public:
   const Token &getToken() const override { return token_; }
   ASTLocation getLocation() const override { return location_; }
 
+  // 节点id：由ExprPool分配，结构相同的子树共享同一个id，0表示未登记
+  size_t getNodeId() const { return nodeId_; }
+  void setNodeId(size_t id) { nodeId_ = id; }
+
+  // 子表达式的共享指针（优化遍重建表达式时使用）
+  virtual std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const {
+    return nullptr;
+  }
+
+  // 依赖分析：子树中是否出现参数T。构造时由子节点自底向上求出，
+  // 不依赖T的子树在一次FOR-DRAW循环中的值不变
+  bool dependsOnT() const { return tDependent_; }
+
 protected:
+  static bool dependsOnT(const std::shared_ptr<ExpressionNode> &node) {
+    return node && node->dependsOnT();
+  }
+
   Token token_;
   ASTLocation location_;
-  std::vector<std::unique_ptr<ExpressionNode>> children_;
+  size_t nodeId_ = 0;
+  bool tDependent_ = false;
 };
 // 二元表达式节点
 class BinaryExprNode : public ExpressionNode {
 public:
-  BinaryExprNode(const Token &op, std::unique_ptr<ExpressionNode> left,
-                 std::unique_ptr<ExpressionNode> right)
+  BinaryExprNode(const Token &op, std::shared_ptr<ExpressionNode> left,
+                 std::shared_ptr<ExpressionNode> right)
       : ExpressionNode(op, ASTLocation(op.sourceLocation)),
-        left_(std::move(left)), right_(std::move(right)) {}
+        left_(std::move(left)), right_(std::move(right)) {
+    tDependent_ = dependsOnT(left_) || dependsOnT(right_);
+  }
 
   DrawASTNodeType getNodeType() const override {
     return DrawASTNodeType::BinaryExpr;
   }
 
-  double value() const override;
+  double evaluate(EvalContext &ctx) const override;
 
   DrawASTNode *getChild(size_t index) const override {
     if (index == 0)
@@ -126,32 +241,46 @@ public:
   }
   size_t getChildCount() const override { return 2; }
 
-  double leftValue() const { return left_ ? left_->value() : 0.0; }
-  double rightValue() const { return right_ ? right_->value() : 0.0; }
+  double leftValue(EvalContext &ctx) const {
+    return left_ ? left_->evaluate(ctx) : 0.0;
+  }
+  double rightValue(EvalContext &ctx) const {
+    return right_ ? right_->evaluate(ctx) : 0.0;
+  }
 
   ExpressionNode *getLeft() const { return left_.get(); }
   ExpressionNode *getRight() const { return right_.get(); }
 
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    if (index == 0)
+      return left_;
+    if (index == 1)
+      return right_;
+    return nullptr;
+  }
+
   void print(int indent = 0) const override;
   std::string toString() const override;
 
 private:
-  std::unique_ptr<ExpressionNode> left_;
-  std::unique_ptr<ExpressionNode> right_;
+  std::shared_ptr<ExpressionNode> left_;
+  std::shared_ptr<ExpressionNode> right_;
 };
 // 一元表达式节点
 class UnaryExprNode : public ExpressionNode {
 public:
-  UnaryExprNode(const Token &op, std::unique_ptr<ExpressionNode> operand)
+  UnaryExprNode(const Token &op, std::shared_ptr<ExpressionNode> operand)
       : ExpressionNode(op, ASTLocation(op.sourceLocation)),
-        operand_(std::move(operand)) {}
+        operand_(std::move(operand)) {
+    tDependent_ = dependsOnT(operand_);
+  }
 
   DrawASTNodeType getNodeType() const override {
     return DrawASTNodeType::UnaryExpr;
   }
 
-  double value() const override {
-    double v = operand_ ? operand_->value() : 0.0;
+  double evaluate(EvalContext &ctx) const override {
+    double v = operand_ ? operand_->evaluate(ctx) : 0.0;
     if (token_.keyword() == KeywordType::Minus) {
       return -v;
     }
@@ -163,28 +292,34 @@ public:
   }
   size_t getChildCount() const override { return 1; }
 
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    return index == 0 ? operand_ : nullptr;
+  }
+
   void print(int indent = 0) const override;
   std::string toString() const override;
 
 private:
-  std::unique_ptr<ExpressionNode> operand_;
+  std::shared_ptr<ExpressionNode> operand_;
 };
 // 函数调用表达式节点
 class FuncCallExprNode : public ExpressionNode {
 public:
   FuncCallExprNode(const Token &funcToken,
-                   std::unique_ptr<ExpressionNode> argument,
+                   std::shared_ptr<ExpressionNode> argument,
                    MathFunc funcPtr = nullptr)
       : ExpressionNode(funcToken, ASTLocation(funcToken.sourceLocation)),
-        argument_(std::move(argument)), funcPtr_(funcPtr) {}
+        argument_(std::move(argument)), funcPtr_(funcPtr) {
+    tDependent_ = dependsOnT(argument_);
+  }
 
   DrawASTNodeType getNodeType() const override {
     return DrawASTNodeType::FuncCallExpr;
   }
 
-  double value() const override {
+  double evaluate(EvalContext &ctx) const override {
     if (funcPtr_ && argument_) {
-      return funcPtr_(argument_->value());
+      return funcPtr_(argument_->evaluate(ctx));
     }
     return 0.0;
   }
@@ -197,11 +332,15 @@ public:
   }
   size_t getChildCount() const override { return 1; }
 
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    return index == 0 ? argument_ : nullptr;
+  }
+
   void print(int indent = 0) const override;
   std::string toString() const override;
 
 private:
-  std::unique_ptr<ExpressionNode> argument_;
+  std::shared_ptr<ExpressionNode> argument_;
   MathFunc funcPtr_;
 };
 // 常量表达式节点
@@ -230,7 +369,7 @@ public:
     return DrawASTNodeType::ConstExpr;
   }
 
-  double value() const override { return constValue_; }
+  double evaluate(EvalContext &ctx) const override { return constValue_; }
 
   void setValue(double v) { constValue_ = v; }
 
@@ -240,27 +379,22 @@ public:
 private:
   double constValue_;
 };
-// 参数T表达式节点
+// 参数T表达式节点，值取自求值上下文
 class ParamExprNode : public ExpressionNode {
 public:
-  ParamExprNode(const Token &token, double *storage = nullptr)
-      : ExpressionNode(token, ASTLocation(token.sourceLocation)),
-        storage_(storage) {}
+  explicit ParamExprNode(const Token &token)
+      : ExpressionNode(token, ASTLocation(token.sourceLocation)) {
+    tDependent_ = true;
+  }
 
   DrawASTNodeType getNodeType() const override {
     return DrawASTNodeType::ParamExpr;
   }
 
-  double value() const override { return storage_ ? *storage_ : 0.0; }
-
-  void setStorage(double *ptr) { storage_ = ptr; }
-  double *getStorage() const { return storage_; }
+  double evaluate(EvalContext &ctx) const override { return ctx.t; }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
-
-private:
-  double *storage_;
 };
 // 颜色名称表达式节点
 class ColorNameExprNode : public ExpressionNode {
@@ -272,7 +406,7 @@ public:
     return DrawASTNodeType::ColorNameExpr;
   }
 
-  double value() const override { return 0.0; }
+  double evaluate(EvalContext &ctx) const override { return 0.0; }
 
   // 获取RGB值
   void getRGB(double &r, double &g, double &b) const;
@@ -282,6 +416,263 @@ public:
   void print(int indent = 0) const override;
   std::string toString() const override;
 };
+// 缓存表达式节点（公共子表达式消除）
+// 包装一个在同一个采样点内被多次求值的子表达式。表达式的值只取决于T，
+// 因此按T的位模式缓存：T未改变时直接返回上一次的结果。
+// 缓存保存在求值上下文中；子表达式不含T时在每个上下文中只计算一次
+class MemoExprNode : public ExpressionNode {
+public:
+  explicit MemoExprNode(std::shared_ptr<ExpressionNode> inner)
+      : ExpressionNode(inner->getToken(), inner->getLocation()),
+        inner_(std::move(inner)) {
+    tDependent_ = dependsOnT(inner_);
+  }
+
+  // 一个上下文中的缓存
+  struct State : EvalContext::NodeState {
+    bool valid = false;
+    uint64_t tBits = 0;
+    double cached = 0.0;
+    size_t hitCount = 0;
+  };
+
+  DrawASTNodeType getNodeType() const override {
+    return DrawASTNodeType::MemoExpr;
+  }
+
+  double evaluate(EvalContext &ctx) const override;
+
+  DrawASTNode *getChild(size_t index) const override {
+    return index == 0 ? inner_.get() : nullptr;
+  }
+  size_t getChildCount() const override { return 1; }
+
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    return index == 0 ? inner_ : nullptr;
+  }
+
+  ExpressionNode *getInner() const { return inner_.get(); }
+  const StateSlot &getSlot() const { return slot_; }
+
+  // 在ctx中命中缓存的次数，即省去的子表达式求值次数
+  size_t getHitCount(const EvalContext &ctx) const {
+    const State *state = ctx.findState<State>(slot_);
+    return state ? state->hitCount : 0;
+  }
+
+  void print(int indent = 0) const override;
+  std::string toString() const override;
+
+private:
+  std::shared_ptr<ExpressionNode> inner_;
+  StateSlot slot_;
+};
+// 递推求值的表达式形式
+enum class RecurrenceKind {
+  Sin,        // sin(a*T+b)
+  Cos,        // cos(a*T+b)
+  Polynomial, // T的多项式
+};
+// 递推求值表达式节点
+// 在FOR-DRAW的等步长采样上增量计算inner的值，代替逐节点求值：
+//   Sin/Cos：coeffs为{b, a}，每一步把(sin, cos)旋转角度a*h；
+//   Polynomial：coeffs为从常数项开始的系数，每一步用前向差分做degree次加法。
+// 步长h取相邻两次求值的T之差。T不在预期的下一个采样点上（新的一次循环）
+// 或者已连续递推resyncInterval步时，按inner精确求值并重新同步以限制误差。
+// 递推状态保存在求值上下文中，每个上下文独立递推。
+// 递推结果与逐节点求值不是逐位相同的
+class RecurrenceExprNode : public ExpressionNode {
+public:
+  RecurrenceExprNode(std::shared_ptr<ExpressionNode> inner,
+                     RecurrenceKind kind, std::vector<double> coeffs,
+                     size_t resyncInterval)
+      : ExpressionNode(inner->getToken(), inner->getLocation()),
+        inner_(std::move(inner)), kind_(kind), coeffs_(std::move(coeffs)),
+        resyncInterval_(resyncInterval) {
+    tDependent_ = dependsOnT(inner_);
+  }
+
+  // 一个上下文中的递推状态
+  struct State : EvalContext::NodeState {
+    bool valid = false;
+    bool hasStep = false;
+    double lastT = 0.0;
+    double step = 0.0;
+    size_t sinceSync = 0;
+    double cached = 0.0;
+    double sin = 0.0, cos = 0.0;       // 三角函数递推的当前角度
+    double rotSin = 0.0, rotCos = 0.0; // 每一步旋转的角度
+    std::vector<double> diffs;         // 多项式的前向差分表
+    size_t stepCount = 0;
+    size_t syncCount = 0;
+  };
+
+  DrawASTNodeType getNodeType() const override {
+    return DrawASTNodeType::RecurrenceExpr;
+  }
+
+  double evaluate(EvalContext &ctx) const override;
+
+  DrawASTNode *getChild(size_t index) const override {
+    return index == 0 ? inner_.get() : nullptr;
+  }
+  size_t getChildCount() const override { return 1; }
+
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    return index == 0 ? inner_ : nullptr;
+  }
+
+  ExpressionNode *getInner() const { return inner_.get(); }
+  RecurrenceKind getKind() const { return kind_; }
+  const std::vector<double> &getCoefficients() const { return coeffs_; }
+  size_t getResyncInterval() const { return resyncInterval_; }
+  const StateSlot &getSlot() const { return slot_; }
+
+  // 在ctx中递推计算的次数和精确求值（同步）的次数
+  size_t getStepCount(const EvalContext &ctx) const {
+    const State *state = ctx.findState<State>(slot_);
+    return state ? state->stepCount : 0;
+  }
+  size_t getSyncCount(const EvalContext &ctx) const {
+    const State *state = ctx.findState<State>(slot_);
+    return state ? state->syncCount : 0;
+  }
+
+  void print(int indent = 0) const override;
+  std::string toString() const override;
+
+private:
+  void sync(EvalContext &ctx, State &state) const;
+  void advance(State &state) const;
+  double evalPolynomial(double t) const;
+
+  std::shared_ptr<ExpressionNode> inner_;
+  RecurrenceKind kind_;
+  std::vector<double> coeffs_;
+  size_t resyncInterval_;
+  StateSlot slot_;
+};
+// 分段切比雪夫逼近表达式节点
+// 把T的取值范围[bounds.front(), bounds.back()]分为若干段，第i段
+// [bounds[i], bounds[i+1]]上用切比雪夫级数sum(c_j * T_j(u))代替inner，
+// u为T在该段上线性映射到[-1, 1]的值，用Clenshaw递推求值。
+// 系数为空的段（拟合失败，如靠近奇点）以及范围之外的T按inner精确求值。
+// 逼近结果与逐节点求值不是逐位相同的
+class ChebyshevExprNode : public ExpressionNode {
+public:
+  ChebyshevExprNode(std::shared_ptr<ExpressionNode> inner,
+                    std::vector<double> bounds,
+                    std::vector<std::vector<double>> segments)
+      : ExpressionNode(inner->getToken(), inner->getLocation()),
+        inner_(std::move(inner)), bounds_(std::move(bounds)),
+        segments_(std::move(segments)) {
+    tDependent_ = dependsOnT(inner_);
+  }
+
+  DrawASTNodeType getNodeType() const override {
+    return DrawASTNodeType::ChebyshevExpr;
+  }
+
+  double evaluate(EvalContext &ctx) const override;
+
+  DrawASTNode *getChild(size_t index) const override {
+    return index == 0 ? inner_.get() : nullptr;
+  }
+  size_t getChildCount() const override { return 1; }
+
+  std::shared_ptr<ExpressionNode> getSubExpr(size_t index) const override {
+    return index == 0 ? inner_ : nullptr;
+  }
+
+  ExpressionNode *getInner() const { return inner_.get(); }
+  // 分界点为a、b的一段上系数为coeffs的级数在T = t处的值（coeffs不为空）
+  static double evalSegment(const std::vector<double> &coeffs, double a,
+                            double b, double t);
+  // 各段的分界点（比段数多一个）和各段的切比雪夫系数
+  const std::vector<double> &getBounds() const { return bounds_; }
+  const std::vector<std::vector<double>> &getSegments() const {
+    return segments_;
+  }
+
+  void print(int indent = 0) const override;
+  std::string toString() const override;
+
+private:
+  std::shared_ptr<ExpressionNode> inner_;
+  std::vector<double> bounds_;
+  std::vector<std::vector<double>> segments_;
+};
+// 表达式节点池（hash-consing）
+// 按结构（节点类型、运算符、函数指针、常量值、子节点身份）对表达式节点去重，
+// 结构相同的子树只分配一次，整个程序的表达式构成一个DAG。
+// 每个登记的节点获得一个从1开始递增的id，同一份源码多次解析得到的id相同，
+// 后续的缓存阶段可以用它作为键。
+// 结构键不含Token和位置：共享的节点保留第一次出现时的Token和位置，
+// 需要定位某一次使用（如报告诊断）时应使用所在语句的位置
+class ExprPool {
+public:
+  ExprPool() = default;
+
+  // 禁止拷贝（节点id与池绑定）
+  ExprPool(const ExprPool &) = delete;
+  ExprPool &operator=(const ExprPool &) = delete;
+
+  // 节点构造：先按结构查表，命中则直接返回已有节点，否则分配新节点
+  std::shared_ptr<ExpressionNode> makeConst(const Token &token, double value);
+  std::shared_ptr<ExpressionNode> makeParam(const Token &token);
+  std::shared_ptr<ExpressionNode>
+  makeUnary(const Token &op, std::shared_ptr<ExpressionNode> operand);
+  std::shared_ptr<ExpressionNode>
+  makeBinary(const Token &op, std::shared_ptr<ExpressionNode> left,
+             std::shared_ptr<ExpressionNode> right);
+  std::shared_ptr<ExpressionNode>
+  makeFuncCall(const Token &funcToken, std::shared_ptr<ExpressionNode> arg,
+               MathFunc funcPtr);
+
+  // 按id获取节点（id从1开始），不存在时返回nullptr
+  ExpressionNode *getNode(size_t id) const {
+    return (id > 0 && id <= nodes_.size()) ? nodes_[id - 1] : nullptr;
+  }
+
+  // 不同节点的数量
+  size_t size() const { return nodes_.size(); }
+
+  // 查表命中次数，即节省下来的节点分配次数
+  size_t getHitCount() const { return hitCount_; }
+
+  void clear();
+
+private:
+  // 结构键：子节点用指针表示身份（子节点本身已经去重）
+  struct Key {
+    DrawASTNodeType type;
+    KeywordType op;
+    uint64_t payload; // 常量的位模式 / 函数指针
+    const ExpressionNode *left;
+    const ExpressionNode *right;
+    std::string name; // 仅用于未解析的函数（funcPtr为空）
+
+    bool operator==(const Key &other) const {
+      return type == other.type && op == other.op &&
+             payload == other.payload && left == other.left &&
+             right == other.right && name == other.name;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  // 查表，命中返回已有节点，否则返回nullptr
+  std::shared_ptr<ExpressionNode> lookup(const Key &key);
+  // 登记新节点并分配id
+  std::shared_ptr<ExpressionNode> insert(const Key &key,
+                                         std::shared_ptr<ExpressionNode> node);
+
+  std::unordered_map<Key, std::shared_ptr<ExpressionNode>, KeyHash> table_;
+  std::vector<ExpressionNode *> nodes_;
+  size_t hitCount_ = 0;
+};
 // 语句节点基类
 class StatementNode : public DrawASTNode {
 public:
@@ -292,7 +683,8 @@ public:
   ASTLocation getLocation() const override { return location_; }
 
   // 添加表达式子节点
-  void addExpression(std::unique_ptr<ExpressionNode> expr) {
+  // 表达式可能被多个语句共享（见ExprPool），因此使用shared_ptr
+  void addExpression(std::shared_ptr<ExpressionNode> expr) {
     expressions_.push_back(std::move(expr));
   }
 
@@ -301,6 +693,16 @@ public:
     return index < expressions_.size() ? expressions_[index].get() : nullptr;
   }
 
+  // 替换表达式子节点（供优化遍使用）
+  std::shared_ptr<ExpressionNode> getExpressionPtr(size_t index) const {
+    return index < expressions_.size() ? expressions_[index] : nullptr;
+  }
+  void setExpression(size_t index, std::shared_ptr<ExpressionNode> expr) {
+    if (index < expressions_.size()) {
+      expressions_[index] = std::move(expr);
+    }
+  }
+
   DrawASTNode *getChild(size_t index) const override {
     return getExpression(index);
   }
@@ -310,7 +712,7 @@ public:
 protected:
   Token token_;
   ASTLocation location_;
-  std::vector<std::unique_ptr<ExpressionNode>> expressions_;
+  std::vector<std::shared_ptr<ExpressionNode>> expressions_;
 };
 // Origin语句节点
 class OriginStmtNode : public StatementNode {
@@ -326,8 +728,8 @@ public:
   ExpressionNode *getXExpr() const { return getExpression(0); }
   ExpressionNode *getYExpr() const { return getExpression(1); }
 
-  double getX() const { return childValue(0); }
-  double getY() const { return childValue(1); }
+  double getX(EvalContext &ctx) const { return childValue(0, ctx); }
+  double getY(EvalContext &ctx) const { return childValue(1, ctx); }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
@@ -342,8 +744,8 @@ public:
     return DrawASTNodeType::ScaleStmt;
   }
 
-  double getScaleX() const { return childValue(0); }
-  double getScaleY() const { return childValue(1); }
+  double getScaleX(EvalContext &ctx) const { return childValue(0, ctx); }
+  double getScaleY(EvalContext &ctx) const { return childValue(1, ctx); }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
@@ -358,7 +760,7 @@ public:
     return DrawASTNodeType::RotStmt;
   }
 
-  double getAngle() const { return childValue(0); }
+  double getAngle(EvalContext &ctx) const { return childValue(0, ctx); }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
@@ -385,12 +787,19 @@ public:
   ExpressionNode *getXExpr() const { return getExpression(3); }
   ExpressionNode *getYExpr() const { return getExpression(4); }
 
-  double getStart() const { return childValue(0); }
-  double getEnd() const { return childValue(1); }
-  double getStep() const { return childValue(2); }
+  double getStart(EvalContext &ctx) const { return childValue(0, ctx); }
+  double getEnd(EvalContext &ctx) const { return childValue(1, ctx); }
+  double getStep(EvalContext &ctx) const { return childValue(2, ctx); }
+
+  // 对这条语句使用自适应采样（见SemanticConfig::adaptiveSampling）
+  void setAdaptiveSampling(bool enable) { adaptiveSampling_ = enable; }
+  bool usesAdaptiveSampling() const { return adaptiveSampling_; }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
+
+private:
+  bool adaptiveSampling_ = false;
 };
 // Color语句节点
 class ColorStmtNode : public StatementNode {
@@ -414,9 +823,9 @@ public:
   ColorNameExprNode *getColorName() const { return colorName_.get(); }
 
   // RGB模式
-  double getRed() const { return childValue(0); }
-  double getGreen() const { return childValue(1); }
-  double getBlue() const { return childValue(2); }
+  double getRed(EvalContext &ctx) const { return childValue(0, ctx); }
+  double getGreen(EvalContext &ctx) const { return childValue(1, ctx); }
+  double getBlue(EvalContext &ctx) const { return childValue(2, ctx); }
 
   // 获取默认颜色
   static void getDefaultColor(double &r, double &g, double &b) {
@@ -443,12 +852,12 @@ public:
   }
 
   // 获取像素大小
-  double getSize() const { return childValue(0); }
+  double getSize(EvalContext &ctx) const { return childValue(0, ctx); }
 
   // 可选的第二个维度
   bool hasTwoDimensions() const { return getChildCount() == 2; }
-  double getWidth() const { return childValue(0); }
-  double getHeight() const { return childValue(1); }
+  double getWidth(EvalContext &ctx) const { return childValue(0, ctx); }
+  double getHeight(EvalContext &ctx) const { return childValue(1, ctx); }
 
   void print(int indent = 0) const override;
   std::string toString() const override;
@@ -475,6 +884,13 @@ public:
     }
   }
 
+  // 删除所有满足pred的语句，其余语句保持原有顺序，返回删除的语句数
+  template <typename Pred> size_t removeStatements(Pred pred) {
+    return std::erase_if(statements_, [&pred](const auto &stmt) {
+      return pred(static_cast<const StatementNode *>(stmt.get()));
+    });
+  }
+
   // 获取语句
   StatementNode *getStatement(size_t index) const {
     return index < statements_.size() ? statements_[index].get() : nullptr;
@@ -488,6 +904,12 @@ public:
 
   const std::string &getFilename() const { return filename_; }
 
+  // 表达式节点池（解析时启用hash-consing才会设置）
+  void setExprPool(std::shared_ptr<ExprPool> pool) {
+    exprPool_ = std::move(pool);
+  }
+  ExprPool *getExprPool() const { return exprPool_.get(); }
+
   void print(int indent = 0) const override;
   std::string toString() const override;
 
@@ -496,6 +918,7 @@ private:
   std::string filename_;
   ASTLocation location_;
   std::vector<std::unique_ptr<StatementNode>> statements_;
+  std::shared_ptr<ExprPool> exprPool_;
 };
 // AST工具类
 class DrawASTUtils {
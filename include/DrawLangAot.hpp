@@ -0,0 +1,92 @@
+// Draw语言程序的预先编译（AOT）
+// 把程序映像（见DrawLangProgramCache.hpp）转换为一个C++编译单元：每条语句
+// 一个直线型函数，FOR-DRAW为内联了表达式的for循环。用系统的C++编译器
+// 编译为共享库放入缓存目录，解释器按源码哈希找到后dlopen执行，
+// 跳过词法、语法分析和逐节点求值。
+// 生成的代码与ProgramImage::evalSpan的运算顺序相同，编译时关闭浮点
+// 收缩（FMA）和内置函数的常量折叠，调用同一个libm，结果与解释执行逐位相同
+
+#pragma once
+
+#include "DrawLangProgramCache.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace interpreter_exp {
+namespace cache {
+
+// 共享库接口版本，改变AotHost、AotInfo或入口函数时需要递增
+inline constexpr uint32_t kAotAbiVersion = 1;
+
+// 宿主（语义分析器）提供给共享库的接口，以C的调用约定传递，
+// 生成的代码中有相同布局的声明。
+// 语句的效果（状态更新、范围检查、绘制、调试输出）都由宿主完成，
+// 共享库只负责求值表达式和执行固定步长的循环
+struct AotHost {
+  void *context;
+  double *t; // T的存储，非循环部分的表达式在其当前值下求值
+  void (*origin)(void *context, double x, double y);
+  void (*scale)(void *context, double x, double y);
+  void (*rot)(void *context, double angle);
+  // set为0时颜色名称在编译时无法解析，不改变颜色
+  void (*color)(void *context, int set, double r, double g, double b);
+  void (*size)(void *context, double size);
+  // FOR-DRAW开始：检查范围并取出坐标变换{scaleX, scaleY, cos, sin,
+  // originX, originY}。返回0表示不执行；返回1时由共享库执行固定步长的
+  // 循环；返回2表示宿主已经用eval逐点求值完成了循环（自适应采样）
+  int (*beginLoop)(void *context, double start, double end, double step,
+                   double *transform, void (*eval)(double t, double *xy));
+  void (*drawPixel)(void *context, double x, double y);
+  void (*endLoop)(void *context, long points);
+};
+
+// 共享库导出的描述（符号drawlang_aot_info）
+struct AotInfo {
+  uint32_t abiVersion;
+  uint32_t stmtCount;
+  uint64_t versionHash; // interpreterVersionHash()
+  uint64_t sourceHash;
+};
+
+// 把程序映像转换为C++源码，导出drawlang_aot_info和
+// void drawlang_aot_run(const AotHost *host)
+// 含有没有C++对应的内置函数时返回空字符串
+std::string transpileProgram(const ProgramImage &image);
+
+// 用系统的C++编译器（环境变量CXX，默认c++）把源码编译为共享库
+// outPath，失败时返回false，error为编译器的输出
+bool compileSharedObject(const std::string &source, const std::string &outPath,
+                         std::string *error);
+
+// 加载的共享库
+class AotModule {
+public:
+  ~AotModule();
+
+  AotModule(const AotModule &) = delete;
+  AotModule &operator=(const AotModule &) = delete;
+
+  // 加载path并校验接口版本、解释器版本和源码哈希（expectedSourceHash为0时
+  // 不比较），失败时返回nullptr，reason为失败原因（文件不存在时为空）
+  static std::unique_ptr<AotModule> load(const std::string &path,
+                                         uint64_t expectedSourceHash,
+                                         std::string *reason = nullptr);
+
+  const AotInfo &info() const { return *info_; }
+  void run(const AotHost &host) const { run_(&host); }
+
+private:
+  AotModule() = default;
+
+  void *handle_ = nullptr;
+  const AotInfo *info_ = nullptr;
+  void (*run_)(const AotHost *) = nullptr;
+};
+
+// 缓存目录中源码对应的共享库路径，文件名与ProgramCache::entryPath相同
+// 而扩展名为.so
+std::string aotModulePath(const std::string &cacheDir, uint64_t sourceHash);
+
+} // namespace cache
+} // namespace interpreter_exp
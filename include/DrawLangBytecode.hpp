@@ -0,0 +1,156 @@
+// Draw语言表达式的寄存器字节码
+// 把FOR-DRAW的坐标表达式（DAG）编译为一段线性的寄存器指令，每个采样点
+// 只需顺序执行这段指令，代替逐节点的虚函数调用和指针追踪。
+// 求值语义与ExpressionNode::evaluate()逐位相同
+
+#pragma once
+
+#include "DrawLangAST.hpp"
+#include "DrawLangVecMath.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace interpreter_exp {
+namespace semantic {
+
+// 字节码操作。T在求值开始时放入寄存器r0，不需要单独的指令
+enum class Opcode : uint8_t {
+  LoadConst, // r[dst] = consts[a]
+  Neg,       // r[dst] = -r[a]
+  Add,       // r[dst] = r[a] + r[b]
+  Sub,       // r[dst] = r[a] - r[b]
+  Mul,       // r[dst] = r[a] * r[b]
+  Div,       // r[dst] = r[b] != 0 ? r[a] / r[b] : 0
+  Pow,       // r[dst] = pow(r[a], r[b])
+  Call,      // r[dst] = 内置函数func(r[a])
+  SinCos,    // r[dst] = SIN(r[a])，r[b] = COS(r[a])（同一参数的SIN和COS）
+  EvalNode,  // r[dst] = nodes[a]->evaluate()（递推、逼近等自带求值方式的节点）
+};
+
+// 一条指令（8字节）
+struct Instruction {
+  Opcode op;
+  uint8_t func;  // Call的内置函数id；SinCos为SIN的id
+  uint8_t dst;
+  uint8_t func2; // SinCos中COS的id
+  uint16_t a;
+  uint16_t b;
+};
+
+// 编译后的一组表达式
+// 所有表达式共用一段指令，DAG中共享的子表达式只计算一次；
+// 不依赖T的子树在编译时求值为常量。寄存器在值最后一次使用后复用。
+// 同一参数的SIN和COS合并为一条SinCos指令
+class Bytecode {
+public:
+  // 寄存器数上限（求值时在栈上分配）
+  static constexpr size_t kMaxRegisters = 256;
+  // 批量求值时每次处理的T值个数
+  static constexpr size_t kBatchSize = 256;
+
+  // 编译roots（可以含nullptr，按0求值），超出寄存器或常量数上限时返回nullptr
+  static std::unique_ptr<Bytecode>
+  compile(const std::vector<const ast::ExpressionNode *> &roots);
+
+  // 在T = t处求值，结果按roots的顺序写入out。
+  // EvalNode指令把ctx的T设为t后在ctx中求值节点，含EvalNode指令时
+  // ctx不能为nullptr
+  void run(double t, double *out, ast::EvalContext *ctx = nullptr) const;
+
+  // 批量求值：对ts中的n个T值求值，第k个表达式的结果写入out[k][0..n)。
+  // 每个寄存器是kBatchSize个值的数组（结构数组布局），每条指令对整批
+  // 逐元素计算，内层循环可以被编译器向量化；CPU支持时算术指令使用AVX2
+  // 编译的实现（与vecmath的指令集选择相同）。结果与逐点调用run()逐位相同。
+  // EvalNode指令逐个把T写入ctx再在ctx中求值节点，含EvalNode指令时
+  // ctx不能为nullptr。寄存器文件每个线程一份，不同线程可以并发调用
+  void runBatch(const double *ts, size_t n, double *const *out,
+                ast::EvalContext *ctx = nullptr) const;
+
+  // 单精度批量求值：接口与runBatch相同，寄存器为float，内置函数使用
+  // libm的单精度版本。同样的向量宽度下每条指令一次处理的元素数加倍，
+  // 结果的相对误差约为float的精度（2^-24）乘以表达式的条件数
+  void runBatchFloat(const double *ts, size_t n, double *const *out,
+                     ast::EvalContext *ctx = nullptr) const;
+
+  // 批量求值时内置函数改用向量实现（见DrawLangVecMath.hpp），
+  // 此后runBatch的结果与run()不再逐位相同，误差不超过各函数的上界
+  void setVectorMath(bool enable);
+  bool usesVectorMath() const { return !arrayFuncs_.empty(); }
+
+  // 调用内置函数的位置，SinCos指令的两个结果各算一处
+  struct CallSite {
+    size_t instruction;
+    bool second; // SinCos的COS结果（写入r[b]）
+    uint8_t func;
+    const ast::ExpressionNode *node; // 对应的函数调用节点
+  };
+  const std::vector<CallSite> &getCallSites() const { return callSites_; }
+
+  // 批量求值时各调用位置改用指定等级的快速近似（见vecmath::Tier），
+  // tiers与getCallSites()一一对应；nullopt以及没有快速近似的函数
+  // 仍按原来的方式计算。传入空表时取消
+  void setFastMath(const std::vector<std::optional<vecmath::Tier>> &tiers);
+  bool usesFastMath() const { return !fastCalls_.empty(); }
+
+  // 与runBatch相同，但调用位置site的结果加上delta（relative为true时
+  // 乘以1 + delta），用于估计函数的误差对结果的影响
+  void runBatchPerturbed(const double *ts, size_t n, double *const *out,
+                         ast::EvalContext *ctx, size_t site, double delta,
+                         bool relative) const;
+
+  // 反汇编，每行一条指令，最后一行列出结果所在的寄存器
+  std::string disassemble() const;
+
+  size_t getInstructionCount() const { return code_.size(); }
+  size_t getRegisterCount() const { return registerCount_; }
+  size_t getResultCount() const { return results_.size(); }
+
+  // 供本地代码生成（见DrawLangJit.hpp）读取的编译结果
+  const std::vector<Instruction> &getInstructions() const { return code_; }
+  const std::vector<double> &getConstants() const { return consts_; }
+  const std::vector<uint8_t> &getResultRegisters() const { return results_; }
+  ast::MathFunc getFunction(size_t id) const { return funcs_[id]; }
+  // 是否含有EvalNode指令
+  bool hasNodeEvaluations() const { return !nodes_.empty(); }
+
+private:
+  using FloatFunc = float (*)(float);
+
+  // 快速近似时一条Call或SinCos指令使用的数组函数
+  struct FastCall {
+    vecmath::ArrayFunc first = nullptr;  // Call的结果或SinCos的SIN
+    vecmath::ArrayFunc second = nullptr; // SinCos的COS
+    // SinCos两个结果的等级相同时用vecmath::fastSincos一并计算
+    std::optional<vecmath::Tier> fused;
+  };
+
+  struct Perturbation {
+    const CallSite *site;
+    double delta;
+    bool relative;
+  };
+
+  Bytecode() = default;
+
+  template <typename Real>
+  void runBatchImpl(const double *ts, size_t n, double *const *out,
+                    ast::EvalContext *ctx,
+                    const Perturbation *perturb = nullptr) const;
+
+  std::vector<Instruction> code_;
+  std::vector<double> consts_;
+  std::vector<const ast::ExpressionNode *> nodes_;
+  std::vector<ast::MathFunc> funcs_; // 按函数id索引
+  std::vector<vecmath::ArrayFunc> arrayFuncs_; // 同上，没有向量实现的为nullptr
+  std::vector<FloatFunc> floatFuncs_; // 同上，没有单精度版本的为nullptr
+  std::vector<CallSite> callSites_;
+  std::vector<FastCall> fastCalls_; // 按指令下标索引
+  std::vector<uint8_t> results_;
+  size_t registerCount_ = 0;
+};
+
+} // namespace semantic
+} // namespace interpreter_exp
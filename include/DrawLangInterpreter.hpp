@@ -5,10 +5,13 @@
 
 #include "DrawLangAST.hpp"
 #include "DrawLangLexer.hpp"
+#include "DrawLangOptimizer.hpp"
 #include "DrawLangParser.hpp"
+#include "DrawLangProgramCache.hpp"
 #include "DrawLangSemantic.hpp"
 #include "DrawLangUI.hpp"
 #include "ErrorLog.hpp"
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <string>
@@ -34,6 +37,27 @@ public:
     bool traceExecution = false;    // 跟踪执行
     lexer::DrawLangDFAType dfaType =
         lexer::DrawLangDFAType::TableDriven; // DFA类型
+    std::string cacheDir; // 编译结果缓存目录，为空时不使用缓存
+    // 流式执行：每解析完一条语句立即执行，不等待整个文件解析完成
+    bool streamExecution = false;
+    // 解析后对AST运行的优化遍，-O级别的预设见OptimizerConfig::forLevel
+    optimizer::OptimizerConfig optimizer;
+    // 自适应采样：按像素误差调整FOR-DRAW的步长
+    bool adaptiveSampling = false;
+    // 逆序绘制，跳过会被后面的语句覆盖的像素（不用于流式执行）
+    bool reverseOverdraw = false;
+    // 坐标表达式编译为寄存器字节码后求值
+    bool bytecode = false;
+    // FOR-DRAW内层循环生成本地代码（仅x86-64）
+    bool jit = false;
+    // 字节码批量求值时内置函数使用向量实现
+    bool vectorMath = false;
+    // 字节码批量求值的精度，调试输出开启时检查单精度与双精度的差
+    semantic::Precision precision = semantic::Precision::Double;
+    // 字节码批量求值时内置函数使用快速近似，误差按像素控制
+    semantic::FastMath fastMath = semantic::FastMath::Off;
+    // FOR-DRAW求值的工作线程数，0为硬件线程数，1为串行执行
+    int threads = 1;
   };
 
   void setConfig(const Config &config);
@@ -74,7 +98,27 @@ private:
   ~DrawLangApp();
 
   // 内部解释执行方法
-  int doInterpret(lexer::DrawLangLexer *lexer);
+  // sourceHash非0且启用了缓存时，解析成功后将编译结果写入缓存
+  int doInterpret(lexer::DrawLangLexer *lexer, uint64_t sourceHash = 0);
+
+  // 尝试从缓存执行，缓存未命中时返回false。缓存目录中有drawc生成的
+  // 共享库时优先使用，否则使用程序映像
+  bool interpretCached(uint64_t sourceHash);
+
+  // 配置语义分析器并设置绘图回调
+  void setupSemantic(semantic::DrawLangSemanticAnalyzer &semantic);
+
+  // 输出各优化遍的统计（仅在跟踪执行时）
+  void reportOptimizer(const optimizer::Optimizer &opt);
+
+  // 输出自适应采样的点数与固定步长的点数（仅在跟踪执行时）
+  void reportSampling(const semantic::DrawLangSemanticAnalyzer &semantic);
+
+  // 执行结束后的状态汇报
+  int finishExecution(int result);
+
+  // 流式执行时让UI处理一帧以显示已绘制的像素（限制刷新频率）
+  void pumpUI();
 
   // 绘图回调
   void onDrawPixel(double x, double y, const semantic::PixelAttribute &attr);
@@ -87,6 +131,8 @@ private:
   bool isRunning_ = false;
   int errorCount_ = 0;
 
+  std::chrono::steady_clock::time_point lastFrameTime_; // 上次刷新UI的时间
+
   // 组件实例（用于重新执行）
   std::unique_ptr<lexer::DrawLangLexer> lastLexer_;
   std::unique_ptr<parser::DrawLangParser> lastParser_;
@@ -0,0 +1,35 @@
+// Draw语言表达式的区间求值
+// 给定T的取值区间，求表达式在该区间上取值范围的一个保守估计（包含所有可能值），
+// 用于在执行前判断一段采样点是否整体落在画布之外
+
+#pragma once
+
+#include "DrawLangAST.hpp"
+#include <limits>
+
+namespace interpreter_exp {
+namespace semantic {
+
+// 闭区间[lo, hi]
+struct Interval {
+  double lo = -std::numeric_limits<double>::infinity();
+  double hi = std::numeric_limits<double>::infinity();
+
+  Interval() = default;
+  Interval(double value) : lo(value), hi(value) {}
+  Interval(double low, double high) : lo(low), hi(high) {}
+
+  // 整个实数轴：无法给出有效估计（可能为NaN、无穷等）时使用
+  static Interval whole() { return Interval(); }
+
+  // 上下界都是有限值
+  bool isBounded() const;
+};
+
+// 表达式在T取值于t时的取值范围
+// 每一步运算都向外扩展舍入误差，结果可能比真实范围大，但不会漏掉任何可能值。
+// 可能出现NaN的运算（如负数的非整数次幂、除数区间包含0）返回whole()
+Interval evalInterval(const ast::ExpressionNode *expr, Interval t);
+
+} // namespace semantic
+} // namespace interpreter_exp
@@ -0,0 +1,61 @@
+// Draw语言FOR-DRAW内层循环的本地代码生成（x86-64）
+// 把编译好的字节码（见DrawLangBytecode.hpp）连同坐标变换翻译为一段机器码，
+// 放在mmap分配的可执行内存中：对一组T值逐个求x、y并做比例、旋转、平移变换。
+// 只使用SSE2标量双精度指令，运算顺序与树遍历相同，结果逐位相同。
+// 不支持的平台（非x86-64或无法分配可执行内存）上compile返回nullptr，
+// 调用者退回字节码解释执行
+
+#pragma once
+
+#include "DrawLangBytecode.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace interpreter_exp {
+namespace semantic {
+
+// 坐标变换参数，与DrawLangSemanticAnalyzer的变换相同：
+// 先比例变换，再按(cosAngle, sinAngle)顺时针旋转，最后平移
+struct JitTransform {
+  double scaleX, scaleY;
+  double cosAngle, sinAngle;
+  double originX, originY;
+};
+
+class JitKernel {
+public:
+  ~JitKernel();
+  JitKernel(const JitKernel &) = delete;
+  JitKernel &operator=(const JitKernel &) = delete;
+
+  // 当前平台是否支持本地代码生成
+  static bool isSupported();
+
+  // 生成代码。code必须有两个结果（x、y），且不含EvalNode指令；
+  // 设置了环境变量DRAWLANG_PERF_MAP时name写入/tmp/perf-<pid>.map，
+  // 供perf解析生成代码的符号
+  static std::unique_ptr<JitKernel> compile(const Bytecode &code,
+                                            const JitTransform &xf,
+                                            const std::string &name);
+
+  // 对ts中的n个T值求值并变换，第i个点的坐标写入out[2i]、out[2i+1]
+  void run(const double *ts, size_t n, double *out) const {
+    entry_(ts, n, out);
+  }
+
+  size_t getCodeSize() const { return codeSize_; }
+
+private:
+  using Entry = void (*)(const double *, size_t, double *);
+
+  JitKernel() = default;
+
+  void *memory_ = nullptr;
+  size_t mappedSize_ = 0;
+  size_t codeSize_ = 0;
+  Entry entry_ = nullptr;
+};
+
+} // namespace semantic
+} // namespace interpreter_exp
@@ -0,0 +1,350 @@
+// Draw语言AST优化器的声明
+// 在语法分析之后、语义分析之前对表达式树做等价改写，
+// 所有默认启用的改写都保证结果与未优化时逐位相同
+
+#pragma once
+
+#include "DrawLangAST.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+// 优化配置
+struct OptimizerConfig {
+  bool constantFolding = true;   // 常量折叠
+  bool algebraicSimplify = true; // 代数化简（默认只做逐位精确的改写）
+  bool commonSubexpr = true;     // FOR-DRAW的公共子表达式消除
+  // 删除在下一条FOR-DRAW之前被覆盖、或之后没有FOR-DRAW的设置语句。
+  // 绘制结果不变，但执行后语义分析器的状态（如原点）可能不同
+  bool deadStatements = false;
+
+  // 以下改写可能改变舍入结果，需要显式开启
+  // x**n（2 <= n <= maxPowerExponent）展开为乘法链；std::pow即使对n=2
+  // 也不保证正确舍入，因此展开后的结果可能相差1ulp
+  bool expandIntegerPowers = false;
+  int maxPowerExponent = 4;
+  // x/c改为x*(1/c)；c为2的幂时总是精确的，不受此开关影响
+  bool reciprocalDivision = false;
+  // x+0 -> x（x为-0时结果由+0变为-0）
+  bool ignoreSignedZeros = false;
+  // FOR-DRAW中的sin/cos(a*T+b)和T的多项式改为递推求值，
+  // 每recurrenceResync步按原表达式精确求值一次
+  bool recurrences = false;
+  int maxRecurrenceDegree = 4;
+  int recurrenceResync = 64;
+  // FOR-DRAW中开销较大的坐标表达式在循环的T范围上用分段切比雪夫多项式
+  // 逼近，误差上限为chebyshevTolerance个像素（按之前的SCALE换算）
+  bool chebyshev = false;
+  double chebyshevTolerance = 0.01;
+  int chebyshevDegree = 16;
+  int maxChebyshevSegments = 256;
+
+  // 每个优化遍运行后用DrawASTNode::print把程序（逐条优化时为该语句）
+  // 输出到标准输出
+  bool dumpAfterEachPass = false;
+
+  // 按优化级别返回预设配置：
+  //   0：不运行任何优化遍；
+  //   1：默认配置，只做逐位精确的改写（常量折叠、代数化简、CSE）；
+  //   2：在1的基础上删除无用语句，并开启递推求值和切比雪夫逼近
+  //      （坐标的误差远小于一个像素）。
+  // 大于2按2处理，小于0按0处理
+  static OptimizerConfig forLevel(int level);
+
+  // 影响优化结果的选项的规范文本（不含dumpAfterEachPass），两个配置的
+  // 优化结果相同当且仅当文本相同。用作编译结果缓存键的一部分
+  std::string fingerprint() const;
+};
+
+// 表达式节点构造器
+// 给定节点池时经由池构造（保持DAG共享），否则直接分配
+class ExprBuilder {
+public:
+  explicit ExprBuilder(ast::ExprPool *pool = nullptr) : pool_(pool) {}
+
+  std::shared_ptr<ast::ExpressionNode> makeConst(const Token &token,
+                                                 double value);
+  std::shared_ptr<ast::ExpressionNode>
+  makeUnary(const Token &op, std::shared_ptr<ast::ExpressionNode> operand);
+  std::shared_ptr<ast::ExpressionNode>
+  makeBinary(const Token &op, std::shared_ptr<ast::ExpressionNode> left,
+             std::shared_ptr<ast::ExpressionNode> right);
+  std::shared_ptr<ast::ExpressionNode>
+  makeFuncCall(const Token &funcToken, std::shared_ptr<ast::ExpressionNode> arg,
+               ast::MathFunc funcPtr);
+
+  // 用新的子节点重建node，节点类型、运算符和函数保持不变；
+  // 缓存、递推、逼近节点围绕新的内部表达式重建，参数保持不变。
+  // 不会返回nullptr：没有子节点或不认识的节点类型原样返回node
+  std::shared_ptr<ast::ExpressionNode>
+  rebuild(const std::shared_ptr<ast::ExpressionNode> &node,
+          std::shared_ptr<ast::ExpressionNode> first,
+          std::shared_ptr<ast::ExpressionNode> second = nullptr);
+
+private:
+  ast::ExprPool *pool_;
+};
+
+// 优化遍基类
+class OptimizationPass {
+public:
+  virtual ~OptimizationPass() = default;
+
+  virtual const char *getName() const = 0;
+
+  // 优化整个程序，返回是否有修改
+  virtual bool run(ast::ProgramNode *program);
+
+  // 优化单条语句（流式执行时逐条调用），返回是否有修改
+  virtual bool runOnStatement(ast::StatementNode *stmt) = 0;
+
+  // 各改写规则的命中次数
+  const std::map<std::string, size_t> &getCounters() const {
+    return counters_;
+  }
+  size_t getCounter(const std::string &rule) const;
+
+  // 优化说明（如每条语句的收益），格式为"[行:列] 说明"
+  const std::vector<std::string> &getRemarks() const { return remarks_; }
+
+protected:
+  void count(const std::string &rule, size_t n = 1) { counters_[rule] += n; }
+  void remark(const ast::StatementNode *stmt, const std::string &message);
+
+private:
+  std::map<std::string, size_t> counters_;
+  std::vector<std::string> remarks_;
+};
+
+// 表达式改写遍基类
+// 自底向上遍历语句中的表达式，先改写子节点再对父节点调用rewrite()。
+// 改写结果按原节点记录，DAG中被共享的节点只改写一次，共享关系得以保留
+class ExprRewritePass : public OptimizationPass {
+public:
+  explicit ExprRewritePass(ast::ExprPool *pool = nullptr) : builder_(pool) {}
+
+  bool runOnStatement(ast::StatementNode *stmt) override;
+
+protected:
+  // 子节点已改写完毕，返回替换node的节点；不改写时返回node本身
+  virtual std::shared_ptr<ast::ExpressionNode>
+  rewrite(const std::shared_ptr<ast::ExpressionNode> &node) = 0;
+
+  ExprBuilder builder_;
+
+private:
+  std::shared_ptr<ast::ExpressionNode>
+  visit(const std::shared_ptr<ast::ExpressionNode> &node);
+
+  // 同时持有原节点，防止其被释放后地址被新节点复用
+  struct Rewritten {
+    std::shared_ptr<ast::ExpressionNode> original;
+    std::shared_ptr<ast::ExpressionNode> result;
+  };
+  std::unordered_map<const ast::ExpressionNode *, Rewritten> memo_;
+};
+
+// 常量折叠
+// 把不含T的子树（包括对内置函数的调用）替换为一个常量节点。
+// 折叠值由节点自身的value()计算，与运行时的求值语义完全一致
+// （包括除数为0时结果为0的规则）
+class ConstantFoldingPass : public ExprRewritePass {
+public:
+  using ExprRewritePass::ExprRewritePass;
+
+  const char *getName() const override { return "constant-folding"; }
+
+  // 节点是否为常量（缺失的操作数按0求值，也视为常量）
+  static bool isConstant(const ast::ExpressionNode *node);
+
+protected:
+  std::shared_ptr<ast::ExpressionNode>
+  rewrite(const std::shared_ptr<ast::ExpressionNode> &node) override;
+};
+
+// 代数化简与强度削弱
+// 默认规则（逐位精确）：
+//   x*1, 1*x, x/1, x-(+0), x+(-0), x**1 -> x；x**0 -> 1；
+//   x*(-1) -> -x；--x, +x -> x；x/2^k -> x*2^-k
+// 可选规则见OptimizerConfig。每条规则的命中次数记录在计数器中
+class AlgebraicSimplifyPass : public ExprRewritePass {
+public:
+  explicit AlgebraicSimplifyPass(const OptimizerConfig &config,
+                                 ast::ExprPool *pool = nullptr)
+      : ExprRewritePass(pool), config_(config) {}
+
+  const char *getName() const override { return "algebraic-simplify"; }
+
+protected:
+  std::shared_ptr<ast::ExpressionNode>
+  rewrite(const std::shared_ptr<ast::ExpressionNode> &node) override;
+
+private:
+  std::shared_ptr<ast::ExpressionNode>
+  simplifyUnary(const std::shared_ptr<ast::ExpressionNode> &node);
+  std::shared_ptr<ast::ExpressionNode>
+  simplifyBinary(const std::shared_ptr<ast::ExpressionNode> &node);
+
+  // 用平方-乘法构造base**n的乘法链
+  std::shared_ptr<ast::ExpressionNode>
+  makePowerChain(const std::shared_ptr<ast::ExpressionNode> &base, int n,
+                 const Token &opToken);
+
+  OptimizerConfig config_;
+};
+
+// 公共子表达式消除
+// 在FOR-DRAW的x、y两棵表达式树（hash-consing之后是一个DAG）中，
+// 把每个采样点会被求值多次的子表达式包装为MemoExprNode，
+// 同一采样点内只计算一次。计数器和说明中给出每个采样点省去的节点求值次数
+class CommonSubexprPass : public OptimizationPass {
+public:
+  const char *getName() const override { return "common-subexpr"; }
+
+  bool runOnStatement(ast::StatementNode *stmt) override;
+
+private:
+  std::shared_ptr<ast::ExpressionNode>
+  wrapShared(const std::shared_ptr<ast::ExpressionNode> &node);
+
+  std::unordered_map<const ast::ExpressionNode *, size_t> useCount_;
+  std::unordered_map<const ast::ExpressionNode *,
+                     std::shared_ptr<ast::ExpressionNode>>
+      rewritten_;
+  size_t memoCount_ = 0;
+};
+
+// 递推求值
+// 在FOR-DRAW的x、y中识别sin/cos(a*T+b)和次数为2到maxRecurrenceDegree的
+// T的多项式，包装为RecurrenceExprNode，把每个采样点的libm调用或乘法链
+// 换成几次乘加。只包装最大的可识别子树，共享的子树只包装一次
+class RecurrencePass : public OptimizationPass {
+public:
+  explicit RecurrencePass(const OptimizerConfig &config) : config_(config) {}
+
+  const char *getName() const override { return "recurrence"; }
+
+  bool runOnStatement(ast::StatementNode *stmt) override;
+
+private:
+  // 把node表示为T的多项式（系数从常数项开始），不是多项式时返回false
+  bool extractPolynomial(const ast::ExpressionNode *node,
+                         std::vector<double> &coeffs);
+
+  std::shared_ptr<ast::ExpressionNode>
+  wrap(const std::shared_ptr<ast::ExpressionNode> &node);
+
+  OptimizerConfig config_;
+  size_t wrapCount_ = 0;
+  std::unordered_map<const ast::ExpressionNode *, std::vector<double>>
+      polynomials_;
+  std::unordered_map<const ast::ExpressionNode *,
+                     std::shared_ptr<ast::ExpressionNode>>
+      rewritten_;
+};
+
+// 分段切比雪夫逼近
+// 对FOR-DRAW中含有多个函数调用的x、y表达式，在循环的T范围上拟合
+// chebyshevDegree次的切比雪夫级数：在一段上拟合后在循环实际的每个采样点
+// （与执行时一样逐次累加步长得到）检查误差，超过容差时二分该段，
+// 段内采样点过少或段数达到上限时该段改为精确求值。
+// 采样点超过kMaxCheckedSamples的循环不做逼近。
+// 容差按像素给出，用最近一条SCALE语句的比例换算为坐标的误差；
+// 比例或循环范围不是常量时不做逼近
+class ChebyshevPass : public OptimizationPass {
+public:
+  explicit ChebyshevPass(const OptimizerConfig &config) : config_(config) {}
+
+  const char *getName() const override { return "chebyshev"; }
+
+  bool runOnStatement(ast::StatementNode *stmt) override;
+
+private:
+  struct Fit {
+    std::vector<double> bounds;
+    std::vector<std::vector<double>> segments;
+    size_t exactSegments = 0;
+  };
+
+  // 在[a, b]上拟合f，用ts（循环的全部T值，递增）中落在[a, b]内的点检查
+  // 误差，失败时二分，结果追加到fit
+  void fitRange(const ast::ExpressionNode *f, ast::EvalContext &ctx,
+                const std::vector<double> &ts, double a, double b, int depth,
+                Fit &fit);
+
+  // 检查误差时保存的采样点数上限
+  static constexpr double kMaxCheckedSamples = 1 << 22;
+
+  OptimizerConfig config_;
+  double scale_ = 1.0; // 当前的SCALE，0表示不是常量
+  double tolerance_ = 0.0;
+  double minWidth_ = 0.0;
+  int maxDepth_ = 0;
+};
+
+// 无用语句删除
+// 从后向前扫描程序：ORIGIN、SCALE、ROT、COLOR、SIZE设置的状态只被FOR-DRAW
+// 使用，在下一条FOR-DRAW之前被同类语句完全覆盖、或者之后没有FOR-DRAW的
+// 设置语句不影响绘制结果，直接删除，并在说明中给出其位置。
+// SIZE小于1时不生效，只有值为常量且不小于1的SIZE才算完全覆盖。
+// 需要看到整个程序，逐条优化（流式执行）时不做任何修改
+class DeadStatementPass : public OptimizationPass {
+public:
+  const char *getName() const override { return "dead-statement"; }
+
+  bool run(ast::ProgramNode *program) override;
+
+  bool runOnStatement(ast::StatementNode *) override { return false; }
+};
+
+// 一个优化遍的运行统计
+struct PassStats {
+  std::string name;
+  double seconds = 0.0;   // 累计运行时间
+  size_t nodesBefore = 0; // 运行前的节点数（逐条优化时为各语句之和）
+  size_t nodesAfter = 0;  // 运行后的节点数
+  size_t changedRuns = 0; // 有修改的运行次数
+};
+
+// 优化器（优化遍管理器）：按配置依次运行各优化遍，
+// 记录每个优化遍的运行时间和前后的节点数
+class Optimizer {
+public:
+  explicit Optimizer(const OptimizerConfig &config = OptimizerConfig(),
+                     ast::ExprPool *pool = nullptr);
+
+  // 优化整个程序
+  void optimize(ast::ProgramNode *program);
+
+  // 优化单条语句（流式执行时使用）
+  void optimizeStatement(ast::StatementNode *stmt);
+
+  size_t getPassCount() const { return passes_.size(); }
+  OptimizationPass *getPass(size_t index) const {
+    return index < passes_.size() ? passes_[index].get() : nullptr;
+  }
+
+  // 各优化遍的统计，顺序与getPass()相同
+  const std::vector<PassStats> &getStats() const { return stats_; }
+
+  // 从root可达的不同节点数（表达式DAG中共享的节点只算一次）
+  static size_t countNodes(const ast::DrawASTNode *root);
+
+private:
+  // 运行第index个优化遍并记录统计
+  void runPass(size_t index, ast::DrawASTNode *root,
+               const std::function<bool()> &run);
+
+  std::vector<std::unique_ptr<OptimizationPass>> passes_;
+  std::vector<PassStats> stats_;
+  bool dumpAfterEachPass_ = false;
+};
+
+} // namespace optimizer
+} // namespace interpreter_exp
@@ -23,8 +23,13 @@ struct DrawParserConfig {
   bool recoverFromErrors = true; // 是否从错误中恢复
   bool enableWarnings = true;    // 是否启用警告
   size_t maxErrors = 100;        // 最大错误数
+  // 对表达式节点做hash-consing，结构相同的子树只分配一次（见ast::ExprPool）
+  bool hashConsExpressions = true;
 };
 
+// 语句回调：每解析完一条语句即调用，语句仍归AST所有
+using StatementCallback = std::function<void(ast::StatementNode *stmt)>;
+
 // 语法错误信息
 struct DrawParseError {
   std::string message;
@@ -60,9 +65,14 @@ public:
   void setConfig(const DrawParserConfig &config) { config_ = config; }
   const DrawParserConfig &getConfig() const { return config_; }
 
-  // T值存储管理（用于语义分析）
-  double *getTStorage() const { return tStorage_; }
-  void setTStorage(double *ptr) { tStorage_ = ptr; }
+  // 当前解析使用的表达式节点池（未启用hash-consing时为nullptr）
+  ast::ExprPool *getExprPool() const { return exprPool_.get(); }
+
+  // 流式执行：设置后每条语句加入AST时立即回调，调用者可以在解析后续
+  // 语句之前执行它。回调在解析线程中同步调用
+  void setStatementCallback(StatementCallback callback) {
+    statementCallback_ = std::move(callback);
+  }
 
 protected:
   // 递归下降解析方法
@@ -76,11 +86,12 @@ protected:
   std::unique_ptr<ast::SizeStmtNode> sizeStatement();
 
   // 表达式解析
-  std::unique_ptr<ast::ExpressionNode> expression();
-  std::unique_ptr<ast::ExpressionNode> term();
-  std::unique_ptr<ast::ExpressionNode> factor();
-  std::unique_ptr<ast::ExpressionNode> component();
-  std::unique_ptr<ast::ExpressionNode> atom();
+  // 启用hash-consing时表达式节点可能被共享，因此返回shared_ptr
+  std::shared_ptr<ast::ExpressionNode> expression();
+  std::shared_ptr<ast::ExpressionNode> term();
+  std::shared_ptr<ast::ExpressionNode> factor();
+  std::shared_ptr<ast::ExpressionNode> component();
+  std::shared_ptr<ast::ExpressionNode> atom();
 
   // Token操作
   Token fetchToken();
@@ -94,13 +105,19 @@ protected:
   void addError(const std::string &message, const SourceLocation &loc);
 
   // 表达式节点构造
-  std::unique_ptr<ast::ExpressionNode> makeExprNode(const Token &token);
-  std::unique_ptr<ast::ExpressionNode>
-  makeExprNode(const Token &op, std::unique_ptr<ast::ExpressionNode> left,
-               std::unique_ptr<ast::ExpressionNode> right);
-  std::unique_ptr<ast::ExpressionNode>
+  // 启用hash-consing时经由exprPool_构造，结构相同的节点直接复用
+  std::shared_ptr<ast::ExpressionNode> makeExprNode(const Token &token);
+  std::shared_ptr<ast::ExpressionNode>
+  makeExprNode(const Token &op, std::shared_ptr<ast::ExpressionNode> left,
+               std::shared_ptr<ast::ExpressionNode> right);
+  std::shared_ptr<ast::ExpressionNode>
+  makeUnaryNode(const Token &op, std::shared_ptr<ast::ExpressionNode> operand);
+  std::shared_ptr<ast::ExpressionNode>
   makeFuncNode(const Token &funcToken,
-               std::unique_ptr<ast::ExpressionNode> arg);
+               std::shared_ptr<ast::ExpressionNode> arg);
+  std::shared_ptr<ast::ExpressionNode> makeConstNode(const Token &token,
+                                                     double value);
+  std::shared_ptr<ast::ExpressionNode> makeParamNode(const Token &token);
 
   // 调试输出
   void enter(const char *ruleName);
@@ -115,12 +132,11 @@ private:
   Token lastToken_;    // 上一个成功匹配的Token
 
   std::unique_ptr<ast::ProgramNode> astRoot_; // AST根节点
+  std::shared_ptr<ast::ExprPool> exprPool_;   // 表达式节点池（hash-consing）
 
-  double *tStorage_;           // T值存储（默认空间）
-  double defaultTValue_ = 0.0; // 默认T值
-
-  std::vector<DrawParseError> errors_; // 错误列表
-  DrawParserConfig config_;            // 配置
+  std::vector<DrawParseError> errors_;  // 错误列表
+  DrawParserConfig config_;             // 配置
+  StatementCallback statementCallback_; // 语句回调（流式执行）
 
   int indent_ = 0; // 调试缩进
 };
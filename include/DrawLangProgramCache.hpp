@@ -0,0 +1,183 @@
+// Draw语言编译结果缓存的声明
+// 将解析后的程序编译为与地址无关的程序映像并写入缓存目录，
+// 下次运行相同源码时直接mmap映像执行，跳过词法和语法分析
+
+#pragma once
+
+#include "DrawLangAST.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace interpreter_exp {
+namespace cache {
+
+// 解释器版本，参与缓存键的计算；改变求值语义时需要修改
+inline constexpr const char *kInterpreterVersion = "interpreter_exp-1.0";
+// 映像格式版本，改变下面任何一个结构体时需要递增
+inline constexpr uint32_t kImageFormatVersion = 1;
+
+// 映像中的表达式操作
+enum class ImageOp : uint8_t {
+  Const, // value
+  Param, // T
+  Pos,   // +a
+  Neg,   // -a
+  Add,   // a + b
+  Sub,   // a - b
+  Mul,   // a * b
+  Div,   // a / b（除数为0时结果为0，与BinaryExprNode一致）
+  Pow,   // a ** b
+  Call,  // 内置函数func(a)
+};
+
+// 映像中的语句类型
+enum class ImageStmtKind : uint8_t { Origin, Scale, Rot, ForDraw, Color, Size };
+
+// 映像文件头
+// 映像内所有引用都是下标或相对文件头的偏移，因此与加载地址无关
+struct ImageHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t headerSize;
+  uint64_t versionHash; // 解释器版本及内置函数表的哈希
+  uint64_t sourceHash;  // 源码内容哈希
+  uint64_t imageSize;   // 整个映像的字节数
+  uint64_t checksum;    // 文件头之后所有字节的校验和
+  uint64_t exprOffset;
+  uint64_t stmtOffset;
+  uint32_t exprCount;
+  uint32_t stmtCount;
+  uint32_t maxSpanLength; // 最长表达式段的长度（求值所需的寄存器数）
+  uint32_t reserved;
+};
+
+// 扁平化的表达式节点
+// 表达式按段存放，段内节点按拓扑序排列，操作数下标相对段首且小于自身下标
+struct ImageExpr {
+  ImageOp op;
+  uint8_t func; // Call的内置函数id
+  uint16_t reserved;
+  uint32_t a;
+  uint32_t b;
+  uint32_t reserved2;
+  double value; // Const的值
+};
+
+// 表达式段：一组一起求值的节点
+struct ImageSpan {
+  uint32_t begin;
+  uint32_t length;
+};
+
+// 语句
+// ForDraw的start/end/step位于spans[0]，x/y位于spans[1]（每个采样点求值）；
+// 其他语句只用spans[0]。roots是各表达式的根在所属段内的下标
+struct ImageStmt {
+  ImageStmtKind kind;
+  uint8_t rootCount;
+  uint8_t usesColorName;
+  uint8_t reserved;
+  uint32_t line;
+  uint32_t column;
+  uint32_t reserved2;
+  ImageSpan spans[2];
+  uint32_t roots[5];
+  uint32_t reserved3;
+  double rgb[3]; // 颜色名称在编译期解析后的RGB值
+};
+
+// 程序映像（只读视图）
+// 数据可能来自mmap的缓存文件，也可能来自compileProgram生成的内存缓冲区
+class ProgramImage {
+public:
+  ~ProgramImage();
+
+  ProgramImage(const ProgramImage &) = delete;
+  ProgramImage &operator=(const ProgramImage &) = delete;
+
+  const ImageHeader &header() const { return *header_; }
+  size_t getStmtCount() const { return header_->stmtCount; }
+  const ImageStmt &getStmt(size_t index) const { return stmts_[index]; }
+  const ImageExpr &getExpr(size_t index) const { return exprs_[index]; }
+
+  // 求值一个表达式段，结果写入regs（长度至少为span.length）
+  void evalSpan(const ImageSpan &span, double t, double *regs) const;
+
+  // 求值所需的寄存器数
+  size_t getRegisterCount() const { return header_->maxSpanLength; }
+
+  // 原始字节（用于写入缓存文件）
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // 是否来自mmap
+  bool isMapped() const { return mapped_; }
+
+private:
+  friend class ProgramCache;
+  friend std::unique_ptr<ProgramImage>
+  compileProgram(const ast::ProgramNode *program, uint64_t sourceHash);
+
+  ProgramImage() = default;
+
+  // 校验映像的完整性，expectedSourceHash为0时不比较源码哈希
+  bool validate(uint64_t expectedSourceHash, std::string *reason) const;
+  void bind();
+
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::unique_ptr<unsigned char[]> owned_; // 未mmap时持有的数据
+
+  const ImageHeader *header_ = nullptr;
+  const ImageExpr *exprs_ = nullptr;
+  const ImageStmt *stmts_ = nullptr;
+};
+
+// 计算源码内容哈希（FNV-1a 64位），用作缓存的键。
+// options为影响编译结果的选项（如OptimizerConfig::fingerprint()），
+// 选项不同的编译结果使用不同的键；为空时只按源码计算
+uint64_t hashSource(const std::string &source,
+                    const std::string &options = "");
+
+// 解释器版本哈希（包含内置函数表，函数id变化时缓存自动失效）
+uint64_t interpreterVersionHash();
+
+// 将AST编译为程序映像
+// 含有无法序列化的节点（如非内置函数指针）时返回nullptr。
+// 递推和切比雪夫逼近节点的结果与逐点精确求值不同，映像无法重现，
+// 同样返回nullptr，这样的程序不进入缓存
+std::unique_ptr<ProgramImage> compileProgram(const ast::ProgramNode *program,
+                                             uint64_t sourceHash);
+
+// 编译结果缓存
+// 缓存文件名由源码哈希（含编译选项，见hashSource）和解释器版本哈希组成，
+// 损坏或版本不符的条目在加载时
+// 被检测出来并删除，调用者随后重新编译并写入即可
+class ProgramCache {
+public:
+  explicit ProgramCache(const std::string &cacheDir);
+
+  const std::string &getCacheDir() const { return cacheDir_; }
+
+  // 加载缓存的映像，不存在或校验失败时返回nullptr
+  std::unique_ptr<ProgramImage> load(uint64_t sourceHash);
+
+  // 编译并写入缓存，返回编译出的映像（写入失败时仍然返回映像）
+  std::unique_ptr<ProgramImage> store(uint64_t sourceHash,
+                                      const ast::ProgramNode *program);
+
+  // 缓存条目路径
+  std::string entryPath(uint64_t sourceHash) const;
+
+  // 最近一次load失败的原因（未命中时为空）
+  const std::string &getLastError() const { return lastError_; }
+
+private:
+  std::string cacheDir_;
+  std::string lastError_;
+};
+
+} // namespace cache
+} // namespace interpreter_exp
@@ -4,7 +4,11 @@
 #pragma once
 
 #include "DrawLangAST.hpp"
+#include "DrawLangAot.hpp"
 #include "DrawLangParser.hpp"
+#include "DrawLangProgramCache.hpp"
+#include "DrawLangVecMath.hpp"
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -35,6 +39,37 @@ struct PixelAttribute {
   void setSize(double s) { size = s > 0 ? s : 1.0; }
 };
 
+class Bytecode;
+class ThreadPool;
+
+// 字节码批量求值的精度
+enum class Precision {
+  Double,
+  Float,
+  Auto, // 估计单精度的误差足够小时使用单精度
+};
+
+// 内置函数的快速近似（见vecmath::Tier）
+enum class FastMath {
+  Off,
+  Auto, // 每个调用使用误差传播后不超过预算的最便宜等级
+  Coarse,
+  Medium,
+  Fine,
+};
+
+// FOR-DRAW坐标表达式中一个函数调用使用的快速近似
+struct FastMathUse {
+  const ast::ExpressionNode *call; // 函数调用节点（属于执行的程序）
+  // 调用所在FOR-DRAW语句的位置。节点可能被多条语句共享（见ExprPool），
+  // 节点自身的位置是它第一次出现的位置，不能用来定位这次调用
+  ast::ASTLocation location;
+  const char *function;
+  bool approximated;  // false表示任何等级都超出误差预算，使用精确实现
+  vecmath::Tier tier; // approximated为true时有效
+  double errorPixels; // 该调用的误差上界传播到设备坐标后的估计值
+};
+
 // 绘图回调函数类型
 using DrawPixelCallback =
     std::function<void(double x, double y, const PixelAttribute &attr)>;
@@ -43,6 +78,56 @@ using DrawPixelCallback =
 struct SemanticConfig {
   bool enableDebugOutput = true; // 调试输出（默认开启以方便调试）
   bool enableDemoMode = false;   // 是否启用演示模式（Zorro）
+  // 融合范围相同的连续FOR-DRAW循环（只用于run(program)）
+  bool fuseLoops = true;
+  // 画布大小（像素）。都大于0时，FOR-DRAW用区间求值跳过
+  // 整段落在画布之外的采样点
+  int canvasWidth = 0;
+  int canvasHeight = 0;
+  // 自适应采样：FOR-DRAW的STEP只作为初始步长，按变换后相邻两点的距离
+  // 细分或放大步长，使相邻点的距离不超过一个像素（按size放大）。
+  // 也可以用ForDrawStmtNode::setAdaptiveSampling对单条语句开启
+  bool adaptiveSampling = false;
+  // 逆序绘制（需要设置画布大小）：先执行全部设置语句，再从最后一条
+  // FOR-DRAW的最后一个点开始向前绘制，用覆盖位图跳过会被后面的点覆盖的
+  // 像素。最终画面与顺序执行逐像素相同，但回调收到的点不同：部分被覆盖
+  // 的方块拆成单个未覆盖的像素（size为1）。像素按DrawLangUI的方式绘制：
+  // 坐标截断为整数，以其为中心画边长为size（取整）的方块
+  bool reverseOverdraw = false;
+  // FOR-DRAW的坐标表达式编译为寄存器字节码后求值（见DrawLangBytecode.hpp），
+  // 结果与树遍历逐位相同。缓存节点在字节码中展开，不再累计命中次数。
+  // T按块生成，每块的x、y用Bytecode::runBatch批量求出
+  bool bytecode = false;
+  // 采样点较多的FOR-DRAW把内层循环编译为x86-64本地代码（见DrawLangJit.hpp），
+  // 结果与树遍历逐位相同；其他平台上退回字节码解释执行。不用于自适应采样
+  bool jit = false;
+  // 字节码批量求值时内置函数改用向量实现（见DrawLangVecMath.hpp），
+  // 隐含bytecode。结果与树遍历不再逐位相同，误差不超过各函数的ULP上界
+  bool vectorMath = false;
+  // 字节码批量求值的精度（隐含bytecode），见Bytecode::runBatchFloat。
+  // Auto在循环开始前沿整个T范围抽样，比较单、双精度变换后的坐标，
+  // 估计的误差小于floatErrorPixels像素时使用单精度。
+  // 不用于本地代码和自适应采样
+  Precision precision = Precision::Double;
+  double floatErrorPixels = 0.25;
+  // 单精度求值时同时用双精度求值，记录两者变换后坐标的最大差（调试用）
+  bool checkFloat = false;
+  // 字节码批量求值时SIN、COS、EXP、LN、SQRT使用快速近似（隐含bytecode）。
+  // 循环开始前沿整个T范围抽样，估计每个调用的结果变化对变换后坐标的
+  // 影响（灵敏度），乘以各等级的误差上界得到传播后的误差。Auto从最便宜的
+  // 等级开始，逐个提高贡献最大的调用的等级，直到全部调用的误差之和
+  // 小于fastMathErrorPixels像素；指定等级时所有调用都使用该等级。
+  // 不用于本地代码、自适应采样和单精度求值
+  FastMath fastMath = FastMath::Off;
+  double fastMathErrorPixels = 0.5;
+  // FOR-DRAW求值使用的工作线程数，0表示硬件线程数。大于1时采样点较多的
+  // 循环按块（kCullChunkSize个点）提交到线程池，每块使用自己的求值上下文
+  // 和缓冲区求值、剔除、变换，调用线程按T的顺序把各块的点交给绘图回调，
+  // 绘制顺序和坐标与串行执行逐位相同。含递推节点（值依赖上一个采样点）的
+  // 循环、自适应采样和逆序绘制仍串行执行；按块并行求值的循环不参与融合。
+  // run(program)中有多条FOR-DRAW且总采样点较多时还按语句并行，
+  // 见executeParallelStatements
+  int threads = 1;
 };
 
 // Draw语言语义分析器
@@ -59,6 +144,18 @@ public:
   // 遍历AST并执行语义动作（绘图）
   int run(ast::ProgramNode *program);
 
+  // 执行单条语句（流式执行时由语法分析器的语句回调调用）
+  // 按语句顺序逐条调用与对整个程序调用run(program)结果相同
+  int runStatement(ast::StatementNode *stmt);
+
+  // 直接执行程序映像（来自编译结果缓存，见DrawLangProgramCache.hpp）
+  // 与执行对应的AST结果相同
+  int run(const cache::ProgramImage &image);
+
+  // 执行预先编译的共享库（见DrawLangAot.hpp），与执行对应的程序映像
+  // 结果相同
+  int run(const cache::AotModule &module);
+
   // 设置绘图回调
   void setDrawCallback(DrawPixelCallback callback) {
     drawCallback_ = std::move(callback);
@@ -82,6 +179,41 @@ public:
   }
   void setRotation(double angle) { rotAngle_ = angle; }
 
+  // 以融合方式执行的FOR-DRAW语句数
+  size_t getFusedLoopCount() const { return fusedLoopCount_; }
+
+  // 因落在画布之外而跳过的采样点数
+  size_t getCulledSampleCount() const { return culledSampleCount_; }
+
+  // 自适应采样的FOR-DRAW实际绘制的点数，以及按固定步长会绘制的点数
+  size_t getAdaptiveSampleCount() const { return adaptiveSampleCount_; }
+  size_t getFixedStepSampleCount() const { return fixedStepSampleCount_; }
+
+  // 逆序绘制时因已被覆盖而跳过的采样点数
+  size_t getCoveredSampleCount() const { return coveredSampleCount_; }
+
+  // 以本地代码执行的FOR-DRAW语句数
+  size_t getJitLoopCount() const { return jitLoopCount_; }
+
+  // 以单精度求值的FOR-DRAW语句数；开启checkFloat时单精度与双精度
+  // 变换后坐标的最大差（像素）
+  size_t getFloatLoopCount() const { return floatLoopCount_; }
+  double getFloatMaxError() const { return floatMaxError_; }
+
+  // 使用快速近似的FOR-DRAW中每个函数调用的等级，按执行顺序追加
+  const std::vector<FastMathUse> &getFastMathUses() const {
+    return fastMathUses_;
+  }
+
+  // 最近一次执行使用的求值上下文（含递推、缓存节点的统计）
+  const ast::EvalContext &getEvalContext() const { return context_; }
+
+  // 分块并行执行的FOR-DRAW语句数
+  size_t getParallelLoopCount() const { return parallelLoopCount_; }
+
+  // 按语句并行执行的FOR-DRAW语句数
+  size_t getParallelStatementCount() const { return parallelStatementCount_; }
+
   // 配置
   void setConfig(const SemanticConfig &config) { config_ = config; }
   const SemanticConfig &getConfig() const { return config_; }
@@ -96,17 +228,133 @@ private:
   void executeColorStmt(ast::ColorStmtNode *stmt);
   void executeSizeStmt(ast::SizeStmtNode *stmt);
 
-  // 坐标计算
-  void calcCoord(ast::ExpressionNode *xTree, ast::ExpressionNode *yTree,
-                 double *ptrX, double *ptrY);
-
-  // 绘制循环
+  // 执行程序映像中的一条语句，regs为表达式求值用的寄存器
+  void executeImageStmt(const cache::ProgramImage &image,
+                        const cache::ImageStmt &stmt, double *regs);
+
+  // 提供给预先编译的共享库的回调（cache::AotHost）
+  struct AotCallbacks;
+
+  // 一次FOR-DRAW循环使用的坐标变换参数，旋转角的cos/sin在循环入口计算一次
+  struct CoordTransform {
+    double scaleX, scaleY;
+    double cosAngle, sinAngle;
+    double originX, originY;
+  };
+  CoordTransform currentTransform() const;
+
+  // 坐标变换（比例、旋转、平移）
+  static void transformCoord(const CoordTransform &xf, double xVal,
+                             double yVal, double *ptrX, double *ptrY);
+
+  // 两组变换前坐标变换后的最大差。双精度结果不是有限值的点不计入，
+  // 只有单精度结果不是有限值时返回inf
+  static double maxDeviceError(const CoordTransform &xf, const double *xd,
+                               const double *yd, const double *xs,
+                               const double *ys, size_t n);
+
+  // 抽样估计整个循环用单精度求值时变换后坐标的误差（像素）
+  double estimateFloatError(const Bytecode &code, const CoordTransform &xf,
+                            double startVal, double endVal, double stepVal);
+
+  // 在整个循环范围内均匀抽取最多kFloatProbeSamples个T值
+  static std::vector<double> probeSamples(double startVal, double endVal,
+                                          double stepVal);
+
+  // 为code的各调用位置选择快速近似的等级并设置，记录到fastMathUses_，
+  // location为循环所在语句的位置
+  void selectFastMath(Bytecode &code, const CoordTransform &xf,
+                      double startVal, double endVal, double stepVal,
+                      const ast::ASTLocation &location);
+
+  // 按config_.threads创建（或重建）线程池，不需要并行时返回nullptr
+  ThreadPool *threadPool();
+  // 同上，语句级并行执行各条FOR-DRAW的线程池
+  ThreadPool *statementPool();
+
+  // 检查循环参数，返回false表示循环不执行
+  bool checkLoopRange(double startVal, double endVal, double stepVal);
+
+  // 变换后的坐标范围{xMin, xMax, yMin, yMax}
+  struct DeviceBounds {
+    double xMin, xMax, yMin, yMax;
+  };
+
+  // T在[t0, t1]之间时曲线变换后的坐标范围（保守估计），无法估计时返回false
+  static bool deviceBounds(const CoordTransform &xf,
+                           const ast::ExpressionNode *xTree,
+                           const ast::ExpressionNode *yTree, double t0,
+                           double t1, DeviceBounds &bounds);
+
+  // T在[t0, t1]之间时曲线是否整段落在画布之外（保守判断），像素大小为size
+  bool isOffCanvas(const CoordTransform &xf, const ast::ExpressionNode *xTree,
+                   const ast::ExpressionNode *yTree, double t0, double t1,
+                   double size) const;
+
+  // 绘制循环，location为循环所在语句的位置（用于调试输出和统计）
   void drawLoop(ast::ExpressionNode *startTree, ast::ExpressionNode *endTree,
                 ast::ExpressionNode *stepTree, ast::ExpressionNode *xTree,
-                ast::ExpressionNode *yTree);
+                ast::ExpressionNode *yTree, const ast::ASTLocation &location,
+                bool adaptive = false);
+
+  // 自适应采样的绘制循环（只处理stepVal > 0）。evalRaw在当前T值下
+  // 计算变换前的坐标；循环结束后T与固定步长的循环相同
+  void adaptiveLoop(double startVal, double endVal, double stepVal,
+                    const CoordTransform &xf,
+                    const std::function<void(double *, double *)> &evalRaw);
+
+  // 融合执行从first开始的一组FOR-DRAW：相邻的FOR-DRAW范围相同，
+  // 中间只有不依赖T的变换、颜色、大小语句。所有曲线的坐标编译为一段
+  // 字节码（或逐点树遍历），与drawLoop一样按块求值、剔除画布之外的段。
+  // 第一条曲线以外的点缓存到循环结束，缓存的点数不超过
+  // kFuseMaxBufferedPoints。本地代码、单精度、快速近似，以及会按块并行
+  // 求值的循环由drawLoop逐个执行，不融合。返回执行的语句数，
+  // 不能融合（少于两个循环）时返回0
+  size_t executeFusedLoops(ast::ProgramNode *program, size_t first);
+
+  // 语句级并行：调用线程依次执行设置语句，遇到FOR-DRAW时记下当时的
+  // 坐标变换和像素属性，交给一个新的分析器作为任务提交到语句线程池
+  // （同时最多线程池大小条，线程在多次执行间保留），画出的点按块写入
+  // 该语句的缓冲区。每条FOR-DRAW的序号
+  // 是它在程序中的位置，调用线程按序号逐块取走最早的语句的点交给绘图
+  // 回调，重叠的曲线按程序顺序合成，结果（包括最后的T值）与串行执行
+  // 逐位相同。每条语句最多缓存kStatementBufferPoints个点，缓存满时
+  // 等待调用线程取走。
+  // 要求设置语句和循环范围都不依赖T、坐标中没有递推节点，至少有两条
+  // FOR-DRAW且总采样点数不少于kParallelStatementMinSamples，否则返回
+  // false，由调用者融合或串行执行
+  bool executeParallelStatements(ast::ProgramNode *program);
+
+  // 累加执行一条语句的分析器的统计
+  void mergeStats(const DrawLangSemanticAnalyzer &worker);
+
+  // 逆序绘制时的一条FOR-DRAW：执行时的坐标变换和像素属性，
+  // 以及每kCullChunkSize个采样点的起始T值（顺序累加得到）
+  struct ReverseLoop {
+    ast::ExpressionNode *xTree, *yTree;
+    CoordTransform xf;
+    PixelAttribute attr;
+    double step;
+    size_t sampleCount;
+    std::vector<double> chunkStarts;
+  };
+
+  // 逆序绘制整个程序，见SemanticConfig::reverseOverdraw
+  void runReverse(ast::ProgramNode *program);
+  void drawLoopReverse(const ReverseLoop &loop);
+
+  // bounds范围内的点画出的方块在画布上覆盖的像素范围[x0, x1] x [y0, y1]，
+  // 与画布不相交时返回false
+  bool stampRect(const DeviceBounds &bounds, const PixelAttribute &attr,
+                 int rect[4]) const;
+  // 像素范围是否都已被覆盖
+  bool isCovered(const int rect[4]) const;
+  // 只绘制方块中未被覆盖的像素，并标记为已覆盖
+  void stampUncovered(double x, double y, const PixelAttribute &attr);
 
   // 绘制单个像素
   void drawPixel(double x, double y);
+  void drawPixel(double x, double y, const PixelAttribute &attr);
 
   // 演示模式：绘制Zorro图案
   void executeZorroDemo(ast::ProgramNode *program);
@@ -121,8 +369,8 @@ private:
   double scaleY_ = 1.0;
   double rotAngle_ = 0.0;
 
-  // T值存储
-  double tStorage_ = 0.0;
+  // 求值上下文：T的当前值和节点的临时状态
+  ast::EvalContext context_;
 
   // 像素属性
   PixelAttribute attr_;
@@ -132,6 +380,55 @@ private:
 
   // 配置
   SemanticConfig config_;
+
+  size_t fusedLoopCount_ = 0;
+  size_t culledSampleCount_ = 0;
+  size_t adaptiveSampleCount_ = 0;
+  size_t fixedStepSampleCount_ = 0;
+  size_t coveredSampleCount_ = 0;
+  size_t jitLoopCount_ = 0;
+  size_t floatLoopCount_ = 0;
+  double floatMaxError_ = 0.0;
+  size_t parallelLoopCount_ = 0;
+  size_t parallelStatementCount_ = 0;
+  std::vector<FastMathUse> fastMathUses_;
+
+  // 并行求值FOR-DRAW的线程池，第一次需要时创建。
+  // 语句级并行时与执行各语句的分析器共享
+  std::shared_ptr<ThreadPool> pool_;
+  // 语句级并行的线程池，第一次需要时创建。任务在缓存满时会阻塞，
+  // 所以不与pool_共用
+  std::shared_ptr<ThreadPool> statementPool_;
+
+  // 逆序绘制的覆盖位图（按行存储）以及已覆盖的像素数
+  std::vector<uint8_t> coverage_;
+  size_t coveredPixelCount_ = 0;
+
+  // 画布剔除：每次生成的T值个数，以及不再二分的最小段长度
+  static constexpr size_t kCullChunkSize = 1024;
+  static constexpr size_t kCullLeafSize = 16;
+  // 生成本地代码的最少采样点数，点数少时生成代码的开销大于收益
+  static constexpr double kJitMinSamples = 1024;
+  // 分块并行执行的最少采样点数，以及每个工作线程同时求值的块数
+  static constexpr double kParallelMinSamples = 4 * kCullChunkSize;
+  static constexpr size_t kParallelChunksPerThread = 4;
+  // 语句级并行的最少总采样点数，以及每条语句缓存的点数上限
+  static constexpr double kParallelStatementMinSamples =
+      4 * kParallelMinSamples;
+  static constexpr size_t kStatementBufferPoints = 16 * kCullChunkSize;
+  // 融合循环时缓存的点数上限（第一条曲线以外的曲线的点）
+  static constexpr double kFuseMaxBufferedPoints = 1 << 16;
+  // 估计单精度误差的采样点数，以及估计值相对抽样最大误差的放大倍数
+  static constexpr size_t kFloatProbeSamples = 64;
+  static constexpr double kFloatProbeMargin = 2.0;
+  // 估计快速近似误差传播时给调用结果加的扰动（绝对或相对）
+  static constexpr double kFastMathPerturbation = 0x1p-20;
+  // 自适应采样：步长最多放大到整个范围的1/kAdaptiveMinSamples，
+  // 最多细分到STEP的1/kAdaptiveMaxRefine
+  static constexpr double kAdaptiveMinSamples = 64;
+  static constexpr double kAdaptiveMaxRefine = 1024;
+  // 逆序绘制：逐像素检查覆盖的最大面积，更大的范围继续二分
+  static constexpr long kCoverScanLimit = 4096;
 };
 
 // 完整的解释器封装
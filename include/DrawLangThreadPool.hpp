@@ -0,0 +1,74 @@
+// 语义分析器使用的线程池（工作窃取）
+// 每个工作线程有自己的任务队列：工作线程提交的任务放入自己的队列，
+// 其他线程提交的任务轮流放入各队列。工作线程先取自己队列最早的任务，
+// 自己的队列为空时从其他队列窃取。
+// FOR-DRAW的并行求值（见SemanticConfig::threads）把采样点分块提交；
+// 语句级并行的语句提交到另一个线程池（缓存满时会阻塞，同时提交的
+// 语句不超过线程数），分块求值时用wait()等待各块，等待期间执行其他任务
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace interpreter_exp {
+namespace semantic {
+
+class ThreadPool {
+public:
+  // 创建threads个工作线程（至少一个）
+  explicit ThreadPool(size_t threads);
+  // 执行完已提交的任务后结束工作线程
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  // 提交一个任务，返回的future在任务完成后就绪，
+  // 任务抛出的异常由future::get()重新抛出
+  std::future<void> submit(std::function<void()> task);
+
+  // 等待submit()返回的future就绪，等待期间执行队列中的任务。
+  // 在任务中等待其他任务时必须使用wait()而不是future::wait()
+  void wait(const std::future<void> &future);
+
+  // 配置的线程数：大于0时原样返回，否则为硬件线程数（至少为1）
+  static size_t resolveThreadCount(int threads);
+
+private:
+  struct Worker {
+    std::deque<std::packaged_task<void()>> tasks;
+    std::mutex mutex;
+    std::thread thread;
+  };
+
+  // 当前线程在本线程池中的工作线程序号，不是工作线程时返回size()
+  size_t currentWorker() const;
+  // 从序号为self的队列（self为size()时没有自己的队列）取出或窃取
+  // 一个任务执行，没有任务时返回false
+  bool runOne(size_t self);
+  void workerLoop(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> queued_{0}; // 各队列中的任务总数
+  std::atomic<size_t> nextQueue_{0};
+  // 空闲的线程在ready_上等待新任务，wait()还等待任务完成
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  size_t completed_ = 0; // 已完成的任务数
+  size_t waiting_ = 0;   // 在wait()中等待的线程数
+  bool stopping_ = false;
+};
+
+} // namespace semantic
+} // namespace interpreter_exp
@@ -0,0 +1,95 @@
+// Draw语言内置函数的向量化实现
+// 对double数组逐元素计算SIN、COS等内置函数，按CPU在运行时选择AVX2（每次4个）
+// 或SSE2（每次2个）实现，其他平台退回逐个调用libm。
+// 向量实现与libm的结果不一定逐位相同，每个函数的误差上界（与libm结果之差，
+// 以ULP计）见functions()，由vecmath_test在各指令集上验证：
+//   SIN COS LN EXP ATAN  <= 1    LOG  <= 2    TAN ASIN ACOS  <= 3
+//   SQRT ABS CEIL FLOOR  = 0（逐位相同）
+// 两种指令集的实现运算顺序相同且不使用FMA，结果逐位相同。
+// SIN、COS、TAN在|x| > 2^19·π/2时（以及inf、NaN）改用libm计算。
+// 另有SIN、COS、EXP、LN的快速近似（见Tier），以精度换速度
+
+#pragma once
+
+#include "DrawLangAST.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace interpreter_exp {
+namespace vecmath {
+
+// 数组函数：y[i] = f(x[i])，x和y可以是同一数组
+using ArrayFunc = void (*)(const double *x, double *y, size_t n);
+
+void sin(const double *x, double *y, size_t n);
+void cos(const double *x, double *y, size_t n);
+void tan(const double *x, double *y, size_t n);
+void ln(const double *x, double *y, size_t n);
+void exp(const double *x, double *y, size_t n);
+void sqrt(const double *x, double *y, size_t n);
+void abs(const double *x, double *y, size_t n);
+void asin(const double *x, double *y, size_t n);
+void acos(const double *x, double *y, size_t n);
+void atan(const double *x, double *y, size_t n);
+void log(const double *x, double *y, size_t n); // 以10为底
+void ceil(const double *x, double *y, size_t n);
+void floor(const double *x, double *y, size_t n);
+
+// 同时计算sin和cos，共用一次参数归约，结果与分别调用sin、cos相同。
+// s、c可以与x是同一数组，但s和c不能相同
+void sincos(const double *x, double *s, double *c, size_t n);
+using SincosFunc = void (*)(const double *x, double *s, double *c, size_t n);
+
+struct FunctionInfo {
+  const char *name;    // 与BuiltinFunctions中的名字相同
+  ast::MathFunc scalar; // 对应的libm函数
+  ArrayFunc array;
+  int maxUlp; // 与scalar结果之差的上界
+};
+
+// 全部函数，顺序与BuiltinFunctions相同
+const std::vector<FunctionInfo> &functions();
+
+// 按内置函数名查找，没有向量实现时返回nullptr
+const FunctionInfo *find(const char *name);
+
+// 快速近似的精度等级，从便宜到昂贵。多项式阶数较低，误差上界是绝对
+// （或相对）误差而不是ULP，见fastFunctions()：
+//            SIN COS   EXP（相对）  LN
+//   Coarse   2e-5      1e-5         2e-5
+//   Medium   5e-8      2e-7         1e-7
+//   Fine     2e-13     5e-14        5e-12
+// SQRT使用硬件指令，各等级都是精确的。标量平台上各等级都直接调用libm
+enum class Tier { Coarse, Medium, Fine };
+constexpr size_t kTierCount = 3;
+
+struct FastFunctionInfo {
+  const char *name;
+  Tier tier;
+  ArrayFunc array;
+  double maxError; // 与libm结果之差的上界
+  bool relative;   // maxError是相对误差
+};
+
+// 全部快速近似，每个函数按等级从低到高排列
+const std::vector<FastFunctionInfo> &fastFunctions();
+
+// 按内置函数名和等级查找，没有快速近似时返回nullptr
+const FastFunctionInfo *findFast(const char *name, Tier tier);
+
+// 快速近似的sincos，两个结果与对应等级的SIN、COS相同
+void fastSincos(Tier tier, const double *x, double *s, double *c, size_t n);
+
+const char *tierName(Tier tier);
+
+// 指令集选择
+enum class Isa { Scalar, SSE2, AVX2 };
+
+bool isSupported(Isa isa);
+Isa getIsa();
+// 强制使用指定的指令集（供测试和性能对比），不支持时返回false且不改变
+bool setIsa(Isa isa);
+const char *isaName(Isa isa);
+
+} // namespace vecmath
+} // namespace interpreter_exp
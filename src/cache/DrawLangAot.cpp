@@ -0,0 +1,419 @@
+// Draw语言程序预先编译（AOT）的实现
+
+#include "DrawLangAot.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+namespace interpreter_exp {
+namespace cache {
+
+using namespace ast;
+
+namespace {
+
+// 内置函数对应的C++函数，与BuiltinFunctions中的函数指针相同
+struct CxxBuiltin {
+  const char *name;
+  const char *cxx;
+};
+
+const CxxBuiltin kCxxBuiltins[] = {
+    {"SIN", "std::sin"},   {"COS", "std::cos"},     {"TAN", "std::tan"},
+    {"LN", "std::log"},    {"EXP", "std::exp"},     {"SQRT", "std::sqrt"},
+    {"ABS", "std::fabs"},  {"ASIN", "std::asin"},   {"ACOS", "std::acos"},
+    {"ATAN", "std::atan"}, {"LOG", "std::log10"},   {"CEIL", "std::ceil"},
+    {"FLOOR", "std::floor"},
+};
+
+const char *cxxFunction(size_t id) {
+  if (id >= BuiltinFunctions::count()) {
+    return nullptr;
+  }
+  for (const auto &entry : kCxxBuiltins) {
+    if (std::strcmp(entry.name, BuiltinFunctions::getName(id)) == 0) {
+      return entry.cxx;
+    }
+  }
+  return nullptr;
+}
+
+// double的C++字面量：有限值用十六进制浮点数（精确表示），
+// inf和NaN按位构造以保留符号和载荷
+std::string literal(double value) {
+  char buffer[64];
+  if (std::isfinite(value)) {
+    std::snprintf(buffer, sizeof(buffer), "%a", value);
+  } else {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    std::snprintf(buffer, sizeof(buffer), "bitsToDouble(0x%016llxULL)",
+                  static_cast<unsigned long long>(bits));
+  }
+  return buffer;
+}
+
+// 生成的代码中的接口声明，布局必须与DrawLangAot.hpp相同
+const char *kPrelude = R"(#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+struct AotHost {
+  void *context;
+  double *t;
+  void (*origin)(void *context, double x, double y);
+  void (*scale)(void *context, double x, double y);
+  void (*rot)(void *context, double angle);
+  void (*color)(void *context, int set, double r, double g, double b);
+  void (*size)(void *context, double size);
+  int (*beginLoop)(void *context, double start, double end, double step,
+                   double *transform, void (*eval)(double t, double *xy));
+  void (*drawPixel)(void *context, double x, double y);
+  void (*endLoop)(void *context, long points);
+};
+
+struct AotInfo {
+  std::uint32_t abiVersion;
+  std::uint32_t stmtCount;
+  std::uint64_t versionHash;
+  std::uint64_t sourceHash;
+};
+
+namespace {
+
+inline double bitsToDouble(std::uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// 除数为0时结果为0，与BinaryExprNode一致
+inline double divide(double a, double b) { return b != 0.0 ? a / b : 0.0; }
+)";
+
+class Transpiler {
+public:
+  explicit Transpiler(const ProgramImage &image) : image_(image) {}
+
+  bool run(std::ostringstream &os) {
+    const ImageHeader &header = image_.header();
+    os << "// Generated by drawc from a Draw program, do not edit\n"
+       << "// source hash " << hex(header.sourceHash) << ", interpreter "
+       << hex(header.versionHash) << "\n\n"
+       << kPrelude << "\n";
+    for (size_t i = 0; i < image_.getStmtCount(); ++i) {
+      if (!statement(os, i)) {
+        return false;
+      }
+    }
+    os << "} // anonymous namespace\n\n"
+       << "extern \"C\" {\n\n"
+       // 花括号内的const变量默认是内部链接，需要显式extern才能导出
+       << "extern const AotInfo drawlang_aot_info = {" << kAotAbiVersion
+       << "u, " << image_.getStmtCount() << "u, " << hex(header.versionHash)
+       << "ULL, " << hex(header.sourceHash) << "ULL};\n\n"
+       << "void drawlang_aot_run(const AotHost *host) {\n";
+    for (size_t i = 0; i < image_.getStmtCount(); ++i) {
+      os << "  stmt" << i << "(host);\n";
+    }
+    os << "}\n\n} // extern \"C\"\n";
+    return true;
+  }
+
+private:
+  static std::string hex(uint64_t value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "0x%016llx",
+                  static_cast<unsigned long long>(value));
+    return buffer;
+  }
+
+  // 表达式段展开为直线型代码，第i个节点为名为prefix<i>的常量，
+  // 运算顺序与ProgramImage::evalSpan相同
+  bool span(std::ostringstream &os, const ImageSpan &s, const char *prefix,
+            const char *param, const char *indent) {
+    for (uint32_t i = 0; i < s.length; ++i) {
+      const ImageExpr &e = image_.getExpr(s.begin + i);
+      std::string a = prefix + std::to_string(e.a);
+      std::string b = prefix + std::to_string(e.b);
+      os << indent << "const double " << prefix << i << " = ";
+      switch (e.op) {
+      case ImageOp::Const:
+        os << literal(e.value);
+        break;
+      case ImageOp::Param:
+        os << param;
+        break;
+      case ImageOp::Pos:
+        os << a;
+        break;
+      case ImageOp::Neg:
+        os << "-" << a;
+        break;
+      case ImageOp::Add:
+        os << a << " + " << b;
+        break;
+      case ImageOp::Sub:
+        os << a << " - " << b;
+        break;
+      case ImageOp::Mul:
+        os << a << " * " << b;
+        break;
+      case ImageOp::Div:
+        os << "divide(" << a << ", " << b << ")";
+        break;
+      case ImageOp::Pow:
+        os << "std::pow(" << a << ", " << b << ")";
+        break;
+      case ImageOp::Call: {
+        const char *func = cxxFunction(e.func);
+        if (!func) {
+          return false;
+        }
+        os << func << "(" << a << ")";
+        break;
+      }
+      }
+      os << ";\n";
+    }
+    return true;
+  }
+
+  bool statement(std::ostringstream &os, size_t index) {
+    const ImageStmt &stmt = image_.getStmt(index);
+    auto root = [&stmt](size_t i) {
+      return i < stmt.rootCount ? "a" + std::to_string(stmt.roots[i])
+                                : std::string("0.0");
+    };
+
+    if (stmt.kind == ImageStmtKind::ForDraw) {
+      // 自适应采样时宿主逐点调用
+      os << "void eval" << index << "(double t, double *xy) {\n";
+      if (!span(os, stmt.spans[1], "b", "t", "  ")) {
+        return false;
+      }
+      os << "  xy[0] = b" << stmt.roots[3] << ";\n"
+         << "  xy[1] = b" << stmt.roots[4] << ";\n}\n\n";
+    }
+
+    os << "// " << stmt.line << ":" << stmt.column << "\n"
+       << "void stmt" << index << "(const AotHost *host) {\n"
+       << "  const double t0 = *host->t;\n";
+    if (!span(os, stmt.spans[0], "a", "t0", "  ")) {
+      return false;
+    }
+    switch (stmt.kind) {
+    case ImageStmtKind::Origin:
+      os << "  host->origin(host->context, " << root(0) << ", " << root(1)
+         << ");\n";
+      break;
+    case ImageStmtKind::Scale:
+      os << "  host->scale(host->context, " << root(0) << ", " << root(1)
+         << ");\n";
+      break;
+    case ImageStmtKind::Rot:
+      os << "  host->rot(host->context, " << root(0) << ");\n";
+      break;
+    case ImageStmtKind::Color:
+      if (stmt.usesColorName) {
+        os << "  host->color(host->context, " << (stmt.rgb[0] >= 0.0) << ", "
+           << literal(stmt.rgb[0]) << ", " << literal(stmt.rgb[1]) << ", "
+           << literal(stmt.rgb[2]) << ");\n";
+      } else {
+        os << "  host->color(host->context, 1, " << root(0) << ", "
+           << root(1) << ", " << root(2) << ");\n";
+      }
+      break;
+    case ImageStmtKind::Size:
+      os << "  host->size(host->context, " << root(0) << ");\n";
+      break;
+    case ImageStmtKind::ForDraw:
+      // 坐标变换与DrawLangSemanticAnalyzer::transformCoord的运算相同
+      os << "  double xf[6];\n"
+         << "  if (host->beginLoop(host->context, " << root(0) << ", "
+         << root(1) << ", " << root(2) << ", xf, eval" << index
+         << ") != 1) {\n"
+         << "    return;\n"
+         << "  }\n"
+         << "  long points = 0;\n"
+         << "  double t = " << root(0) << ";\n"
+         << "  for (; t <= " << root(1) << "; t += " << root(2) << ") {\n";
+      if (!span(os, stmt.spans[1], "b", "t", "    ")) {
+        return false;
+      }
+      os << "    const double x = b" << stmt.roots[3] << " * xf[0];\n"
+         << "    const double y = b" << stmt.roots[4] << " * xf[1];\n"
+         << "    const double xr = x * xf[2] + y * xf[3];\n"
+         << "    const double yr = y * xf[2] - x * xf[3];\n"
+         << "    host->drawPixel(host->context, xr + xf[4], yr + xf[5]);\n"
+         << "    ++points;\n"
+         << "  }\n"
+         << "  *host->t = t;\n"
+         << "  host->endLoop(host->context, points);\n";
+      break;
+    }
+    os << "}\n\n";
+    return true;
+  }
+
+  const ProgramImage &image_;
+};
+
+#ifndef _WIN32
+// 单引号包围，内部的单引号转义
+std::string shellQuote(const std::string &text) {
+  std::string quoted = "'";
+  for (char c : text) {
+    if (c == '\'') {
+      quoted += "'\\''";
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "'";
+}
+#endif
+
+} // anonymous namespace
+
+std::string transpileProgram(const ProgramImage &image) {
+  std::ostringstream os;
+  if (!Transpiler(image).run(os)) {
+    return {};
+  }
+  return os.str();
+}
+
+bool compileSharedObject(const std::string &source, const std::string &outPath,
+                         std::string *error) {
+#ifdef _WIN32
+  if (error) {
+    *error = "AOT compilation is not supported on this platform";
+  }
+  return false;
+#else
+  // 源码和输出先写入临时文件，编译成功后再改名，避免加载到不完整的文件
+  std::string suffix = "." + std::to_string(::getpid());
+  std::string sourcePath = outPath + suffix + ".cc";
+  std::string tmpPath = outPath + suffix + ".tmp";
+  {
+    std::ofstream file(sourcePath, std::ios::trunc);
+    file << source;
+    if (!file) {
+      if (error) {
+        *error = "cannot write " + sourcePath;
+      }
+      return false;
+    }
+  }
+
+  const char *cxx = std::getenv("CXX");
+  // 关闭浮点收缩和内置函数的常量折叠，使结果与解释执行逐位相同
+  std::string command = std::string(cxx && *cxx ? cxx : "c++") +
+                        " -std=c++17 -O2 -fPIC -shared -ffp-contract=off"
+                        " -fno-builtin -w -o " +
+                        shellQuote(tmpPath) + " " + shellQuote(sourcePath) +
+                        " 2>&1";
+  std::string output;
+  int status = -1;
+  if (FILE *pipe = ::popen(command.c_str(), "r")) {
+    char buffer[256];
+    while (std::fgets(buffer, sizeof(buffer), pipe)) {
+      output += buffer;
+    }
+    status = ::pclose(pipe);
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(sourcePath, ec);
+  if (status != 0) {
+    std::filesystem::remove(tmpPath, ec);
+    if (error) {
+      *error = output.empty() ? "cannot run " + command : output;
+    }
+    return false;
+  }
+  std::filesystem::rename(tmpPath, outPath, ec);
+  if (ec) {
+    std::filesystem::remove(tmpPath, ec);
+    if (error) {
+      *error = "cannot write " + outPath;
+    }
+    return false;
+  }
+  return true;
+#endif
+}
+
+AotModule::~AotModule() {
+#ifndef _WIN32
+  if (handle_) {
+    ::dlclose(handle_);
+  }
+#endif
+}
+
+std::unique_ptr<AotModule> AotModule::load(const std::string &path,
+                                           uint64_t expectedSourceHash,
+                                           std::string *reason) {
+  auto fail = [reason](const std::string &message) {
+    if (reason) {
+      *reason = message;
+    }
+    return nullptr;
+  };
+#ifdef _WIN32
+  (void)path;
+  (void)expectedSourceHash;
+  return fail("AOT modules are not supported on this platform");
+#else
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    return fail("");
+  }
+  auto module = std::unique_ptr<AotModule>(new AotModule());
+  module->handle_ = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!module->handle_) {
+    const char *message = ::dlerror();
+    return fail(message ? message : "dlopen failed");
+  }
+  module->info_ = static_cast<const AotInfo *>(
+      ::dlsym(module->handle_, "drawlang_aot_info"));
+  module->run_ = reinterpret_cast<void (*)(const AotHost *)>(
+      ::dlsym(module->handle_, "drawlang_aot_run"));
+  if (!module->info_ || !module->run_) {
+    return fail("missing entry points");
+  }
+  if (module->info_->abiVersion != kAotAbiVersion) {
+    return fail("ABI version mismatch");
+  }
+  if (module->info_->versionHash != interpreterVersionHash()) {
+    return fail("interpreter version mismatch");
+  }
+  if (expectedSourceHash != 0 &&
+      module->info_->sourceHash != expectedSourceHash) {
+    return fail("source hash mismatch");
+  }
+  return module;
+#endif
+}
+
+std::string aotModulePath(const std::string &cacheDir, uint64_t sourceHash) {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016llx-%016llx.so",
+                static_cast<unsigned long long>(sourceHash),
+                static_cast<unsigned long long>(interpreterVersionHash()));
+  return (std::filesystem::path(cacheDir) / name).string();
+}
+
+} // namespace cache
+} // namespace interpreter_exp
@@ -0,0 +1,626 @@
+// Draw语言编译结果缓存的实现
+
+#include "DrawLangProgramCache.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace interpreter_exp {
+namespace cache {
+
+using namespace ast;
+
+static_assert(sizeof(ImageHeader) == 80, "ImageHeader layout changed");
+static_assert(sizeof(ImageExpr) == 24, "ImageExpr layout changed");
+static_assert(sizeof(ImageStmt) == 80, "ImageStmt layout changed");
+
+namespace {
+
+const char kImageMagic[8] = {'D', 'R', 'A', 'W', 'I', 'M', 'G', '\0'};
+
+// FNV-1a 64位
+uint64_t fnv1a(const void *data, size_t size,
+               uint64_t hash = 0xcbf29ce484222325ULL) {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// 将AST编译为扁平的表达式段
+class ImageBuilder {
+public:
+  // 编译一组表达式到同一个段，返回false表示遇到了无法序列化的节点
+  bool buildSpan(const std::vector<const ExpressionNode *> &roots,
+                 const std::vector<double> &defaults, ImageSpan &span,
+                 uint32_t *rootIndices) {
+    span.begin = static_cast<uint32_t>(exprs_.size());
+    memo_.clear();
+    for (size_t i = 0; i < roots.size(); ++i) {
+      uint32_t index = 0;
+      if (roots[i]) {
+        if (!emit(roots[i], span.begin, index)) {
+          return false;
+        }
+      } else {
+        index = emitConst(defaults[i], span.begin);
+      }
+      rootIndices[i] = index;
+    }
+    span.length = static_cast<uint32_t>(exprs_.size()) - span.begin;
+    maxSpanLength_ = std::max(maxSpanLength_, span.length);
+    return true;
+  }
+
+  std::vector<ImageExpr> &exprs() { return exprs_; }
+  uint32_t maxSpanLength() const { return maxSpanLength_; }
+
+private:
+  uint32_t push(const ImageExpr &expr, uint32_t spanBegin) {
+    exprs_.push_back(expr);
+    return static_cast<uint32_t>(exprs_.size()) - 1 - spanBegin;
+  }
+
+  uint32_t emitConst(double value, uint32_t spanBegin) {
+    ImageExpr expr{};
+    expr.op = ImageOp::Const;
+    expr.value = value;
+    return push(expr, spanBegin);
+  }
+
+  // 缺失的子节点按0处理，与DrawASTNode::childValue一致
+  bool emitOperand(const ExpressionNode *node, uint32_t spanBegin,
+                   uint32_t &out) {
+    if (!node) {
+      out = emitConst(0.0, spanBegin);
+      return true;
+    }
+    return emit(node, spanBegin, out);
+  }
+
+  // 后序遍历，DAG中共享的节点在一个段内只输出一次
+  bool emit(const ExpressionNode *node, uint32_t spanBegin, uint32_t &out) {
+    auto it = memo_.find(node);
+    if (it != memo_.end()) {
+      out = it->second;
+      return true;
+    }
+
+    ImageExpr expr{};
+    switch (node->getNodeType()) {
+    case DrawASTNodeType::ConstExpr:
+      expr.op = ImageOp::Const;
+      expr.value = node->value();
+      break;
+    case DrawASTNodeType::ParamExpr:
+      expr.op = ImageOp::Param;
+      break;
+    case DrawASTNodeType::UnaryExpr: {
+      auto *operand = static_cast<const ExpressionNode *>(node->getChild(0));
+      if (!emitOperand(operand, spanBegin, expr.a)) {
+        return false;
+      }
+      expr.op = node->getToken().keyword() == KeywordType::Minus
+                    ? ImageOp::Neg
+                    : ImageOp::Pos;
+      break;
+    }
+    case DrawASTNodeType::BinaryExpr: {
+      auto *left = static_cast<const ExpressionNode *>(node->getChild(0));
+      auto *right = static_cast<const ExpressionNode *>(node->getChild(1));
+      if (!emitOperand(left, spanBegin, expr.a) ||
+          !emitOperand(right, spanBegin, expr.b)) {
+        return false;
+      }
+      switch (node->getToken().keyword()) {
+      case KeywordType::Plus:
+        expr.op = ImageOp::Add;
+        break;
+      case KeywordType::Minus:
+        expr.op = ImageOp::Sub;
+        break;
+      case KeywordType::Mul:
+        expr.op = ImageOp::Mul;
+        break;
+      case KeywordType::Div:
+        expr.op = ImageOp::Div;
+        break;
+      case KeywordType::Power:
+        expr.op = ImageOp::Pow;
+        break;
+      default:
+        // 未知运算符求值为0
+        expr = ImageExpr{};
+        expr.op = ImageOp::Const;
+        break;
+      }
+      break;
+    }
+    case DrawASTNodeType::FuncCallExpr: {
+      auto *call = static_cast<const FuncCallExprNode *>(node);
+      auto *arg = static_cast<const ExpressionNode *>(call->getChild(0));
+      if (!call->getFuncPtr() || !arg) {
+        // 未解析的函数求值为0
+        expr.op = ImageOp::Const;
+        expr.value = 0.0;
+        break;
+      }
+      size_t id = BuiltinFunctions::findByFunc(call->getFuncPtr());
+      if (id == BuiltinFunctions::npos) {
+        return false;
+      }
+      if (!emit(arg, spanBegin, expr.a)) {
+        return false;
+      }
+      expr.op = ImageOp::Call;
+      expr.func = static_cast<uint8_t>(id);
+      break;
+    }
+    case DrawASTNodeType::MemoExpr: {
+      // 缓存节点只影响AST的求值方式，段内的节点本来就只输出一次
+      auto *inner = static_cast<const MemoExprNode *>(node)->getInner();
+      if (!emit(inner, spanBegin, out)) {
+        return false;
+      }
+      memo_[node] = out;
+      return true;
+    }
+    default:
+      // 包括递推和切比雪夫逼近节点：映像逐点精确求值，
+      // 画出的点与执行AST时不同
+      return false;
+    }
+
+    out = push(expr, spanBegin);
+    memo_[node] = out;
+    return true;
+  }
+
+  std::vector<ImageExpr> exprs_;
+  std::unordered_map<const ExpressionNode *, uint32_t> memo_;
+  uint32_t maxSpanLength_ = 0;
+};
+
+bool compileStmt(ImageBuilder &builder, const StatementNode *stmt,
+                 ImageStmt &out) {
+  out = ImageStmt{};
+  out.line = static_cast<uint32_t>(stmt->getLocation().start.line);
+  out.column = static_cast<uint32_t>(stmt->getLocation().start.column);
+
+  auto expr = [stmt](size_t index) { return stmt->getExpression(index); };
+  std::vector<const ExpressionNode *> roots;
+  std::vector<double> defaults;
+
+  switch (stmt->getNodeType()) {
+  case DrawASTNodeType::OriginStmt:
+    out.kind = ImageStmtKind::Origin;
+    roots = {expr(0), expr(1)};
+    break;
+  case DrawASTNodeType::ScaleStmt:
+    out.kind = ImageStmtKind::Scale;
+    roots = {expr(0), expr(1)};
+    break;
+  case DrawASTNodeType::RotStmt:
+    out.kind = ImageStmtKind::Rot;
+    roots = {expr(0)};
+    break;
+  case DrawASTNodeType::SizeStmt:
+    out.kind = ImageStmtKind::Size;
+    roots = {expr(0)};
+    break;
+  case DrawASTNodeType::ColorStmt: {
+    auto *color = static_cast<const ColorStmtNode *>(stmt);
+    out.kind = ImageStmtKind::Color;
+    if (color->usesColorName()) {
+      out.usesColorName = 1;
+      if (auto *name = color->getColorName()) {
+        name->getRGB(out.rgb[0], out.rgb[1], out.rgb[2]);
+      } else {
+        // 没有颜色名称节点时不改变颜色，用负数标记
+        out.rgb[0] = -1.0;
+      }
+    } else {
+      roots = {expr(0), expr(1), expr(2)};
+    }
+    break;
+  }
+  case DrawASTNodeType::ForDrawStmt: {
+    out.kind = ImageStmtKind::ForDraw;
+    out.rootCount = 5;
+    // 与drawLoop一致：缺失的step按1处理
+    if (!builder.buildSpan({expr(0), expr(1), expr(2)}, {0.0, 0.0, 1.0},
+                           out.spans[0], out.roots)) {
+      return false;
+    }
+    return builder.buildSpan({expr(3), expr(4)}, {0.0, 0.0}, out.spans[1],
+                             out.roots + 3);
+  }
+  default:
+    return false;
+  }
+
+  out.rootCount = static_cast<uint8_t>(roots.size());
+  defaults.assign(roots.size(), 0.0);
+  return builder.buildSpan(roots, defaults, out.spans[0], out.roots);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// ProgramImage
+// ============================================================================
+
+ProgramImage::~ProgramImage() {
+#ifndef _WIN32
+  if (mapped_ && data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+#endif
+}
+
+void ProgramImage::bind() {
+  header_ = reinterpret_cast<const ImageHeader *>(data_);
+  exprs_ = reinterpret_cast<const ImageExpr *>(data_ + header_->exprOffset);
+  stmts_ = reinterpret_cast<const ImageStmt *>(data_ + header_->stmtOffset);
+}
+
+bool ProgramImage::validate(uint64_t expectedSourceHash,
+                            std::string *reason) const {
+  auto fail = [reason](const char *message) {
+    if (reason) {
+      *reason = message;
+    }
+    return false;
+  };
+
+  if (size_ < sizeof(ImageHeader)) {
+    return fail("truncated header");
+  }
+  const auto *header = reinterpret_cast<const ImageHeader *>(data_);
+  if (std::memcmp(header->magic, kImageMagic, sizeof(kImageMagic)) != 0) {
+    return fail("bad magic");
+  }
+  if (header->formatVersion != kImageFormatVersion ||
+      header->headerSize != sizeof(ImageHeader)) {
+    return fail("image format version mismatch");
+  }
+  if (header->versionHash != interpreterVersionHash()) {
+    return fail("interpreter version mismatch");
+  }
+  if (expectedSourceHash != 0 && header->sourceHash != expectedSourceHash) {
+    return fail("source hash mismatch");
+  }
+  if (header->imageSize != size_) {
+    return fail("image size mismatch");
+  }
+  if (fnv1a(data_ + sizeof(ImageHeader), size_ - sizeof(ImageHeader)) !=
+      header->checksum) {
+    return fail("checksum mismatch");
+  }
+
+  // 各段的范围
+  uint64_t exprBytes = uint64_t(header->exprCount) * sizeof(ImageExpr);
+  uint64_t stmtBytes = uint64_t(header->stmtCount) * sizeof(ImageStmt);
+  if (header->exprOffset % alignof(ImageExpr) != 0 ||
+      header->stmtOffset % alignof(ImageStmt) != 0 ||
+      header->exprOffset < sizeof(ImageHeader) ||
+      header->stmtOffset < sizeof(ImageHeader) ||
+      header->exprOffset + exprBytes > size_ ||
+      header->stmtOffset + stmtBytes > size_) {
+    return fail("section out of range");
+  }
+
+  const auto *exprs =
+      reinterpret_cast<const ImageExpr *>(data_ + header->exprOffset);
+  const auto *stmts =
+      reinterpret_cast<const ImageStmt *>(data_ + header->stmtOffset);
+
+  for (uint32_t i = 0; i < header->stmtCount; ++i) {
+    const ImageStmt &stmt = stmts[i];
+    if (stmt.kind > ImageStmtKind::Size || stmt.rootCount > 5) {
+      return fail("bad statement");
+    }
+    size_t spanCount = stmt.kind == ImageStmtKind::ForDraw ? 2 : 1;
+    for (size_t s = 0; s < spanCount; ++s) {
+      const ImageSpan &span = stmt.spans[s];
+      if (uint64_t(span.begin) + span.length > header->exprCount ||
+          span.length > header->maxSpanLength) {
+        return fail("statement span out of range");
+      }
+      // 段内节点的操作数必须指向前面的节点
+      for (uint32_t k = 0; k < span.length; ++k) {
+        const ImageExpr &expr = exprs[span.begin + k];
+        switch (expr.op) {
+        case ImageOp::Const:
+        case ImageOp::Param:
+          break;
+        case ImageOp::Pos:
+        case ImageOp::Neg:
+          if (expr.a >= k) {
+            return fail("bad operand");
+          }
+          break;
+        case ImageOp::Call:
+          if (expr.a >= k || expr.func >= BuiltinFunctions::count()) {
+            return fail("bad function call");
+          }
+          break;
+        case ImageOp::Add:
+        case ImageOp::Sub:
+        case ImageOp::Mul:
+        case ImageOp::Div:
+        case ImageOp::Pow:
+          if (expr.a >= k || expr.b >= k) {
+            return fail("bad operand");
+          }
+          break;
+        default:
+          return fail("bad opcode");
+        }
+      }
+    }
+    for (uint8_t r = 0; r < stmt.rootCount; ++r) {
+      const ImageSpan &span =
+          (stmt.kind == ImageStmtKind::ForDraw && r >= 3) ? stmt.spans[1]
+                                                          : stmt.spans[0];
+      if (stmt.roots[r] >= span.length) {
+        return fail("bad expression root");
+      }
+    }
+  }
+  return true;
+}
+
+void ProgramImage::evalSpan(const ImageSpan &span, double t,
+                            double *regs) const {
+  const ImageExpr *code = exprs_ + span.begin;
+  for (uint32_t i = 0; i < span.length; ++i) {
+    const ImageExpr &e = code[i];
+    switch (e.op) {
+    case ImageOp::Const:
+      regs[i] = e.value;
+      break;
+    case ImageOp::Param:
+      regs[i] = t;
+      break;
+    case ImageOp::Pos:
+      regs[i] = regs[e.a];
+      break;
+    case ImageOp::Neg:
+      regs[i] = -regs[e.a];
+      break;
+    case ImageOp::Add:
+      regs[i] = regs[e.a] + regs[e.b];
+      break;
+    case ImageOp::Sub:
+      regs[i] = regs[e.a] - regs[e.b];
+      break;
+    case ImageOp::Mul:
+      regs[i] = regs[e.a] * regs[e.b];
+      break;
+    case ImageOp::Div:
+      regs[i] = (regs[e.b] != 0.0) ? regs[e.a] / regs[e.b] : 0.0;
+      break;
+    case ImageOp::Pow:
+      regs[i] = std::pow(regs[e.a], regs[e.b]);
+      break;
+    case ImageOp::Call:
+      regs[i] = BuiltinFunctions::getFunc(e.func)(regs[e.a]);
+      break;
+    }
+  }
+}
+
+// ============================================================================
+// 编译
+// ============================================================================
+
+uint64_t hashSource(const std::string &source, const std::string &options) {
+  uint64_t hash = fnv1a(source.data(), source.size());
+  if (!options.empty()) {
+    // 分隔符使源码与选项的不同切分得到不同的哈希
+    hash = fnv1a("", 1, hash);
+    hash = fnv1a(options.data(), options.size(), hash);
+  }
+  return hash;
+}
+
+uint64_t interpreterVersionHash() {
+  static const uint64_t hash = [] {
+    uint64_t h = fnv1a(kInterpreterVersion, std::strlen(kInterpreterVersion));
+    h = fnv1a(&kImageFormatVersion, sizeof(kImageFormatVersion), h);
+    for (size_t i = 0; i < BuiltinFunctions::count(); ++i) {
+      const char *name = BuiltinFunctions::getName(i);
+      h = fnv1a(name, std::strlen(name) + 1, h);
+    }
+    return h;
+  }();
+  return hash;
+}
+
+std::unique_ptr<ProgramImage> compileProgram(const ProgramNode *program,
+                                             uint64_t sourceHash) {
+  if (!program) {
+    return nullptr;
+  }
+
+  ImageBuilder builder;
+  std::vector<ImageStmt> stmts;
+  for (size_t i = 0; i < program->getChildCount(); ++i) {
+    auto *stmt = program->getStatement(i);
+    if (!stmt) {
+      continue;
+    }
+    ImageStmt imageStmt;
+    if (!compileStmt(builder, stmt, imageStmt)) {
+      return nullptr;
+    }
+    stmts.push_back(imageStmt);
+  }
+
+  const auto &exprs = builder.exprs();
+  size_t exprOffset = alignUp(sizeof(ImageHeader), alignof(ImageExpr));
+  size_t stmtOffset = alignUp(exprOffset + exprs.size() * sizeof(ImageExpr),
+                              alignof(ImageStmt));
+  size_t imageSize = stmtOffset + stmts.size() * sizeof(ImageStmt);
+
+  auto image = std::unique_ptr<ProgramImage>(new ProgramImage());
+  image->owned_ = std::make_unique<unsigned char[]>(imageSize);
+  unsigned char *buffer = image->owned_.get();
+  std::memset(buffer, 0, imageSize);
+  if (!exprs.empty()) {
+    std::memcpy(buffer + exprOffset, exprs.data(),
+                exprs.size() * sizeof(ImageExpr));
+  }
+  if (!stmts.empty()) {
+    std::memcpy(buffer + stmtOffset, stmts.data(),
+                stmts.size() * sizeof(ImageStmt));
+  }
+
+  ImageHeader header{};
+  std::memcpy(header.magic, kImageMagic, sizeof(kImageMagic));
+  header.formatVersion = kImageFormatVersion;
+  header.headerSize = sizeof(ImageHeader);
+  header.versionHash = interpreterVersionHash();
+  header.sourceHash = sourceHash;
+  header.imageSize = imageSize;
+  header.exprOffset = exprOffset;
+  header.stmtOffset = stmtOffset;
+  header.exprCount = static_cast<uint32_t>(exprs.size());
+  header.stmtCount = static_cast<uint32_t>(stmts.size());
+  header.maxSpanLength = builder.maxSpanLength();
+  header.checksum = fnv1a(buffer + sizeof(ImageHeader),
+                          imageSize - sizeof(ImageHeader));
+  std::memcpy(buffer, &header, sizeof(header));
+
+  image->data_ = buffer;
+  image->size_ = imageSize;
+  image->bind();
+  return image;
+}
+
+// ============================================================================
+// ProgramCache
+// ============================================================================
+
+ProgramCache::ProgramCache(const std::string &cacheDir) : cacheDir_(cacheDir) {}
+
+std::string ProgramCache::entryPath(uint64_t sourceHash) const {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016llx-%016llx.dlimg",
+                static_cast<unsigned long long>(sourceHash),
+                static_cast<unsigned long long>(interpreterVersionHash()));
+  return (std::filesystem::path(cacheDir_) / name).string();
+}
+
+std::unique_ptr<ProgramImage> ProgramCache::load(uint64_t sourceHash) {
+  lastError_.clear();
+  std::string path = entryPath(sourceHash);
+
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    return nullptr;
+  }
+
+  auto image = std::unique_ptr<ProgramImage>(new ProgramImage());
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    lastError_ = "cannot open cache entry";
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    lastError_ = "empty cache entry";
+    std::filesystem::remove(path, ec);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    lastError_ = "mmap failed";
+    return nullptr;
+  }
+  image->data_ = static_cast<const unsigned char *>(addr);
+  image->size_ = size;
+  image->mapped_ = true;
+#else
+  // 没有mmap的平台退化为整体读入
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  size_t size = file ? static_cast<size_t>(file.tellg()) : 0;
+  image->owned_ = std::make_unique<unsigned char[]>(size > 0 ? size : 1);
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(image->owned_.get()), size);
+  image->data_ = image->owned_.get();
+  image->size_ = size;
+#endif
+
+  if (!image->validate(sourceHash, &lastError_)) {
+    // 损坏或版本不符的条目直接删除，调用者会重新编译
+    image.reset();
+    std::filesystem::remove(path, ec);
+    return nullptr;
+  }
+
+  image->bind();
+  return image;
+}
+
+std::unique_ptr<ProgramImage> ProgramCache::store(uint64_t sourceHash,
+                                                  const ProgramNode *program) {
+  auto image = compileProgram(program, sourceHash);
+  if (!image) {
+    return nullptr;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(cacheDir_, ec);
+
+  // 先写临时文件再改名，避免其他进程读到写了一半的条目
+  std::string path = entryPath(sourceHash);
+  std::string tmpPath = path + ".tmp";
+#ifndef _WIN32
+  tmpPath += "." + std::to_string(::getpid());
+#endif
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return image;
+    }
+    file.write(reinterpret_cast<const char *>(image->data()),
+               static_cast<std::streamsize>(image->size()));
+    if (!file) {
+      file.close();
+      std::filesystem::remove(tmpPath, ec);
+      return image;
+    }
+  }
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmpPath, ec);
+  }
+  return image;
+}
+
+} // namespace cache
+} // namespace interpreter_exp
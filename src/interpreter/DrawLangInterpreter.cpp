@@ -84,10 +84,21 @@ int DrawLangApp::interpretFile(const std::string &filePath) {
     ui_->showMessage(0, "File loaded, starting interpretation...");
   }
 
+  // 命中编译结果缓存时直接执行，跳过词法和语法分析。
+  // 缓存的是优化后的程序，键中包含优化配置
+  uint64_t sourceHash = 0;
+  if (!config_.cacheDir.empty()) {
+    sourceHash =
+        cache::hashSource(source, config_.optimizer.fingerprint());
+    if (interpretCached(sourceHash)) {
+      return errorCount_;
+    }
+  }
+
   // 创建词法分析器
   auto lexer = createDrawLangLexerFromString(source, config_.dfaType, filePath);
 
-  return doInterpret(lexer.get());
+  return doInterpret(lexer.get(), sourceHash);
 }
 
 int DrawLangApp::interpretString(const std::string &source,
@@ -103,11 +114,20 @@ int DrawLangApp::interpretString(const std::string &source,
     ui_->clearCanvas();
   }
 
+  uint64_t sourceHash = 0;
+  if (!config_.cacheDir.empty()) {
+    sourceHash =
+        cache::hashSource(source, config_.optimizer.fingerprint());
+    if (interpretCached(sourceHash)) {
+      return errorCount_;
+    }
+  }
+
   // 创建词法分析器
   auto lexer =
       createDrawLangLexerFromString(source, config_.dfaType, sourceName);
 
-  return doInterpret(lexer.get());
+  return doInterpret(lexer.get(), sourceHash);
 }
 
 int DrawLangApp::reinterpret() {
@@ -121,7 +141,7 @@ int DrawLangApp::reinterpret() {
   return interpretFile(sourceFilePath_);
 }
 
-int DrawLangApp::doInterpret(DrawLangLexer *lexer) {
+int DrawLangApp::doInterpret(DrawLangLexer *lexer, uint64_t sourceHash) {
   isRunning_ = true;
 
   if (ui_) {
@@ -140,20 +160,31 @@ int DrawLangApp::doInterpret(DrawLangLexer *lexer) {
 
     // 创建语义分析器
     DrawLangSemanticAnalyzer semantic(&parser);
+    setupSemantic(semantic);
 
-    // 配置
-    SemanticConfig semConfig;
-    semConfig.enableDebugOutput = config_.enableDebugOutput;
-    semConfig.enableDemoMode = config_.enableDemoMode;
-    semantic.setConfig(semConfig);
-
-    // 设置绘图回调
-    semantic.setDrawCallback(
-        [this](double x, double y, const semantic::PixelAttribute &attr) {
-          onDrawPixel(x, y, attr);
-        });
-
-    // 现在解析 - ParamExprNode将使用semantic的tStorage_
+    // 优化器在第一条语句解析出来之后创建，此时节点池已经存在
+    std::unique_ptr<optimizer::Optimizer> opt;
+
+    // 流式执行：每条语句加入AST后立即优化并执行
+    if (config_.streamExecution) {
+      if (ui_) {
+        ui_->setStatus("Executing...");
+      }
+      // 第一条语句执行后立即刷新，尽早显示第一个像素
+      lastFrameTime_ = {};
+      parser.setStatementCallback(
+          [this, &semantic, &parser, &opt](StatementNode *stmt) {
+            if (!opt) {
+              opt = std::make_unique<optimizer::Optimizer>(
+                  config_.optimizer, parser.getExprPool());
+            }
+            opt->optimizeStatement(stmt);
+            semantic.runStatement(stmt);
+            pumpUI();
+          });
+    }
+
+    // 现在解析，T的值由semantic的求值上下文提供
     auto program = parser.parse();
 
     if (!program) {
@@ -179,6 +210,31 @@ int DrawLangApp::doInterpret(DrawLangLexer *lexer) {
       }
     }
 
+    // 优化AST（流式执行时已经逐条优化过）
+    if (!config_.streamExecution) {
+      opt = std::make_unique<optimizer::Optimizer>(config_.optimizer,
+                                                   program->getExprPool());
+      opt->optimize(program.get());
+    }
+    if (opt) {
+      reportOptimizer(*opt);
+    }
+
+    // 没有语法错误时写入编译结果缓存，供下次运行直接使用
+    if (sourceHash != 0 && !config_.cacheDir.empty() && parseErrors.empty()) {
+      cache::ProgramCache programCache(config_.cacheDir);
+      if (!programCache.store(sourceHash, program.get())) {
+        ErrLog::logPrint("Program cannot be cached, skip writing {}\n",
+                         programCache.entryPath(sourceHash));
+      }
+    }
+
+    // 流式执行时所有语句已在解析过程中执行完毕
+    if (config_.streamExecution) {
+      reportSampling(semantic);
+      return finishExecution(0);
+    }
+
     if (ui_) {
       ui_->setStatus("Executing...");
       ui_->showMessage(0, "Parsing completed. Executing...");
@@ -186,24 +242,63 @@ int DrawLangApp::doInterpret(DrawLangLexer *lexer) {
 
     // 执行
     int result = semantic.run(program.get());
+    reportSampling(semantic);
 
-    errorCount_ = ErrLog::error_count();
+    return finishExecution(result);
 
+  } catch (const std::exception &e) {
+    errorCount_++;
+    std::string errorMsg = std::string("Exception: ") + e.what();
+    ErrLog::error(errorMsg);
     if (ui_) {
-      if (result == 0 && errorCount_ == 0) {
-        ui_->showMessage(0, "Execution completed successfully.");
-        ui_->setStatus("Completed");
-      } else {
-        std::ostringstream oss;
-        oss << "Execution completed with " << errorCount_ << " error(s).";
-        ui_->showMessage(1, oss.str());
-        ui_->setStatus("Completed with errors");
+      ui_->showMessage(1, errorMsg);
+      ui_->setStatus("Error");
+    }
+    isRunning_ = false;
+    return 1;
+  }
+}
+
+bool DrawLangApp::interpretCached(uint64_t sourceHash) {
+  std::string modulePath = cache::aotModulePath(config_.cacheDir, sourceHash);
+  std::string reason;
+  auto module = cache::AotModule::load(modulePath, sourceHash, &reason);
+  if (!module && !reason.empty()) {
+    // 共享库不删除（可能由drawc生成），退回程序映像
+    ErrLog::logPrint("Ignore AOT module {}: {}\n", modulePath, reason);
+  }
+
+  cache::ProgramCache programCache(config_.cacheDir);
+  std::unique_ptr<cache::ProgramImage> image;
+  if (!module) {
+    image = programCache.load(sourceHash);
+    if (!image) {
+      // 损坏或版本不符的条目已被删除，随后会重新编译
+      if (!programCache.getLastError().empty()) {
+        ErrLog::logPrint("Discard cache entry {}: {}\n",
+                         programCache.entryPath(sourceHash),
+                         programCache.getLastError());
       }
-      ui_->refresh();
+      return false;
     }
+  }
 
-    isRunning_ = false;
-    return errorCount_;
+  isRunning_ = true;
+
+  if (ui_) {
+    ui_->setStatus("Executing...");
+    ui_->showMessage(0, module ? "Using AOT module. Executing..."
+                               : "Using cached program image. Executing...");
+  }
+
+  try {
+    DrawLangSemanticAnalyzer semantic;
+    setupSemantic(semantic);
+
+    int result = module ? semantic.run(*module) : semantic.run(*image);
+    reportSampling(semantic);
+
+    finishExecution(result);
 
   } catch (const std::exception &e) {
     errorCount_++;
@@ -214,8 +309,102 @@ int DrawLangApp::doInterpret(DrawLangLexer *lexer) {
       ui_->setStatus("Error");
     }
     isRunning_ = false;
-    return 1;
   }
+
+  return true;
+}
+
+void DrawLangApp::setupSemantic(DrawLangSemanticAnalyzer &semantic) {
+  // 配置
+  SemanticConfig semConfig;
+  semConfig.enableDebugOutput = config_.enableDebugOutput;
+  semConfig.enableDemoMode = config_.enableDemoMode;
+  semConfig.adaptiveSampling = config_.adaptiveSampling;
+  semConfig.reverseOverdraw = config_.reverseOverdraw;
+  semConfig.bytecode = config_.bytecode;
+  semConfig.jit = config_.jit;
+  semConfig.vectorMath = config_.vectorMath;
+  semConfig.precision = config_.precision;
+  semConfig.checkFloat = config_.enableDebugOutput;
+  semConfig.fastMath = config_.fastMath;
+  semConfig.threads = config_.threads;
+  // 画布之外的点不会显示，执行时直接跳过
+  if (ui_) {
+    semConfig.canvasWidth = ui_->getCanvasWidth();
+    semConfig.canvasHeight = ui_->getCanvasHeight();
+  }
+  semantic.setConfig(semConfig);
+
+  // 设置绘图回调
+  semantic.setDrawCallback(
+      [this](double x, double y, const semantic::PixelAttribute &attr) {
+        onDrawPixel(x, y, attr);
+      });
+}
+
+void DrawLangApp::reportOptimizer(const optimizer::Optimizer &opt) {
+  if (!config_.traceExecution) {
+    return;
+  }
+
+  for (size_t i = 0; i < opt.getPassCount(); ++i) {
+    const auto *pass = opt.getPass(i);
+    const auto &stats = opt.getStats()[i];
+    ErrLog::logPrint("// {}: {:.3f} ms, {} -> {} nodes\n", stats.name,
+                     stats.seconds * 1000, stats.nodesBefore,
+                     stats.nodesAfter);
+    for (const auto &[rule, hits] : pass->getCounters()) {
+      ErrLog::logPrint("// {}: {} = {}\n", pass->getName(), rule, hits);
+    }
+    for (const auto &remark : pass->getRemarks()) {
+      ErrLog::logPrint("// {}: {}\n", pass->getName(), remark);
+    }
+  }
+}
+
+void DrawLangApp::reportSampling(const DrawLangSemanticAnalyzer &semantic) {
+  if (!config_.traceExecution || !config_.adaptiveSampling) {
+    return;
+  }
+  ErrLog::logPrint("// adaptive sampling: {} samples (fixed step: {})\n",
+                   semantic.getAdaptiveSampleCount(),
+                   semantic.getFixedStepSampleCount());
+}
+
+int DrawLangApp::finishExecution(int result) {
+  errorCount_ = ErrLog::error_count();
+
+  if (ui_) {
+    if (result == 0 && errorCount_ == 0) {
+      ui_->showMessage(0, "Execution completed successfully.");
+      ui_->setStatus("Completed");
+    } else {
+      std::ostringstream oss;
+      oss << "Execution completed with " << errorCount_ << " error(s).";
+      ui_->showMessage(1, oss.str());
+      ui_->setStatus("Completed with errors");
+    }
+    ui_->refresh();
+  }
+
+  isRunning_ = false;
+  return errorCount_;
+}
+
+void DrawLangApp::pumpUI() {
+  if (!ui_) {
+    return;
+  }
+
+  // 约60帧每秒，避免每条语句都渲染一帧拖慢解析
+  auto now = std::chrono::steady_clock::now();
+  if (now - lastFrameTime_ < std::chrono::milliseconds(16)) {
+    return;
+  }
+  lastFrameTime_ = now;
+
+  ui_->refresh();
+  ui_->processFrame();
 }
 
 void DrawLangApp::onDrawPixel(double x, double y,
@@ -0,0 +1,213 @@
+// 代数化简与强度削弱优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+namespace {
+
+// 常量节点的值（按位比较，用于区分+0和-0）
+bool isConstBits(const ExpressionNode *node, double value) {
+  if (!node || node->getNodeType() != DrawASTNodeType::ConstExpr) {
+    return false;
+  }
+  double v = node->value();
+  return std::memcmp(&v, &value, sizeof(v)) == 0;
+}
+
+bool getConst(const ExpressionNode *node, double &value) {
+  if (!node || node->getNodeType() != DrawASTNodeType::ConstExpr) {
+    return false;
+  }
+  value = node->value();
+  return true;
+}
+
+bool isUnaryMinus(const ExpressionNode *node) {
+  return node && node->getNodeType() == DrawASTNodeType::UnaryExpr &&
+         node->getToken().keyword() == KeywordType::Minus;
+}
+
+// c是2的幂且1/c可以精确表示，此时x/c与x*(1/c)对所有x逐位相同
+bool hasExactReciprocal(double c) {
+  if (!std::isfinite(c) || c == 0.0) {
+    return false;
+  }
+  int exp = 0;
+  if (std::fabs(std::frexp(c, &exp)) != 0.5) {
+    return false;
+  }
+  double r = 1.0 / c;
+  return std::isfinite(r) && r != 0.0 &&
+         std::fabs(std::frexp(r, &exp)) == 0.5;
+}
+
+Token makeOpToken(KeywordType op, const char *lexeme,
+                  const SourceLocation &loc) {
+  Token tok(TokenType::Operator, lexeme, loc);
+  tok.payload = op;
+  return tok;
+}
+
+} // anonymous namespace
+
+std::shared_ptr<ExpressionNode>
+AlgebraicSimplifyPass::rewrite(const std::shared_ptr<ExpressionNode> &node) {
+  switch (node->getNodeType()) {
+  case DrawASTNodeType::UnaryExpr:
+    return simplifyUnary(node);
+  case DrawASTNodeType::BinaryExpr:
+    return simplifyBinary(node);
+  default:
+    return node;
+  }
+}
+
+std::shared_ptr<ExpressionNode> AlgebraicSimplifyPass::simplifyUnary(
+    const std::shared_ptr<ExpressionNode> &node) {
+  auto operand = node->getSubExpr(0);
+  if (!operand) {
+    return node;
+  }
+
+  if (node->getToken().keyword() == KeywordType::Plus) {
+    count("unary-plus");
+    return operand;
+  }
+
+  // --x -> x
+  if (isUnaryMinus(operand.get()) && operand->getSubExpr(0)) {
+    count("double-negation");
+    return operand->getSubExpr(0);
+  }
+
+  return node;
+}
+
+std::shared_ptr<ExpressionNode> AlgebraicSimplifyPass::simplifyBinary(
+    const std::shared_ptr<ExpressionNode> &node) {
+  auto left = node->getSubExpr(0);
+  auto right = node->getSubExpr(1);
+  const Token &opToken = node->getToken();
+  const SourceLocation &loc = opToken.sourceLocation;
+  double c = 0.0;
+
+  switch (opToken.keyword()) {
+  case KeywordType::Mul:
+    if (left && isConstBits(right.get(), 1.0)) {
+      count("mul-one");
+      return left;
+    }
+    if (right && isConstBits(left.get(), 1.0)) {
+      count("mul-one");
+      return right;
+    }
+    // x*(-1)只翻转符号位；得到的-x可能继续化简（如x本身是-y）
+    if (left && isConstBits(right.get(), -1.0)) {
+      count("mul-minus-one");
+      return simplifyUnary(builder_.makeUnary(
+          makeOpToken(KeywordType::Minus, "-", loc), left));
+    }
+    if (right && isConstBits(left.get(), -1.0)) {
+      count("mul-minus-one");
+      return simplifyUnary(builder_.makeUnary(
+          makeOpToken(KeywordType::Minus, "-", loc), right));
+    }
+    break;
+
+  case KeywordType::Div:
+    if (!left || !getConst(right.get(), c)) {
+      break;
+    }
+    if (c == 1.0) {
+      count("div-one");
+      return left;
+    }
+    // 除数是非0常量，运行时不会走除数为0的分支
+    if (hasExactReciprocal(c)) {
+      count("div-pow2");
+    } else if (config_.reciprocalDivision && std::isfinite(c) && c != 0.0 &&
+               std::isfinite(1.0 / c) && 1.0 / c != 0.0) {
+      count("div-reciprocal");
+    } else {
+      break;
+    }
+    return builder_.makeBinary(makeOpToken(KeywordType::Mul, "*", loc), left,
+                               builder_.makeConst(right->getToken(), 1.0 / c));
+
+  case KeywordType::Minus:
+    // x-(+0) -> x；x-(-0)在x为-0时结果为+0，不能化简
+    if (left && isConstBits(right.get(), 0.0)) {
+      count("sub-zero");
+      return left;
+    }
+    break;
+
+  case KeywordType::Plus:
+    // x+(-0) -> x对所有x成立；x+(+0)在x为-0时结果为+0
+    if (left && isConstBits(right.get(), -0.0)) {
+      count("add-zero");
+      return left;
+    }
+    if (right && isConstBits(left.get(), -0.0)) {
+      count("add-zero");
+      return right;
+    }
+    if (config_.ignoreSignedZeros) {
+      if (left && isConstBits(right.get(), 0.0)) {
+        count("add-zero");
+        return left;
+      }
+      if (right && isConstBits(left.get(), 0.0)) {
+        count("add-zero");
+        return right;
+      }
+    }
+    break;
+
+  case KeywordType::Power:
+    if (!left || !getConst(right.get(), c)) {
+      break;
+    }
+    // pow(x, ±0)对任何x（包括NaN）都是1
+    if (c == 0.0) {
+      count("pow-zero");
+      return builder_.makeConst(right->getToken(), 1.0);
+    }
+    if (c == 1.0) {
+      count("pow-one");
+      return left;
+    }
+    if (config_.expandIntegerPowers && c >= 2.0 &&
+        c <= config_.maxPowerExponent && c == std::floor(c)) {
+      count("pow-expand");
+      return makePowerChain(left, static_cast<int>(c), opToken);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return node;
+}
+
+std::shared_ptr<ExpressionNode> AlgebraicSimplifyPass::makePowerChain(
+    const std::shared_ptr<ExpressionNode> &base, int n, const Token &opToken) {
+  if (n == 1) {
+    return base;
+  }
+
+  Token mul = makeOpToken(KeywordType::Mul, "*", opToken.sourceLocation);
+  auto half = makePowerChain(base, n / 2, opToken);
+  auto square = builder_.makeBinary(mul, half, half);
+  return n % 2 ? builder_.makeBinary(mul, square, base) : square;
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
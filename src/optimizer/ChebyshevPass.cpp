@@ -0,0 +1,189 @@
+// 分段切比雪夫逼近优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <unordered_set>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+namespace {
+
+// 含有至少这么多个函数调用（或以T为底、指数的乘方）的表达式才值得逼近，
+// 单个调用比Clenshaw递推加上查找分段还便宜
+constexpr size_t kMinExpensiveOps = 2;
+
+// 统计DAG中依赖T的函数调用和乘方节点数
+size_t countExpensiveOps(const ExpressionNode *node,
+                         std::unordered_set<const ExpressionNode *> &seen) {
+  if (!node || !node->dependsOnT() || !seen.insert(node).second) {
+    return 0;
+  }
+  size_t n = 0;
+  if (node->getNodeType() == DrawASTNodeType::FuncCallExpr ||
+      (node->getNodeType() == DrawASTNodeType::BinaryExpr &&
+       node->getToken().keyword() == KeywordType::Power)) {
+    n = 1;
+  }
+  for (size_t i = 0; i < node->getChildCount(); ++i) {
+    n += countExpensiveOps(
+        static_cast<const ExpressionNode *>(node->getChild(i)), seen);
+  }
+  return n;
+}
+
+} // anonymous namespace
+
+bool ChebyshevPass::runOnStatement(StatementNode *stmt) {
+  if (!stmt) {
+    return false;
+  }
+
+  // 记录SCALE以把像素容差换算为坐标的误差
+  if (stmt->getNodeType() == DrawASTNodeType::ScaleStmt) {
+    auto *sx = stmt->getExpression(0);
+    auto *sy = stmt->getExpression(1);
+    bool constant = sx && sy && !sx->dependsOnT() && !sy->dependsOnT();
+    scale_ = constant
+                 ? std::max(std::fabs(sx->value()), std::fabs(sy->value()))
+                 : 0.0;
+    return false;
+  }
+  if (stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+    return false;
+  }
+  if (!(scale_ > 0.0) || !std::isfinite(scale_)) {
+    return false;
+  }
+
+  auto *startExpr = stmt->getExpression(0);
+  auto *endExpr = stmt->getExpression(1);
+  auto *stepExpr = stmt->getExpression(2);
+  if (!startExpr || !endExpr || !stepExpr || startExpr->dependsOnT() ||
+      endExpr->dependsOnT() || stepExpr->dependsOnT()) {
+    return false;
+  }
+  double start = startExpr->value();
+  double end = endExpr->value();
+  double step = stepExpr->value();
+  int degree = std::max(config_.chebyshevDegree, 1);
+  if (!std::isfinite(start) || !std::isfinite(end) || !(step > 0.0) ||
+      end - start < step * (degree + 1) ||
+      (end - start) / step >= kMaxCheckedSamples) {
+    return false;
+  }
+
+  // x、y的误差各占一半；旋转不改变距离
+  tolerance_ = config_.chebyshevTolerance / scale_ / 2;
+  minWidth_ = step * (degree + 1);
+  maxDepth_ = 0;
+  while ((2 << maxDepth_) <= config_.maxChebyshevSegments) {
+    ++maxDepth_;
+  }
+
+  // 执行时的T值序列：逐次累加步长，与start + i * step不一定逐位相同
+  std::vector<double> ts;
+  for (double t = start; t <= end; t += step) {
+    ts.push_back(t);
+  }
+
+  size_t fitted = 0, segments = 0, exact = 0;
+  bool changed = false;
+  for (size_t i = 3; i <= 4; ++i) {
+    auto expr = stmt->getExpressionPtr(i);
+    std::unordered_set<const ExpressionNode *> seen;
+    if (!expr || countExpensiveOps(expr.get(), seen) < kMinExpensiveOps ||
+        !expr->dependsOnT()) {
+      continue;
+    }
+
+    // 拟合时在单独的上下文中求值
+    EvalContext ctx;
+    Fit fit;
+    fit.bounds.push_back(start);
+    fitRange(expr.get(), ctx, ts, start, end, 0, fit);
+
+    if (fit.exactSegments == fit.segments.size()) {
+      continue;
+    }
+    ++fitted;
+    segments += fit.segments.size();
+    exact += fit.exactSegments;
+    stmt->setExpression(i, std::make_shared<ChebyshevExprNode>(
+                               expr, std::move(fit.bounds),
+                               std::move(fit.segments)));
+    changed = true;
+  }
+
+  if (fitted > 0) {
+    count("approximated-exprs", fitted);
+    count("chebyshev-segments", segments - exact);
+    count("exact-segments", exact);
+    remark(stmt, "FOR-DRAW: " + std::to_string(fitted) +
+                     " expression(s) approximated by " +
+                     std::to_string(segments - exact) +
+                     " Chebyshev segment(s) of degree " +
+                     std::to_string(degree) + ", " + std::to_string(exact) +
+                     " segment(s) evaluated exactly");
+  }
+  return changed;
+}
+
+void ChebyshevPass::fitRange(const ExpressionNode *f, EvalContext &ctx,
+                             const std::vector<double> &ts, double a,
+                             double b, int depth, Fit &fit) {
+  int degree = std::max(config_.chebyshevDegree, 1);
+  double mid = (a + b) / 2;
+  double half = (b - a) / 2;
+  auto eval = [&](double u) {
+    ctx.t = mid + half * u;
+    return f->evaluate(ctx);
+  };
+
+  // 在n + 1个切比雪夫节点上插值（离散余弦变换）
+  size_t n = static_cast<size_t>(degree) + 1;
+  std::vector<double> values(n);
+  bool ok = true;
+  for (size_t k = 0; k < n && ok; ++k) {
+    values[k] = eval(std::cos(std::numbers::pi * (k + 0.5) / n));
+    ok = std::isfinite(values[k]);
+  }
+  std::vector<double> coeffs(n, 0.0);
+  for (size_t j = 0; j < n && ok; ++j) {
+    double sum = 0.0;
+    for (size_t k = 0; k < n; ++k) {
+      sum += values[k] * std::cos(std::numbers::pi * j * (k + 0.5) / n);
+    }
+    coeffs[j] = (j == 0 ? 1.0 : 2.0) * sum / n;
+  }
+
+  // 在循环落在这一段内的每个采样点上检查误差，求值方式与执行时相同
+  auto first = std::lower_bound(ts.begin(), ts.end(), a);
+  auto last = std::upper_bound(first, ts.end(), b);
+  for (auto it = first; it != last && ok; ++it) {
+    ctx.t = *it;
+    double exact = f->evaluate(ctx);
+    ok = std::isfinite(exact) &&
+         std::fabs(ChebyshevExprNode::evalSegment(coeffs, a, b, *it) -
+                   exact) <= tolerance_;
+  }
+
+  if (ok) {
+    fit.segments.push_back(std::move(coeffs));
+  } else if (depth < maxDepth_ && half >= minWidth_) {
+    fitRange(f, ctx, ts, a, mid, depth + 1, fit);
+    fitRange(f, ctx, ts, mid, b, depth + 1, fit);
+    return;
+  } else {
+    fit.segments.emplace_back();
+    ++fit.exactSegments;
+  }
+  fit.bounds.push_back(b);
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
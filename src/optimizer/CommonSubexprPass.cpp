@@ -0,0 +1,149 @@
+// 公共子表达式消除优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+namespace {
+
+// 参与共享分析的子节点数：递推节点和切比雪夫逼近节点的子表达式
+// 只在同步或精确求值时才求值，视为叶子
+size_t operandCount(const ExpressionNode *node) {
+  return node->getNodeType() == DrawASTNodeType::RecurrenceExpr ||
+                 node->getNodeType() == DrawASTNodeType::ChebyshevExpr
+             ? 0
+             : node->getChildCount();
+}
+
+// 逐节点递归求值（不做任何缓存）时的节点求值次数
+size_t treeCost(const ExpressionNode *node,
+                std::unordered_map<const ExpressionNode *, size_t> &memo) {
+  if (!node) {
+    return 0;
+  }
+  auto it = memo.find(node);
+  if (it != memo.end()) {
+    return it->second;
+  }
+  size_t cost = 1;
+  for (size_t i = 0; i < operandCount(node); ++i) {
+    cost += treeCost(static_cast<const ExpressionNode *>(node->getChild(i)),
+                     memo);
+  }
+  memo[node] = cost;
+  return cost;
+}
+
+// 改写后的节点求值次数：缓存节点第二次及以后求值时只算自身一次
+size_t memoCost(const ExpressionNode *node,
+                std::unordered_set<const ExpressionNode *> &evaluated) {
+  if (!node) {
+    return 0;
+  }
+  if (node->getNodeType() == DrawASTNodeType::MemoExpr &&
+      !evaluated.insert(node).second) {
+    return 1;
+  }
+  size_t cost = 1;
+  for (size_t i = 0; i < operandCount(node); ++i) {
+    cost += memoCost(static_cast<const ExpressionNode *>(node->getChild(i)),
+                     evaluated);
+  }
+  return cost;
+}
+
+} // anonymous namespace
+
+bool CommonSubexprPass::runOnStatement(StatementNode *stmt) {
+  if (!stmt || stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+    return false;
+  }
+
+  auto x = stmt->getExpressionPtr(3);
+  auto y = stmt->getExpressionPtr(4);
+
+  useCount_.clear();
+  rewritten_.clear();
+  memoCount_ = 0;
+
+  // 统计每个节点的入边数：两个根各算一次，每个父节点的每条边算一次
+  std::function<void(const ExpressionNode *)> addUse =
+      [&](const ExpressionNode *node) {
+        if (!node || useCount_[node]++ > 0) {
+          return;
+        }
+        for (size_t i = 0; i < operandCount(node); ++i) {
+          addUse(static_cast<const ExpressionNode *>(node->getChild(i)));
+        }
+      };
+  addUse(x.get());
+  addUse(y.get());
+
+  std::unordered_map<const ExpressionNode *, size_t> costMemo;
+  size_t before = treeCost(x.get(), costMemo) + treeCost(y.get(), costMemo);
+
+  auto newX = wrapShared(x);
+  auto newY = wrapShared(y);
+  if (memoCount_ == 0) {
+    return false;
+  }
+  stmt->setExpression(3, newX);
+  stmt->setExpression(4, newY);
+
+  std::unordered_set<const ExpressionNode *> evaluated;
+  size_t after = memoCost(newX.get(), evaluated) +
+                 memoCost(newY.get(), evaluated);
+  size_t saved = before > after ? before - after : 0;
+
+  count("memo-nodes", memoCount_);
+  count("saved-evals-per-sample", saved);
+  remark(stmt, "FOR-DRAW: " + std::to_string(memoCount_) +
+                   " shared subexpression(s), " + std::to_string(saved) +
+                   " of " + std::to_string(before) +
+                   " node evaluations saved per sample");
+  return true;
+}
+
+std::shared_ptr<ExpressionNode>
+CommonSubexprPass::wrapShared(const std::shared_ptr<ExpressionNode> &node) {
+  if (!node) {
+    return nullptr;
+  }
+  auto it = rewritten_.find(node.get());
+  if (it != rewritten_.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<ExpressionNode> children[2];
+  bool childChanged = false;
+  size_t childCount = std::min<size_t>(operandCount(node.get()), 2);
+  for (size_t i = 0; i < childCount; ++i) {
+    auto child = node->getSubExpr(i);
+    children[i] = wrapShared(child);
+    childChanged |= children[i] != child;
+  }
+
+  // 缓存节点不进入节点池，重建的父节点也直接分配
+  ExprBuilder builder;
+  auto result =
+      childChanged ? builder.rebuild(node, children[0], children[1]) : node;
+
+  // 叶子节点求值比查缓存还便宜，不需要包装
+  if (useCount_[node.get()] > 1 && node->getChildCount() > 0 &&
+      node->getNodeType() != DrawASTNodeType::MemoExpr) {
+    result = std::make_shared<MemoExprNode>(result);
+    ++memoCount_;
+  }
+
+  rewritten_[node.get()] = result;
+  return result;
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
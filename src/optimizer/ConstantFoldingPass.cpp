@@ -0,0 +1,45 @@
+// 常量折叠优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+bool ConstantFoldingPass::isConstant(const ExpressionNode *node) {
+  return !node || node->getNodeType() == DrawASTNodeType::ConstExpr;
+}
+
+std::shared_ptr<ExpressionNode>
+ConstantFoldingPass::rewrite(const std::shared_ptr<ExpressionNode> &node) {
+  const char *rule = nullptr;
+  switch (node->getNodeType()) {
+  case DrawASTNodeType::UnaryExpr:
+    rule = "fold-unary";
+    break;
+  case DrawASTNodeType::BinaryExpr:
+    rule = "fold-binary";
+    break;
+  case DrawASTNodeType::FuncCallExpr:
+    rule = "fold-call";
+    break;
+  default:
+    return node;
+  }
+
+  // 子节点已经折叠过，只需检查直接子节点
+  size_t childCount = node->getChildCount();
+  for (size_t i = 0; i < childCount; ++i) {
+    if (!isConstant(node->getSubExpr(i).get())) {
+      return node;
+    }
+  }
+
+  // 子节点都是常量时value()不依赖T，结果与运行时逐位相同
+  count(rule);
+  return builder_.makeConst(node->getToken(), node->value());
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
@@ -0,0 +1,125 @@
+// 无用语句删除优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+#include <unordered_set>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+namespace {
+
+// 设置语句的种类，按位记录
+enum StateBit : unsigned {
+  kOrigin = 1u << 0,
+  kScale = 1u << 1,
+  kRot = 1u << 2,
+  kColor = 1u << 3,
+  kSize = 1u << 4,
+  kAllState = kOrigin | kScale | kRot | kColor | kSize,
+};
+
+// 语句设置的状态，不是设置语句时返回0
+unsigned stateOf(const StatementNode *stmt) {
+  switch (stmt->getNodeType()) {
+  case DrawASTNodeType::OriginStmt:
+    return kOrigin;
+  case DrawASTNodeType::ScaleStmt:
+    return kScale;
+  case DrawASTNodeType::RotStmt:
+    return kRot;
+  case DrawASTNodeType::ColorStmt:
+    return kColor;
+  case DrawASTNodeType::SizeStmt:
+    return kSize;
+  default:
+    return 0;
+  }
+}
+
+const char *stateName(unsigned state) {
+  switch (state) {
+  case kOrigin:
+    return "ORIGIN";
+  case kScale:
+    return "SCALE";
+  case kRot:
+    return "ROT";
+  case kColor:
+    return "COLOR";
+  default:
+    return "SIZE";
+  }
+}
+
+// 语句执行后是否一定覆盖原来的状态
+bool overwrites(const StatementNode *stmt) {
+  switch (stmt->getNodeType()) {
+  case DrawASTNodeType::ColorStmt: {
+    // 颜色名称缺失时不设置颜色
+    auto *color = static_cast<const ColorStmtNode *>(stmt);
+    return !color->usesColorName() || color->getColorName();
+  }
+  case DrawASTNodeType::SizeStmt: {
+    // 小于1的SIZE被忽略
+    auto *size = stmt->getExpression(0);
+    return size && !size->dependsOnT() && size->value() >= 1;
+  }
+  default:
+    return true;
+  }
+}
+
+} // anonymous namespace
+
+bool DeadStatementPass::run(ProgramNode *program) {
+  if (!program) {
+    return false;
+  }
+
+  // dead中的状态在被FOR-DRAW使用之前会被覆盖（或者之后不再被使用）
+  unsigned dead = kAllState;
+  bool sawDraw = false;
+  std::unordered_set<const StatementNode *> removed;
+  std::vector<std::pair<const StatementNode *, std::string>> messages;
+  for (size_t i = program->getChildCount(); i-- > 0;) {
+    auto *stmt = program->getStatement(i);
+    if (!stmt) {
+      continue;
+    }
+    unsigned state = stateOf(stmt);
+    if (state == 0) {
+      // FOR-DRAW以及未知的语句使用全部状态
+      dead = 0;
+      sawDraw = true;
+      continue;
+    }
+    if (dead & state) {
+      removed.insert(stmt);
+      bool overwritten = sawDraw;
+      count(overwritten ? "overwritten" : "trailing");
+      messages.emplace_back(
+          stmt, std::string(stateName(state)) +
+                    (overwritten ? " is overwritten before the next FOR-DRAW"
+                                 : " has no FOR-DRAW after it") +
+                    ", removed");
+    } else if (overwrites(stmt)) {
+      dead |= state;
+    }
+  }
+  if (removed.empty()) {
+    return false;
+  }
+
+  // 说明按源码顺序给出
+  for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
+    remark(it->first, it->second);
+  }
+  program->removeStatements(
+      [&removed](const StatementNode *stmt) { return removed.count(stmt); });
+  return true;
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
@@ -0,0 +1,284 @@
+// Draw语言AST优化器的实现
+// 包括节点构造器、优化遍基类和优化器本身，具体的优化遍见同目录下其他文件
+
+#include "DrawLangOptimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+// ============================================================================
+// ExprBuilder 实现
+// ============================================================================
+
+std::shared_ptr<ExpressionNode> ExprBuilder::makeConst(const Token &token,
+                                                       double value) {
+  if (pool_) {
+    return pool_->makeConst(token, value);
+  }
+  return std::make_shared<ConstExprNode>(token, value);
+}
+
+std::shared_ptr<ExpressionNode>
+ExprBuilder::makeUnary(const Token &op,
+                       std::shared_ptr<ExpressionNode> operand) {
+  if (pool_) {
+    return pool_->makeUnary(op, std::move(operand));
+  }
+  return std::make_shared<UnaryExprNode>(op, std::move(operand));
+}
+
+std::shared_ptr<ExpressionNode>
+ExprBuilder::makeBinary(const Token &op, std::shared_ptr<ExpressionNode> left,
+                        std::shared_ptr<ExpressionNode> right) {
+  if (pool_) {
+    return pool_->makeBinary(op, std::move(left), std::move(right));
+  }
+  return std::make_shared<BinaryExprNode>(op, std::move(left),
+                                          std::move(right));
+}
+
+std::shared_ptr<ExpressionNode>
+ExprBuilder::makeFuncCall(const Token &funcToken,
+                          std::shared_ptr<ExpressionNode> arg,
+                          MathFunc funcPtr) {
+  if (pool_) {
+    return pool_->makeFuncCall(funcToken, std::move(arg), funcPtr);
+  }
+  return std::make_shared<FuncCallExprNode>(funcToken, std::move(arg),
+                                            funcPtr);
+}
+
+std::shared_ptr<ExpressionNode>
+ExprBuilder::rebuild(const std::shared_ptr<ExpressionNode> &node,
+                     std::shared_ptr<ExpressionNode> first,
+                     std::shared_ptr<ExpressionNode> second) {
+  switch (node->getNodeType()) {
+  case DrawASTNodeType::UnaryExpr:
+    return makeUnary(node->getToken(), std::move(first));
+  case DrawASTNodeType::BinaryExpr:
+    return makeBinary(node->getToken(), std::move(first), std::move(second));
+  case DrawASTNodeType::FuncCallExpr:
+    return makeFuncCall(
+        node->getToken(), std::move(first),
+        static_cast<const FuncCallExprNode &>(*node).getFuncPtr());
+  case DrawASTNodeType::MemoExpr:
+    return std::make_shared<MemoExprNode>(std::move(first));
+  case DrawASTNodeType::RecurrenceExpr: {
+    const auto &rec = static_cast<const RecurrenceExprNode &>(*node);
+    return std::make_shared<RecurrenceExprNode>(
+        std::move(first), rec.getKind(), rec.getCoefficients(),
+        rec.getResyncInterval());
+  }
+  case DrawASTNodeType::ChebyshevExpr: {
+    const auto &cheb = static_cast<const ChebyshevExprNode &>(*node);
+    return std::make_shared<ChebyshevExprNode>(
+        std::move(first), cheb.getBounds(), cheb.getSegments());
+  }
+  default:
+    // 叶子节点没有子节点，不需要重建；新增带子节点的类型时需要在上面
+    // 处理，否则子节点的改写被放弃（结果仍然正确）
+    return node;
+  }
+}
+
+// ============================================================================
+// OptimizationPass 实现
+// ============================================================================
+
+bool OptimizationPass::run(ProgramNode *program) {
+  if (!program) {
+    return false;
+  }
+
+  bool changed = false;
+  size_t stmtCount = program->getChildCount();
+  for (size_t i = 0; i < stmtCount; ++i) {
+    if (auto *stmt = program->getStatement(i)) {
+      changed |= runOnStatement(stmt);
+    }
+  }
+  return changed;
+}
+
+size_t OptimizationPass::getCounter(const std::string &rule) const {
+  auto it = counters_.find(rule);
+  return it != counters_.end() ? it->second : 0;
+}
+
+void OptimizationPass::remark(const StatementNode *stmt,
+                              const std::string &message) {
+  remarks_.push_back(stmt->getLocation().toString() + " " + message);
+}
+
+// ============================================================================
+// ExprRewritePass 实现
+// ============================================================================
+
+bool ExprRewritePass::runOnStatement(StatementNode *stmt) {
+  if (!stmt) {
+    return false;
+  }
+
+  bool changed = false;
+  size_t exprCount = stmt->getChildCount();
+  for (size_t i = 0; i < exprCount; ++i) {
+    auto expr = stmt->getExpressionPtr(i);
+    auto result = visit(expr);
+    if (result != expr) {
+      stmt->setExpression(i, std::move(result));
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+std::shared_ptr<ExpressionNode>
+ExprRewritePass::visit(const std::shared_ptr<ExpressionNode> &node) {
+  if (!node) {
+    return nullptr;
+  }
+
+  auto it = memo_.find(node.get());
+  if (it != memo_.end()) {
+    return it->second.result;
+  }
+
+  // 先改写子节点
+  std::shared_ptr<ExpressionNode> children[2];
+  bool childChanged = false;
+  size_t childCount = std::min<size_t>(node->getChildCount(), 2);
+  for (size_t i = 0; i < childCount; ++i) {
+    auto child = node->getSubExpr(i);
+    children[i] = visit(child);
+    childChanged |= children[i] != child;
+  }
+
+  auto current =
+      childChanged ? builder_.rebuild(node, children[0], children[1]) : node;
+  auto result = rewrite(current);
+
+  memo_[node.get()] = Rewritten{node, result};
+  return result;
+}
+
+// ============================================================================
+// Optimizer 实现
+// ============================================================================
+
+OptimizerConfig OptimizerConfig::forLevel(int level) {
+  OptimizerConfig config;
+  if (level <= 0) {
+    config.constantFolding = false;
+    config.algebraicSimplify = false;
+    config.commonSubexpr = false;
+  } else if (level >= 2) {
+    config.deadStatements = true;
+    config.recurrences = true;
+    config.chebyshev = true;
+  }
+  return config;
+}
+
+std::string OptimizerConfig::fingerprint() const {
+  // 浮点数用十六进制格式输出，保证逐位相同的值得到相同的文本
+  char tolerance[32];
+  std::snprintf(tolerance, sizeof(tolerance), "%a", chebyshevTolerance);
+  std::ostringstream oss;
+  oss << "cf=" << constantFolding << ";as=" << algebraicSimplify
+      << ";cse=" << commonSubexpr << ";dse=" << deadStatements
+      << ";pow=" << expandIntegerPowers << "/" << maxPowerExponent
+      << ";rcp=" << reciprocalDivision << ";sz=" << ignoreSignedZeros
+      << ";rec=" << recurrences << "/" << maxRecurrenceDegree << "/"
+      << recurrenceResync << ";cheb=" << chebyshev << "/" << tolerance << "/"
+      << chebyshevDegree << "/" << maxChebyshevSegments;
+  return oss.str();
+}
+
+Optimizer::Optimizer(const OptimizerConfig &config, ExprPool *pool)
+    : dumpAfterEachPass_(config.dumpAfterEachPass) {
+  if (config.deadStatements) {
+    passes_.push_back(std::make_unique<DeadStatementPass>());
+  }
+  if (config.constantFolding) {
+    passes_.push_back(std::make_unique<ConstantFoldingPass>(pool));
+  }
+  if (config.algebraicSimplify) {
+    passes_.push_back(std::make_unique<AlgebraicSimplifyPass>(config, pool));
+  }
+  if (config.chebyshev) {
+    passes_.push_back(std::make_unique<ChebyshevPass>(config));
+  }
+  if (config.recurrences) {
+    passes_.push_back(std::make_unique<RecurrencePass>(config));
+  }
+  if (config.commonSubexpr) {
+    passes_.push_back(std::make_unique<CommonSubexprPass>());
+  }
+
+  for (const auto &pass : passes_) {
+    stats_.push_back(PassStats{pass->getName()});
+  }
+}
+
+void Optimizer::optimize(ProgramNode *program) {
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    runPass(i, program, [&] { return passes_[i]->run(program); });
+  }
+}
+
+void Optimizer::optimizeStatement(StatementNode *stmt) {
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    runPass(i, stmt, [&] { return passes_[i]->runOnStatement(stmt); });
+  }
+}
+
+void Optimizer::runPass(size_t index, DrawASTNode *root,
+                        const std::function<bool()> &run) {
+  auto &stats = stats_[index];
+  stats.nodesBefore += countNodes(root);
+
+  auto begin = std::chrono::steady_clock::now();
+  bool changed = run();
+  auto end = std::chrono::steady_clock::now();
+
+  stats.seconds += std::chrono::duration<double>(end - begin).count();
+  stats.nodesAfter += countNodes(root);
+  stats.changedRuns += changed ? 1 : 0;
+
+  if (dumpAfterEachPass_ && root) {
+    std::cout << "*** after " << stats.name << " ***" << std::endl;
+    root->print();
+  }
+}
+
+size_t Optimizer::countNodes(const DrawASTNode *root) {
+  std::unordered_set<const DrawASTNode *> seen;
+  std::vector<const DrawASTNode *> stack;
+  if (root) {
+    stack.push_back(root);
+  }
+  while (!stack.empty()) {
+    const DrawASTNode *node = stack.back();
+    stack.pop_back();
+    if (!seen.insert(node).second) {
+      continue;
+    }
+    for (size_t i = 0; i < node->getChildCount(); ++i) {
+      if (const DrawASTNode *child = node->getChild(i)) {
+        stack.push_back(child);
+      }
+    }
+  }
+  return seen.size();
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
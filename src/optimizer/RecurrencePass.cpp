@@ -0,0 +1,249 @@
+// 递推求值优化遍的实现
+
+#include "DrawLangOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace interpreter_exp {
+namespace optimizer {
+
+using namespace ast;
+
+namespace {
+
+// 多项式乘法，结果的次数超过maxDegree时返回false
+bool multiply(const std::vector<double> &a, const std::vector<double> &b,
+              int maxDegree, std::vector<double> &out) {
+  if (a.size() + b.size() - 2 > static_cast<size_t>(maxDegree)) {
+    return false;
+  }
+  std::vector<double> product(a.size() + b.size() - 1, 0.0);
+  for (size_t i = 0; i < a.size(); ++i) {
+    for (size_t j = 0; j < b.size(); ++j) {
+      product[i + j] += a[i] * b[j];
+    }
+  }
+  out = std::move(product);
+  return true;
+}
+
+// 去掉最高次的0系数
+void trim(std::vector<double> &coeffs) {
+  while (coeffs.size() > 1 && coeffs.back() == 0.0) {
+    coeffs.pop_back();
+  }
+}
+
+// node是否为sin或cos的调用
+bool isTrigCall(const ExpressionNode *node, RecurrenceKind &kind) {
+  if (node->getNodeType() != DrawASTNodeType::FuncCallExpr) {
+    return false;
+  }
+  static const MathFunc sinFunc =
+      BuiltinFunctions::getFunc(BuiltinFunctions::findByName("SIN"));
+  static const MathFunc cosFunc =
+      BuiltinFunctions::getFunc(BuiltinFunctions::findByName("COS"));
+  MathFunc func = static_cast<const FuncCallExprNode *>(node)->getFuncPtr();
+  if (func && func == sinFunc) {
+    kind = RecurrenceKind::Sin;
+    return true;
+  }
+  if (func && func == cosFunc) {
+    kind = RecurrenceKind::Cos;
+    return true;
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+bool RecurrencePass::runOnStatement(StatementNode *stmt) {
+  if (!stmt || stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+    return false;
+  }
+
+  wrapCount_ = 0;
+  polynomials_.clear();
+  rewritten_.clear();
+
+  bool changed = false;
+  for (size_t i = 3; i <= 4; ++i) {
+    auto expr = stmt->getExpressionPtr(i);
+    auto result = wrap(expr);
+    if (result != expr) {
+      stmt->setExpression(i, std::move(result));
+      changed = true;
+    }
+  }
+
+  if (wrapCount_ > 0) {
+    remark(stmt, "FOR-DRAW: " + std::to_string(wrapCount_) +
+                     " subexpression(s) evaluated by recurrence, resync "
+                     "every " +
+                     std::to_string(std::max(config_.recurrenceResync, 1)) +
+                     " samples");
+  }
+  return changed;
+}
+
+bool RecurrencePass::extractPolynomial(const ExpressionNode *node,
+                                       std::vector<double> &coeffs) {
+  // 缺失的操作数按0求值
+  if (!node) {
+    coeffs = {0.0};
+    return true;
+  }
+  auto it = polynomials_.find(node);
+  if (it != polynomials_.end()) {
+    coeffs = it->second;
+    return !coeffs.empty();
+  }
+
+  int maxDegree = config_.maxRecurrenceDegree;
+  std::vector<double> result;
+  bool ok = false;
+  switch (node->getNodeType()) {
+  case DrawASTNodeType::ConstExpr:
+    result = {node->value()};
+    ok = true;
+    break;
+
+  case DrawASTNodeType::ParamExpr:
+    if (maxDegree >= 1) {
+      result = {0.0, 1.0};
+      ok = true;
+    }
+    break;
+
+  case DrawASTNodeType::MemoExpr:
+    ok = extractPolynomial(static_cast<const MemoExprNode *>(node)->getInner(),
+                           result);
+    break;
+
+  case DrawASTNodeType::UnaryExpr:
+    ok = extractPolynomial(
+        static_cast<const ExpressionNode *>(node->getChild(0)), result);
+    if (ok && node->getToken().keyword() == KeywordType::Minus) {
+      for (double &c : result) {
+        c = -c;
+      }
+    }
+    break;
+
+  case DrawASTNodeType::BinaryExpr: {
+    std::vector<double> left, right;
+    if (!extractPolynomial(
+            static_cast<const ExpressionNode *>(node->getChild(0)), left) ||
+        !extractPolynomial(
+            static_cast<const ExpressionNode *>(node->getChild(1)), right)) {
+      break;
+    }
+    switch (node->getToken().keyword()) {
+    case KeywordType::Plus:
+    case KeywordType::Minus: {
+      double sign = node->getToken().keyword() == KeywordType::Plus ? 1 : -1;
+      result = left;
+      result.resize(std::max(left.size(), right.size()), 0.0);
+      for (size_t i = 0; i < right.size(); ++i) {
+        result[i] += sign * right[i];
+      }
+      ok = true;
+      break;
+    }
+    case KeywordType::Mul:
+      ok = multiply(left, right, maxDegree, result);
+      break;
+    case KeywordType::Div:
+      // 只处理除以常量；除数为0时结果为0，与BinaryExprNode一致
+      if (right.size() == 1) {
+        result = left;
+        for (double &c : result) {
+          c = right[0] != 0.0 ? c / right[0] : 0.0;
+        }
+        ok = true;
+      }
+      break;
+    case KeywordType::Power: {
+      // 只处理非负整数次幂
+      double n = right.size() == 1 ? right[0] : -1.0;
+      if (n < 0.0 || n > maxDegree || n != std::floor(n)) {
+        break;
+      }
+      result = {1.0};
+      ok = true;
+      for (int k = 0; ok && k < static_cast<int>(n); ++k) {
+        ok = multiply(result, left, maxDegree, result);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  if (ok) {
+    trim(result);
+  } else {
+    result.clear();
+  }
+  polynomials_[node] = result;
+  coeffs = std::move(result);
+  return ok;
+}
+
+std::shared_ptr<ExpressionNode>
+RecurrencePass::wrap(const std::shared_ptr<ExpressionNode> &node) {
+  // 切比雪夫逼近节点的子表达式只在拟合失败的段上求值
+  if (!node || !node->dependsOnT() ||
+      node->getNodeType() == DrawASTNodeType::ChebyshevExpr) {
+    return node;
+  }
+  auto it = rewritten_.find(node.get());
+  if (it != rewritten_.end()) {
+    return it->second;
+  }
+
+  size_t resync = static_cast<size_t>(std::max(config_.recurrenceResync, 1));
+  std::shared_ptr<ExpressionNode> result;
+  std::vector<double> coeffs;
+  RecurrenceKind kind;
+  if (isTrigCall(node.get(), kind) &&
+      extractPolynomial(
+          static_cast<const ExpressionNode *>(node->getChild(0)), coeffs) &&
+      coeffs.size() == 2) {
+    // 参数为a*T+b（a != 0）
+    result =
+        std::make_shared<RecurrenceExprNode>(node, kind, coeffs, resync);
+    count("trig-recurrence");
+    ++wrapCount_;
+  } else if (extractPolynomial(node.get(), coeffs) && coeffs.size() >= 3) {
+    result = std::make_shared<RecurrenceExprNode>(
+        node, RecurrenceKind::Polynomial, coeffs, resync);
+    count("polynomial-recurrence");
+    ++wrapCount_;
+  } else {
+    std::shared_ptr<ExpressionNode> children[2];
+    bool childChanged = false;
+    size_t childCount = std::min<size_t>(node->getChildCount(), 2);
+    for (size_t i = 0; i < childCount; ++i) {
+      auto child = node->getSubExpr(i);
+      children[i] = wrap(child);
+      childChanged |= children[i] != child;
+    }
+    // 递推节点带有状态，不进入节点池
+    ExprBuilder builder;
+    result =
+        childChanged ? builder.rebuild(node, children[0], children[1]) : node;
+  }
+
+  rewritten_[node.get()] = result;
+  return result;
+}
+
+} // namespace optimizer
+} // namespace interpreter_exp
@@ -4,15 +4,69 @@
 #include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 namespace interpreter_exp {
 namespace ast {
 
-double BinaryExprNode::value() const {
-  double l = leftValue();
-  double r = rightValue();
+namespace {
+
+struct BuiltinEntry {
+  const char *name;
+  MathFunc func;
+};
+
+const BuiltinEntry builtinTable[] = {
+    {"SIN", std::sin},   {"COS", std::cos},     {"TAN", std::tan},
+    {"LN", std::log},    {"EXP", std::exp},     {"SQRT", std::sqrt},
+    {"ABS", std::fabs},  {"ASIN", std::asin},   {"ACOS", std::acos},
+    {"ATAN", std::atan}, {"LOG", std::log10},   {"CEIL", std::ceil},
+    {"FLOOR", std::floor},
+};
+
+constexpr size_t builtinCount = sizeof(builtinTable) / sizeof(builtinTable[0]);
+
+} // anonymous namespace
+
+size_t BuiltinFunctions::count() { return builtinCount; }
+
+const char *BuiltinFunctions::getName(size_t id) {
+  return id < builtinCount ? builtinTable[id].name : nullptr;
+}
+
+MathFunc BuiltinFunctions::getFunc(size_t id) {
+  return id < builtinCount ? builtinTable[id].func : nullptr;
+}
+
+size_t BuiltinFunctions::findByName(const std::string &name) {
+  std::string upper = name;
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  for (size_t i = 0; i < builtinCount; ++i) {
+    if (upper == builtinTable[i].name) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+size_t BuiltinFunctions::findByFunc(MathFunc func) {
+  if (!func) {
+    return npos;
+  }
+  for (size_t i = 0; i < builtinCount; ++i) {
+    if (func == builtinTable[i].func) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+double BinaryExprNode::evaluate(EvalContext &ctx) const {
+  double l = leftValue(ctx);
+  double r = rightValue(ctx);
 
   KeywordType op = token_.keyword();
   switch (op) {
@@ -101,6 +155,306 @@ void ColorNameExprNode::print(int indent) const {
 
 std::string ColorNameExprNode::toString() const { return token_.lexeme; }
 
+namespace {
+
+// StateSlot的分配器：回收的下标优先复用。
+// 不析构，静态对象中的节点在程序退出时仍可以回收下标
+struct SlotAllocator {
+  std::mutex mutex;
+  size_t count = 0;
+  uint64_t serial = 0;
+  std::vector<size_t> free;
+};
+
+SlotAllocator &slotAllocator() {
+  static auto *allocator = new SlotAllocator;
+  return *allocator;
+}
+
+} // anonymous namespace
+
+StateSlot::StateSlot() {
+  auto &slots = slotAllocator();
+  std::lock_guard<std::mutex> lock(slots.mutex);
+  if (slots.free.empty()) {
+    index_ = slots.count++;
+  } else {
+    index_ = slots.free.back();
+    slots.free.pop_back();
+  }
+  serial_ = ++slots.serial;
+}
+
+StateSlot::~StateSlot() {
+  auto &slots = slotAllocator();
+  std::lock_guard<std::mutex> lock(slots.mutex);
+  slots.free.push_back(index_);
+}
+
+double MemoExprNode::evaluate(EvalContext &ctx) const {
+  State &state = ctx.getState<State>(slot_);
+  uint64_t bits = 0;
+  if (tDependent_) {
+    std::memcpy(&bits, &ctx.t, sizeof(bits));
+  }
+  if (state.valid && bits == state.tBits) {
+    ++state.hitCount;
+    return state.cached;
+  }
+  state.cached = inner_->evaluate(ctx);
+  state.tBits = bits;
+  state.valid = true;
+  return state.cached;
+}
+
+void MemoExprNode::print(int indent) const {
+  std::cout << DrawASTUtils::makeIndent(indent) << "MEMO" << std::endl;
+  inner_->print(indent + 2);
+}
+
+std::string MemoExprNode::toString() const { return inner_->toString(); }
+
+namespace {
+
+// T与预期的下一个采样点之差在步长的这个比例以内时，视为等步长采样
+// （drawLoop累加步长，T本身带有舍入误差）
+constexpr double kStepTolerance = 1e-6;
+
+} // anonymous namespace
+
+double RecurrenceExprNode::evaluate(EvalContext &ctx) const {
+  State &state = ctx.getState<State>(slot_);
+  double t = ctx.t;
+  if (state.valid) {
+    if (std::memcmp(&t, &state.lastT, sizeof(t)) == 0) {
+      return state.cached;
+    }
+    if (state.hasStep && state.sinceSync < resyncInterval_ &&
+        std::fabs(t - (state.lastT + state.step)) <=
+            std::fabs(state.step) * kStepTolerance) {
+      advance(state);
+      state.lastT = t;
+      ++state.sinceSync;
+      ++state.stepCount;
+      return state.cached;
+    }
+    state.step = t - state.lastT;
+    state.hasStep = std::isfinite(state.step) && state.step != 0.0;
+  }
+  sync(ctx, state);
+  return state.cached;
+}
+
+void RecurrenceExprNode::sync(EvalContext &ctx, State &state) const {
+  double t = ctx.t;
+  state.cached = inner_->evaluate(ctx);
+  state.lastT = t;
+  state.valid = true;
+  state.sinceSync = 0;
+  ++state.syncCount;
+  if (!state.hasStep) {
+    return;
+  }
+
+  if (kind_ == RecurrenceKind::Polynomial) {
+    // 前向差分表：diffs[j]为p在t处的j阶差分
+    auto &diffs = state.diffs;
+    size_t degree = coeffs_.empty() ? 0 : coeffs_.size() - 1;
+    diffs.resize(degree + 1);
+    for (size_t j = 0; j <= degree; ++j) {
+      diffs[j] = evalPolynomial(t + static_cast<double>(j) * state.step);
+    }
+    for (size_t k = 1; k <= degree; ++k) {
+      for (size_t j = degree; j >= k; --j) {
+        diffs[j] -= diffs[j - 1];
+      }
+    }
+    return;
+  }
+
+  double a = coeffs_.size() > 1 ? coeffs_[1] : 0.0;
+  double b = coeffs_.empty() ? 0.0 : coeffs_[0];
+  state.sin = std::sin(a * t + b);
+  state.cos = std::cos(a * t + b);
+  state.rotSin = std::sin(a * state.step);
+  state.rotCos = std::cos(a * state.step);
+}
+
+void RecurrenceExprNode::advance(State &state) const {
+  if (kind_ == RecurrenceKind::Polynomial) {
+    auto &diffs = state.diffs;
+    for (size_t j = 0; j + 1 < diffs.size(); ++j) {
+      diffs[j] += diffs[j + 1];
+    }
+    state.cached = diffs.empty() ? 0.0 : diffs[0];
+    return;
+  }
+
+  // sin(θ+Δ) = sinθcosΔ + cosθsinΔ，cos(θ+Δ) = cosθcosΔ - sinθsinΔ
+  double s = state.sin * state.rotCos + state.cos * state.rotSin;
+  double c = state.cos * state.rotCos - state.sin * state.rotSin;
+  state.sin = s;
+  state.cos = c;
+  state.cached = kind_ == RecurrenceKind::Sin ? s : c;
+}
+
+double RecurrenceExprNode::evalPolynomial(double t) const {
+  double result = 0.0;
+  for (auto it = coeffs_.rbegin(); it != coeffs_.rend(); ++it) {
+    result = result * t + *it;
+  }
+  return result;
+}
+
+void RecurrenceExprNode::print(int indent) const {
+  static const char *kKindNames[] = {"SIN", "COS", "POLYNOMIAL"};
+  std::cout << DrawASTUtils::makeIndent(indent) << "RECURRENCE "
+            << kKindNames[static_cast<int>(kind_)] << std::endl;
+  inner_->print(indent + 2);
+}
+
+std::string RecurrenceExprNode::toString() const {
+  return inner_->toString();
+}
+
+double ChebyshevExprNode::evaluate(EvalContext &ctx) const {
+  double t = ctx.t;
+  if (segments_.empty() || !(t >= bounds_.front() && t <= bounds_.back())) {
+    return inner_->evaluate(ctx);
+  }
+
+  // 第一个大于t的分界点之前的一段；t等于最后一个分界点时属于最后一段
+  auto it = std::upper_bound(bounds_.begin() + 1, bounds_.end() - 1, t);
+  size_t index = static_cast<size_t>(it - bounds_.begin()) - 1;
+  const auto &coeffs = segments_[index];
+  if (coeffs.empty()) {
+    return inner_->evaluate(ctx);
+  }
+  return evalSegment(coeffs, bounds_[index], bounds_[index + 1], t);
+}
+
+double ChebyshevExprNode::evalSegment(const std::vector<double> &coeffs,
+                                      double a, double b, double t) {
+  double u = (2.0 * t - a - b) / (b - a);
+  // Clenshaw：b_k = c_k + 2u*b_{k+1} - b_{k+2}，结果为c_0 + u*b_1 - b_2
+  double b1 = 0.0, b2 = 0.0;
+  for (size_t k = coeffs.size() - 1; k >= 1; --k) {
+    double bk = coeffs[k] + 2.0 * u * b1 - b2;
+    b2 = b1;
+    b1 = bk;
+  }
+  return coeffs[0] + u * b1 - b2;
+}
+
+void ChebyshevExprNode::print(int indent) const {
+  std::cout << DrawASTUtils::makeIndent(indent) << "CHEBYSHEV "
+            << segments_.size() << " SEGMENT(S)" << std::endl;
+  inner_->print(indent + 2);
+}
+
+std::string ChebyshevExprNode::toString() const { return inner_->toString(); }
+
+size_t ExprPool::KeyHash::operator()(const Key &key) const {
+  // 与boost::hash_combine相同的组合方式
+  size_t h = std::hash<int>()(static_cast<int>(key.type));
+  auto mix = [&h](size_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  };
+  mix(std::hash<int>()(static_cast<int>(key.op)));
+  mix(std::hash<uint64_t>()(key.payload));
+  mix(std::hash<const void *>()(key.left));
+  mix(std::hash<const void *>()(key.right));
+  if (!key.name.empty()) {
+    mix(std::hash<std::string>()(key.name));
+  }
+  return h;
+}
+
+std::shared_ptr<ExpressionNode> ExprPool::lookup(const Key &key) {
+  auto it = table_.find(key);
+  if (it == table_.end()) {
+    return nullptr;
+  }
+  ++hitCount_;
+  return it->second;
+}
+
+std::shared_ptr<ExpressionNode>
+ExprPool::insert(const Key &key, std::shared_ptr<ExpressionNode> node) {
+  nodes_.push_back(node.get());
+  node->setNodeId(nodes_.size());
+  table_.emplace(key, node);
+  return node;
+}
+
+std::shared_ptr<ExpressionNode> ExprPool::makeConst(const Token &token,
+                                                    double value) {
+  // 按位模式比较，+0/-0以及不同的NaN不会被合并
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  Key key{DrawASTNodeType::ConstExpr, KeywordType::None, bits, nullptr,
+          nullptr, ""};
+  if (auto node = lookup(key)) {
+    return node;
+  }
+  return insert(key, std::make_shared<ConstExprNode>(token, value));
+}
+
+std::shared_ptr<ExpressionNode> ExprPool::makeParam(const Token &token) {
+  Key key{DrawASTNodeType::ParamExpr, KeywordType::None, 0, nullptr, nullptr,
+          ""};
+  if (auto node = lookup(key)) {
+    return node;
+  }
+  return insert(key, std::make_shared<ParamExprNode>(token));
+}
+
+std::shared_ptr<ExpressionNode>
+ExprPool::makeUnary(const Token &op, std::shared_ptr<ExpressionNode> operand) {
+  Key key{DrawASTNodeType::UnaryExpr, op.keyword(), 0, operand.get(), nullptr,
+          ""};
+  if (auto node = lookup(key)) {
+    return node;
+  }
+  return insert(key, std::make_shared<UnaryExprNode>(op, std::move(operand)));
+}
+
+std::shared_ptr<ExpressionNode>
+ExprPool::makeBinary(const Token &op, std::shared_ptr<ExpressionNode> left,
+                     std::shared_ptr<ExpressionNode> right) {
+  Key key{DrawASTNodeType::BinaryExpr, op.keyword(), 0, left.get(),
+          right.get(), ""};
+  if (auto node = lookup(key)) {
+    return node;
+  }
+  return insert(key, std::make_shared<BinaryExprNode>(op, std::move(left),
+                                                      std::move(right)));
+}
+
+std::shared_ptr<ExpressionNode>
+ExprPool::makeFuncCall(const Token &funcToken,
+                       std::shared_ptr<ExpressionNode> arg, MathFunc funcPtr) {
+  // 未解析的函数都求值为0，但保留名字以便打印时不混淆
+  std::string name;
+  if (!funcPtr) {
+    name = funcToken.lexeme;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+  }
+  Key key{DrawASTNodeType::FuncCallExpr, KeywordType::None,
+          reinterpret_cast<uintptr_t>(funcPtr), arg.get(), nullptr, name};
+  if (auto node = lookup(key)) {
+    return node;
+  }
+  return insert(key, std::make_shared<FuncCallExprNode>(
+                         funcToken, std::move(arg), funcPtr));
+}
+
+void ExprPool::clear() {
+  table_.clear();
+  nodes_.clear();
+  hitCount_ = 0;
+}
+
 void OriginStmtNode::print(int indent) const {
   std::cout << DrawASTUtils::makeIndent(indent) << "ORIGIN" << std::endl;
   for (size_t i = 0; i < expressions_.size(); ++i) {
@@ -123,8 +477,9 @@ void ScaleStmtNode::print(int indent) const {
 }
 
 std::string ScaleStmtNode::toString() const {
-  return "scale is (" + std::to_string(getScaleX()) + ", " +
-         std::to_string(getScaleY()) + ")";
+  EvalContext ctx;
+  return "scale is (" + std::to_string(getScaleX(ctx)) + ", " +
+         std::to_string(getScaleY(ctx)) + ")";
 }
 
 void RotStmtNode::print(int indent) const {
@@ -135,7 +490,8 @@ void RotStmtNode::print(int indent) const {
 }
 
 std::string RotStmtNode::toString() const {
-  return "rot is " + std::to_string(getAngle());
+  EvalContext ctx;
+  return "rot is " + std::to_string(getAngle(ctx));
 }
 
 void ForDrawStmtNode::print(int indent) const {
@@ -181,9 +537,10 @@ std::string ColorStmtNode::toString() const {
   if (useColorName_ && colorName_) {
     return "color is " + colorName_->toString();
   }
-  return "color is (" + std::to_string(static_cast<int>(getRed())) + ", " +
-         std::to_string(static_cast<int>(getGreen())) + ", " +
-         std::to_string(static_cast<int>(getBlue())) + ")";
+  EvalContext ctx;
+  return "color is (" + std::to_string(static_cast<int>(getRed(ctx))) +
+         ", " + std::to_string(static_cast<int>(getGreen(ctx))) + ", " +
+         std::to_string(static_cast<int>(getBlue(ctx))) + ")";
 }
 
 void SizeStmtNode::print(int indent) const {
@@ -195,11 +552,12 @@ void SizeStmtNode::print(int indent) const {
 }
 
 std::string SizeStmtNode::toString() const {
+  EvalContext ctx;
   if (hasTwoDimensions()) {
-    return "size is (" + std::to_string(getWidth()) + ", " +
-           std::to_string(getHeight()) + ")";
+    return "size is (" + std::to_string(getWidth(ctx)) + ", " +
+           std::to_string(getHeight(ctx)) + ")";
   }
-  return "size is " + std::to_string(getSize());
+  return "size is " + std::to_string(getSize(ctx));
 }
 
 void ProgramNode::print(int indent) const {
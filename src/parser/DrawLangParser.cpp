@@ -12,8 +12,7 @@ using namespace ast;
 using namespace lexer;
 using namespace errlog;
 
-DrawLangParser::DrawLangParser(SimpleLexer *lexer)
-    : lexer_(lexer), tStorage_(&defaultTValue_) {
+DrawLangParser::DrawLangParser(SimpleLexer *lexer) : lexer_(lexer) {
   if (lexer_) {
     // 获取源文件名（如果有）
     // filename_ = lexer_->getSourceId();
@@ -32,6 +31,13 @@ std::unique_ptr<ProgramNode> DrawLangParser::parse() {
 
   astRoot_ = std::make_unique<ProgramNode>(rootToken, filename_);
 
+  // 每次解析使用新的节点池，节点id因此只取决于源码
+  exprPool_.reset();
+  if (config_.hashConsExpressions) {
+    exprPool_ = std::make_shared<ExprPool>();
+    astRoot_->setExprPool(exprPool_);
+  }
+
   // 获取第一个Token
   fetchToken();
 
@@ -62,7 +68,11 @@ void DrawLangParser::program() {
       if (currentToken_.type == TokenType::Eof) {
         // 丢弃未完成的语句
       } else {
+        auto *added = stmt.get();
         astRoot_->addStatement(std::move(stmt));
+        if (statementCallback_) {
+          statementCallback_(added);
+        }
       }
     }
 
@@ -323,7 +333,7 @@ std::unique_ptr<SizeStmtNode> DrawLangParser::sizeStatement() {
 // expression 的递归子程序
 // 语法: expression -> term { (PLUS | MINUS) term }
 
-std::unique_ptr<ExpressionNode> DrawLangParser::expression() {
+std::shared_ptr<ExpressionNode> DrawLangParser::expression() {
   enter("expression");
 
   auto left = term();
@@ -343,7 +353,7 @@ std::unique_ptr<ExpressionNode> DrawLangParser::expression() {
 // term 的递归子程序
 // 语法: term -> factor { (MUL | DIV) factor }
 
-std::unique_ptr<ExpressionNode> DrawLangParser::term() {
+std::shared_ptr<ExpressionNode> DrawLangParser::term() {
   auto left = factor();
 
   while (checkToken(KeywordType::Mul) || checkToken(KeywordType::Div)) {
@@ -360,19 +370,19 @@ std::unique_ptr<ExpressionNode> DrawLangParser::term() {
 // factor 的递归子程序
 // 语法: factor -> [PLUS | MINUS] component
 
-std::unique_ptr<ExpressionNode> DrawLangParser::factor() {
+std::shared_ptr<ExpressionNode> DrawLangParser::factor() {
   if (checkToken(KeywordType::Plus)) {
     // 一元加：创建UnaryExprNode
     Token op = currentToken_;
     matchToken(KeywordType::Plus);
     auto operand = factor();
-    return std::make_unique<UnaryExprNode>(op, std::move(operand));
+    return makeUnaryNode(op, std::move(operand));
   } else if (checkToken(KeywordType::Minus)) {
     // 一元减：创建UnaryExprNode
     Token op = currentToken_;
     matchToken(KeywordType::Minus);
     auto operand = factor();
-    return std::make_unique<UnaryExprNode>(op, std::move(operand));
+    return makeUnaryNode(op, std::move(operand));
   }
 
   return component();
@@ -381,7 +391,7 @@ std::unique_ptr<ExpressionNode> DrawLangParser::factor() {
 // component 的递归子程序
 // 语法: component -> atom [POWER component]  (右结合)
 
-std::unique_ptr<ExpressionNode> DrawLangParser::component() {
+std::shared_ptr<ExpressionNode> DrawLangParser::component() {
   auto left = atom();
 
   if (checkToken(KeywordType::Power)) {
@@ -399,8 +409,8 @@ std::unique_ptr<ExpressionNode> DrawLangParser::component() {
 // 语法: atom -> CONST_ID | T | FUNC L_BRACKET expression R_BRACKET | L_BRACKET
 // expression R_BRACKET
 
-std::unique_ptr<ExpressionNode> DrawLangParser::atom() {
-  std::unique_ptr<ExpressionNode> root = nullptr;
+std::shared_ptr<ExpressionNode> DrawLangParser::atom() {
+  std::shared_ptr<ExpressionNode> root = nullptr;
 
   if (currentToken_.type == TokenType::Literal) {
     // 常量
@@ -408,7 +418,7 @@ std::unique_ptr<ExpressionNode> DrawLangParser::atom() {
     fetchToken();
   } else if (checkToken(KeywordType::T)) {
     // 参数T
-    root = std::make_unique<ParamExprNode>(currentToken_, tStorage_);
+    root = makeParamNode(currentToken_);
     fetchToken();
   } else if (checkToken(KeywordType::Func)) {
     // 函数调用
@@ -451,7 +461,7 @@ std::unique_ptr<ExpressionNode> DrawLangParser::atom() {
     Token zeroToken;
     zeroToken.type = TokenType::Literal;
     zeroToken.lexeme = "0";
-    root = std::make_unique<ConstExprNode>(zeroToken, 0.0);
+    root = makeConstNode(zeroToken, 0.0);
   }
 
   return root;
@@ -595,7 +605,7 @@ void DrawLangParser::addError(const std::string &message,
 
 // 表达式节点构造
 
-std::unique_ptr<ExpressionNode>
+std::shared_ptr<ExpressionNode>
 DrawLangParser::makeExprNode(const Token &token) {
   if (token.type == TokenType::Literal) {
     double value = 0.0;
@@ -621,9 +631,9 @@ DrawLangParser::makeExprNode(const Token &token) {
         value = 0.0;
       }
     }
-    return std::make_unique<ConstExprNode>(token, value);
+    return makeConstNode(token, value);
   } else if (token.isKeyword() && token.keyword() == KeywordType::T) {
-    return std::make_unique<ParamExprNode>(token, tStorage_);
+    return makeParamNode(token);
   } else {
     // 尝试从符号表查找
     // 这里简化处理，假设词法分析器已经处理了常量查找
@@ -638,57 +648,60 @@ DrawLangParser::makeExprNode(const Token &token) {
       } else if (upper == "E") {
         value = 2.7182818284590452;
       }
-      return std::make_unique<ConstExprNode>(token, value);
+      return makeConstNode(token, value);
     }
-    return std::make_unique<ConstExprNode>(token, 0.0);
+    return makeConstNode(token, 0.0);
   }
 }
 
-std::unique_ptr<ExpressionNode>
+std::shared_ptr<ExpressionNode>
 DrawLangParser::makeExprNode(const Token &op,
-                             std::unique_ptr<ExpressionNode> left,
-                             std::unique_ptr<ExpressionNode> right) {
-  return std::make_unique<BinaryExprNode>(op, std::move(left),
+                             std::shared_ptr<ExpressionNode> left,
+                             std::shared_ptr<ExpressionNode> right) {
+  if (exprPool_) {
+    return exprPool_->makeBinary(op, std::move(left), std::move(right));
+  }
+  return std::make_shared<BinaryExprNode>(op, std::move(left),
                                           std::move(right));
 }
 
-std::unique_ptr<ExpressionNode>
+std::shared_ptr<ExpressionNode>
+DrawLangParser::makeUnaryNode(const Token &op,
+                              std::shared_ptr<ExpressionNode> operand) {
+  if (exprPool_) {
+    return exprPool_->makeUnary(op, std::move(operand));
+  }
+  return std::make_shared<UnaryExprNode>(op, std::move(operand));
+}
+
+std::shared_ptr<ExpressionNode>
+DrawLangParser::makeConstNode(const Token &token, double value) {
+  if (exprPool_) {
+    return exprPool_->makeConst(token, value);
+  }
+  return std::make_shared<ConstExprNode>(token, value);
+}
+
+std::shared_ptr<ExpressionNode>
+DrawLangParser::makeParamNode(const Token &token) {
+  if (exprPool_) {
+    return exprPool_->makeParam(token);
+  }
+  return std::make_shared<ParamExprNode>(token);
+}
+
+std::shared_ptr<ExpressionNode>
 DrawLangParser::makeFuncNode(const Token &funcToken,
-                             std::unique_ptr<ExpressionNode> arg) {
+                             std::shared_ptr<ExpressionNode> arg) {
 
   // 查找函数指针
-  MathFunc funcPtr = nullptr;
-  std::string upper = funcToken.lexeme;
-  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-
-  if (upper == "SIN")
-    funcPtr = std::sin;
-  else if (upper == "COS")
-    funcPtr = std::cos;
-  else if (upper == "TAN")
-    funcPtr = std::tan;
-  else if (upper == "LN")
-    funcPtr = std::log;
-  else if (upper == "EXP")
-    funcPtr = std::exp;
-  else if (upper == "SQRT")
-    funcPtr = std::sqrt;
-  else if (upper == "ABS")
-    funcPtr = std::fabs;
-  else if (upper == "ASIN")
-    funcPtr = std::asin;
-  else if (upper == "ACOS")
-    funcPtr = std::acos;
-  else if (upper == "ATAN")
-    funcPtr = std::atan;
-  else if (upper == "LOG")
-    funcPtr = std::log10;
-  else if (upper == "CEIL")
-    funcPtr = std::ceil;
-  else if (upper == "FLOOR")
-    funcPtr = std::floor;
-
-  return std::make_unique<FuncCallExprNode>(funcToken, std::move(arg), funcPtr);
+  MathFunc funcPtr =
+      BuiltinFunctions::getFunc(BuiltinFunctions::findByName(funcToken.lexeme));
+
+  if (exprPool_) {
+    return exprPool_->makeFuncCall(funcToken, std::move(arg), funcPtr);
+  }
+  return std::make_shared<FuncCallExprNode>(funcToken, std::move(arg), funcPtr);
 }
 
 // 调试输出
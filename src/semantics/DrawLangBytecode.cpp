@@ -0,0 +1,677 @@
+// Draw语言表达式寄存器字节码的实现
+
+#include "DrawLangBytecode.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define DRAW_LANG_BYTECODE_X86 1
+#endif
+
+namespace interpreter_exp {
+namespace semantic {
+
+using namespace ast;
+
+namespace {
+
+constexpr uint32_t kNoValue = std::numeric_limits<uint32_t>::max();
+
+// 批量求值的逐元素算术运算（Neg只使用第一个操作数）
+template <typename Real> struct ArithKernels {
+  using Func = void (*)(const Real *, const Real *, Real *, size_t);
+  Func neg, add, sub, mul, div, pow;
+};
+
+#ifdef DRAW_LANG_BYTECODE_X86
+namespace baseline {
+constexpr size_t kVectorBytes = 16; // SSE2
+#include "DrawLangBytecodeKernels.hpp"
+} // namespace baseline
+
+// 与DrawLangVecMath.cpp相同，AVX2的一份用target pragma编译，
+// 只在vecmath选择了AVX2（CPU支持）时调用
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2 {
+constexpr size_t kVectorBytes = 32;
+#include "DrawLangBytecodeKernels.hpp"
+} // namespace avx2
+#pragma GCC pop_options
+#else
+namespace baseline {
+constexpr size_t kVectorBytes = 0;
+#include "DrawLangBytecodeKernels.hpp"
+} // namespace baseline
+#endif
+
+// 按vecmath当前的指令集（见vecmath::getIsa）选择算术运算的实现
+template <typename Real> ArithKernels<Real> arithKernels() {
+#ifdef DRAW_LANG_BYTECODE_X86
+  if (vecmath::getIsa() == vecmath::Isa::AVX2) {
+    return avx2::kernels<Real>();
+  }
+#endif
+  return baseline::kernels<Real>();
+}
+
+// 编译的中间结果：除T以外每个值一条指令，操作数为值的编号（尚未分配寄存器）
+struct Value {
+  bool isT = false; // T固定在寄存器0中，不需要指令
+  Opcode op = Opcode::LoadConst;
+  uint8_t func = 0;
+  uint32_t a = 0; // 值编号；LoadConst为常量下标，EvalNode为节点下标
+  uint32_t b = 0;
+  // 合并为SinCos的另一个值：前一个值的op改为SinCos，后一个仍为Call，
+  // 它的结果由前一个值的指令一并写入
+  uint32_t pair = kNoValue;
+  const ExpressionNode *node = nullptr; // Call对应的函数调用节点
+};
+
+// 指令的操作数个数（按值编号引用的）
+int operandCount(Opcode op) {
+  switch (op) {
+  case Opcode::LoadConst:
+  case Opcode::EvalNode:
+    return 0;
+  case Opcode::Neg:
+  case Opcode::Call:
+  case Opcode::SinCos:
+    return 1;
+  default:
+    return 2;
+  }
+}
+
+class Compiler {
+public:
+  // 返回表达式的值编号
+  uint32_t emit(const ExpressionNode *node) {
+    auto it = memo_.find(node);
+    if (it != memo_.end()) {
+      return it->second;
+    }
+    uint32_t id = emitNode(node);
+    memo_[node] = id;
+    return id;
+  }
+
+  std::vector<Value> values;
+  std::vector<double> consts;
+  std::vector<const ExpressionNode *> nodes;
+
+private:
+  uint32_t push(Value v) {
+    values.push_back(v);
+    return static_cast<uint32_t>(values.size() - 1);
+  }
+
+  uint32_t constant(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = constIds_.find(bits);
+    if (it != constIds_.end()) {
+      return it->second;
+    }
+    consts.push_back(value);
+    uint32_t id = push({false, Opcode::LoadConst, 0,
+                        static_cast<uint32_t>(consts.size() - 1)});
+    constIds_[bits] = id;
+    return id;
+  }
+
+  uint32_t evalNode(const ExpressionNode *node) {
+    nodes.push_back(node);
+    return push({false, Opcode::EvalNode, 0,
+                 static_cast<uint32_t>(nodes.size() - 1)});
+  }
+
+  uint32_t emitNode(const ExpressionNode *node) {
+    // 缺失的操作数按0求值；不依赖T的子树在编译时求值
+    if (!node) {
+      return constant(0.0);
+    }
+    if (!node->dependsOnT()) {
+      return constant(node->value());
+    }
+    auto child = [node](size_t index) {
+      return static_cast<const ExpressionNode *>(node->getChild(index));
+    };
+
+    switch (node->getNodeType()) {
+    case DrawASTNodeType::ParamExpr:
+      return push({true});
+
+    case DrawASTNodeType::MemoExpr:
+      // 指令中共享的子表达式本来就只计算一次
+      return emit(child(0));
+
+    case DrawASTNodeType::UnaryExpr: {
+      uint32_t operand = emit(child(0));
+      if (node->getToken().keyword() != KeywordType::Minus) {
+        return operand;
+      }
+      return push({false, Opcode::Neg, 0, operand});
+    }
+
+    case DrawASTNodeType::BinaryExpr: {
+      Opcode op;
+      switch (node->getToken().keyword()) {
+      case KeywordType::Plus:
+        op = Opcode::Add;
+        break;
+      case KeywordType::Minus:
+        op = Opcode::Sub;
+        break;
+      case KeywordType::Mul:
+        op = Opcode::Mul;
+        break;
+      case KeywordType::Div:
+        op = Opcode::Div;
+        break;
+      case KeywordType::Power:
+        op = Opcode::Pow;
+        break;
+      default:
+        return evalNode(node);
+      }
+      uint32_t left = emit(child(0));
+      uint32_t right = emit(child(1));
+      return push({false, op, 0, left, right});
+    }
+
+    case DrawASTNodeType::FuncCallExpr: {
+      auto *call = static_cast<const FuncCallExprNode *>(node);
+      size_t id = BuiltinFunctions::findByFunc(call->getFuncPtr());
+      if (!call->getFuncPtr() || !child(0)) {
+        return constant(0.0);
+      }
+      if (id == BuiltinFunctions::npos ||
+          id > std::numeric_limits<uint8_t>::max()) {
+        return evalNode(node);
+      }
+      uint32_t arg = emit(child(0));
+      Value v{false, Opcode::Call, static_cast<uint8_t>(id), arg};
+      v.node = node;
+      return push(v);
+    }
+
+    default:
+      // 递推、切比雪夫逼近等节点按自身的方式求值
+      return evalNode(node);
+    }
+  }
+
+  std::unordered_map<const ExpressionNode *, uint32_t> memo_;
+  std::unordered_map<uint64_t, uint32_t> constIds_;
+};
+
+// 内置函数的单精度版本
+struct FloatBuiltin {
+  const char *name;
+  float (*func)(float);
+};
+
+const FloatBuiltin kFloatBuiltins[] = {
+    {"SIN", std::sin},   {"COS", std::cos},     {"TAN", std::tan},
+    {"LN", std::log},    {"EXP", std::exp},     {"SQRT", std::sqrt},
+    {"ABS", std::fabs},  {"ASIN", std::asin},   {"ACOS", std::acos},
+    {"ATAN", std::atan}, {"LOG", std::log10},   {"CEIL", std::ceil},
+    {"FLOOR", std::floor},
+};
+
+const char *opcodeName(Opcode op) {
+  switch (op) {
+  case Opcode::LoadConst:
+    return "loadk";
+  case Opcode::Neg:
+    return "neg";
+  case Opcode::Add:
+    return "add";
+  case Opcode::Sub:
+    return "sub";
+  case Opcode::Mul:
+    return "mul";
+  case Opcode::Div:
+    return "div";
+  case Opcode::Pow:
+    return "pow";
+  case Opcode::Call:
+    return "call";
+  case Opcode::SinCos:
+    return "sincos";
+  case Opcode::EvalNode:
+    return "node";
+  }
+  return "?";
+}
+
+} // anonymous namespace
+
+std::unique_ptr<Bytecode>
+Bytecode::compile(const std::vector<const ExpressionNode *> &roots) {
+  Compiler compiler;
+  std::vector<uint32_t> rootValues;
+  for (const auto *root : roots) {
+    rootValues.push_back(compiler.emit(root));
+  }
+  auto &values = compiler.values;
+  if (compiler.consts.size() > std::numeric_limits<uint16_t>::max() ||
+      compiler.nodes.size() > std::numeric_limits<uint16_t>::max()) {
+    return nullptr;
+  }
+
+  // 同一参数的SIN和COS合并：前一个值改为SinCos，同时求出两个结果
+  size_t sinId = BuiltinFunctions::findByName("SIN");
+  size_t cosId = BuiltinFunctions::findByName("COS");
+  std::unordered_map<uint32_t, uint32_t> sinOf, cosOf; // 参数 -> 值编号
+  for (uint32_t i = 0; i < values.size(); ++i) {
+    if (!values[i].isT && values[i].op == Opcode::Call) {
+      if (values[i].func == sinId) {
+        sinOf[values[i].a] = i;
+      } else if (values[i].func == cosId) {
+        cosOf[values[i].a] = i;
+      }
+    }
+  }
+  for (const auto &[arg, sinValue] : sinOf) {
+    auto it = cosOf.find(arg);
+    if (it == cosOf.end()) {
+      continue;
+    }
+    uint32_t first = std::min(sinValue, it->second);
+    uint32_t second = std::max(sinValue, it->second);
+    values[first].op = Opcode::SinCos;
+    values[first].pair = second;
+    values[second].pair = first;
+  }
+
+  // 每个值最后一次被使用的位置，结果一直保留到最后
+  std::vector<size_t> lastUse(values.size(), 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    int n = values[i].isT ? 0 : operandCount(values[i].op);
+    if (n >= 1) {
+      lastUse[values[i].a] = i;
+    }
+    if (n >= 2) {
+      lastUse[values[i].b] = i;
+    }
+  }
+  for (uint32_t v : rootValues) {
+    lastUse[v] = values.size();
+  }
+
+  // 线性扫描分配寄存器：操作数在本条指令之后不再使用时，
+  // 它的寄存器可以立即给本条指令的结果使用
+  auto code = std::unique_ptr<Bytecode>(new Bytecode());
+  std::vector<uint32_t> reg(values.size(), kNoValue);
+  std::vector<uint8_t> freeRegs;
+  size_t registerCount = 1;
+  auto allocate = [&](uint8_t &dst) {
+    if (!freeRegs.empty()) {
+      dst = freeRegs.back();
+      freeRegs.pop_back();
+    } else if (registerCount < kMaxRegisters) {
+      dst = static_cast<uint8_t>(registerCount++);
+    } else {
+      return false;
+    }
+    return true;
+  };
+  for (size_t i = 0; i < values.size(); ++i) {
+    const Value &v = values[i];
+    if (v.isT) {
+      reg[i] = 0;
+      continue;
+    }
+    int n = operandCount(v.op);
+    uint32_t operands[2] = {v.a, v.b};
+    for (int k = 0; k < n; ++k) {
+      uint32_t operand = operands[k];
+      if (lastUse[operand] == i && !values[operand].isT &&
+          (k == 0 || operands[0] != operand)) {
+        freeRegs.push_back(static_cast<uint8_t>(reg[operand]));
+      }
+    }
+
+    if (v.op == Opcode::Call && v.pair != kNoValue) {
+      continue; // 结果已由SinCos指令写入
+    }
+
+    uint8_t dst;
+    if (!allocate(dst)) {
+      return nullptr;
+    }
+    reg[i] = dst;
+
+    Instruction in{v.op, v.func, dst, 0, 0, 0};
+    in.a = static_cast<uint16_t>(n >= 1 ? reg[v.a] : v.a);
+    in.b = static_cast<uint16_t>(n >= 2 ? reg[v.b] : 0);
+    if (v.op == Opcode::SinCos) {
+      // 参数在配对的值处才最后使用，两个结果都不会与参数共用寄存器
+      uint8_t other;
+      if (!allocate(other)) {
+        return nullptr;
+      }
+      reg[v.pair] = other;
+      bool isSin = v.func == sinId;
+      in.func = static_cast<uint8_t>(sinId);
+      in.func2 = static_cast<uint8_t>(cosId);
+      in.dst = isSin ? dst : other;
+      in.b = isSin ? other : dst;
+      const Value &sinValue = isSin ? v : values[v.pair];
+      const Value &cosValue = isSin ? values[v.pair] : v;
+      code->callSites_.push_back({code->code_.size(), false, in.func,
+                                  sinValue.node});
+      code->callSites_.push_back({code->code_.size(), true, in.func2,
+                                  cosValue.node});
+    } else if (v.op == Opcode::Call) {
+      code->callSites_.push_back({code->code_.size(), false, v.func, v.node});
+    }
+    code->code_.push_back(in);
+
+    // 结果没有被使用时立即释放
+    if (lastUse[i] == 0) {
+      freeRegs.push_back(dst);
+    }
+  }
+
+  for (uint32_t v : rootValues) {
+    code->results_.push_back(static_cast<uint8_t>(reg[v]));
+  }
+  // 内置函数表在编译时取出，求值时不再跨编译单元查表
+  for (size_t id = 0; id < BuiltinFunctions::count(); ++id) {
+    code->funcs_.push_back(BuiltinFunctions::getFunc(id));
+    FloatFunc floatFunc = nullptr;
+    for (const auto &entry : kFloatBuiltins) {
+      if (std::strcmp(entry.name, BuiltinFunctions::getName(id)) == 0) {
+        floatFunc = entry.func;
+      }
+    }
+    code->floatFuncs_.push_back(floatFunc);
+  }
+  code->consts_ = std::move(compiler.consts);
+  code->nodes_ = std::move(compiler.nodes);
+  code->registerCount_ = registerCount;
+  return code;
+}
+
+void Bytecode::run(double t, double *out, EvalContext *ctx) const {
+  double r[kMaxRegisters];
+  r[0] = t;
+  for (const Instruction &in : code_) {
+    switch (in.op) {
+    case Opcode::LoadConst:
+      r[in.dst] = consts_[in.a];
+      break;
+    case Opcode::Neg:
+      r[in.dst] = -r[in.a];
+      break;
+    case Opcode::Add:
+      r[in.dst] = r[in.a] + r[in.b];
+      break;
+    case Opcode::Sub:
+      r[in.dst] = r[in.a] - r[in.b];
+      break;
+    case Opcode::Mul:
+      r[in.dst] = r[in.a] * r[in.b];
+      break;
+    case Opcode::Div:
+      r[in.dst] = (r[in.b] != 0.0) ? r[in.a] / r[in.b] : 0.0;
+      break;
+    case Opcode::Pow:
+      r[in.dst] = std::pow(r[in.a], r[in.b]);
+      break;
+    case Opcode::Call:
+      r[in.dst] = funcs_[in.func](r[in.a]);
+      break;
+    case Opcode::SinCos: {
+      double x = r[in.a];
+      r[in.dst] = funcs_[in.func](x);
+      r[in.b] = funcs_[in.func2](x);
+      break;
+    }
+    case Opcode::EvalNode:
+      ctx->t = t;
+      r[in.dst] = nodes_[in.a]->evaluate(*ctx);
+      break;
+    }
+  }
+  for (size_t i = 0; i < results_.size(); ++i) {
+    out[i] = r[results_[i]];
+  }
+}
+
+void Bytecode::runBatch(const double *ts, size_t n, double *const *out,
+                        EvalContext *ctx) const {
+  runBatchImpl<double>(ts, n, out, ctx);
+}
+
+void Bytecode::runBatchFloat(const double *ts, size_t n, double *const *out,
+                             EvalContext *ctx) const {
+  runBatchImpl<float>(ts, n, out, ctx);
+}
+
+void Bytecode::runBatchPerturbed(const double *ts, size_t n,
+                                 double *const *out, EvalContext *ctx,
+                                 size_t site, double delta,
+                                 bool relative) const {
+  Perturbation perturb{&callSites_.at(site), delta, relative};
+  runBatchImpl<double>(ts, n, out, ctx, &perturb);
+}
+
+template <typename Real>
+void Bytecode::runBatchImpl(const double *ts, size_t n, double *const *out,
+                            EvalContext *ctx,
+                            const Perturbation *perturb) const {
+  constexpr bool kDouble = std::is_same_v<Real, double>;
+  // 每个线程一份寄存器文件，寄存器k占[k*kBatchSize, (k+1)*kBatchSize)
+  thread_local std::vector<Real> file;
+  if (file.size() < registerCount_ * kBatchSize) {
+    file.resize(registerCount_ * kBatchSize);
+  }
+  auto reg = [](size_t index) { return file.data() + index * kBatchSize; };
+  const ArithKernels<Real> arith = arithKernels<Real>();
+  // 内置函数id对应的标量函数；单精度没有对应版本时经double计算
+  auto call = [this](size_t id, const Real *a, Real *d, size_t m) {
+    if constexpr (!kDouble) {
+      if (FloatFunc f = floatFuncs_[id]) {
+        for (size_t i = 0; i < m; ++i) {
+          d[i] = f(a[i]);
+        }
+        return;
+      }
+    }
+    MathFunc f = funcs_[id];
+    for (size_t i = 0; i < m; ++i) {
+      d[i] = static_cast<Real>(f(a[i]));
+    }
+  };
+
+  for (size_t base = 0; base < n; base += kBatchSize) {
+    size_t m = std::min(kBatchSize, n - base);
+    const double *t = ts + base;
+    std::copy(t, t + m, reg(0));
+
+    for (size_t index = 0; index < code_.size(); ++index) {
+      const Instruction &in = code_[index];
+      const FastCall *fast =
+          kDouble && !fastCalls_.empty() ? &fastCalls_[index] : nullptr;
+      // LoadConst、EvalNode的a是常量、节点的下标，不是寄存器
+      Real *d = reg(in.dst);
+      const Real *a = operandCount(in.op) >= 1 ? reg(in.a) : nullptr;
+      const Real *b = operandCount(in.op) >= 2 ? reg(in.b) : nullptr;
+      switch (in.op) {
+      case Opcode::LoadConst:
+        std::fill(d, d + m, static_cast<Real>(consts_[in.a]));
+        break;
+      case Opcode::Neg:
+        arith.neg(a, nullptr, d, m);
+        break;
+      case Opcode::Add:
+        arith.add(a, b, d, m);
+        break;
+      case Opcode::Sub:
+        arith.sub(a, b, d, m);
+        break;
+      case Opcode::Mul:
+        arith.mul(a, b, d, m);
+        break;
+      case Opcode::Div:
+        arith.div(a, b, d, m);
+        break;
+      case Opcode::Pow:
+        arith.pow(a, b, d, m);
+        break;
+      case Opcode::Call:
+        if constexpr (kDouble) {
+          if (fast && fast->first) {
+            fast->first(a, d, m);
+            break;
+          }
+          if (!arrayFuncs_.empty() && arrayFuncs_[in.func]) {
+            arrayFuncs_[in.func](a, d, m);
+            break;
+          }
+        }
+        call(in.func, a, d, m);
+        break;
+      case Opcode::SinCos: {
+        Real *c = reg(in.b);
+        if constexpr (kDouble) {
+          if (fast && fast->fused) {
+            vecmath::fastSincos(*fast->fused, a, d, c, m);
+            break;
+          }
+          if (fast && (fast->first || fast->second)) {
+            // 两个结果的等级不同，分别计算
+            auto one = [&](vecmath::ArrayFunc f, size_t id, Real *r) {
+              if (!f && !arrayFuncs_.empty()) {
+                f = arrayFuncs_[id];
+              }
+              if (f) {
+                f(a, r, m);
+              } else {
+                call(id, a, r, m);
+              }
+            };
+            one(fast->first, in.func, d);
+            one(fast->second, in.func2, c);
+            break;
+          }
+          if (!arrayFuncs_.empty()) {
+            vecmath::sincos(a, d, c, m);
+            break;
+          }
+        }
+        call(in.func, a, d, m);
+        call(in.func2, a, c, m);
+        break;
+      }
+      case Opcode::EvalNode:
+        for (size_t i = 0; i < m; ++i) {
+          ctx->t = t[i];
+          d[i] = static_cast<Real>(nodes_[in.a]->evaluate(*ctx));
+        }
+        break;
+      }
+
+      if (perturb && perturb->site->instruction == index) {
+        Real *r = perturb->site->second ? reg(in.b) : d;
+        for (size_t i = 0; i < m; ++i) {
+          r[i] = static_cast<Real>(perturb->relative
+                                       ? r[i] * (1.0 + perturb->delta)
+                                       : r[i] + perturb->delta);
+        }
+      }
+    }
+
+    for (size_t k = 0; k < results_.size(); ++k) {
+      const Real *r = reg(results_[k]);
+      std::copy(r, r + m, out[k] + base);
+    }
+  }
+}
+
+void Bytecode::setVectorMath(bool enable) {
+  arrayFuncs_.clear();
+  if (!enable) {
+    return;
+  }
+  for (size_t id = 0; id < funcs_.size(); ++id) {
+    const auto *info = vecmath::find(BuiltinFunctions::getName(id));
+    arrayFuncs_.push_back(info ? info->array : nullptr);
+  }
+}
+
+void Bytecode::setFastMath(
+    const std::vector<std::optional<vecmath::Tier>> &tiers) {
+  fastCalls_.clear();
+  if (tiers.empty()) {
+    return;
+  }
+  fastCalls_.resize(code_.size());
+  for (size_t i = 0; i < callSites_.size() && i < tiers.size(); ++i) {
+    if (!tiers[i]) {
+      continue;
+    }
+    const CallSite &site = callSites_[i];
+    const auto *info =
+        vecmath::findFast(BuiltinFunctions::getName(site.func), *tiers[i]);
+    FastCall &fast = fastCalls_[site.instruction];
+    (site.second ? fast.second : fast.first) = info ? info->array : nullptr;
+  }
+  // SinCos的两个结果等级相同时合并计算
+  for (size_t i = 0; i + 1 < callSites_.size() && i + 1 < tiers.size(); ++i) {
+    const CallSite &site = callSites_[i];
+    if (code_[site.instruction].op == Opcode::SinCos && !site.second &&
+        tiers[i] && tiers[i] == tiers[i + 1]) {
+      fastCalls_[site.instruction].fused = tiers[i];
+    }
+  }
+}
+
+std::string Bytecode::disassemble() const {
+  std::ostringstream oss;
+  for (size_t i = 0; i < code_.size(); ++i) {
+    const Instruction &in = code_[i];
+    oss << i << ": r" << static_cast<int>(in.dst);
+    if (in.op == Opcode::SinCos) {
+      oss << ", r" << in.b;
+    }
+    oss << " = " << opcodeName(in.op);
+    switch (operandCount(in.op)) {
+    case 1:
+      if (in.op == Opcode::Call) {
+        oss << " " << BuiltinFunctions::getName(in.func);
+      }
+      oss << " r" << in.a;
+      break;
+    case 2:
+      oss << " r" << in.a << ", r" << in.b;
+      break;
+    default:
+      if (in.op == Opcode::LoadConst) {
+        oss << " " << consts_[in.a];
+      } else if (in.op == Opcode::EvalNode) {
+        oss << " #" << in.a << " " << nodes_[in.a]->toString();
+      }
+      break;
+    }
+    oss << "\n";
+  }
+  oss << "results:";
+  for (uint8_t r : results_) {
+    oss << " r" << static_cast<int>(r);
+  }
+  oss << "\n";
+  return oss.str();
+}
+
+} // namespace semantic
+} // namespace interpreter_exp
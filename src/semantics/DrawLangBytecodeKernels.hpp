@@ -0,0 +1,69 @@
+// 字节码批量求值的逐元素算术运算
+// 只由DrawLangBytecode.cpp在每种指令集的命名空间中各包含一次，包含前需要定义：
+//   kVectorBytes  向量的字节数（GCC向量扩展），不使用向量时为0
+// 加减乘除是IEEE的基本运算（不使用FMA），按向量计算与逐元素计算的结果
+// 逐位相同；乘方逐元素调用std::pow，与指令集无关
+
+// 本文件没有include guard，有意被多次包含
+
+// d[i] = op(a[i], b[i])：整向量部分用向量运算，剩余的元素逐个计算。
+// op同时用于向量和标量
+template <typename Real, typename Op>
+inline void binary(const Real *a, const Real *b, Real *d, size_t m, Op op) {
+  size_t i = 0;
+  if constexpr (kVectorBytes > 0) {
+    typedef Real V __attribute__((vector_size(kVectorBytes)));
+    constexpr size_t kLanes = kVectorBytes / sizeof(Real);
+    for (; i + kLanes <= m; i += kLanes) {
+      V x, y;
+      __builtin_memcpy(&x, a + i, sizeof(V));
+      __builtin_memcpy(&y, b + i, sizeof(V));
+      V r = op(x, y);
+      __builtin_memcpy(d + i, &r, sizeof(V));
+    }
+  }
+  for (; i < m; ++i) {
+    d[i] = op(a[i], b[i]);
+  }
+}
+
+template <typename Real>
+void neg(const Real *a, const Real *, Real *d, size_t m) {
+  // 两个操作数都用a：Neg没有第二个操作数
+  binary(a, a, d, m, [](auto x, auto) { return -x; });
+}
+
+template <typename Real>
+void add(const Real *a, const Real *b, Real *d, size_t m) {
+  binary(a, b, d, m, [](auto x, auto y) { return x + y; });
+}
+
+template <typename Real>
+void sub(const Real *a, const Real *b, Real *d, size_t m) {
+  binary(a, b, d, m, [](auto x, auto y) { return x - y; });
+}
+
+template <typename Real>
+void mul(const Real *a, const Real *b, Real *d, size_t m) {
+  binary(a, b, d, m, [](auto x, auto y) { return x * y; });
+}
+
+template <typename Real>
+void div(const Real *a, const Real *b, Real *d, size_t m) {
+  // 除数为0时结果为0；按掩码选择，除数为0的元素的商不被使用
+  binary(a, b, d, m, [](auto x, auto y) {
+    using T = decltype(x);
+    return y != T{} ? x / y : T{};
+  });
+}
+
+template <typename Real>
+void pow(const Real *a, const Real *b, Real *d, size_t m) {
+  for (size_t i = 0; i < m; ++i) {
+    d[i] = std::pow(a[i], b[i]);
+  }
+}
+
+template <typename Real> constexpr ArithKernels<Real> kernels() {
+  return {neg<Real>, add<Real>, sub<Real>, mul<Real>, div<Real>, pow<Real>};
+}
@@ -0,0 +1,239 @@
+// Draw语言表达式区间求值的实现
+
+#include "DrawLangInterval.hpp"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <numbers>
+#include <string>
+
+namespace interpreter_exp {
+namespace semantic {
+
+using namespace ast;
+
+bool Interval::isBounded() const {
+  return std::isfinite(lo) && std::isfinite(hi);
+}
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+constexpr double kPi = std::numbers::pi;
+
+// 由若干个端点值构造区间，并向外扩展2ulp以覆盖舍入误差
+// （libm的三角、指数函数误差在1ulp以内）
+Interval hull(std::initializer_list<double> values) {
+  double lo = kInf;
+  double hi = -kInf;
+  for (double v : values) {
+    if (std::isnan(v)) {
+      return Interval::whole();
+    }
+    lo = std::min(lo, v);
+    hi = std::max(hi, v);
+  }
+  for (int i = 0; i < 2; ++i) {
+    lo = std::nextafter(lo, -kInf);
+    hi = std::nextafter(hi, kInf);
+  }
+  return {lo, hi};
+}
+
+bool contains(const Interval &x, double v) { return x.lo <= v && v <= x.hi; }
+
+// [lo, hi]中是否（近似地）含有offset + k*period形式的点，误差按偏大处理
+bool hasCriticalPoint(const Interval &x, double offset, double period) {
+  double slack = 1e-9 * (1.0 + std::max(std::fabs(x.lo), std::fabs(x.hi)));
+  double k = std::ceil((x.lo - slack - offset) / period);
+  return offset + k * period <= x.hi + slack;
+}
+
+Interval mul(const Interval &a, const Interval &b) {
+  return hull({a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi});
+}
+
+Interval div(const Interval &a, const Interval &b) {
+  if (b.lo == 0.0 && b.hi == 0.0) {
+    // 除数为0时结果为0，与BinaryExprNode一致
+    return {0.0, 0.0};
+  }
+  if (contains(b, 0.0)) {
+    return Interval::whole();
+  }
+  return hull({a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi});
+}
+
+Interval pow(const Interval &a, const Interval &b) {
+  if (b.lo == b.hi && b.lo == std::floor(b.lo) && std::fabs(b.lo) <= 64) {
+    double n = b.lo;
+    if (n == 0.0) {
+      return {1.0, 1.0};
+    }
+    double pl = std::pow(a.lo, n);
+    double ph = std::pow(a.hi, n);
+    bool even = std::fmod(n, 2.0) == 0.0;
+    if (n > 0.0) {
+      // 偶数次幂在0处取最小值
+      if (even && a.lo < 0.0 && a.hi > 0.0) {
+        return hull({0.0, pl, ph});
+      }
+      return hull({pl, ph});
+    }
+    // 负整数次幂：底数区间不含0时在两侧各自单调
+    if (a.lo > 0.0 || a.hi < 0.0) {
+      return hull({pl, ph});
+    }
+    return Interval::whole();
+  }
+
+  // 正底数时pow(x, y) = exp(y*ln(x))，极值在四个角上取得
+  if (a.lo > 0.0) {
+    return hull({std::pow(a.lo, b.lo), std::pow(a.lo, b.hi),
+                 std::pow(a.hi, b.lo), std::pow(a.hi, b.hi)});
+  }
+  return Interval::whole();
+}
+
+Interval callInterval(const std::string &name, const Interval &x) {
+  if (std::isnan(x.lo) || std::isnan(x.hi)) {
+    return Interval::whole();
+  }
+
+  if (name == "SIN" || name == "COS") {
+    if (!x.isBounded() || x.hi - x.lo >= 2 * kPi) {
+      return {-1.0, 1.0};
+    }
+    // cos(x) = sin(x + π/2)：把极值点平移π/2
+    double shift = name == "SIN" ? 0.0 : -kPi / 2;
+    auto f = name == "SIN" ? static_cast<double (*)(double)>(std::sin)
+                           : static_cast<double (*)(double)>(std::cos);
+    Interval r = hull({f(x.lo), f(x.hi)});
+    if (hasCriticalPoint(x, kPi / 2 + shift, 2 * kPi)) {
+      r.hi = 1.0;
+    }
+    if (hasCriticalPoint(x, -kPi / 2 + shift, 2 * kPi)) {
+      r.lo = -1.0;
+    }
+    return r;
+  }
+  if (name == "TAN") {
+    if (!x.isBounded() || x.hi - x.lo >= kPi ||
+        hasCriticalPoint(x, kPi / 2, kPi)) {
+      return Interval::whole();
+    }
+    return hull({std::tan(x.lo), std::tan(x.hi)});
+  }
+  if (name == "LN" || name == "LOG") {
+    if (x.lo <= 0.0) {
+      return Interval::whole();
+    }
+    auto f = name == "LN" ? static_cast<double (*)(double)>(std::log)
+                          : static_cast<double (*)(double)>(std::log10);
+    return hull({f(x.lo), f(x.hi)});
+  }
+  if (name == "EXP") {
+    return hull({std::exp(x.lo), std::exp(x.hi)});
+  }
+  if (name == "SQRT") {
+    if (x.lo < 0.0) {
+      return Interval::whole();
+    }
+    return hull({std::sqrt(x.lo), std::sqrt(x.hi)});
+  }
+  if (name == "ABS") {
+    if (x.lo >= 0.0) {
+      return x;
+    }
+    if (x.hi <= 0.0) {
+      return {-x.hi, -x.lo};
+    }
+    return {0.0, std::max(-x.lo, x.hi)};
+  }
+  if (name == "ASIN" || name == "ACOS") {
+    if (x.lo < -1.0 || x.hi > 1.0) {
+      return Interval::whole();
+    }
+    return name == "ASIN" ? hull({std::asin(x.lo), std::asin(x.hi)})
+                          : hull({std::acos(x.lo), std::acos(x.hi)});
+  }
+  if (name == "ATAN") {
+    return hull({std::atan(x.lo), std::atan(x.hi)});
+  }
+  if (name == "CEIL") {
+    return {std::ceil(x.lo), std::ceil(x.hi)};
+  }
+  if (name == "FLOOR") {
+    return {std::floor(x.lo), std::floor(x.hi)};
+  }
+  return Interval::whole();
+}
+
+} // anonymous namespace
+
+Interval evalInterval(const ExpressionNode *expr, Interval t) {
+  // 缺失的操作数按0求值
+  if (!expr) {
+    return {0.0, 0.0};
+  }
+  auto child = [expr, &t](size_t index) {
+    return evalInterval(
+        static_cast<const ExpressionNode *>(expr->getChild(index)), t);
+  };
+
+  switch (expr->getNodeType()) {
+  case DrawASTNodeType::ConstExpr:
+    return Interval(expr->value());
+
+  case DrawASTNodeType::ParamExpr:
+    return t;
+
+  case DrawASTNodeType::MemoExpr:
+  // 切比雪夫逼近的误差在像素的百分之一量级，远小于剔除时留出的余量
+  case DrawASTNodeType::RecurrenceExpr:
+  case DrawASTNodeType::ChebyshevExpr:
+    return child(0);
+
+  case DrawASTNodeType::UnaryExpr: {
+    Interval x = child(0);
+    if (expr->getToken().keyword() == KeywordType::Minus) {
+      return {-x.hi, -x.lo};
+    }
+    return x;
+  }
+
+  case DrawASTNodeType::BinaryExpr: {
+    Interval a = child(0);
+    Interval b = child(1);
+    switch (expr->getToken().keyword()) {
+    case KeywordType::Plus:
+      return hull({a.lo + b.lo, a.hi + b.hi});
+    case KeywordType::Minus:
+      return hull({a.lo - b.hi, a.hi - b.lo});
+    case KeywordType::Mul:
+      return mul(a, b);
+    case KeywordType::Div:
+      return div(a, b);
+    case KeywordType::Power:
+      return pow(a, b);
+    default:
+      return Interval::whole();
+    }
+  }
+
+  case DrawASTNodeType::FuncCallExpr: {
+    auto *call = static_cast<const FuncCallExprNode *>(expr);
+    size_t id = BuiltinFunctions::findByFunc(call->getFuncPtr());
+    if (id == BuiltinFunctions::npos) {
+      return Interval::whole();
+    }
+    return callInterval(BuiltinFunctions::getName(id), child(0));
+  }
+
+  default:
+    return Interval::whole();
+  }
+}
+
+} // namespace semantic
+} // namespace interpreter_exp
@@ -0,0 +1,356 @@
+// Draw语言FOR-DRAW内层循环本地代码生成的实现
+//
+// 生成的函数为void kernel(const double *ts, size_t n, double *out)（System V
+// 调用约定）。字节码的每个寄存器对应栈帧中的一个8字节槽位[rbp + 8*i]，
+// 每条指令从槽位读操作数、计算后写回；常量（字节码常量、变换参数、符号位掩码）
+// 放在代码之后的常量池中，用RIP相对寻址读取。循环状态放在被调用者保存的
+// 寄存器中，调用libm函数后不需要恢复：
+//   rbx = 当前T的地址，r12 = ts的末尾，r13 = 当前输出位置，rbp = 槽位基址
+
+#include "DrawLangJit.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define DRAW_LANG_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace interpreter_exp {
+namespace semantic {
+
+#ifdef DRAW_LANG_JIT_X86_64
+
+namespace {
+
+// SSE2指令的前缀和操作码（都在0F转义之后）
+constexpr uint8_t kF2 = 0xF2; // 标量双精度
+constexpr uint8_t k66 = 0x66; // 打包双精度 / ucomisd
+constexpr uint8_t kMovsdLoad = 0x10;
+constexpr uint8_t kMovsdStore = 0x11;
+constexpr uint8_t kAddsd = 0x58;
+constexpr uint8_t kMulsd = 0x59;
+constexpr uint8_t kSubsd = 0x5C;
+constexpr uint8_t kDivsd = 0x5E;
+constexpr uint8_t kXorpd = 0x57;
+constexpr uint8_t kUcomisd = 0x2E;
+
+uint8_t modrm(int mod, int reg, int rm) {
+  return static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// 最小的x86-64汇编器：只支持生成内层循环用到的几种指令形式
+class Assembler {
+public:
+  void emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+  }
+
+  void emit32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      code_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  void emit64(uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      code_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  size_t size() const { return code_.size(); }
+
+  // 把rel32字段（位于at处）指向target
+  void patchRel32(size_t at, size_t target) {
+    auto rel = static_cast<int32_t>(static_cast<int64_t>(target) -
+                                    static_cast<int64_t>(at + 4));
+    std::memcpy(&code_[at], &rel, sizeof(rel));
+  }
+
+  // op xmm, [rbp + 8*slot]（存储时为op [rbp + 8*slot], xmm）
+  void sseSlot(uint8_t prefix, uint8_t op, int xmm, size_t slot) {
+    emit({prefix, 0x0F, op, modrm(2, xmm, 5)});
+    emit32(static_cast<uint32_t>(8 * slot));
+  }
+
+  // op xmm, [rip + 常量池中的value]
+  void ssePool(uint8_t prefix, uint8_t op, int xmm, double value) {
+    emit({prefix, 0x0F, op, modrm(0, xmm, 5)});
+    fixups_.push_back({code_.size(), poolIndex(value)});
+    emit32(0);
+  }
+
+  // op dst, src（都是xmm寄存器）
+  void sseReg(uint8_t prefix, uint8_t op, int dst, int src) {
+    emit({prefix, 0x0F, op, modrm(3, dst, src)});
+  }
+
+  // 调用函数指针：mov rax, imm64; call rax
+  void callAbsolute(const void *target) {
+    emit({0x48, 0xB8});
+    emit64(reinterpret_cast<uint64_t>(target));
+    emit({0xFF, 0xD0});
+  }
+
+  // 在代码之后（8字节对齐）放置常量池并修正所有引用，返回代码的长度
+  std::vector<uint8_t> finish(size_t *codeSize) {
+    *codeSize = code_.size();
+    while (code_.size() % 8 != 0) {
+      code_.push_back(0xCC); // int3
+    }
+    size_t poolOffset = code_.size();
+    for (double value : pool_) {
+      uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      emit64(bits);
+    }
+    for (const auto &fixup : fixups_) {
+      patchRel32(fixup.first, poolOffset + 8 * fixup.second);
+    }
+    return std::move(code_);
+  }
+
+private:
+  size_t poolIndex(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = poolIds_.find(bits);
+    if (it != poolIds_.end()) {
+      return it->second;
+    }
+    pool_.push_back(value);
+    poolIds_[bits] = pool_.size() - 1;
+    return pool_.size() - 1;
+  }
+
+  std::vector<uint8_t> code_;
+  std::vector<double> pool_;
+  std::unordered_map<uint64_t, size_t> poolIds_;
+  std::vector<std::pair<size_t, size_t>> fixups_; // (rel32位置, 常量下标)
+};
+
+// 翻译一条字节码指令：结果写回槽位in.dst
+void emitInstruction(Assembler &as, const Bytecode &code,
+                     const Instruction &in) {
+  switch (in.op) {
+  case Opcode::LoadConst:
+    as.ssePool(kF2, kMovsdLoad, 0, code.getConstants()[in.a]);
+    break;
+  case Opcode::Neg:
+    // 与C++的一元负号相同：翻转符号位
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.ssePool(kF2, kMovsdLoad, 1, -0.0);
+    as.sseReg(k66, kXorpd, 0, 1);
+    break;
+  case Opcode::Add:
+  case Opcode::Sub:
+  case Opcode::Mul: {
+    uint8_t op = in.op == Opcode::Add   ? kAddsd
+                 : in.op == Opcode::Sub ? kSubsd
+                                        : kMulsd;
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.sseSlot(kF2, op, 0, in.b);
+    break;
+  }
+  case Opcode::Div:
+    // 除数为0（不含NaN）时结果为0：ucomisd相等时ZF=1、PF=0
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.sseSlot(kF2, kMovsdLoad, 1, in.b);
+    as.sseReg(k66, kXorpd, 2, 2);
+    as.sseReg(k66, kUcomisd, 1, 2);
+    as.emit({0x7A, 8});  // jp  divide
+    as.emit({0x75, 6});  // jne divide
+    as.sseReg(k66, kXorpd, 0, 0);
+    as.emit({0xEB, 4});  // jmp done
+    as.sseReg(kF2, kDivsd, 0, 1); // divide:
+    break;                         // done:
+  case Opcode::Pow:
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.sseSlot(kF2, kMovsdLoad, 1, in.b);
+    as.callAbsolute(reinterpret_cast<const void *>(
+        static_cast<double (*)(double, double)>(std::pow)));
+    break;
+  case Opcode::Call:
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.callAbsolute(reinterpret_cast<const void *>(code.getFunction(in.func)));
+    break;
+  case Opcode::SinCos:
+    // 两次调用，SIN的结果写入dst，COS的结果写入b
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.callAbsolute(reinterpret_cast<const void *>(code.getFunction(in.func)));
+    as.sseSlot(kF2, kMovsdStore, 0, in.dst);
+    as.sseSlot(kF2, kMovsdLoad, 0, in.a);
+    as.callAbsolute(
+        reinterpret_cast<const void *>(code.getFunction(in.func2)));
+    as.sseSlot(kF2, kMovsdStore, 0, in.b);
+    return;
+  case Opcode::EvalNode:
+    break; // compile()已经排除
+  }
+  as.sseSlot(kF2, kMovsdStore, 0, in.dst);
+}
+
+std::vector<uint8_t> generate(const Bytecode &code, const JitTransform &xf,
+                              size_t *codeSize) {
+  Assembler as;
+
+  // 序言：保存用到的被调用者保存寄存器，分配槽位。
+  // 入口处rsp ≡ 8 (mod 16)，压入4个寄存器后仍为8，栈帧大小也取≡ 8，
+  // 使调用libm函数时栈按16字节对齐
+  uint32_t frame =
+      static_cast<uint32_t>((code.getRegisterCount() * 8 + 15) / 16 * 16 + 8);
+  as.emit({0x55});             // push rbp
+  as.emit({0x53});             // push rbx
+  as.emit({0x41, 0x54});       // push r12
+  as.emit({0x41, 0x55});       // push r13
+  as.emit({0x48, 0x81, 0xEC}); // sub rsp, frame
+  as.emit32(frame);
+  as.emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+
+  as.emit({0x48, 0x85, 0xF6}); // test rsi, rsi
+  as.emit({0x0F, 0x84});       // jz epilogue
+  size_t skipLoop = as.size();
+  as.emit32(0);
+  as.emit({0x48, 0x89, 0xFB});       // mov rbx, rdi
+  as.emit({0x4C, 0x8D, 0x24, 0xF7}); // lea r12, [rdi + rsi*8]
+  as.emit({0x49, 0x89, 0xD5});       // mov r13, rdx
+
+  // 循环体：r0 = T，然后依次执行字节码
+  size_t loop = as.size();
+  as.emit({kF2, 0x0F, kMovsdLoad, 0x03}); // movsd xmm0, [rbx]
+  as.sseSlot(kF2, kMovsdStore, 0, 0);
+  for (const Instruction &in : code.getInstructions()) {
+    emitInstruction(as, code, in);
+  }
+
+  // 坐标变换，运算顺序与DrawLangSemanticAnalyzer::transformCoord相同：
+  //   x = xVal*sx, y = yVal*sy
+  //   x' = x*cos + y*sin + ox, y' = y*cos - x*sin + oy
+  const auto &results = code.getResultRegisters();
+  as.sseSlot(kF2, kMovsdLoad, 0, results[0]);
+  as.ssePool(kF2, kMulsd, 0, xf.scaleX);
+  as.sseSlot(kF2, kMovsdLoad, 1, results[1]);
+  as.ssePool(kF2, kMulsd, 1, xf.scaleY);
+  as.sseReg(kF2, kMovsdLoad, 2, 0);
+  as.ssePool(kF2, kMulsd, 2, xf.cosAngle);
+  as.sseReg(kF2, kMovsdLoad, 3, 1);
+  as.ssePool(kF2, kMulsd, 3, xf.sinAngle);
+  as.sseReg(kF2, kAddsd, 2, 3);
+  as.ssePool(kF2, kMulsd, 1, xf.cosAngle);
+  as.ssePool(kF2, kMulsd, 0, xf.sinAngle);
+  as.sseReg(kF2, kSubsd, 1, 0);
+  as.ssePool(kF2, kAddsd, 2, xf.originX);
+  as.ssePool(kF2, kAddsd, 1, xf.originY);
+  as.emit({kF2, 0x41, 0x0F, kMovsdStore, modrm(1, 2, 5), 0}); // [r13]
+  as.emit({kF2, 0x41, 0x0F, kMovsdStore, modrm(1, 1, 5), 8}); // [r13 + 8]
+
+  as.emit({0x48, 0x83, 0xC3, 0x08}); // add rbx, 8
+  as.emit({0x49, 0x83, 0xC5, 0x10}); // add r13, 16
+  as.emit({0x4C, 0x39, 0xE3});       // cmp rbx, r12
+  as.emit({0x0F, 0x82});             // jb loop
+  as.emit32(0);
+  as.patchRel32(as.size() - 4, loop);
+
+  // 尾声
+  as.patchRel32(skipLoop, as.size());
+  as.emit({0x48, 0x81, 0xC4}); // add rsp, frame
+  as.emit32(frame);
+  as.emit({0x41, 0x5D}); // pop r13
+  as.emit({0x41, 0x5C}); // pop r12
+  as.emit({0x5B});       // pop rbx
+  as.emit({0x5D});       // pop rbp
+  as.emit({0xC3});       // ret
+
+  return as.finish(codeSize);
+}
+
+// 是否设置了环境变量DRAWLANG_PERF_MAP（非空且不为"0"）
+bool perfMapEnabled() {
+  static const bool enabled = [] {
+    const char *value = std::getenv("DRAWLANG_PERF_MAP");
+    return value && *value && std::strcmp(value, "0") != 0;
+  }();
+  return enabled;
+}
+
+// 追加一条perf的JIT符号映射："起始地址 长度 名字"（十六进制）。
+// 文件只增不减，默认不写，需要用perf分析时设置DRAWLANG_PERF_MAP
+void writePerfMap(const void *start, size_t size, const std::string &name) {
+  if (!perfMapEnabled()) {
+    return;
+  }
+  std::ofstream map("/tmp/perf-" + std::to_string(getpid()) + ".map",
+                    std::ios::app);
+  if (map) {
+    map << std::hex << reinterpret_cast<uintptr_t>(start) << " " << size
+        << " " << name << "\n";
+  }
+}
+
+} // anonymous namespace
+
+bool JitKernel::isSupported() { return true; }
+
+std::unique_ptr<JitKernel> JitKernel::compile(const Bytecode &code,
+                                              const JitTransform &xf,
+                                              const std::string &name) {
+  if (code.getResultCount() != 2 || code.hasNodeEvaluations()) {
+    return nullptr;
+  }
+
+  size_t codeSize = 0;
+  std::vector<uint8_t> bytes = generate(code, xf, &codeSize);
+
+  // 先以可写方式映射并写入，再改为只读可执行
+  long pageSize = sysconf(_SC_PAGESIZE);
+  size_t page = pageSize > 0 ? static_cast<size_t>(pageSize) : 4096;
+  size_t mappedSize = (bytes.size() + page - 1) / page * page;
+  void *memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  std::memcpy(memory, bytes.data(), bytes.size());
+  if (mprotect(memory, mappedSize, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, mappedSize);
+    return nullptr;
+  }
+  writePerfMap(memory, codeSize, name);
+
+  auto kernel = std::unique_ptr<JitKernel>(new JitKernel());
+  kernel->memory_ = memory;
+  kernel->mappedSize_ = mappedSize;
+  kernel->codeSize_ = codeSize;
+  kernel->entry_ = reinterpret_cast<Entry>(memory);
+  return kernel;
+}
+
+JitKernel::~JitKernel() {
+  if (memory_) {
+    munmap(memory_, mappedSize_);
+  }
+}
+
+#else // !DRAW_LANG_JIT_X86_64
+
+bool JitKernel::isSupported() { return false; }
+
+std::unique_ptr<JitKernel> JitKernel::compile(const Bytecode &,
+                                              const JitTransform &,
+                                              const std::string &) {
+  return nullptr;
+}
+
+JitKernel::~JitKernel() = default;
+
+#endif
+
+} // namespace semantic
+} // namespace interpreter_exp
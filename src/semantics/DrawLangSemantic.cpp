@@ -2,12 +2,21 @@
 // 实现语义计算和绘图操作
 
 #include "DrawLangSemantic.hpp"
+#include "DrawLangBytecode.hpp"
+#include "DrawLangJit.hpp"
+#include "DrawLangInterval.hpp"
+#include "DrawLangThreadPool.hpp"
 #include "ErrorLog.hpp"
 #include "lexer.hpp"
 #include "spdlog/spdlog.h"
 #include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <mutex>
 
 namespace interpreter_exp {
 namespace semantic {
@@ -23,20 +32,12 @@ DrawLangSemanticAnalyzer::DrawLangSemanticAnalyzer(DrawLangParser *parser)
   double r, g, b;
   ColorStmtNode::getDefaultColor(r, g, b);
   attr_.setColor(r, g, b);
-
-  // 如果有parser，设置T值存储
-  if (parser_) {
-    parser_->setTStorage(&tStorage_);
-  }
 }
 
 DrawLangSemanticAnalyzer::~DrawLangSemanticAnalyzer() = default;
 
 void DrawLangSemanticAnalyzer::setParser(DrawLangParser *parser) {
   parser_ = parser;
-  if (parser_) {
-    parser_->setTStorage(&tStorage_);
-  }
 }
 
 int DrawLangSemanticAnalyzer::run(ProgramNode *program) {
@@ -44,18 +45,59 @@ int DrawLangSemanticAnalyzer::run(ProgramNode *program) {
     return -1;
   }
 
+  // 上一个程序的节点可能已经释放
+  context_.clearStates();
+
   // 演示模式：添加Zorro图案
   if (config_.enableDemoMode) {
     executeZorroDemo(program);
   }
 
+  if (config_.reverseOverdraw && config_.canvasWidth > 0 &&
+      config_.canvasHeight > 0 && !config_.adaptiveSampling) {
+    runReverse(program);
+    return 0;
+  }
+
+  if (executeParallelStatements(program)) {
+    return 0;
+  }
+
   // 遍历所有语句
   size_t stmtCount = program->getChildCount();
-  for (size_t i = 0; i < stmtCount; ++i) {
+  for (size_t i = 0; i < stmtCount;) {
+    size_t fused = config_.fuseLoops ? executeFusedLoops(program, i) : 0;
+    if (fused > 0) {
+      i += fused;
+      continue;
+    }
     auto *stmt = program->getStatement(i);
     if (stmt) {
       executeStatement(stmt);
     }
+    ++i;
+  }
+
+  return 0;
+}
+
+int DrawLangSemanticAnalyzer::runStatement(StatementNode *stmt) {
+  if (!stmt) {
+    return -1;
+  }
+
+  // 优化遍可能替换（释放）了之前执行过的节点
+  context_.clearStates();
+  executeStatement(stmt);
+  return 0;
+}
+
+int DrawLangSemanticAnalyzer::run(const cache::ProgramImage &image) {
+  std::vector<double> regs(std::max<size_t>(image.getRegisterCount(), 1));
+
+  size_t stmtCount = image.getStmtCount();
+  for (size_t i = 0; i < stmtCount; ++i) {
+    executeImageStmt(image, image.getStmt(i), regs.data());
   }
 
   return 0;
@@ -91,8 +133,8 @@ void DrawLangSemanticAnalyzer::executeStatement(StatementNode *stmt) {
 }
 
 void DrawLangSemanticAnalyzer::executeOriginStmt(OriginStmtNode *stmt) {
-  originX_ = stmt->getX();
-  originY_ = stmt->getY();
+  originX_ = stmt->getX(context_);
+  originY_ = stmt->getY(context_);
 
   if (config_.enableDebugOutput) {
     ErrLog::logPrint("ORIGIN: ({}, {})\n", originX_, originY_);
@@ -100,8 +142,8 @@ void DrawLangSemanticAnalyzer::executeOriginStmt(OriginStmtNode *stmt) {
 }
 
 void DrawLangSemanticAnalyzer::executeScaleStmt(ScaleStmtNode *stmt) {
-  scaleX_ = stmt->getScaleX();
-  scaleY_ = stmt->getScaleY();
+  scaleX_ = stmt->getScaleX(context_);
+  scaleY_ = stmt->getScaleY(context_);
 
   if (config_.enableDebugOutput) {
     ErrLog::logPrint("SCALE: ({}, {})\n", scaleX_, scaleY_);
@@ -109,7 +151,7 @@ void DrawLangSemanticAnalyzer::executeScaleStmt(ScaleStmtNode *stmt) {
 }
 
 void DrawLangSemanticAnalyzer::executeRotStmt(RotStmtNode *stmt) {
-  rotAngle_ = stmt->getAngle();
+  rotAngle_ = stmt->getAngle(context_);
 
   if (config_.enableDebugOutput) {
     ErrLog::logPrint("ROT: {}\n", rotAngle_);
@@ -118,7 +160,8 @@ void DrawLangSemanticAnalyzer::executeRotStmt(RotStmtNode *stmt) {
 
 void DrawLangSemanticAnalyzer::executeForDrawStmt(ForDrawStmtNode *stmt) {
   drawLoop(stmt->getStartExpr(), stmt->getEndExpr(), stmt->getStepExpr(),
-           stmt->getXExpr(), stmt->getYExpr());
+           stmt->getXExpr(), stmt->getYExpr(), stmt->getLocation(),
+           config_.adaptiveSampling || stmt->usesAdaptiveSampling());
 }
 
 void DrawLangSemanticAnalyzer::executeColorStmt(ColorStmtNode *stmt) {
@@ -132,7 +175,8 @@ void DrawLangSemanticAnalyzer::executeColorStmt(ColorStmtNode *stmt) {
     }
   } else {
     // 使用RGB值
-    attr_.setColor(stmt->getRed(), stmt->getGreen(), stmt->getBlue());
+    attr_.setColor(stmt->getRed(context_), stmt->getGreen(context_),
+                   stmt->getBlue(context_));
   }
 
   if (config_.enableDebugOutput) {
@@ -142,7 +186,7 @@ void DrawLangSemanticAnalyzer::executeColorStmt(ColorStmtNode *stmt) {
 }
 
 void DrawLangSemanticAnalyzer::executeSizeStmt(SizeStmtNode *stmt) {
-  double sz = stmt->getSize();
+  double sz = stmt->getSize(context_);
   if (sz >= 1) {
     attr_.setSize(sz);
   }
@@ -152,30 +196,30 @@ void DrawLangSemanticAnalyzer::executeSizeStmt(SizeStmtNode *stmt) {
   }
 }
 
-void DrawLangSemanticAnalyzer::calcCoord(ExpressionNode *xTree,
-                                         ExpressionNode *yTree, double *ptrX,
-                                         double *ptrY) {
-  // 计算表达式的值，得到点的原始坐标
-  double xVal = xTree ? xTree->value() : 0.0;
-  double yVal = yTree ? yTree->value() : 0.0;
+DrawLangSemanticAnalyzer::CoordTransform
+DrawLangSemanticAnalyzer::currentTransform() const {
+  return {scaleX_,  scaleY_,  std::cos(rotAngle_), std::sin(rotAngle_),
+          originX_, originY_};
+}
 
+void DrawLangSemanticAnalyzer::transformCoord(const CoordTransform &xf,
+                                              double xVal, double yVal,
+                                              double *ptrX, double *ptrY) {
   // 比例变换
-  xVal *= scaleX_;
-  yVal *= scaleY_;
+  xVal *= xf.scaleX;
+  yVal *= xf.scaleY;
 
   // 旋转变换 (与原始compile_exp保持一致的顺时针旋转)
   // x' = x * cos(θ) + y * sin(θ)
   // y' = y * cos(θ) - x * sin(θ)
-  double cosAngle = std::cos(rotAngle_);
-  double sinAngle = std::sin(rotAngle_);
-  double xTemp = xVal * cosAngle + yVal * sinAngle;
-  double yTemp = yVal * cosAngle - xVal * sinAngle;
+  double xTemp = xVal * xf.cosAngle + yVal * xf.sinAngle;
+  double yTemp = yVal * xf.cosAngle - xVal * xf.sinAngle;
   xVal = xTemp;
   yVal = yTemp;
 
   // 平移变换
-  xVal += originX_;
-  yVal += originY_;
+  xVal += xf.originX;
+  yVal += xf.originY;
 
   // 返回变换后的坐标
   if (ptrX)
@@ -184,16 +228,8 @@ void DrawLangSemanticAnalyzer::calcCoord(ExpressionNode *xTree,
     *ptrY = yVal;
 }
 
-void DrawLangSemanticAnalyzer::drawLoop(ExpressionNode *startTree,
-                                        ExpressionNode *endTree,
-                                        ExpressionNode *stepTree,
-                                        ExpressionNode *xTree,
-                                        ExpressionNode *yTree) {
-  // 计算起点、终点、步长
-  double startVal = startTree ? startTree->value() : 0.0;
-  double endVal = endTree ? endTree->value() : 0.0;
-  double stepVal = stepTree ? stepTree->value() : 1.0;
-
+bool DrawLangSemanticAnalyzer::checkLoopRange(double startVal, double endVal,
+                                              double stepVal) {
   // 调试输出 - 始终输出以方便调试
   if (config_.enableDebugOutput) {
     spdlog::debug("FOR loop: start={}, end={}, step={}", startVal, endVal,
@@ -202,51 +238,1517 @@ void DrawLangSemanticAnalyzer::drawLoop(ExpressionNode *startTree,
 
   if (stepVal == 0.0) {
     ErrLog::error_msg("Step value cannot be zero!");
-    return;
+    return false;
   }
 
   // 检查步长方向是否正确
   if ((stepVal > 0 && startVal > endVal) ||
       (stepVal < 0 && startVal < endVal)) {
     spdlog::warn("Step direction mismatch, loop will not execute!");
+    return false;
+  }
+
+  return true;
+}
+
+ThreadPool *DrawLangSemanticAnalyzer::threadPool() {
+  size_t threads = ThreadPool::resolveThreadCount(config_.threads);
+  if (threads <= 1) {
+    return nullptr;
+  }
+  if (!pool_ || pool_->size() != threads) {
+    pool_ = std::make_shared<ThreadPool>(threads);
+  }
+  return pool_.get();
+}
+
+ThreadPool *DrawLangSemanticAnalyzer::statementPool() {
+  size_t threads = ThreadPool::resolveThreadCount(config_.threads);
+  if (threads <= 1) {
+    return nullptr;
+  }
+  if (!statementPool_ || statementPool_->size() != threads) {
+    statementPool_ = std::make_shared<ThreadPool>(threads);
+  }
+  return statementPool_.get();
+}
+
+namespace {
+
+// 表达式中是否有递推节点（见RecurrenceExprNode）
+bool hasRecurrence(const DrawASTNode *node) {
+  if (!node) {
+    return false;
+  }
+  if (node->getNodeType() == DrawASTNodeType::RecurrenceExpr) {
+    return true;
+  }
+  for (size_t i = 0; i < node->getChildCount(); ++i) {
+    if (hasRecurrence(node->getChild(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+void DrawLangSemanticAnalyzer::drawLoop(ExpressionNode *startTree,
+                                        ExpressionNode *endTree,
+                                        ExpressionNode *stepTree,
+                                        ExpressionNode *xTree,
+                                        ExpressionNode *yTree,
+                                        const ASTLocation &location,
+                                        bool adaptive) {
+  // 计算起点、终点、步长
+  double startVal = startTree ? startTree->evaluate(context_) : 0.0;
+  double endVal = endTree ? endTree->evaluate(context_) : 0.0;
+  double stepVal = stepTree ? stepTree->evaluate(context_) : 1.0;
+
+  if (!checkLoopRange(startVal, endVal, stepVal)) {
     return;
   }
 
+  // 循环不变量在进入循环前只计算一次：旋转角的cos/sin，
+  // 以及整棵不依赖T的坐标表达式（如竖直线DRAW(sin(PI/7)*2, T)的x）。
+  // 部分不依赖T的子树由优化器的常量折叠在执行前处理
+  CoordTransform xf = currentTransform();
+  bool xInvariant = !xTree || !xTree->dependsOnT();
+  bool yInvariant = !yTree || !yTree->dependsOnT();
+  double xInvariantVal =
+      xTree && xInvariant ? xTree->evaluate(context_) : 0.0;
+  double yInvariantVal =
+      yTree && yInvariant ? yTree->evaluate(context_) : 0.0;
+
+  // 字节码求值：x、y共用一段指令，编译失败（表达式过大）时退回树遍历
+  std::unique_ptr<Bytecode> code;
+  if ((config_.bytecode || config_.jit || config_.vectorMath ||
+       config_.precision != Precision::Double ||
+       config_.fastMath != FastMath::Off) &&
+      !(xInvariant && yInvariant)) {
+    code = Bytecode::compile({xTree, yTree});
+    if (code) {
+      code->setVectorMath(config_.vectorMath);
+    }
+    if (code && config_.enableDebugOutput) {
+      spdlog::debug("FOR-DRAW bytecode ({} registers):\n{}",
+                    code->getRegisterCount(), code->disassemble());
+    }
+  }
+
+  // 采样点足够多时把整个内层循环（求值和坐标变换）生成为本地代码，
+  // 不支持时用字节码解释执行
+  std::unique_ptr<JitKernel> kernel;
+  if (config_.jit && code && !adaptive &&
+      (endVal - startVal) / stepVal >= kJitMinSamples) {
+    JitTransform jitXf{xf.scaleX,   xf.scaleY,  xf.cosAngle,
+                       xf.sinAngle, xf.originX, xf.originY};
+    kernel = JitKernel::compile(
+        *code, jitXf, "drawlang_for_draw_" + std::to_string(jitLoopCount_));
+    if (kernel) {
+      jitLoopCount_++;
+      if (config_.enableDebugOutput) {
+        spdlog::debug("FOR-DRAW compiled to {} bytes of native code",
+                      kernel->getCodeSize());
+      }
+    }
+  }
+  // 单精度只用于字节码批量求值
+  bool useFloat = false;
+  if (code && !kernel && !adaptive && config_.precision != Precision::Double) {
+    useFloat = config_.precision == Precision::Float ||
+               estimateFloatError(*code, xf, startVal, endVal, stepVal) <
+                   config_.floatErrorPixels;
+    if (useFloat) {
+      floatLoopCount_++;
+    }
+  }
+  // 快速近似同样只用于双精度的字节码批量求值
+  if (code && !kernel && !adaptive && !useFloat &&
+      config_.fastMath != FastMath::Off) {
+    selectFastMath(*code, xf, startVal, endVal, stepVal, location);
+  }
+  double floatError = 0.0;
+
+  auto evalRaw = [&](double *x, double *y) {
+    if (code) {
+      double xy[2];
+      code->run(context_.t, xy, &context_);
+      *x = xy[0];
+      *y = xy[1];
+      return;
+    }
+    *x = xInvariant ? xInvariantVal : xTree->evaluate(context_);
+    *y = yInvariant ? yInvariantVal : yTree->evaluate(context_);
+  };
+
   int pointCount = 0;
 
-  // 循环绘制
-  // 注意：ParamExprNode使用parser的tStorage_指针，
-  // setParser已经将其指向了analyzer的tStorage_
-  for (tStorage_ = startVal; tStorage_ <= endVal; tStorage_ += stepVal) {
+  // 在当前T值处绘制一个点
+  auto drawSample = [&]() {
+    double xVal, yVal;
+    evalRaw(&xVal, &yVal);
     double x, y;
-    calcCoord(xTree, yTree, &x, &y);
+    transformCoord(xf, xVal, yVal, &x, &y);
 
     // 每100个点输出一次调试信息
     if (config_.enableDebugOutput &&
         (pointCount < 5 || pointCount % 100 == 0)) {
-      spdlog::debug("T={} -> raw({}, {}) -> transformed({}, {})", tStorage_,
-                    (xTree ? xTree->value() : 0.0),
-                    (yTree ? yTree->value() : 0.0), x, y);
+      spdlog::debug("T={} -> raw({}, {}) -> transformed({}, {})", context_.t,
+                    xVal, yVal, x, y);
     }
 
     drawPixel(x, y);
     pointCount++;
+  };
+
+  // 绘制已经求出坐标的点
+  auto drawTransformed = [&](double t, double x, double y) {
+    if (config_.enableDebugOutput &&
+        (pointCount < 5 || pointCount % 100 == 0)) {
+      spdlog::debug("T={} -> transformed({}, {})", t, x, y);
+    }
+    drawPixel(x, y);
+    pointCount++;
+  };
+
+  // 一块采样点的缓冲区：批量求值的中间结果，以及按T的顺序排列的
+  // 未被剔除的点{t, x, y}（变换后的坐标）
+  struct ChunkBuffers {
+    std::vector<double> xs, ys;
+    std::vector<double> checkXs, checkYs; // 检查单精度结果时的双精度结果
+    std::vector<double> points;
+    size_t culled = 0;
+    double floatError = 0.0;
+  };
+  auto initBuffers = [&](ChunkBuffers &buf) {
+    buf.xs.resize(kernel ? 2 * kCullChunkSize : code ? kCullChunkSize : 0);
+    buf.ys.resize(!kernel && code ? kCullChunkSize : 0);
+    buf.checkXs.resize(useFloat && config_.checkFloat ? kCullChunkSize : 0);
+    buf.checkYs.resize(buf.checkXs.size());
+    buf.points.reserve(3 * kCullChunkSize);
+  };
+
+  // 求出一组采样点变换后的坐标，追加到buf.points：本地代码一次求出整组
+  // 变换后的坐标；字节码按批求出整组x、y（结构数组）再逐点变换；
+  // 否则逐点求值。只修改ctx和buf，可以在工作线程中执行
+  auto evalSamples = [&](EvalContext &ctx, ChunkBuffers &buf,
+                         const double *ts, size_t n) {
+    auto &points = buf.points;
+    if (kernel) {
+      kernel->run(ts, n, buf.xs.data());
+      for (size_t i = 0; i < n; ++i) {
+        points.insert(points.end(), {ts[i], buf.xs[2 * i], buf.xs[2 * i + 1]});
+      }
+      return;
+    }
+    if (code) {
+      double *outs[2] = {buf.xs.data(), buf.ys.data()};
+      if (!useFloat) {
+        code->runBatch(ts, n, outs, &ctx);
+      } else {
+        code->runBatchFloat(ts, n, outs, &ctx);
+        if (config_.checkFloat) {
+          double *checkOuts[2] = {buf.checkXs.data(), buf.checkYs.data()};
+          code->runBatch(ts, n, checkOuts, &ctx);
+          buf.floatError = std::max(
+              buf.floatError,
+              maxDeviceError(xf, buf.checkXs.data(), buf.checkYs.data(),
+                             buf.xs.data(), buf.ys.data(), n));
+        }
+      }
+      for (size_t i = 0; i < n; ++i) {
+        double x, y;
+        transformCoord(xf, buf.xs[i], buf.ys[i], &x, &y);
+        points.insert(points.end(), {ts[i], x, y});
+      }
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      ctx.t = ts[i];
+      double x, y;
+      transformCoord(xf, xInvariant ? xInvariantVal : xTree->evaluate(ctx),
+                     yInvariant ? yInvariantVal : yTree->evaluate(ctx), &x,
+                     &y);
+      points.insert(points.end(), {ts[i], x, y});
+    }
+  };
+
+  // 求出一块T值的点：递归二分，用区间求值跳过整段落在画布之外的
+  // 采样点，其余点按原顺序求值。不剔除时整块交给本地代码或批量求值
+  bool cull = config_.canvasWidth > 0 && config_.canvasHeight > 0;
+  auto evalChunk = [&](EvalContext &ctx, ChunkBuffers &buf,
+                       const std::vector<double> &ts) {
+    auto visit = [&](auto &self, size_t begin, size_t end) -> void {
+      if (cull && isOffCanvas(xf, xTree, yTree, ts[begin], ts[end - 1],
+                              attr_.size)) {
+        buf.culled += end - begin;
+        return;
+      }
+      if (!cull || end - begin <= kCullLeafSize) {
+        evalSamples(ctx, buf, &ts[begin], end - begin);
+        return;
+      }
+      size_t mid = begin + (end - begin) / 2;
+      self(self, begin, mid);
+      self(self, mid, end);
+    };
+    buf.points.clear();
+    visit(visit, 0, ts.size());
+  };
+
+  // 按T的顺序绘制一块求出的点
+  auto drawChunk = [&](ChunkBuffers &buf) {
+    for (size_t i = 0; i < buf.points.size(); i += 3) {
+      drawTransformed(buf.points[i], buf.points[i + 1], buf.points[i + 2]);
+    }
+    culledSampleCount_ += buf.culled;
+    buf.culled = 0;
+    floatError = std::max(floatError, buf.floatError);
+  };
+
+  // 生成下一块T值（与逐点累加得到的序列逐位相同），t为下一个T值
+  double t = startVal;
+  auto nextChunk = [&](std::vector<double> &ts) {
+    ts.clear();
+    for (; t <= endVal && ts.size() < kCullChunkSize; t += stepVal) {
+      ts.push_back(t);
+    }
+    return !ts.empty();
+  };
+
+  // 递推节点的值依赖上一个采样点，这样的循环不能分块求值
+  ThreadPool *pool = nullptr;
+  if (!adaptive && (endVal - startVal) / stepVal >= kParallelMinSamples &&
+      !hasRecurrence(xTree) && !hasRecurrence(yTree)) {
+    pool = threadPool();
   }
 
+  if (adaptive && stepVal > 0) {
+    adaptiveLoop(startVal, endVal, stepVal, xf, evalRaw);
+  } else if (pool) {
+    // 最多kParallelChunksPerThread * 线程数个块同时在线程池中求值，
+    // 每块有自己的求值上下文和缓冲区。调用线程按顺序等待最早提交的块，
+    // 绘制后用它的缓冲区提交下一块，绘制顺序与串行执行相同
+    struct Slot {
+      std::vector<double> ts;
+      ChunkBuffers buf;
+      EvalContext ctx;
+      std::future<void> done;
+    };
+    std::vector<Slot> slots(kParallelChunksPerThread * pool->size());
+    auto submit = [&](Slot &slot) {
+      if (!nextChunk(slot.ts)) {
+        return false;
+      }
+      slot.done = pool->submit(
+          [&evalChunk, &slot] { evalChunk(slot.ctx, slot.buf, slot.ts); });
+      return true;
+    };
+    size_t pending = 0;
+    for (auto &slot : slots) {
+      slot.ts.reserve(kCullChunkSize);
+      initBuffers(slot.buf);
+      pending += submit(slot);
+    }
+    parallelLoopCount_++;
+    try {
+      for (size_t i = 0; pending > 0; i = (i + 1) % slots.size()) {
+        pool->wait(slots[i].done);
+        slots[i].done.get();
+        --pending;
+        drawChunk(slots[i].buf);
+        pending += submit(slots[i]);
+      }
+    } catch (...) {
+      // 仍在执行的块引用着slots，等它们结束后再退出
+      for (auto &slot : slots) {
+        if (slot.done.valid()) {
+          pool->wait(slot.done);
+        }
+      }
+      throw;
+    }
+    context_.t = t;
+  } else if (!cull && !code) {
+    // 循环绘制
+    for (context_.t = startVal; context_.t <= endVal; context_.t += stepVal) {
+      drawSample();
+    }
+  } else {
+    std::vector<double> ts;
+    ts.reserve(kCullChunkSize);
+    ChunkBuffers buf;
+    initBuffers(buf);
+    while (nextChunk(ts)) {
+      evalChunk(context_, buf, ts);
+      drawChunk(buf);
+    }
+    context_.t = t;
+  }
+
+  if (useFloat && config_.checkFloat) {
+    floatMaxError_ = std::max(floatMaxError_, floatError);
+    spdlog::debug("FOR-DRAW evaluated in float: max {} pixels from double",
+                  floatError);
+  }
   if (config_.enableDebugOutput) {
     spdlog::debug("FOR loop completed: {} points drawn", pointCount);
   }
 }
 
+double DrawLangSemanticAnalyzer::maxDeviceError(const CoordTransform &xf,
+                                                const double *xd,
+                                                const double *yd,
+                                                const double *xs,
+                                                const double *ys, size_t n) {
+  double error = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double x0, y0, x1, y1;
+    transformCoord(xf, xd[i], yd[i], &x0, &y0);
+    if (!std::isfinite(x0) || !std::isfinite(y0)) {
+      continue;
+    }
+    transformCoord(xf, xs[i], ys[i], &x1, &y1);
+    if (!std::isfinite(x1) || !std::isfinite(y1)) {
+      return std::numeric_limits<double>::infinity();
+    }
+    error = std::max({error, std::fabs(x1 - x0), std::fabs(y1 - y0)});
+  }
+  return error;
+}
+
+double DrawLangSemanticAnalyzer::estimateFloatError(const Bytecode &code,
+                                                    const CoordTransform &xf,
+                                                    double startVal,
+                                                    double endVal,
+                                                    double stepVal) {
+  std::vector<double> ts = probeSamples(startVal, endVal, stepVal);
+  size_t probes = ts.size();
+  if (probes == 0) {
+    return 0.0;
+  }
+
+  std::vector<double> xd(probes), yd(probes), xs(probes), ys(probes);
+  double *doubleOuts[2] = {xd.data(), yd.data()};
+  double *floatOuts[2] = {xs.data(), ys.data()};
+  code.runBatch(ts.data(), probes, doubleOuts, &context_);
+  code.runBatchFloat(ts.data(), probes, floatOuts, &context_);
+  double error = kFloatProbeMargin *
+                 maxDeviceError(xf, xd.data(), yd.data(), xs.data(),
+                                ys.data(), probes);
+  if (config_.enableDebugOutput) {
+    spdlog::debug("Estimated float error: {} pixels", error);
+  }
+  return error;
+}
+
+std::vector<double> DrawLangSemanticAnalyzer::probeSamples(double startVal,
+                                                          double endVal,
+                                                          double stepVal) {
+  // 第k个采样点取startVal + k*stepVal
+  double count = std::floor((endVal - startVal) / stepVal) + 1;
+  if (!(count >= 1)) {
+    return {};
+  }
+  size_t probes = static_cast<size_t>(
+      std::min(count, static_cast<double>(kFloatProbeSamples)));
+  std::vector<double> ts(probes);
+  for (size_t i = 0; i < probes; ++i) {
+    double k = probes > 1 ? std::floor(i * (count - 1) / (probes - 1)) : 0.0;
+    ts[i] = startVal + k * stepVal;
+  }
+  return ts;
+}
+
+void DrawLangSemanticAnalyzer::selectFastMath(Bytecode &code,
+                                              const CoordTransform &xf,
+                                              double startVal, double endVal,
+                                              double stepVal,
+                                              const ASTLocation &location) {
+  using vecmath::Tier;
+  constexpr size_t kExact = vecmath::kTierCount;
+  const auto &sites = code.getCallSites();
+  std::vector<double> ts = probeSamples(startVal, endVal, stepVal);
+  size_t probes = ts.size();
+  std::vector<double> xd(probes), yd(probes), xp(probes), yp(probes);
+  double *exactOuts[2] = {xd.data(), yd.data()};
+  double *perturbedOuts[2] = {xp.data(), yp.data()};
+  code.runBatch(ts.data(), probes, exactOuts, &context_);
+
+  // 有快速近似的调用位置：各等级的误差上界，以及灵敏度，即结果变化1
+  // （相对误差的函数为变化100%）时变换后坐标的估计变化（像素）
+  struct Candidate {
+    size_t site;
+    const char *name;
+    double bounds[vecmath::kTierCount];
+    double sensitivity;
+    size_t level; // 选定的等级，kExact表示使用精确实现
+  };
+  std::vector<Candidate> candidates;
+  for (size_t i = 0; i < sites.size(); ++i) {
+    const char *name = BuiltinFunctions::getName(sites[i].func);
+    const auto *coarse = vecmath::findFast(name, Tier::Coarse);
+    if (!coarse) {
+      continue;
+    }
+    Candidate c{i, name, {}, 0.0, 0};
+    for (size_t k = 0; k < vecmath::kTierCount; ++k) {
+      c.bounds[k] = vecmath::findFast(name, static_cast<Tier>(k))->maxError;
+    }
+    if (c.bounds[0] > 0.0 && probes > 0) {
+      code.runBatchPerturbed(ts.data(), probes, perturbedOuts, &context_, i,
+                             kFastMathPerturbation, coarse->relative);
+      c.sensitivity = kFloatProbeMargin *
+                      maxDeviceError(xf, xd.data(), yd.data(), xp.data(),
+                                     yp.data(), probes) /
+                      kFastMathPerturbation;
+    }
+    candidates.push_back(c);
+  }
+  auto errorOf = [](const Candidate &c) {
+    return c.level < kExact && c.bounds[c.level] > 0.0
+               ? c.sensitivity * c.bounds[c.level]
+               : 0.0;
+  };
+
+  if (config_.fastMath == FastMath::Auto) {
+    // 从最便宜的等级开始，每次提高误差最大的调用的等级
+    for (;;) {
+      double total = 0.0;
+      Candidate *worst = nullptr;
+      for (auto &c : candidates) {
+        double error = errorOf(c);
+        total += error;
+        if (error > 0.0 && (!worst || error > errorOf(*worst))) {
+          worst = &c;
+        }
+      }
+      if (total < config_.fastMathErrorPixels || !worst) {
+        break;
+      }
+      worst->level++;
+    }
+  } else {
+    size_t level = config_.fastMath == FastMath::Coarse   ? 0
+                   : config_.fastMath == FastMath::Medium ? 1
+                                                          : 2;
+    for (auto &c : candidates) {
+      c.level = level;
+    }
+  }
+
+  std::vector<std::optional<Tier>> tiers(sites.size());
+  for (const auto &c : candidates) {
+    bool approximated = c.level < kExact;
+    Tier tier = static_cast<Tier>(approximated ? c.level : 0);
+    if (approximated) {
+      tiers[c.site] = tier;
+    }
+    fastMathUses_.push_back({sites[c.site].node, location, c.name,
+                             approximated, tier, errorOf(c)});
+    if (config_.enableDebugOutput) {
+      spdlog::debug("Fast math: {} in FOR-DRAW at {} -> {} ({} pixels)",
+                    c.name, location.toString(),
+                    approximated ? vecmath::tierName(tier) : "exact",
+                    errorOf(c));
+    }
+  }
+  code.setFastMath(tiers);
+}
+
+void DrawLangSemanticAnalyzer::adaptiveLoop(
+    double startVal, double endVal, double stepVal, const CoordTransform &xf,
+    const std::function<void(double *, double *)> &evalRaw) {
+  auto point = [&](double t, double *x, double *y) {
+    context_.t = t;
+    double xVal, yVal;
+    evalRaw(&xVal, &yVal);
+    transformCoord(xf, xVal, yVal, x, y);
+  };
+
+  // 相邻两点的距离上限：一个像素，像素画得更大时相应放宽
+  double tolerance = std::max(1.0, attr_.size);
+  double hMax = std::max(stepVal, (endVal - startVal) / kAdaptiveMinSamples);
+  double hMin = stepVal / kAdaptiveMaxRefine;
+  double h = stepVal;
+
+  double t = startVal;
+  double px, py;
+  point(t, &px, &py);
+  drawPixel(px, py);
+  size_t count = 1;
+  while (t < endVal) {
+    double tn = std::min(t + h, endVal);
+    double qx, qy;
+    point(tn, &qx, &qy);
+    double dist = std::hypot(qx - px, qy - py);
+
+    // 距离过大（或为NaN）时减半步长重试；步长至少要让T前进
+    double hFloor = std::max(
+        hMin, std::fabs(t) * 4 * std::numeric_limits<double>::epsilon());
+    if (!(dist <= tolerance) && h > hFloor) {
+      h = std::max(h / 2, hFloor);
+      continue;
+    }
+
+    drawPixel(qx, qy);
+    ++count;
+    t = tn;
+    px = qx;
+    py = qy;
+    if (dist < tolerance / 2) {
+      h = std::min(h * 2, hMax);
+    }
+  }
+
+  // 按固定步长累加得到循环结束时的T，后面的语句可能用到它
+  size_t fixedCount = 0;
+  double tEnd = startVal;
+  for (; tEnd <= endVal; tEnd += stepVal) {
+    ++fixedCount;
+  }
+  context_.t = tEnd;
+
+  adaptiveSampleCount_ += count;
+  fixedStepSampleCount_ += fixedCount;
+  if (config_.enableDebugOutput) {
+    spdlog::debug("Adaptive sampling: {} points (fixed step: {})", count,
+                  fixedCount);
+  }
+}
+
+bool DrawLangSemanticAnalyzer::deviceBounds(const CoordTransform &xf,
+                                            const ExpressionNode *xTree,
+                                            const ExpressionNode *yTree,
+                                            double t0, double t1,
+                                            DeviceBounds &bounds) {
+  Interval t(std::min(t0, t1), std::max(t0, t1));
+  Interval xRange = evalInterval(xTree, t);
+  Interval yRange = evalInterval(yTree, t);
+  if (!xRange.isBounded() || !yRange.isBounded()) {
+    return false;
+  }
+
+  // 坐标变换对(x, y)是仿射的，变换后的范围由四个角确定
+  constexpr double kInf = std::numeric_limits<double>::infinity();
+  double xMin = kInf, xMax = -kInf;
+  double yMin = kInf, yMax = -kInf;
+  for (double xv : {xRange.lo, xRange.hi}) {
+    for (double yv : {yRange.lo, yRange.hi}) {
+      double x, y;
+      transformCoord(xf, xv, yv, &x, &y);
+      xMin = std::min(xMin, x);
+      xMax = std::max(xMax, x);
+      yMin = std::min(yMin, y);
+      yMax = std::max(yMax, y);
+    }
+  }
+  if (!std::isfinite(xMin) || !std::isfinite(xMax) || !std::isfinite(yMin) ||
+      !std::isfinite(yMax)) {
+    return false;
+  }
+
+  // 留出变换本身的舍入误差
+  double slack = 1e-9 * std::max({std::fabs(xMin), std::fabs(xMax),
+                                  std::fabs(yMin), std::fabs(yMax)});
+  bounds = {xMin - slack, xMax + slack, yMin - slack, yMax + slack};
+  return true;
+}
+
+bool DrawLangSemanticAnalyzer::isOffCanvas(const CoordTransform &xf,
+                                           const ExpressionNode *xTree,
+                                           const ExpressionNode *yTree,
+                                           double t0, double t1,
+                                           double size) const {
+  DeviceBounds b;
+  if (!deviceBounds(xf, xTree, yTree, t0, t1, b)) {
+    return false;
+  }
+
+  // 像素按size画成方块，坐标截断为整数
+  double margin = size / 2 + 1;
+  return b.xMax < -margin || b.xMin > config_.canvasWidth + margin ||
+         b.yMax < -margin || b.yMin > config_.canvasHeight + margin;
+}
+
+void DrawLangSemanticAnalyzer::runReverse(ProgramNode *program) {
+  // 含有逐条开启自适应采样的循环时按顺序执行
+  size_t stmtCount = program->getChildCount();
+  for (size_t i = 0; i < stmtCount; ++i) {
+    auto *stmt = program->getStatement(i);
+    if (stmt && stmt->getNodeType() == DrawASTNodeType::ForDrawStmt &&
+        static_cast<ForDrawStmtNode *>(stmt)->usesAdaptiveSampling()) {
+      for (size_t j = 0; j < stmtCount; ++j) {
+        executeStatement(program->getStatement(j));
+      }
+      return;
+    }
+  }
+
+  // 第一遍按顺序执行设置语句，记录每个FOR-DRAW执行时的状态，
+  // 并按逐点累加的方式推进T，使后面的语句看到的T与顺序执行相同
+  std::vector<ReverseLoop> loops;
+  for (size_t i = 0; i < stmtCount; ++i) {
+    auto *stmt = program->getStatement(i);
+    if (!stmt) {
+      continue;
+    }
+    if (stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+      executeStatement(stmt);
+      continue;
+    }
+
+    auto *forDraw = static_cast<ForDrawStmtNode *>(stmt);
+    auto *startTree = forDraw->getStartExpr();
+    auto *endTree = forDraw->getEndExpr();
+    auto *stepTree = forDraw->getStepExpr();
+    double startVal = startTree ? startTree->evaluate(context_) : 0.0;
+    double endVal = endTree ? endTree->evaluate(context_) : 0.0;
+    double stepVal = stepTree ? stepTree->evaluate(context_) : 1.0;
+    if (!checkLoopRange(startVal, endVal, stepVal)) {
+      continue;
+    }
+
+    ReverseLoop loop{forDraw->getXExpr(), forDraw->getYExpr(),
+                     currentTransform(), attr_, stepVal, 0, {}};
+    double t = startVal;
+    for (; t <= endVal; t += stepVal) {
+      if (loop.sampleCount % kCullChunkSize == 0) {
+        loop.chunkStarts.push_back(t);
+      }
+      ++loop.sampleCount;
+    }
+    context_.t = t;
+    loops.push_back(std::move(loop));
+  }
+
+  // 第二遍从最后一个点开始向前绘制
+  double finalT = context_.t;
+  size_t canvasSize = static_cast<size_t>(config_.canvasWidth) *
+                      static_cast<size_t>(config_.canvasHeight);
+  coverage_.assign(canvasSize, 0);
+  coveredPixelCount_ = 0;
+  for (auto it = loops.rbegin(); it != loops.rend(); ++it) {
+    drawLoopReverse(*it);
+  }
+  context_.t = finalT;
+}
+
+void DrawLangSemanticAnalyzer::drawLoopReverse(const ReverseLoop &loop) {
+  size_t canvasSize = coverage_.size();
+  std::vector<double> ts;
+  ts.reserve(kCullChunkSize);
+  double xs[kCullLeafSize], ys[kCullLeafSize];
+
+  // 与drawLoop的剔除相同的二分，但先访问后一半；整段的方块都已被覆盖时跳过
+  auto visit = [&](auto &self, size_t begin, size_t end) -> void {
+    if (coveredPixelCount_ == canvasSize) {
+      coveredSampleCount_ += end - begin;
+      return;
+    }
+    DeviceBounds bounds;
+    int rect[4];
+    if (deviceBounds(loop.xf, loop.xTree, loop.yTree, ts[begin], ts[end - 1],
+                     bounds)) {
+      if (!stampRect(bounds, loop.attr, rect)) {
+        culledSampleCount_ += end - begin;
+        return;
+      }
+      long area = static_cast<long>(rect[2] - rect[0] + 1) *
+                  static_cast<long>(rect[3] - rect[1] + 1);
+      if (area <= kCoverScanLimit && isCovered(rect)) {
+        coveredSampleCount_ += end - begin;
+        return;
+      }
+    }
+    if (end - begin <= kCullLeafSize) {
+      // 按T的顺序求值（递推节点依赖这一点），再逆序绘制
+      for (size_t i = begin; i < end; ++i) {
+        context_.t = ts[i];
+        double xVal = loop.xTree ? loop.xTree->evaluate(context_) : 0.0;
+        double yVal = loop.yTree ? loop.yTree->evaluate(context_) : 0.0;
+        transformCoord(loop.xf, xVal, yVal, &xs[i - begin], &ys[i - begin]);
+      }
+      for (size_t i = end; i-- > begin;) {
+        stampUncovered(xs[i - begin], ys[i - begin], loop.attr);
+      }
+      return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    self(self, mid, end);
+    self(self, begin, mid);
+  };
+
+  // 从每块的起始T值重新累加，得到与顺序执行逐位相同的T
+  for (size_t chunk = loop.chunkStarts.size(); chunk-- > 0;) {
+    size_t count = std::min(kCullChunkSize,
+                            loop.sampleCount - chunk * kCullChunkSize);
+    ts.clear();
+    double t = loop.chunkStarts[chunk];
+    for (size_t i = 0; i < count; ++i, t += loop.step) {
+      ts.push_back(t);
+    }
+    visit(visit, 0, ts.size());
+  }
+}
+
+bool DrawLangSemanticAnalyzer::stampRect(const DeviceBounds &bounds,
+                                         const PixelAttribute &attr,
+                                         int rect[4]) const {
+  if (std::isnan(bounds.xMin) || std::isnan(bounds.xMax) ||
+      std::isnan(bounds.yMin) || std::isnan(bounds.yMax)) {
+    return false;
+  }
+
+  // 与DrawLangUI相同：size取整，方块为截断后的坐标±size/2
+  int size = std::max(1, static_cast<int>(std::min(attr.size, 65536.0)));
+  int half = size / 2;
+  // 先把坐标限制在画布附近，超出的部分截断后同样会被裁掉
+  auto toPixel = [half](double v, int limit) {
+    return static_cast<int>(std::clamp(v, -half - 2.0, limit + half + 1.0));
+  };
+  rect[0] = std::max(toPixel(bounds.xMin, config_.canvasWidth) - half, 0);
+  rect[1] = std::max(toPixel(bounds.yMin, config_.canvasHeight) - half, 0);
+  rect[2] = std::min(toPixel(bounds.xMax, config_.canvasWidth) + half,
+                     config_.canvasWidth - 1);
+  rect[3] = std::min(toPixel(bounds.yMax, config_.canvasHeight) + half,
+                     config_.canvasHeight - 1);
+  return rect[0] <= rect[2] && rect[1] <= rect[3];
+}
+
+bool DrawLangSemanticAnalyzer::isCovered(const int rect[4]) const {
+  for (int py = rect[1]; py <= rect[3]; ++py) {
+    const uint8_t *row = &coverage_[static_cast<size_t>(py) *
+                                    static_cast<size_t>(config_.canvasWidth)];
+    for (int px = rect[0]; px <= rect[2]; ++px) {
+      if (!row[px]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void DrawLangSemanticAnalyzer::stampUncovered(double x, double y,
+                                              const PixelAttribute &attr) {
+  int rect[4];
+  if (!stampRect({x, x, y, y}, attr, rect)) {
+    culledSampleCount_++;
+    return;
+  }
+
+  size_t width = static_cast<size_t>(config_.canvasWidth);
+  long area = static_cast<long>(rect[2] - rect[0] + 1) *
+              static_cast<long>(rect[3] - rect[1] + 1);
+  long uncovered = 0;
+  for (int py = rect[1]; py <= rect[3]; ++py) {
+    for (int px = rect[0]; px <= rect[2]; ++px) {
+      uncovered += coverage_[py * width + px] == 0;
+    }
+  }
+  if (uncovered == 0) {
+    coveredSampleCount_++;
+    return;
+  }
+
+  // 整个方块都未被覆盖时按原样绘制，否则逐个绘制未覆盖的像素
+  PixelAttribute single = attr;
+  single.size = 1.0;
+  for (int py = rect[1]; py <= rect[3]; ++py) {
+    for (int px = rect[0]; px <= rect[2]; ++px) {
+      uint8_t &covered = coverage_[py * width + px];
+      if (!covered && uncovered < area) {
+        drawPixel(px, py, single);
+      }
+      covered = 1;
+    }
+  }
+  coveredPixelCount_ += static_cast<size_t>(uncovered);
+  if (uncovered == area) {
+    drawPixel(x, y, attr);
+  }
+}
+
+namespace {
+
+// 语句的表达式是否都不依赖T
+bool isTInvariant(const StatementNode *stmt) {
+  for (size_t i = 0; i < stmt->getChildCount(); ++i) {
+    auto *expr = stmt->getExpression(i);
+    if (expr && expr->dependsOnT()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool sameBits(double a, double b) {
+  return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+} // anonymous namespace
+
+size_t DrawLangSemanticAnalyzer::executeFusedLoops(ProgramNode *program,
+                                                   size_t first) {
+  auto *head = program->getStatement(first);
+  if (!head || head->getNodeType() != DrawASTNodeType::ForDrawStmt ||
+      config_.adaptiveSampling ||
+      static_cast<ForDrawStmtNode *>(head)->usesAdaptiveSampling()) {
+    return 0;
+  }
+  // 本地代码按每个循环的坐标变换生成，单精度和快速近似按每个循环的
+  // 误差估计选择，融合执行会绕过它们
+  if (config_.jit || config_.precision != Precision::Double ||
+      config_.fastMath != FastMath::Off) {
+    return 0;
+  }
+
+  // 与drawLoop相同的默认值；第一个循环的范围在当前T下求值
+  auto range = [this](const StatementNode *stmt, double out[3]) {
+    const double defaults[3] = {0.0, 0.0, 1.0};
+    for (size_t i = 0; i < 3; ++i) {
+      auto *expr = stmt->getExpression(i);
+      out[i] = expr ? expr->evaluate(context_) : defaults[i];
+    }
+  };
+  double headRange[3];
+  range(head, headRange);
+  double startVal = headRange[0];
+  double endVal = headRange[1];
+  double stepVal = headRange[2];
+  // 不执行的循环交给executeForDrawStmt处理（包括输出警告）
+  if (stepVal == 0.0 || (stepVal > 0 && startVal > endVal) ||
+      (stepVal < 0 && startVal < endVal)) {
+    return 0;
+  }
+  // 采样点多的循环由drawLoop按块并行求值
+  double samples = (endVal - startVal) / stepVal + 1;
+  if (samples >= kParallelMinSamples &&
+      ThreadPool::resolveThreadCount(config_.threads) > 1) {
+    return 0;
+  }
+  // 第一条曲线以外的点要缓存到循环结束，按缓存上限限制曲线数
+  double maxCurves = 1 + std::floor(kFuseMaxBufferedPoints / samples);
+
+  // 后面的循环范围必须不依赖T且逐位相同，这样T的取值序列完全一样；
+  // 中间的语句不依赖T，在循环之前执行与在循环之后执行结果相同
+  size_t last = first;
+  size_t loopCount = 1;
+  size_t stmtCount = program->getChildCount();
+  for (size_t i = first + 1; i < stmtCount; ++i) {
+    auto *stmt = program->getStatement(i);
+    if (!stmt) {
+      break;
+    }
+    auto type = stmt->getNodeType();
+    if (type == DrawASTNodeType::ForDrawStmt) {
+      if (static_cast<ForDrawStmtNode *>(stmt)->usesAdaptiveSampling() ||
+          loopCount >= maxCurves) {
+        break;
+      }
+      double r[3];
+      bool invariant = true;
+      for (size_t k = 0; k < 3; ++k) {
+        auto *expr = stmt->getExpression(k);
+        invariant &= !expr || !expr->dependsOnT();
+      }
+      if (!invariant) {
+        break;
+      }
+      range(stmt, r);
+      if (!sameBits(r[0], startVal) || !sameBits(r[1], endVal) ||
+          !sameBits(r[2], stepVal)) {
+        break;
+      }
+      last = i;
+      loopCount++;
+    } else if (type == DrawASTNodeType::OriginStmt ||
+               type == DrawASTNodeType::ScaleStmt ||
+               type == DrawASTNodeType::RotStmt ||
+               type == DrawASTNodeType::ColorStmt ||
+               type == DrawASTNodeType::SizeStmt) {
+      if (!isTInvariant(stmt)) {
+        break;
+      }
+    } else {
+      break;
+    }
+  }
+  if (last == first) {
+    return 0;
+  }
+
+  // 按语句顺序执行中间语句，并记下每条曲线执行时的绘图状态
+  struct Curve {
+    ExpressionNode *x;
+    ExpressionNode *y;
+    CoordTransform xf;
+    PixelAttribute attr;
+    std::vector<std::pair<double, double>> points;
+  };
+  std::vector<Curve> curves;
+  for (size_t i = first; i <= last; ++i) {
+    auto *stmt = program->getStatement(i);
+    if (stmt->getNodeType() == DrawASTNodeType::ForDrawStmt) {
+      auto *loop = static_cast<ForDrawStmtNode *>(stmt);
+      curves.push_back(
+          {loop->getXExpr(), loop->getYExpr(), currentTransform(), attr_, {}});
+    } else {
+      executeStatement(stmt);
+    }
+  }
+
+  // 所有曲线的x、y编译为一段字节码，曲线之间共享的子表达式每个T只计算一次；
+  // 编译失败（表达式过大）时逐点树遍历
+  std::unique_ptr<Bytecode> code;
+  if (config_.bytecode || config_.vectorMath) {
+    std::vector<const ExpressionNode *> roots;
+    for (const auto &curve : curves) {
+      roots.push_back(curve.x);
+      roots.push_back(curve.y);
+    }
+    code = Bytecode::compile(roots);
+    if (code) {
+      code->setVectorMath(config_.vectorMath);
+    }
+    if (code && config_.enableDebugOutput) {
+      spdlog::debug("Fused FOR-DRAW bytecode ({} registers):\n{}",
+                    code->getRegisterCount(), code->disassemble());
+    }
+  }
+  std::vector<double> values(code ? 2 * curves.size() * kCullChunkSize : 0);
+  std::vector<double *> outs;
+  for (size_t k = 0; code && k < 2 * curves.size(); ++k) {
+    outs.push_back(&values[k * kCullChunkSize]);
+  }
+
+  // 求值一段采样点中active的曲线：第一条曲线的点直接输出，其余的缓存到
+  // 循环结束后按语句顺序输出，与逐个执行时的像素顺序相同
+  auto evalSamples = [&](const double *ts, size_t n,
+                         const std::vector<char> &active) {
+    if (code) {
+      code->runBatch(ts, n, outs.data(), &context_);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      context_.t = ts[i];
+      for (size_t k = 0; k < curves.size(); ++k) {
+        if (!active[k]) {
+          continue;
+        }
+        Curve &curve = curves[k];
+        double xVal, yVal;
+        if (code) {
+          xVal = outs[2 * k][i];
+          yVal = outs[2 * k + 1][i];
+        } else {
+          xVal = curve.x ? curve.x->evaluate(context_) : 0.0;
+          yVal = curve.y ? curve.y->evaluate(context_) : 0.0;
+        }
+        double x, y;
+        transformCoord(curve.xf, xVal, yVal, &x, &y);
+        if (k == 0) {
+          drawPixel(x, y, curve.attr);
+        } else {
+          curve.points.emplace_back(x, y);
+        }
+      }
+    }
+  };
+
+  // 与drawLoop相同的递归二分剔除，逐条曲线判断：整段落在画布之外的曲线
+  // 在这一段中不再绘制（与单独执行时剔除的点相同），所有曲线都在画布
+  // 之外时跳过求值
+  bool cull = config_.canvasWidth > 0 && config_.canvasHeight > 0;
+  std::vector<double> ts;
+  ts.reserve(kCullChunkSize);
+  auto visit = [&](auto &self, size_t begin, size_t end,
+                   std::vector<char> active) -> void {
+    size_t remaining = 0;
+    for (size_t k = 0; k < curves.size(); ++k) {
+      const Curve &curve = curves[k];
+      if (active[k] && cull &&
+          isOffCanvas(curve.xf, curve.x, curve.y, ts[begin], ts[end - 1],
+                      curve.attr.size)) {
+        active[k] = 0;
+        culledSampleCount_ += end - begin;
+      }
+      remaining += active[k];
+    }
+    if (remaining == 0) {
+      return;
+    }
+    if (!cull || end - begin <= kCullLeafSize) {
+      evalSamples(&ts[begin], end - begin, active);
+      return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    self(self, begin, mid, active);
+    self(self, mid, end, active);
+  };
+
+  // 按块生成T值（与逐点累加得到的序列逐位相同）
+  size_t pointCount = 0;
+  double t = startVal;
+  for (;;) {
+    ts.clear();
+    for (; t <= endVal && ts.size() < kCullChunkSize; t += stepVal) {
+      ts.push_back(t);
+    }
+    if (ts.empty()) {
+      break;
+    }
+    visit(visit, 0, ts.size(), std::vector<char>(curves.size(), 1));
+    pointCount += ts.size();
+  }
+  context_.t = t;
+  for (size_t k = 1; k < curves.size(); ++k) {
+    for (const auto &[x, y] : curves[k].points) {
+      drawPixel(x, y, curves[k].attr);
+    }
+  }
+
+  fusedLoopCount_ += curves.size();
+  if (config_.enableDebugOutput) {
+    spdlog::debug("Fused {} FOR loops: {} points each", curves.size(),
+                  pointCount);
+  }
+  return last - first + 1;
+}
+
+bool DrawLangSemanticAnalyzer::executeParallelStatements(ProgramNode *program) {
+  if (ThreadPool::resolveThreadCount(config_.threads) <= 1) {
+    return false;
+  }
+  size_t loopCount = 0;
+  double sampleCount = 0.0;
+  for (size_t i = 0; i < program->getChildCount(); ++i) {
+    auto *stmt = program->getStatement(i);
+    if (!stmt) {
+      continue;
+    }
+    if (stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+      if (!isTInvariant(stmt)) {
+        return false;
+      }
+      continue;
+    }
+    for (size_t k = 0; k < 3; ++k) {
+      auto *range = stmt->getExpression(k);
+      if (range && range->dependsOnT()) {
+        return false;
+      }
+    }
+    if (hasRecurrence(stmt->getExpression(3)) ||
+        hasRecurrence(stmt->getExpression(4))) {
+      return false;
+    }
+    // 范围不依赖T，这里只估计采样点数，出错的范围在执行时报告
+    auto *loop = static_cast<ForDrawStmtNode *>(stmt);
+    double startVal =
+        loop->getStartExpr() ? loop->getStartExpr()->evaluate(context_) : 0.0;
+    double endVal =
+        loop->getEndExpr() ? loop->getEndExpr()->evaluate(context_) : 0.0;
+    double stepVal =
+        loop->getStepExpr() ? loop->getStepExpr()->evaluate(context_) : 1.0;
+    if (stepVal > 0 && endVal >= startVal) {
+      sampleCount += (endVal - startVal) / stepVal + 1;
+    }
+    ++loopCount;
+  }
+  // 点数少时融合或串行执行更快
+  if (loopCount < 2 || sampleCount < kParallelStatementMinSamples) {
+    return false;
+  }
+  ThreadPool *pool = statementPool();
+  // 各语句的分析器共享分块求值的线程池
+  threadPool();
+
+  // 一条FOR-DRAW，在jobs中的下标即合成的序号。工作线程把点按块
+  // （最多kCullChunkSize个）放入chunks，缓存的点达到kStatementBufferPoints
+  // 时等待调用线程取走；调用线程逐块取走最早的语句的点并绘制
+  struct StatementJob {
+    ForDrawStmtNode *loop = nullptr;
+    std::unique_ptr<DrawLangSemanticAnalyzer> worker;
+    PixelAttribute attr; // 循环中像素属性不变，只保存一份
+    std::vector<double> filling; // 工作线程正在填充的块{x, y, ...}
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<double>> chunks;
+    size_t buffered = 0; // chunks中的点数
+    bool finished = false;
+    bool aborted = false; // 调用线程出错，不再需要后面的点
+    std::exception_ptr error;
+    std::future<void> done;
+  };
+  // 把工作线程填满的块交给调用线程，缓存已满时等待
+  auto publish = [](StatementJob &job) {
+    size_t n = job.filling.size() / 2;
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.changed.wait(lock, [&] {
+      return job.aborted || job.buffered + n <= kStatementBufferPoints;
+    });
+    if (!job.aborted && n > 0) {
+      job.chunks.push_back(std::move(job.filling));
+      job.buffered += n;
+      job.changed.notify_all();
+    }
+    job.filling.clear();
+    job.filling.reserve(2 * kCullChunkSize);
+  };
+  // 语句在语句线程池中执行：缓存满时会阻塞，不与分块求值共用工作线程。
+  // 同时执行的语句不超过语句线程池的线程数，最早的语句总有线程执行。
+  // 循环内部的分块求值仍提交到threadPool()（这些任务不会阻塞）
+  auto launch = [pool, &publish](StatementJob &job) {
+    job.done = pool->submit([&job, &publish] {
+      try {
+        job.worker->executeForDrawStmt(job.loop);
+        publish(job);
+      } catch (...) {
+        job.error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(job.mutex);
+      job.finished = true;
+      job.changed.notify_all();
+    });
+  };
+
+  // 元素中有互斥量且被线程引用，不能移动
+  std::vector<std::unique_ptr<StatementJob>> jobs;
+  jobs.reserve(loopCount);
+  // 同时执行的语句数
+  size_t window = pool->size();
+  size_t launched = 0;
+
+  try {
+    for (size_t i = 0; i < program->getChildCount(); ++i) {
+      auto *stmt = program->getStatement(i);
+      if (!stmt) {
+        continue;
+      }
+      if (stmt->getNodeType() != DrawASTNodeType::ForDrawStmt) {
+        executeStatement(stmt);
+        continue;
+      }
+
+      // 循环范围在调用线程中检查：出错时写入的ErrLog不支持并发
+      auto *loop = static_cast<ForDrawStmtNode *>(stmt);
+      auto *startTree = loop->getStartExpr();
+      auto *endTree = loop->getEndExpr();
+      auto *stepTree = loop->getStepExpr();
+      double startVal = startTree ? startTree->evaluate(context_) : 0.0;
+      double endVal = endTree ? endTree->evaluate(context_) : 0.0;
+      double stepVal = stepTree ? stepTree->evaluate(context_) : 1.0;
+      if (!checkLoopRange(startVal, endVal, stepVal)) {
+        continue;
+      }
+
+      auto &job = *jobs.emplace_back(std::make_unique<StatementJob>());
+      job.loop = loop;
+      job.attr = attr_;
+      job.filling.reserve(2 * kCullChunkSize);
+      job.worker = std::make_unique<DrawLangSemanticAnalyzer>(parser_);
+      DrawLangSemanticAnalyzer &worker = *job.worker;
+      worker.config_ = config_;
+      worker.config_.enableDemoMode = false;
+      worker.pool_ = pool_;
+      worker.originX_ = originX_;
+      worker.originY_ = originY_;
+      worker.scaleX_ = scaleX_;
+      worker.scaleY_ = scaleY_;
+      worker.rotAngle_ = rotAngle_;
+      worker.attr_ = attr_;
+      worker.drawCallback_ = [&job, &publish](double x, double y,
+                                              const PixelAttribute &) {
+        job.filling.insert(job.filling.end(), {x, y});
+        if (job.filling.size() >= 2 * kCullChunkSize) {
+          publish(job);
+        }
+      };
+      if (launched < window) {
+        launch(*jobs[launched++]);
+      }
+    }
+
+    // 按序号合成：逐块绘制最早的语句已求出的点，它结束后再开始
+    // 下一条语句；后面的语句最多缓存kStatementBufferPoints个点
+    std::vector<double> points;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+      StatementJob &job = *jobs[j];
+      for (;;) {
+        std::deque<std::vector<double>> chunks;
+        {
+          std::unique_lock<std::mutex> lock(job.mutex);
+          job.changed.wait(lock,
+                           [&] { return !job.chunks.empty() || job.finished; });
+          if (job.chunks.empty()) {
+            break;
+          }
+          chunks.swap(job.chunks);
+          job.buffered = 0;
+          job.changed.notify_all();
+        }
+        for (const auto &chunk : chunks) {
+          for (size_t i = 0; i < chunk.size(); i += 2) {
+            drawPixel(chunk[i], chunk[i + 1], job.attr);
+          }
+        }
+      }
+      job.done.get();
+      if (job.error) {
+        std::rethrow_exception(job.error);
+      }
+      mergeStats(*job.worker);
+      // 与串行执行相同，T为最后一条循环结束后的值
+      context_.t = job.worker->context_.t;
+      job.worker.reset();
+      if (launched < jobs.size()) {
+        launch(*jobs[launched++]);
+      }
+    }
+  } catch (...) {
+    // 仍在执行的语句引用着jobs：让它们丢弃后面的点，等它们结束后再退出
+    for (size_t j = 0; j < launched; ++j) {
+      StatementJob &job = *jobs[j];
+      {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.aborted = true;
+        job.changed.notify_all();
+      }
+      if (job.done.valid()) {
+        job.done.wait();
+      }
+    }
+    throw;
+  }
+
+  parallelStatementCount_ += jobs.size();
+  return true;
+}
+
+void DrawLangSemanticAnalyzer::mergeStats(
+    const DrawLangSemanticAnalyzer &worker) {
+  culledSampleCount_ += worker.culledSampleCount_;
+  adaptiveSampleCount_ += worker.adaptiveSampleCount_;
+  fixedStepSampleCount_ += worker.fixedStepSampleCount_;
+  jitLoopCount_ += worker.jitLoopCount_;
+  floatLoopCount_ += worker.floatLoopCount_;
+  floatMaxError_ = std::max(floatMaxError_, worker.floatMaxError_);
+  parallelLoopCount_ += worker.parallelLoopCount_;
+  fastMathUses_.insert(fastMathUses_.end(), worker.fastMathUses_.begin(),
+                       worker.fastMathUses_.end());
+}
+
+void DrawLangSemanticAnalyzer::executeImageStmt(
+    const cache::ProgramImage &image, const cache::ImageStmt &stmt,
+    double *regs) {
+  using cache::ImageStmtKind;
+
+  // 非循环部分的表达式在当前T值下求值，与AST执行一致
+  image.evalSpan(stmt.spans[0], context_.t, regs);
+  auto root = [&stmt, regs](size_t index) {
+    return index < stmt.rootCount ? regs[stmt.roots[index]] : 0.0;
+  };
+
+  switch (stmt.kind) {
+  case ImageStmtKind::Origin:
+    originX_ = root(0);
+    originY_ = root(1);
+    if (config_.enableDebugOutput) {
+      ErrLog::logPrint("ORIGIN: ({}, {})\n", originX_, originY_);
+    }
+    break;
+  case ImageStmtKind::Scale:
+    scaleX_ = root(0);
+    scaleY_ = root(1);
+    if (config_.enableDebugOutput) {
+      ErrLog::logPrint("SCALE: ({}, {})\n", scaleX_, scaleY_);
+    }
+    break;
+  case ImageStmtKind::Rot:
+    rotAngle_ = root(0);
+    if (config_.enableDebugOutput) {
+      ErrLog::logPrint("ROT: {}\n", rotAngle_);
+    }
+    break;
+  case ImageStmtKind::Color:
+    if (stmt.usesColorName) {
+      if (stmt.rgb[0] >= 0.0) {
+        attr_.setColor(stmt.rgb[0], stmt.rgb[1], stmt.rgb[2]);
+      }
+    } else {
+      attr_.setColor(root(0), root(1), root(2));
+    }
+    if (config_.enableDebugOutput) {
+      ErrLog::logPrint("COLOR: ({}, {}, {})\n", static_cast<int>(attr_.r),
+                       static_cast<int>(attr_.g), static_cast<int>(attr_.b));
+    }
+    break;
+  case ImageStmtKind::Size: {
+    double sz = root(0);
+    if (sz >= 1) {
+      attr_.setSize(sz);
+    }
+    if (config_.enableDebugOutput) {
+      ErrLog::logPrint("SIZE: {}\n", attr_.size);
+    }
+    break;
+  }
+  case ImageStmtKind::ForDraw: {
+    double startVal = root(0);
+    double endVal = root(1);
+    double stepVal = root(2);
+    if (!checkLoopRange(startVal, endVal, stepVal)) {
+      break;
+    }
+
+    CoordTransform xf = currentTransform();
+    if (config_.adaptiveSampling && stepVal > 0) {
+      adaptiveLoop(startVal, endVal, stepVal, xf, [&](double *x, double *y) {
+        image.evalSpan(stmt.spans[1], context_.t, regs);
+        *x = regs[stmt.roots[3]];
+        *y = regs[stmt.roots[4]];
+      });
+      break;
+    }
+    int pointCount = 0;
+    for (context_.t = startVal; context_.t <= endVal; context_.t += stepVal) {
+      image.evalSpan(stmt.spans[1], context_.t, regs);
+      double x, y;
+      transformCoord(xf, regs[stmt.roots[3]], regs[stmt.roots[4]], &x, &y);
+      drawPixel(x, y);
+      pointCount++;
+    }
+
+    if (config_.enableDebugOutput) {
+      spdlog::debug("FOR loop completed: {} points drawn", pointCount);
+    }
+    break;
+  }
+  }
+}
+
+// 各语句的效果与executeImageStmt相同
+struct DrawLangSemanticAnalyzer::AotCallbacks {
+  static DrawLangSemanticAnalyzer *self(void *context) {
+    return static_cast<DrawLangSemanticAnalyzer *>(context);
+  }
+
+  static void origin(void *context, double x, double y) {
+    auto *s = self(context);
+    s->originX_ = x;
+    s->originY_ = y;
+    if (s->config_.enableDebugOutput) {
+      ErrLog::logPrint("ORIGIN: ({}, {})\n", s->originX_, s->originY_);
+    }
+  }
+
+  static void scale(void *context, double x, double y) {
+    auto *s = self(context);
+    s->scaleX_ = x;
+    s->scaleY_ = y;
+    if (s->config_.enableDebugOutput) {
+      ErrLog::logPrint("SCALE: ({}, {})\n", s->scaleX_, s->scaleY_);
+    }
+  }
+
+  static void rot(void *context, double angle) {
+    auto *s = self(context);
+    s->rotAngle_ = angle;
+    if (s->config_.enableDebugOutput) {
+      ErrLog::logPrint("ROT: {}\n", s->rotAngle_);
+    }
+  }
+
+  static void color(void *context, int set, double r, double g, double b) {
+    auto *s = self(context);
+    if (set) {
+      s->attr_.setColor(r, g, b);
+    }
+    if (s->config_.enableDebugOutput) {
+      ErrLog::logPrint("COLOR: ({}, {}, {})\n", static_cast<int>(s->attr_.r),
+                       static_cast<int>(s->attr_.g),
+                       static_cast<int>(s->attr_.b));
+    }
+  }
+
+  static void size(void *context, double sz) {
+    auto *s = self(context);
+    if (sz >= 1) {
+      s->attr_.setSize(sz);
+    }
+    if (s->config_.enableDebugOutput) {
+      ErrLog::logPrint("SIZE: {}\n", s->attr_.size);
+    }
+  }
+
+  static int beginLoop(void *context, double startVal, double endVal,
+                       double stepVal, double *transform,
+                       void (*eval)(double t, double *xy)) {
+    auto *s = self(context);
+    if (!s->checkLoopRange(startVal, endVal, stepVal)) {
+      return 0;
+    }
+    CoordTransform xf = s->currentTransform();
+    if (s->config_.adaptiveSampling && stepVal > 0) {
+      s->adaptiveLoop(startVal, endVal, stepVal, xf,
+                      [s, eval](double *x, double *y) {
+                        double xy[2];
+                        eval(s->context_.t, xy);
+                        *x = xy[0];
+                        *y = xy[1];
+                      });
+      return 2;
+    }
+    transform[0] = xf.scaleX;
+    transform[1] = xf.scaleY;
+    transform[2] = xf.cosAngle;
+    transform[3] = xf.sinAngle;
+    transform[4] = xf.originX;
+    transform[5] = xf.originY;
+    return 1;
+  }
+
+  static void drawPixel(void *context, double x, double y) {
+    self(context)->drawPixel(x, y);
+  }
+
+  static void endLoop(void *context, long points) {
+    if (self(context)->config_.enableDebugOutput) {
+      spdlog::debug("FOR loop completed: {} points drawn", points);
+    }
+  }
+};
+
+int DrawLangSemanticAnalyzer::run(const cache::AotModule &module) {
+  cache::AotHost host{this,
+                      &context_.t,
+                      AotCallbacks::origin,
+                      AotCallbacks::scale,
+                      AotCallbacks::rot,
+                      AotCallbacks::color,
+                      AotCallbacks::size,
+                      AotCallbacks::beginLoop,
+                      AotCallbacks::drawPixel,
+                      AotCallbacks::endLoop};
+  module.run(host);
+  return 0;
+}
+
 void DrawLangSemanticAnalyzer::drawPixel(double x, double y) {
+  drawPixel(x, y, attr_);
+}
+
+void DrawLangSemanticAnalyzer::drawPixel(double x, double y,
+                                         const PixelAttribute &attr) {
   if (drawCallback_) {
-    drawCallback_(x, y, attr_);
+    drawCallback_(x, y, attr);
   } else {
     // 默认输出到控制台
     if (config_.enableDebugOutput) {
       spdlog::debug("DrawPixel({}, {}) color=({}, {}, {})", static_cast<int>(x),
-                    static_cast<int>(y), static_cast<int>(attr_.r),
-                    static_cast<int>(attr_.g), static_cast<int>(attr_.b));
+                    static_cast<int>(y), static_cast<int>(attr.r),
+                    static_cast<int>(attr.g), static_cast<int>(attr.b));
     }
   }
 }
@@ -0,0 +1,149 @@
+// 语义分析器线程池的实现
+
+#include "DrawLangThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace interpreter_exp {
+namespace semantic {
+
+namespace {
+
+// 当前线程所属的线程池及其在池中的序号
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+
+} // anonymous namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  // 先创建全部队列再启动线程，工作线程会访问其他线程的队列
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers_[i]->thread = std::thread([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> result = packaged.get_future();
+  size_t index = currentWorker();
+  if (index == size()) {
+    index = nextQueue_.fetch_add(1, std::memory_order_relaxed) % size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+    workers_[index]->tasks.push_back(std::move(packaged));
+  }
+  queued_.fetch_add(1);
+  // 空闲线程在mutex_下检查queued_后才等待，这里先同步一次再通知，
+  // 避免通知在检查和等待之间丢失
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  ready_.notify_all();
+  return result;
+}
+
+void ThreadPool::wait(const std::future<void> &future) {
+  auto isReady = [&future] {
+    return future.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  };
+  size_t self = currentWorker();
+  while (!isReady()) {
+    if (runOne(self)) {
+      continue;
+    }
+    // 没有可执行的任务：等待新任务或者有任务完成。任务先使future就绪，
+    // 再在mutex_下增加completed_，所以这里在锁内检查不会错过
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (isReady()) {
+      break;
+    }
+    size_t seen = completed_;
+    ++waiting_;
+    ready_.wait(lock, [&] { return completed_ != seen || queued_ > 0; });
+    --waiting_;
+  }
+}
+
+size_t ThreadPool::resolveThreadCount(int threads) {
+  if (threads > 0) {
+    return static_cast<size_t>(threads);
+  }
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+size_t ThreadPool::currentWorker() const {
+  return currentPool == this ? currentIndex : size();
+}
+
+bool ThreadPool::runOne(size_t self) {
+  size_t count = size();
+  std::packaged_task<void()> task;
+  auto take = [&task](Worker &worker) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+  };
+
+  // 先取自己队列中最早的任务，再从下一个队列开始依次窃取
+  bool found = self < count && take(*workers_[self]);
+  size_t start =
+      self < count ? self + 1 : nextQueue_.load(std::memory_order_relaxed);
+  for (size_t i = 0; !found && i < count; ++i) {
+    found = take(*workers_[(start + i) % count]);
+  }
+  if (!found) {
+    return false;
+  }
+  queued_.fetch_sub(1);
+
+  task();
+
+  bool notify;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++completed_;
+    notify = waiting_ > 0;
+  }
+  if (notify) {
+    ready_.notify_all();
+  }
+  return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+  currentPool = this;
+  currentIndex = index;
+  for (;;) {
+    if (runOne(index)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+    // 停止时仍先执行完队列中剩余的任务
+    if (stopping_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+} // namespace semantic
+} // namespace interpreter_exp
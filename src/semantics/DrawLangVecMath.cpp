@@ -0,0 +1,326 @@
+// Draw语言内置函数向量化实现的指令集分派
+// 核心实现在DrawLangVecMathKernels.hpp中，分别以SSE2和AVX2的向量宽度
+// 各编译一次；AVX2的一份用target pragma编译，只在CPU支持时调用
+
+#include "DrawLangVecMath.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define DRAW_LANG_VECMATH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace interpreter_exp {
+namespace vecmath {
+
+namespace {
+
+// 函数在各表中的下标
+enum FunctionId {
+  kSin,
+  kCos,
+  kTan,
+  kLn,
+  kExp,
+  kSqrt,
+  kAbs,
+  kAsin,
+  kAcos,
+  kAtan,
+  kLog,
+  kCeil,
+  kFloor,
+  kFunctionCount
+};
+
+// 标量实现：逐个调用libm
+template <double (*F)(double)>
+void scalarArray(const double *x, double *y, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    y[i] = F(x[i]);
+  }
+}
+
+double scalarSin(double x) { return std::sin(x); }
+double scalarCos(double x) { return std::cos(x); }
+double scalarTan(double x) { return std::tan(x); }
+double scalarLn(double x) { return std::log(x); }
+double scalarExp(double x) { return std::exp(x); }
+double scalarSqrt(double x) { return std::sqrt(x); }
+double scalarAbs(double x) { return std::fabs(x); }
+double scalarAsin(double x) { return std::asin(x); }
+double scalarAcos(double x) { return std::acos(x); }
+double scalarAtan(double x) { return std::atan(x); }
+double scalarLog(double x) { return std::log10(x); }
+double scalarCeil(double x) { return std::ceil(x); }
+double scalarFloor(double x) { return std::floor(x); }
+
+void scalarSincos(const double *x, double *s, double *c, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    double v = x[i];
+    s[i] = std::sin(v);
+    c[i] = std::cos(v);
+  }
+}
+
+const ArrayFunc kScalarFuncs[] = {
+    scalarArray<scalarSin>,  scalarArray<scalarCos>,
+    scalarArray<scalarTan>,  scalarArray<scalarLn>,
+    scalarArray<scalarExp>,  scalarArray<scalarSqrt>,
+    scalarArray<scalarAbs>,  scalarArray<scalarAsin>,
+    scalarArray<scalarAcos>, scalarArray<scalarAtan>,
+    scalarArray<scalarLog>,  scalarArray<scalarCeil>,
+    scalarArray<scalarFloor>,
+};
+
+#ifdef DRAW_LANG_VECMATH_X86
+
+namespace sse2 {
+typedef double V __attribute__((vector_size(16)));
+typedef int64_t I __attribute__((vector_size(16)));
+inline V sqrtv(V x) { return _mm_sqrt_pd(x); }
+#include "DrawLangVecMathKernels.hpp"
+} // namespace sse2
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2 {
+typedef double V __attribute__((vector_size(32)));
+typedef int64_t I __attribute__((vector_size(32)));
+inline V sqrtv(V x) { return _mm256_sqrt_pd(x); }
+#include "DrawLangVecMathKernels.hpp"
+} // namespace avx2
+#pragma GCC pop_options
+
+#endif // DRAW_LANG_VECMATH_X86
+
+// 标量实现没有快速近似，各等级都使用libm
+const ArrayFunc kScalarSinFuncs[] = {scalarArray<scalarSin>,
+                                     scalarArray<scalarSin>,
+                                     scalarArray<scalarSin>};
+const ArrayFunc kScalarCosFuncs[] = {scalarArray<scalarCos>,
+                                     scalarArray<scalarCos>,
+                                     scalarArray<scalarCos>};
+const ArrayFunc kScalarExpFuncs[] = {scalarArray<scalarExp>,
+                                     scalarArray<scalarExp>,
+                                     scalarArray<scalarExp>};
+const ArrayFunc kScalarLnFuncs[] = {scalarArray<scalarLn>,
+                                    scalarArray<scalarLn>,
+                                    scalarArray<scalarLn>};
+const SincosFunc kScalarSincosFuncs[] = {scalarSincos, scalarSincos,
+                                         scalarSincos};
+
+struct Dispatch {
+  const ArrayFunc *funcs;
+  SincosFunc sincos;
+  // 快速近似，按等级索引
+  const ArrayFunc *fastSin;
+  const ArrayFunc *fastCos;
+  const ArrayFunc *fastExp;
+  const ArrayFunc *fastLn;
+  const SincosFunc *fastSincos;
+};
+
+#define DRAW_LANG_VECMATH_DISPATCH(ns)                                         \
+  {ns::kArrayFuncs,   ns::sincosArray<ns::sinCosKernel>,                     \
+   ns::kFastSinFuncs, ns::kFastCosFuncs,                                     \
+   ns::kFastExpFuncs, ns::kFastLnFuncs,                                      \
+   ns::kFastSincosFuncs}
+
+Dispatch dispatchFor(Isa isa) {
+  switch (isa) {
+#ifdef DRAW_LANG_VECMATH_X86
+  case Isa::AVX2:
+    return DRAW_LANG_VECMATH_DISPATCH(avx2);
+  case Isa::SSE2:
+    return DRAW_LANG_VECMATH_DISPATCH(sse2);
+#endif
+  default:
+    return {kScalarFuncs,    scalarSincos,    kScalarSinFuncs,
+            kScalarCosFuncs, kScalarExpFuncs, kScalarLnFuncs,
+            kScalarSincosFuncs};
+  }
+}
+
+#undef DRAW_LANG_VECMATH_DISPATCH
+
+Isa bestIsa() {
+#ifdef DRAW_LANG_VECMATH_X86
+  return __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE2;
+#else
+  return Isa::Scalar;
+#endif
+}
+
+std::atomic<Isa> &currentIsa() {
+  static std::atomic<Isa> isa{bestIsa()};
+  return isa;
+}
+
+inline Dispatch current() {
+  return dispatchFor(currentIsa().load(std::memory_order_relaxed));
+}
+
+inline void apply(FunctionId id, const double *x, double *y, size_t n) {
+  current().funcs[id](x, y, n);
+}
+
+// 快速近似的入口，调用时才按指令集分派
+template <Tier T>
+void fastSin(const double *x, double *y, size_t n) {
+  current().fastSin[static_cast<size_t>(T)](x, y, n);
+}
+
+template <Tier T>
+void fastCos(const double *x, double *y, size_t n) {
+  current().fastCos[static_cast<size_t>(T)](x, y, n);
+}
+
+template <Tier T>
+void fastExp(const double *x, double *y, size_t n) {
+  current().fastExp[static_cast<size_t>(T)](x, y, n);
+}
+
+template <Tier T>
+void fastLn(const double *x, double *y, size_t n) {
+  current().fastLn[static_cast<size_t>(T)](x, y, n);
+}
+
+} // anonymous namespace
+
+void sin(const double *x, double *y, size_t n) { apply(kSin, x, y, n); }
+void cos(const double *x, double *y, size_t n) { apply(kCos, x, y, n); }
+void tan(const double *x, double *y, size_t n) { apply(kTan, x, y, n); }
+void ln(const double *x, double *y, size_t n) { apply(kLn, x, y, n); }
+void exp(const double *x, double *y, size_t n) { apply(kExp, x, y, n); }
+void sqrt(const double *x, double *y, size_t n) { apply(kSqrt, x, y, n); }
+void abs(const double *x, double *y, size_t n) { apply(kAbs, x, y, n); }
+void asin(const double *x, double *y, size_t n) { apply(kAsin, x, y, n); }
+void acos(const double *x, double *y, size_t n) { apply(kAcos, x, y, n); }
+void atan(const double *x, double *y, size_t n) { apply(kAtan, x, y, n); }
+void log(const double *x, double *y, size_t n) { apply(kLog, x, y, n); }
+void ceil(const double *x, double *y, size_t n) { apply(kCeil, x, y, n); }
+void floor(const double *x, double *y, size_t n) { apply(kFloor, x, y, n); }
+
+void sincos(const double *x, double *s, double *c, size_t n) {
+  current().sincos(x, s, c, n);
+}
+
+void fastSincos(Tier tier, const double *x, double *s, double *c,
+                size_t n) {
+  current().fastSincos[static_cast<size_t>(tier)](x, s, c, n);
+}
+
+const std::vector<FunctionInfo> &functions() {
+  static const std::vector<FunctionInfo> table = {
+      {"SIN", std::sin, vecmath::sin, 1},
+      {"COS", std::cos, vecmath::cos, 1},
+      {"TAN", std::tan, vecmath::tan, 3},
+      {"LN", std::log, vecmath::ln, 1},
+      {"EXP", std::exp, vecmath::exp, 1},
+      {"SQRT", std::sqrt, vecmath::sqrt, 0},
+      {"ABS", std::fabs, vecmath::abs, 0},
+      {"ASIN", std::asin, vecmath::asin, 3},
+      {"ACOS", std::acos, vecmath::acos, 3},
+      {"ATAN", std::atan, vecmath::atan, 1},
+      {"LOG", std::log10, vecmath::log, 2},
+      {"CEIL", std::ceil, vecmath::ceil, 0},
+      {"FLOOR", std::floor, vecmath::floor, 0},
+  };
+  return table;
+}
+
+const FunctionInfo *find(const char *name) {
+  for (const auto &info : functions()) {
+    if (std::strcmp(info.name, name) == 0) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+const std::vector<FastFunctionInfo> &fastFunctions() {
+  constexpr Tier C = Tier::Coarse, M = Tier::Medium, F = Tier::Fine;
+  static const std::vector<FastFunctionInfo> table = {
+      {"SIN", C, fastSin<C>, 2e-5, false},
+      {"SIN", M, fastSin<M>, 5e-8, false},
+      {"SIN", F, fastSin<F>, 2e-13, false},
+      {"COS", C, fastCos<C>, 2e-5, false},
+      {"COS", M, fastCos<M>, 5e-8, false},
+      {"COS", F, fastCos<F>, 2e-13, false},
+      {"EXP", C, fastExp<C>, 1e-5, true},
+      {"EXP", M, fastExp<M>, 2e-7, true},
+      {"EXP", F, fastExp<F>, 5e-14, true},
+      {"LN", C, fastLn<C>, 2e-5, false},
+      {"LN", M, fastLn<M>, 1e-7, false},
+      {"LN", F, fastLn<F>, 5e-12, false},
+      {"SQRT", C, vecmath::sqrt, 0.0, false},
+      {"SQRT", M, vecmath::sqrt, 0.0, false},
+      {"SQRT", F, vecmath::sqrt, 0.0, false},
+  };
+  return table;
+}
+
+const FastFunctionInfo *findFast(const char *name, Tier tier) {
+  for (const auto &info : fastFunctions()) {
+    if (info.tier == tier && std::strcmp(info.name, name) == 0) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+const char *tierName(Tier tier) {
+  switch (tier) {
+  case Tier::Coarse:
+    return "coarse";
+  case Tier::Medium:
+    return "medium";
+  case Tier::Fine:
+    return "fine";
+  }
+  return "?";
+}
+
+bool isSupported(Isa isa) {
+  switch (isa) {
+  case Isa::Scalar:
+    return true;
+#ifdef DRAW_LANG_VECMATH_X86
+  case Isa::SSE2:
+    return true;
+  case Isa::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+Isa getIsa() { return currentIsa().load(std::memory_order_relaxed); }
+
+bool setIsa(Isa isa) {
+  if (!isSupported(isa)) {
+    return false;
+  }
+  currentIsa().store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+const char *isaName(Isa isa) {
+  switch (isa) {
+  case Isa::Scalar:
+    return "scalar";
+  case Isa::SSE2:
+    return "SSE2";
+  case Isa::AVX2:
+    return "AVX2";
+  }
+  return "?";
+}
+
+} // namespace vecmath
+} // namespace interpreter_exp
@@ -0,0 +1,552 @@
+// 向量数学函数的核心实现
+// 只由DrawLangVecMath.cpp在每种指令集的命名空间中各包含一次，包含前需要定义：
+//   V      double向量类型（GCC向量扩展）
+//   I      与V同宽的int64_t向量类型
+//   sqrtv  V的逐元素平方根
+// 所有运算都是逐元素的加减乘除和位运算（不使用FMA），
+// 因此不同宽度的实现对同一输入给出逐位相同的结果。
+// 多项式和归约方法取自fdlibm/musl，标量实现中的分支改为对各条路径
+// 都求值后按掩码选择
+
+// 本文件没有include guard，有意被多次包含
+
+constexpr size_t kLanes = sizeof(V) / sizeof(double);
+
+constexpr int64_t kSignMask = INT64_MIN;
+constexpr int64_t kAbsMask = INT64_MAX;
+constexpr int64_t kMantissaMask = 0x000fffffffffffffLL;
+constexpr int64_t kOneBits = 0x3ff0000000000000LL;
+// 1.5·2^52：|x| < 2^51时x + kRoundMagic的尾数低位就是round(x)
+constexpr double kRoundMagic = 0x1.8p52;
+constexpr int64_t kRoundMagicBits = 0x4338000000000000LL;
+
+inline V splat(double value) { return V{} + value; }
+
+inline V load(const double *p) {
+  V v;
+  __builtin_memcpy(&v, p, sizeof(V));
+  return v;
+}
+
+inline void store(double *p, V v) { __builtin_memcpy(p, &v, sizeof(V)); }
+
+// mask的元素为全1时取a，否则取b
+inline V select(I mask, V a, V b) {
+  return (V)(((I)a & mask) | ((I)b & ~mask));
+}
+
+inline bool anyLane(I mask) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    if (mask[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline V absv(V x) { return (V)((I)x & kAbsMask); }
+
+inline V copySign(V magnitude, V sign) {
+  return (V)(((I)magnitude & kAbsMask) | ((I)sign & kSignMask));
+}
+
+// 就近舍入到整数（偶数优先），要求|x| < 2^51
+inline V roundNearest(V x) { return (x + kRoundMagic) - kRoundMagic; }
+
+// roundNearest的结果转换为整数
+inline I toInt(V rounded) {
+  return (I)(rounded + kRoundMagic) - kRoundMagicBits;
+}
+
+// 整数（|k| < 2^51）转换为double
+inline V toDouble(I k) { return (V)(k + kRoundMagicBits) - kRoundMagic; }
+
+// 2^k，要求-1022 <= k <= 1023
+inline V pow2(I k) { return (V)((k + 1023) << 52); }
+
+// ---- 指数 ----
+
+constexpr double kLn2Hi = 6.93147180369123816490e-01;
+constexpr double kLn2Lo = 1.90821492927058770002e-10;
+constexpr double kInvLn2 = 1.44269504088896338700e+00;
+constexpr double kExpP1 = 1.66666666666666019037e-01;
+constexpr double kExpP2 = -2.77777777770155933842e-03;
+constexpr double kExpP3 = 6.61375632143793436117e-05;
+constexpr double kExpP4 = -1.65339022054652515390e-06;
+constexpr double kExpP5 = 4.13813679705723846039e-08;
+// 超出范围时结果已经上溢为inf或下溢为0，截断后k的两半都是正规数的指数
+constexpr double kExpMax = 710.0;
+constexpr double kExpMin = -746.0;
+
+inline V expKernel(V x) {
+  V xc = select(x > kExpMax, splat(kExpMax), x);
+  xc = select(xc < kExpMin, splat(kExpMin), xc);
+  // x = k·ln2 + r，|r| <= ln2/2
+  V k = roundNearest(xc * kInvLn2);
+  V hi = xc - k * kLn2Hi;
+  V lo = k * kLn2Lo;
+  V r = hi - lo;
+  V t = r * r;
+  V c = r - t * (kExpP1 + t * (kExpP2 + t * (kExpP3 + t * (kExpP4 +
+                                                            t * kExpP5))));
+  V y = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+  // 分两次乘2^k，避免k超出正规数指数的范围
+  I ki = toInt(k);
+  I k1 = ki >> 1;
+  return y * pow2(k1) * pow2(ki - k1);
+}
+
+// ---- 对数 ----
+
+constexpr double kLg1 = 6.666666666666735130e-01;
+constexpr double kLg2 = 3.999999999940941908e-01;
+constexpr double kLg3 = 2.857142874366239149e-01;
+constexpr double kLg4 = 2.222219843214978396e-01;
+constexpr double kLg5 = 1.818357216161805012e-01;
+constexpr double kLg6 = 1.531383769920937332e-01;
+constexpr double kLg7 = 1.479819860511658591e-01;
+constexpr double kIvLn10Hi = 4.34294481878168880939e-01;
+constexpr double kIvLn10Lo = 2.50829467116452752298e-11;
+constexpr double kLog10_2Hi = 3.01029995663611771306e-01;
+constexpr double kLog10_2Lo = 3.69423907715893078616e-13;
+// 尾数不小于此值（约为sqrt(2)）时除以2，使1+f落在[sqrt(2)/2, sqrt(2))
+constexpr int64_t kLogSplitBits = 0x3ff6a09e00000000LL;
+
+// x = 2^k·(1+f)的分解，以及ln(1+f) = f - hfsq + s·(hfsq+R)中的各项
+struct LogParts {
+  V k, f, hfsq, sR;
+};
+
+// x = 2^k·(1+f)，返回f，1+f在[sqrt(2)/2, sqrt(2))内
+inline V logMantissa(V x, V &k) {
+  // 次正规数先放大2^54
+  I subnormal = x < 0x1p-1022;
+  V xs = select(subnormal, x * 0x1p54, x);
+  I bits = (I)xs;
+  I e = ((bits >> 52) & 0x7ff) - 1023 - (subnormal & 54);
+  I m = (bits & kMantissaMask) | kOneBits;
+  I big = m >= kLogSplitBits;
+  V mantissa = select(big, (V)m * 0.5, (V)m);
+  e -= big;
+  k = toDouble(e);
+  return mantissa - 1.0;
+}
+
+inline LogParts logReduce(V x) {
+  LogParts p;
+  p.f = logMantissa(x, p.k);
+  p.hfsq = 0.5 * p.f * p.f;
+  V s = p.f / (2.0 + p.f);
+  V z = s * s;
+  V w = z * z;
+  V t1 = w * (kLg2 + w * (kLg4 + w * kLg6));
+  V t2 = z * (kLg1 + w * (kLg3 + w * (kLg5 + w * kLg7)));
+  p.sR = s * (p.hfsq + t2 + t1);
+  return p;
+}
+
+// 负数、0、inf和NaN的结果
+inline V logSpecial(V x, V y) {
+  y = select(x == __builtin_inf(), x, y);
+  y = select(x == 0.0, splat(-__builtin_inf()), y);
+  y = select(x < 0.0, splat(__builtin_nan("")), y);
+  return select(x != x, x, y);
+}
+
+inline V lnKernel(V x) {
+  LogParts p = logReduce(x);
+  V y = p.sR + p.k * kLn2Lo - p.hfsq + p.f + p.k * kLn2Hi;
+  return logSpecial(x, y);
+}
+
+inline V log10Kernel(V x) {
+  LogParts p = logReduce(x);
+  // f - hfsq拆成高32位和其余部分，高位与1/ln10的高位相乘没有舍入
+  V hi = p.f - p.hfsq;
+  hi = (V)((I)hi & (int64_t)0xffffffff00000000ULL);
+  V lo = p.f - hi - p.hfsq + p.sR;
+  V valHi = hi * kIvLn10Hi;
+  V y = p.k * kLog10_2Hi;
+  V valLo = p.k * kLog10_2Lo + (lo + hi) * kIvLn10Lo + lo * kIvLn10Hi;
+  V w = y + valHi;
+  valLo += (y - w) + valHi;
+  return logSpecial(x, valLo + w);
+}
+
+// ---- 三角函数 ----
+
+constexpr double kInvPio2 = 6.36619772367581382433e-01;
+constexpr double kPio2_1 = 1.57079632673412561417e+00;
+constexpr double kPio2_1t = 6.07710050650619224932e-11;
+constexpr double kPio2_2 = 6.07710050630396597660e-11;
+constexpr double kPio2_2t = 2.02226624879595063154e-21;
+constexpr double kPio2_3 = 2.02226624871116645580e-21;
+constexpr double kPio2_3t = 8.47842766036889956997e-32;
+// 超过此值（2^19·π/2）的元素用libm重新计算
+constexpr double kTrigMax = 0x1p19 * 1.57079632679489661923;
+
+constexpr double kS1 = -1.66666666666666324348e-01;
+constexpr double kS2 = 8.33333333332248946124e-03;
+constexpr double kS3 = -1.98412698298579493134e-04;
+constexpr double kS4 = 2.75573137070700676789e-06;
+constexpr double kS5 = -2.50507602534068634195e-08;
+constexpr double kS6 = 1.58969099521155010221e-10;
+
+constexpr double kC1 = 4.16666666666666019037e-02;
+constexpr double kC2 = -1.38888888888741095749e-03;
+constexpr double kC3 = 2.48015872894767294178e-05;
+constexpr double kC4 = -2.75573143513906633035e-07;
+constexpr double kC5 = 2.08757232129817482790e-09;
+constexpr double kC6 = -1.13596475577881948265e-11;
+
+// x = n·π/2 + (y0 + y1)，y0 + y1是精度约118位的双double余数。
+// 分三步减去π/2的三段，每步的乘积都是精确的
+struct TrigReduced {
+  V y0, y1;
+  I n;
+};
+
+inline TrigReduced trigReduce(V x) {
+  V fn = roundNearest(x * kInvPio2);
+  V r = x - fn * kPio2_1;
+  V t = r;
+  V w = fn * kPio2_2;
+  r = t - w;
+  w = fn * kPio2_2t - ((t - r) - w);
+  t = r;
+  w = fn * kPio2_3;
+  r = t - w;
+  w = fn * kPio2_3t - ((t - r) - w);
+
+  TrigReduced red;
+  red.y0 = r - w;
+  red.y1 = (r - red.y0) - w;
+  red.n = toInt(fn);
+  return red;
+}
+
+// |x + y| <= π/4时的sin(x + y)
+inline V sinPoly(V x, V y) {
+  V z = x * x;
+  V w = z * z;
+  V r = kS2 + z * (kS3 + z * kS4) + z * w * (kS5 + z * kS6);
+  V v = z * x;
+  return x - ((z * (0.5 * y - v * r) - y) - v * kS1);
+}
+
+// |x + y| <= π/4时的cos(x + y)
+inline V cosPoly(V x, V y) {
+  V z = x * x;
+  V w = z * z;
+  V r = z * (kC1 + z * (kC2 + z * kC3)) + w * w * (kC4 + z * (kC5 + z * kC6));
+  V hz = 0.5 * z;
+  w = 1.0 - hz;
+  return w + (((1.0 - w) - hz) + (z * r - x * y));
+}
+
+// 把|x|过大、inf和NaN的元素换成标量函数的结果
+inline V trigFixup(V x, V y, double (*scalar)(double)) {
+  I large = ~(absv(x) <= kTrigMax);
+  if (anyLane(large)) {
+    for (size_t i = 0; i < kLanes; ++i) {
+      if (large[i]) {
+        y[i] = scalar(x[i]);
+      }
+    }
+  }
+  return y;
+}
+
+// 符号位：象限的第1位为1时取负
+inline V negateIf(V v, I quadrantBit) {
+  return (V)((I)v ^ (quadrantBit << 62));
+}
+
+inline void sinCosKernel(V x, V &sinOut, V &cosOut) {
+  TrigReduced red = trigReduce(x);
+  V s = sinPoly(red.y0, red.y1);
+  V c = cosPoly(red.y0, red.y1);
+  I odd = (red.n & 1) != 0;
+  sinOut = trigFixup(x, negateIf(select(odd, c, s), red.n & 2), std::sin);
+  cosOut = trigFixup(x, negateIf(select(odd, s, c), (red.n + 1) & 2),
+                     std::cos);
+}
+
+inline V sinKernel(V x) {
+  V s, c;
+  sinCosKernel(x, s, c);
+  return s;
+}
+
+inline V cosKernel(V x) {
+  V s, c;
+  sinCosKernel(x, s, c);
+  return c;
+}
+
+// tan = sin/cos，奇数象限为-cos/sin
+inline V tanKernel(V x) {
+  TrigReduced red = trigReduce(x);
+  V s = sinPoly(red.y0, red.y1);
+  V c = cosPoly(red.y0, red.y1);
+  I odd = (red.n & 1) != 0;
+  V y = select(odd, -c / s, s / c);
+  return trigFixup(x, y, std::tan);
+}
+
+// ---- 反三角函数 ----
+
+constexpr double kAtanHi[] = {
+    4.63647609000806093515e-01, 7.85398163397448278999e-01,
+    9.82793723247329054082e-01, 1.57079632679489655800e+00};
+constexpr double kAtanLo[] = {
+    2.26987774529616870924e-17, 3.06161699786838301793e-17,
+    1.39033110312309984516e-17, 6.12323399573676603587e-17};
+constexpr double kAT[] = {
+    3.33333333333329318027e-01,  -1.99999999998764832476e-01,
+    1.42857142725034663711e-01,  -1.11111104054623557880e-01,
+    9.09088713343650656196e-02,  -7.69187620504482999495e-02,
+    6.66107313738753120669e-02,  -5.83357013379057348645e-02,
+    4.97687799461593236017e-02,  -3.65315727442169155270e-02,
+    1.62858201153657823623e-02};
+
+inline V atanKernel(V x) {
+  V ax = absv(x);
+  // |x|按区间归约为atan(hi) + atan(num/den)，NaN落在最后一个区间
+  I r0 = ax < 0.4375;
+  I r1 = ax < 0.6875;
+  I r2 = ax < 1.1875;
+  I r3 = ax < 2.4375;
+  V num = select(r3, ax - 1.5, splat(-1.0));
+  V den = select(r3, 1.0 + 1.5 * ax, ax);
+  V hi = select(r3, splat(kAtanHi[2]), splat(kAtanHi[3]));
+  V lo = select(r3, splat(kAtanLo[2]), splat(kAtanLo[3]));
+  num = select(r2, ax - 1.0, num);
+  den = select(r2, ax + 1.0, den);
+  hi = select(r2, splat(kAtanHi[1]), hi);
+  lo = select(r2, splat(kAtanLo[1]), lo);
+  num = select(r1, 2.0 * ax - 1.0, num);
+  den = select(r1, 2.0 + ax, den);
+  hi = select(r1, splat(kAtanHi[0]), hi);
+  lo = select(r1, splat(kAtanLo[0]), lo);
+  num = select(r0, ax, num);
+  den = select(r0, splat(1.0), den);
+  hi = select(r0, splat(0.0), hi);
+  lo = select(r0, splat(0.0), lo);
+
+  V xr = num / den;
+  V z = xr * xr;
+  V w = z * z;
+  V s1 = z * (kAT[0] +
+              w * (kAT[2] + w * (kAT[4] + w * (kAT[6] +
+                                               w * (kAT[8] + w * kAT[10])))));
+  V s2 = w * (kAT[1] + w * (kAT[3] + w * (kAT[5] + w * (kAT[7] +
+                                                          w * kAT[9]))));
+  V y = hi - ((xr * (s1 + s2) - lo) - xr);
+  return copySign(y, x);
+}
+
+// asin(x) = atan(x / sqrt(1 - x^2))
+inline V asinKernel(V x) {
+  return atanKernel(x / sqrtv((1.0 - x) * (1.0 + x)));
+}
+
+// acos(x) = 2·atan(sqrt((1 - x) / (1 + x)))
+inline V acosKernel(V x) {
+  return 2.0 * atanKernel(sqrtv((1.0 - x) / (1.0 + x)));
+}
+
+// ---- 精确的函数 ----
+
+inline V sqrtKernel(V x) { return sqrtv(x); }
+
+inline V absKernel(V x) { return absv(x); }
+
+// 先就近取整再修正1，|x| >= 2^52（已是整数）、inf和NaN原样返回。
+// 结果的符号与x相同（例如ceil(-0.5) = -0）
+inline V floorKernel(V x) {
+  V r = copySign(absv(x) + 0x1p52 - 0x1p52, x);
+  r = select(r > x, r - 1.0, r);
+  return select(absv(x) < 0x1p52, copySign(r, x), x);
+}
+
+inline V ceilKernel(V x) {
+  V r = copySign(absv(x) + 0x1p52 - 0x1p52, x);
+  r = select(r < x, r + 1.0, r);
+  return select(absv(x) < 0x1p52, copySign(r, x), x);
+}
+
+// ---- 快速近似 ----
+// 系数在各自的归约区间上按最小二乘拟合，阶数越低越便宜、误差越大。
+// 每个函数按等级（Coarse、Medium、Fine）各有一组系数
+
+// sin(r) = r + r·z·P(z)，cos(r) = 1 + z·Q(z)，z = r^2，|r| <= π/4
+constexpr double kFastSin0[] = {-0.16662756079273444, 0.0081515894447491515};
+constexpr double kFastSin1[] = {-0.16666650192526497, 0.0083319579768801957,
+                                -0.00019493496711838463};
+constexpr double kFastSin2[] = {-0.16666666666603494, 0.0083333333216307967,
+                                -0.00019841262248934173,
+                                2.7555079390117816e-06,
+                                -2.4744296643476681e-08};
+constexpr double kFastCos0[] = {-0.49977258032725363, 0.040481992805261692};
+constexpr double kFastCos1[] = {-0.49999892383507599, 0.041656182481924819,
+                                -0.0013596604326871046};
+constexpr double kFastCos2[] = {-0.49999999999531575, 0.041666666560305488,
+                                -0.0013888881001612185,
+                                2.4799027336750841e-05,
+                                -2.7179243187238883e-07};
+// e^r = 1 + r + r^2·P(r)，|r| <= ln2/2
+constexpr double kFastExp0[] = {0.49999120522695978, 0.16754475017303741,
+                                0.041900784566019818};
+constexpr double kFastExp1[] = {0.49999120522695978, 0.16666515988904151,
+                                0.041900784566019818, 0.0083691516941849457};
+constexpr double kFastExp2[] = {
+    0.49999999999588252,    0.16666666666608565,    0.041666666995689154,
+    0.0083333333720661904,  0.0013888806729813491,  0.00019841183760447242,
+    2.4882616862834532e-05, 2.7635562736268808e-06};
+// ln(1+f) = 2s + s·w·R(w)，s = f/(2+f)，w = s^2
+constexpr double kFastLn0[] = {0.67717224990605274};
+constexpr double kFastLn1[] = {0.66653177925116724, 0.41296972859640085};
+constexpr double kFastLn2[] = {0.6666666503079185, 0.40000442536270991,
+                               0.28531636769381236, 0.23675572638956371};
+
+template <size_t N> inline V horner(V x, const double (&c)[N]) {
+  V r = splat(c[N - 1]);
+  for (size_t i = N - 1; i-- > 0;) {
+    r = r * x + c[i];
+  }
+  return r;
+}
+
+// 只减去π/2的两段，|x| <= 2^19·π/2时余数的误差在1e-15以内
+template <const auto &SinC, const auto &CosC>
+inline I fastTrigReduce(V x, V &s, V &c) {
+  V fn = roundNearest(x * kInvPio2);
+  V r = (x - fn * kPio2_1) - fn * kPio2_1t;
+  V z = r * r;
+  s = r + r * z * horner(z, SinC);
+  c = 1.0 + z * horner(z, CosC);
+  return toInt(fn);
+}
+
+template <const auto &SinC, const auto &CosC>
+inline V fastSinKernel(V x) {
+  V s, c;
+  I n = fastTrigReduce<SinC, CosC>(x, s, c);
+  I odd = (n & 1) != 0;
+  return trigFixup(x, negateIf(select(odd, c, s), n & 2), std::sin);
+}
+
+template <const auto &SinC, const auto &CosC>
+inline V fastCosKernel(V x) {
+  V s, c;
+  I n = fastTrigReduce<SinC, CosC>(x, s, c);
+  I odd = (n & 1) != 0;
+  return trigFixup(x, negateIf(select(odd, s, c), (n + 1) & 2), std::cos);
+}
+
+template <const auto &SinC, const auto &CosC>
+inline void fastSinCosKernel(V x, V &sinOut, V &cosOut) {
+  V s, c;
+  I n = fastTrigReduce<SinC, CosC>(x, s, c);
+  I odd = (n & 1) != 0;
+  sinOut = trigFixup(x, negateIf(select(odd, c, s), n & 2), std::sin);
+  cosOut = trigFixup(x, negateIf(select(odd, s, c), (n + 1) & 2),
+                     std::cos);
+}
+
+// 归约和溢出处理与expKernel相同
+template <const auto &C> inline V fastExpKernel(V x) {
+  V xc = select(x > kExpMax, splat(kExpMax), x);
+  xc = select(xc < kExpMin, splat(kExpMin), xc);
+  V k = roundNearest(xc * kInvLn2);
+  V r = (xc - k * kLn2Hi) - k * kLn2Lo;
+  V y = 1.0 + (r + r * r * horner(r, C));
+  I ki = toInt(k);
+  I k1 = ki >> 1;
+  return y * pow2(k1) * pow2(ki - k1);
+}
+
+template <const auto &C> inline V fastLnKernel(V x) {
+  V k;
+  V f = logMantissa(x, k);
+  V s = f / (2.0 + f);
+  V w = s * s;
+  V y = k * kLn2Hi + ((s * w * horner(w, C) + k * kLn2Lo) + 2.0 * s);
+  return logSpecial(x, y);
+}
+
+// ---- 数组接口 ----
+
+// 逐向量计算y = kernel(x)；不足一个向量的尾部补齐后计算，
+// 使每个元素的结果与它在数组中的位置无关。x和y可以是同一数组
+template <V (*Kernel)(V)>
+void mapArray(const double *x, double *y, size_t n) {
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    store(y + i, Kernel(load(x + i)));
+  }
+  if (i < n) {
+    double buffer[kLanes] = {};
+    __builtin_memcpy(buffer, x + i, (n - i) * sizeof(double));
+    store(buffer, Kernel(load(buffer)));
+    __builtin_memcpy(y + i, buffer, (n - i) * sizeof(double));
+  }
+}
+
+template <void (*Kernel)(V, V &, V &)>
+void sincosArray(const double *x, double *s, double *c, size_t n) {
+  size_t i = 0;
+  V vs, vc;
+  for (; i + kLanes <= n; i += kLanes) {
+    Kernel(load(x + i), vs, vc);
+    store(s + i, vs);
+    store(c + i, vc);
+  }
+  if (i < n) {
+    double buffer[kLanes] = {};
+    __builtin_memcpy(buffer, x + i, (n - i) * sizeof(double));
+    Kernel(load(buffer), vs, vc);
+    store(buffer, vs);
+    __builtin_memcpy(s + i, buffer, (n - i) * sizeof(double));
+    store(buffer, vc);
+    __builtin_memcpy(c + i, buffer, (n - i) * sizeof(double));
+  }
+}
+
+// 与内置函数表相同的顺序
+const ArrayFunc kArrayFuncs[] = {
+    mapArray<sinKernel>,  mapArray<cosKernel>,   mapArray<tanKernel>,
+    mapArray<lnKernel>,   mapArray<expKernel>,   mapArray<sqrtKernel>,
+    mapArray<absKernel>,  mapArray<asinKernel>,  mapArray<acosKernel>,
+    mapArray<atanKernel>, mapArray<log10Kernel>, mapArray<ceilKernel>,
+    mapArray<floorKernel>,
+};
+
+
+// 快速近似，按等级排列
+const ArrayFunc kFastSinFuncs[] = {
+    mapArray<fastSinKernel<kFastSin0, kFastCos0>>,
+    mapArray<fastSinKernel<kFastSin1, kFastCos1>>,
+    mapArray<fastSinKernel<kFastSin2, kFastCos2>>,
+};
+const ArrayFunc kFastCosFuncs[] = {
+    mapArray<fastCosKernel<kFastSin0, kFastCos0>>,
+    mapArray<fastCosKernel<kFastSin1, kFastCos1>>,
+    mapArray<fastCosKernel<kFastSin2, kFastCos2>>,
+};
+const ArrayFunc kFastExpFuncs[] = {
+    mapArray<fastExpKernel<kFastExp0>>,
+    mapArray<fastExpKernel<kFastExp1>>,
+    mapArray<fastExpKernel<kFastExp2>>,
+};
+const ArrayFunc kFastLnFuncs[] = {
+    mapArray<fastLnKernel<kFastLn0>>,
+    mapArray<fastLnKernel<kFastLn1>>,
+    mapArray<fastLnKernel<kFastLn2>>,
+};
+const SincosFunc kFastSincosFuncs[] = {
+    sincosArray<fastSinCosKernel<kFastSin0, kFastCos0>>,
+    sincosArray<fastSinCosKernel<kFastSin1, kFastCos1>>,
+    sincosArray<fastSinCosKernel<kFastSin2, kFastCos2>>,
+};
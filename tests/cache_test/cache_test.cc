@@ -0,0 +1,340 @@
+/**
+ * @file cache_test.cc
+ * @brief 编译结果缓存单元测试
+ */
+
+#include "DrawLangAST.hpp"
+#include "DrawLangAot.hpp"
+#include "DrawLangParser.hpp"
+#include "DrawLangProgramCache.hpp"
+#include "DrawLangSemantic.hpp"
+#include "SimpleLexer.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <tuple>
+#include <vector>
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::lexer;
+using namespace interpreter_exp::ast;
+using namespace interpreter_exp::parser;
+using namespace interpreter_exp::semantic;
+using namespace interpreter_exp::cache;
+
+namespace {
+
+using Pixel = std::tuple<double, double, int, int, int, double>;
+
+const char *kDrawSource =
+    "pixsize is 5;\n"
+    "rot IS 0;\n"
+    "scale is (20, 20);\n"
+    "ORIGIN IS (20,120);\n"
+    "color is red;\n"
+    "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));\n"
+    "ORIGIN IS (380,240);\n"
+    "SCALE IS(80,80/3);\n"
+    "COLOR is (0, 255, 255);\n"
+    "ROT IS PI/2+2*PI/3;\n"
+    "FOR T FROM -PI TO PI STEP PI/50 DRAW (cos(T), sin(T));\n"
+    "color is (128, 0, 128);\n"
+    "FOR T FROM 0 TO PI*20 STEP PI/50\n"
+    "DRAW((1-1/(10/7)) * cos(T) + 1/(10/7)*cos(-T*((10/7)-1)),\n"
+    "     (1-1/(10/7)) * sin(T) + 1/(10/7)*sin(-T*(10/7-1)));\n"
+    "size is 0.5;\n"
+    "FOR T FROM 1 TO 2 STEP 0.25 DRAW(ln(T)/0, T**2 + abs(-T));\n"
+    "ORIGIN IS (T, T*2);\n"
+    "FOR T FROM 0 TO 1 STEP 0.5 DRAW(+T, -T);\n";
+
+} // anonymous namespace
+
+// =============================================================================
+// 测试夹具类
+// =============================================================================
+
+class CacheTest : public ::testing::Test {
+protected:
+  std::filesystem::path cacheDir_;
+  bool adaptive_ = false; // record配置的语义分析器是否自适应采样
+
+  void SetUp() override {
+    cacheDir_ = std::filesystem::temp_directory_path() /
+                ("drawlang_cache_test_" +
+                 std::string(::testing::UnitTest::GetInstance()
+                                 ->current_test_info()
+                                 ->name()));
+    std::filesystem::remove_all(cacheDir_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(cacheDir_); }
+
+  std::unique_ptr<ProgramNode> parse(const std::string &source,
+                                     DrawLangSemanticAnalyzer &analyzer) {
+    auto lexer = createLexerFromString(source, DFAType::HardCoded);
+    auto parser = std::make_unique<DrawLangParser>(lexer.release());
+    analyzer.setParser(parser.get());
+    return parser->parse();
+  }
+
+  std::vector<Pixel> runAST(const std::string &source) {
+    std::vector<Pixel> pixels;
+    DrawLangSemanticAnalyzer analyzer;
+    record(analyzer, pixels);
+    auto ast = parse(source, analyzer);
+    analyzer.run(ast.get());
+    return pixels;
+  }
+
+  std::vector<Pixel> runImage(const ProgramImage &image) {
+    std::vector<Pixel> pixels;
+    DrawLangSemanticAnalyzer analyzer;
+    record(analyzer, pixels);
+    analyzer.run(image);
+    return pixels;
+  }
+
+  std::vector<Pixel> runModule(const AotModule &module) {
+    std::vector<Pixel> pixels;
+    DrawLangSemanticAnalyzer analyzer;
+    record(analyzer, pixels);
+    analyzer.run(module);
+    return pixels;
+  }
+
+  void record(DrawLangSemanticAnalyzer &analyzer, std::vector<Pixel> &out) {
+    SemanticConfig config;
+    config.enableDebugOutput = false;
+    config.adaptiveSampling = adaptive_;
+    analyzer.setConfig(config);
+    analyzer.setDrawCallback(
+        [&out](double x, double y, const PixelAttribute &attr) {
+          out.emplace_back(x, y, attr.r, attr.g, attr.b, attr.size);
+        });
+  }
+
+  std::unique_ptr<ProgramImage> storeSource(ProgramCache &programCache,
+                                            const std::string &source) {
+    DrawLangSemanticAnalyzer analyzer;
+    auto ast = parse(source, analyzer);
+    return programCache.store(hashSource(source), ast.get());
+  }
+
+  // 把源码预先编译到缓存目录，系统没有C++编译器时返回false
+  bool compileModule(const std::string &source, std::string *error) {
+    DrawLangSemanticAnalyzer analyzer;
+    auto ast = parse(source, analyzer);
+    auto image = compileProgram(ast.get(), hashSource(source));
+    if (!image) {
+      *error = "program cannot be compiled to an image";
+      return false;
+    }
+    std::string cpp = transpileProgram(*image);
+    if (cpp.empty()) {
+      *error = "program cannot be transpiled";
+      return false;
+    }
+    std::filesystem::create_directories(cacheDir_);
+    return compileSharedObject(
+        cpp, aotModulePath(cacheDir_.string(), hashSource(source)), error);
+  }
+
+  // 修改缓存文件中的一个字节
+  void patchEntry(const std::string &path, size_t offset,
+                  unsigned char value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    ASSERT_TRUE(file.is_open());
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.put(static_cast<char>(value));
+  }
+};
+
+// =============================================================================
+// 映像执行测试
+// =============================================================================
+
+TEST_F(CacheTest, ImageMatchesASTExecution) {
+  DrawLangSemanticAnalyzer analyzer;
+  auto ast = parse(kDrawSource, analyzer);
+  auto image = compileProgram(ast.get(), hashSource(kDrawSource));
+  ASSERT_NE(image, nullptr);
+  EXPECT_FALSE(image->isMapped());
+
+  auto expected = runAST(kDrawSource);
+  auto actual = runImage(*image);
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(actual, expected);
+}
+
+TEST_F(CacheTest, SharedSubtreesAreFlattenedOnce) {
+  DrawLangSemanticAnalyzer analyzer;
+  auto ast = parse("FOR T FROM 0 TO 1 STEP 1 DRAW(sin(T)*2, sin(T)*3);",
+                   analyzer);
+  auto image = compileProgram(ast.get(), 1);
+  ASSERT_NE(image, nullptr);
+  ASSERT_EQ(image->getStmtCount(), 1u);
+
+  // x/y段：T, sin(T), 2, *, 3, *
+  const ImageStmt &stmt = image->getStmt(0);
+  EXPECT_EQ(stmt.spans[1].length, 6u);
+}
+
+// =============================================================================
+// 缓存读写测试
+// =============================================================================
+
+TEST_F(CacheTest, StoreThenLoadMapsImage) {
+  ProgramCache programCache(cacheDir_.string());
+  uint64_t hash = hashSource(kDrawSource);
+
+  EXPECT_EQ(programCache.load(hash), nullptr);
+  EXPECT_TRUE(programCache.getLastError().empty());
+
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+  EXPECT_TRUE(std::filesystem::exists(programCache.entryPath(hash)));
+
+  auto image = programCache.load(hash);
+  ASSERT_NE(image, nullptr);
+#ifndef _WIN32
+  EXPECT_TRUE(image->isMapped());
+#endif
+  EXPECT_EQ(runImage(*image), runAST(kDrawSource));
+}
+
+TEST_F(CacheTest, DifferentSourceMisses) {
+  ProgramCache programCache(cacheDir_.string());
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+
+  std::string changed = std::string(kDrawSource) + "ROT IS 1;\n";
+  EXPECT_EQ(programCache.load(hashSource(changed)), nullptr);
+  EXPECT_TRUE(programCache.getLastError().empty());
+}
+
+TEST_F(CacheTest, DifferentOptionsMiss) {
+  // 缓存的是优化后的程序，优化配置不同时不能命中
+  EXPECT_EQ(hashSource(kDrawSource, ""), hashSource(kDrawSource));
+  EXPECT_NE(hashSource(kDrawSource, "cf=1"), hashSource(kDrawSource));
+  EXPECT_NE(hashSource(kDrawSource, "cf=1"), hashSource(kDrawSource, "cf=0"));
+
+  ProgramCache programCache(cacheDir_.string());
+  DrawLangSemanticAnalyzer analyzer;
+  auto ast = parse(kDrawSource, analyzer);
+  ASSERT_NE(programCache.store(hashSource(kDrawSource, "cf=1"), ast.get()),
+            nullptr);
+  EXPECT_NE(programCache.load(hashSource(kDrawSource, "cf=1")), nullptr);
+  EXPECT_EQ(programCache.load(hashSource(kDrawSource, "cf=0")), nullptr);
+  EXPECT_TRUE(programCache.getLastError().empty());
+}
+
+TEST_F(CacheTest, ApproximationsAreNotCached) {
+  // 映像只能逐点精确求值，含切比雪夫逼近的程序不能缓存
+  DrawLangSemanticAnalyzer analyzer;
+  auto ast = parse("FOR T FROM 0 TO 1 STEP 0.1 DRAW(T, sin(T));", analyzer);
+  auto *stmt = ast->getStatement(0);
+  ASSERT_NE(stmt, nullptr);
+  stmt->setExpression(4, std::make_shared<ChebyshevExprNode>(
+                             stmt->getExpressionPtr(4),
+                             std::vector<double>{0.0, 1.0},
+                             std::vector<std::vector<double>>{{0.5, 0.5}}));
+  EXPECT_EQ(compileProgram(ast.get(), 1), nullptr);
+
+  ProgramCache programCache(cacheDir_.string());
+  EXPECT_EQ(programCache.store(1, ast.get()), nullptr);
+  EXPECT_FALSE(std::filesystem::exists(programCache.entryPath(1)));
+}
+
+TEST_F(CacheTest, CorruptedEntryIsRebuilt) {
+  ProgramCache programCache(cacheDir_.string());
+  uint64_t hash = hashSource(kDrawSource);
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+  std::string path = programCache.entryPath(hash);
+
+  // 破坏映像末尾的一个字节
+  size_t size = std::filesystem::file_size(path);
+  patchEntry(path, size - 8, 0x7f);
+
+  EXPECT_EQ(programCache.load(hash), nullptr);
+  EXPECT_FALSE(programCache.getLastError().empty());
+  EXPECT_FALSE(std::filesystem::exists(path));
+
+  // 重新写入后可以正常加载
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+  auto image = programCache.load(hash);
+  ASSERT_NE(image, nullptr);
+  EXPECT_EQ(runImage(*image), runAST(kDrawSource));
+}
+
+TEST_F(CacheTest, VersionMismatchIsRejected) {
+  ProgramCache programCache(cacheDir_.string());
+  uint64_t hash = hashSource(kDrawSource);
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+  std::string path = programCache.entryPath(hash);
+
+  // 修改文件头中的解释器版本哈希
+  patchEntry(path, offsetof(ImageHeader, versionHash), 0x00);
+  patchEntry(path, offsetof(ImageHeader, versionHash) + 1, 0x00);
+
+  EXPECT_EQ(programCache.load(hash), nullptr);
+  EXPECT_EQ(programCache.getLastError(), "interpreter version mismatch");
+  EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST_F(CacheTest, TruncatedEntryIsRejected) {
+  ProgramCache programCache(cacheDir_.string());
+  uint64_t hash = hashSource(kDrawSource);
+  ASSERT_NE(storeSource(programCache, kDrawSource), nullptr);
+  std::string path = programCache.entryPath(hash);
+
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+
+  EXPECT_EQ(programCache.load(hash), nullptr);
+  EXPECT_FALSE(programCache.getLastError().empty());
+}
+
+// =============================================================================
+// 预先编译测试
+// =============================================================================
+
+TEST_F(CacheTest, AotModuleMatchesASTExecution) {
+  std::string error;
+  if (!compileModule(kDrawSource, &error)) {
+    GTEST_SKIP() << "C++ compiler unavailable: " << error;
+  }
+  uint64_t hash = hashSource(kDrawSource);
+  std::string reason;
+  auto module =
+      AotModule::load(aotModulePath(cacheDir_.string(), hash), hash, &reason);
+  ASSERT_NE(module, nullptr) << reason;
+  EXPECT_EQ(module->info().sourceHash, hash);
+
+  // 固定步长的循环由共享库执行，自适应采样时由宿主逐点调用
+  EXPECT_EQ(runModule(*module), runAST(kDrawSource));
+  adaptive_ = true;
+  EXPECT_EQ(runModule(*module), runAST(kDrawSource));
+}
+
+TEST_F(CacheTest, AotModuleIsRejectedOnHashMismatch) {
+  uint64_t hash = hashSource(kDrawSource);
+  std::string path = aotModulePath(cacheDir_.string(), hash);
+  std::string reason = "unset";
+  EXPECT_EQ(AotModule::load(path, hash, &reason), nullptr);
+  EXPECT_TRUE(reason.empty());
+
+  std::string error;
+  if (!compileModule(kDrawSource, &error)) {
+    GTEST_SKIP() << "C++ compiler unavailable: " << error;
+  }
+  EXPECT_EQ(AotModule::load(path, hash + 1, &reason), nullptr);
+  EXPECT_EQ(reason, "source hash mismatch");
+  EXPECT_NE(AotModule::load(path, 0, &reason), nullptr);
+}
+
+// =============================================================================
+// 主函数
+// =============================================================================
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,932 @@
+/**
+ * @file optimizer_test.cc
+ * @brief AST优化器单元测试
+ */
+
+#include "DrawLangAST.hpp"
+#include "DrawLangOptimizer.hpp"
+#include "DrawLangParser.hpp"
+#include "DrawLangSemantic.hpp"
+#include "SimpleLexer.hpp"
+#include <cmath>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::lexer;
+using namespace interpreter_exp::ast;
+using namespace interpreter_exp::parser;
+using namespace interpreter_exp::semantic;
+using namespace interpreter_exp::optimizer;
+
+namespace {
+
+using Pixel = std::tuple<double, double, int, int, int, double>;
+
+const char *kDrawSource =
+    "pixsize is 5;\n"
+    "scale is (20, 20);\n"
+    "ORIGIN IS (20,120);\n"
+    "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));\n"
+    "ORIGIN IS (380,240);\n"
+    "SCALE IS(80,80/3);\n"
+    "COLOR is (0, 255/2, cos(PI/3)*255);\n"
+    "ROT IS PI/2+2*PI/3;\n"
+    "FOR T FROM -PI TO PI STEP PI/50 DRAW (cos(T), sin(T));\n"
+    "FOR T FROM 0 TO PI*20 STEP PI/50\n"
+    "DRAW((1-1/(10/7)) * cos(T) + 1/(10/7)*cos(-T*((10/7)-1)),\n"
+    "     (1-1/(10/7)) * sin(T) + 1/(10/7)*sin(-T*(10/7-1)));\n"
+    "size is 1/0 + 2;\n"
+    "FOR T FROM 1 TO 2 STEP 0.25 DRAW(ln(T)/(1-1), T**2 + abs(-T));\n"
+    "ORIGIN IS (T, T*2);\n"
+    "FOR T FROM 0 TO 1 STEP 0.5 DRAW(+T, -(-T));\n";
+
+} // anonymous namespace
+
+// =============================================================================
+// 测试夹具类
+// =============================================================================
+
+class OptimizerTest : public ::testing::Test {
+protected:
+  std::unique_ptr<DrawLangSemanticAnalyzer> analyzer_;
+  std::unique_ptr<DrawLangParser> parser_;
+  std::vector<Pixel> pixels_;
+  std::unique_ptr<ProgramNode> program_; // 最近一次execute()的程序
+  bool bytecode_ = false;                // 执行时使用字节码求值
+  bool jit_ = false;                     // 执行时生成本地代码
+  int threads_ = 1;                      // FOR-DRAW求值的线程数
+
+  void SetUp() override { resetAnalyzer(); }
+
+  // 每次执行使用新的语义分析器，避免上一次的绘图参数影响结果
+  void resetAnalyzer() {
+    pixels_.clear();
+    analyzer_ = std::make_unique<DrawLangSemanticAnalyzer>();
+    SemanticConfig config;
+    config.enableDebugOutput = false;
+    config.bytecode = bytecode_;
+    config.jit = jit_;
+    config.threads = threads_;
+    analyzer_->setConfig(config);
+    analyzer_->setDrawCallback(
+        [this](double x, double y, const PixelAttribute &attr) {
+          pixels_.emplace_back(x, y, attr.r, attr.g, attr.b, attr.size);
+        });
+  }
+
+  std::unique_ptr<ProgramNode> parse(const std::string &source) {
+    auto lexer = createLexerFromString(source, DFAType::HardCoded);
+    parser_ = std::make_unique<DrawLangParser>(lexer.release());
+    analyzer_->setParser(parser_.get());
+    return parser_->parse();
+  }
+
+  std::vector<Pixel> execute(const std::string &source, bool optimize) {
+    OptimizerConfig config;
+    return execute(source, optimize ? &config : nullptr);
+  }
+
+  std::vector<Pixel> execute(const std::string &source,
+                             const OptimizerConfig *config) {
+    resetAnalyzer();
+    program_ = parse(source);
+    if (config) {
+      Optimizer(*config, program_->getExprPool()).optimize(program_.get());
+    }
+    analyzer_->run(program_.get());
+    return pixels_;
+  }
+
+  static bool isConst(const ExpressionNode *node) {
+    return node && node->getNodeType() == DrawASTNodeType::ConstExpr;
+  }
+
+  // 对"ROT IS expr;"中的表达式在一组T值上求值
+  std::vector<double> evalOverT(const std::string &expr,
+                                const OptimizerConfig *config) {
+    auto program = parse("ROT IS " + expr + ";");
+    if (config) {
+      Optimizer(*config, program->getExprPool()).optimize(program.get());
+    }
+    std::vector<double> values;
+    EvalContext ctx;
+    for (double v : kSpecialT) {
+      ctx.t = v;
+      values.push_back(
+          program->getStatement(0)->getExpression(0)->evaluate(ctx));
+    }
+    return values;
+  }
+
+  // 按位比较（NaN与NaN视为相同）
+  static bool sameBits(const std::vector<double> &a,
+                       const std::vector<double> &b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (std::isnan(a[i]) && std::isnan(b[i])) {
+        continue;
+      }
+      if (std::memcmp(&a[i], &b[i], sizeof(double)) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // 包括±0、非规格化数、溢出边界、无穷和NaN
+  static constexpr double kSpecialT[] = {
+      0.0,   -0.0,  1.0,    -1.0,    0.1,     -2.5,     3.0,       1e300,
+      1e308, -7.25, 1e-310, -1e-310, 123.456, INFINITY, -INFINITY, NAN};
+};
+
+// =============================================================================
+// 常量折叠测试
+// =============================================================================
+
+TEST_F(OptimizerTest, FoldsTFreeLoopBounds) {
+  auto program = parse("FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, T);");
+  auto *stmt = program->getStatement(0);
+  double end = stmt->getExpression(1)->value();
+  double step = stmt->getExpression(2)->value();
+
+  ConstantFoldingPass pass(program->getExprPool());
+  EXPECT_TRUE(pass.run(program.get()));
+
+  ASSERT_TRUE(isConst(stmt->getExpression(1)));
+  ASSERT_TRUE(isConst(stmt->getExpression(2)));
+  EXPECT_EQ(stmt->getExpression(1)->value(), end);
+  EXPECT_EQ(stmt->getExpression(2)->value(), step);
+}
+
+TEST_F(OptimizerTest, FoldsBuiltinCalls) {
+  auto program = parse("ROT IS cos(PI/3);");
+  auto *stmt = program->getStatement(0);
+  double angle = stmt->getExpression(0)->value();
+
+  ConstantFoldingPass pass(program->getExprPool());
+  pass.run(program.get());
+
+  ASSERT_TRUE(isConst(stmt->getExpression(0)));
+  EXPECT_EQ(stmt->getExpression(0)->value(), angle);
+  EXPECT_EQ(pass.getCounter("fold-call"), 1u);
+  EXPECT_EQ(pass.getCounter("fold-binary"), 1u);
+}
+
+TEST_F(OptimizerTest, DivisionByZeroFoldsToZero) {
+  auto program = parse("ORIGIN IS (1/0, -1/(2-2));");
+  auto *stmt = program->getStatement(0);
+
+  ConstantFoldingPass pass(program->getExprPool());
+  pass.run(program.get());
+
+  ASSERT_TRUE(isConst(stmt->getExpression(0)));
+  ASSERT_TRUE(isConst(stmt->getExpression(1)));
+  EXPECT_EQ(stmt->getExpression(0)->value(), 0.0);
+  EXPECT_EQ(stmt->getExpression(1)->value(), 0.0);
+}
+
+TEST_F(OptimizerTest, KeepsTDependentSubtrees) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP 1 DRAW((1-1/(10/7))*cos(T), "
+                       "T);");
+  auto *stmt = program->getStatement(0);
+
+  ConstantFoldingPass pass(program->getExprPool());
+  pass.run(program.get());
+
+  auto *x = stmt->getExpression(3);
+  ASSERT_EQ(x->getNodeType(), DrawASTNodeType::BinaryExpr);
+  auto *mul = static_cast<BinaryExprNode *>(x);
+  EXPECT_TRUE(isConst(mul->getLeft()));
+  EXPECT_EQ(mul->getRight()->getNodeType(), DrawASTNodeType::FuncCallExpr);
+  EXPECT_EQ(stmt->getExpression(4)->getNodeType(),
+            DrawASTNodeType::ParamExpr);
+}
+
+TEST_F(OptimizerTest, SharedSubtreesAreFoldedOnce) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP PI/50 DRAW(PI/50*T, PI/50);");
+  auto *stmt = program->getStatement(0);
+
+  ConstantFoldingPass pass(program->getExprPool());
+  pass.run(program.get());
+
+  // PI/50在DAG中只有一个节点，只折叠一次，折叠结果仍然共享
+  EXPECT_EQ(pass.getCounter("fold-binary"), 1u);
+  auto *mul = static_cast<BinaryExprNode *>(stmt->getExpression(3));
+  EXPECT_EQ(mul->getLeft(), stmt->getExpression(2));
+  EXPECT_EQ(stmt->getExpression(4), stmt->getExpression(2));
+}
+
+TEST_F(OptimizerTest, WorksWithoutExprPool) {
+  auto lexer = createLexerFromString("SCALE IS (2*3, 4+T);",
+                                     DFAType::HardCoded);
+  DrawLangParser parser(lexer.get());
+  DrawParserConfig config;
+  config.hashConsExpressions = false;
+  parser.setConfig(config);
+  auto program = parser.parse();
+  ASSERT_EQ(program->getExprPool(), nullptr);
+
+  Optimizer(OptimizerConfig(), nullptr).optimize(program.get());
+
+  auto *stmt = program->getStatement(0);
+  ASSERT_TRUE(isConst(stmt->getExpression(0)));
+  EXPECT_EQ(stmt->getExpression(0)->value(), 6.0);
+  EXPECT_EQ(stmt->getExpression(1)->getNodeType(),
+            DrawASTNodeType::BinaryExpr);
+}
+
+TEST_F(OptimizerTest, DisabledPassesLeaveProgramUnchanged) {
+  auto program = parse("ROT IS PI/2;");
+  auto *before = program->getStatement(0)->getExpression(0);
+
+  OptimizerConfig config;
+  config.constantFolding = false;
+  config.algebraicSimplify = false;
+  config.commonSubexpr = false;
+  Optimizer opt(config, program->getExprPool());
+  opt.optimize(program.get());
+
+  EXPECT_EQ(opt.getPassCount(), 0u);
+  EXPECT_EQ(program->getStatement(0)->getExpression(0), before);
+}
+
+// =============================================================================
+// 代数化简测试
+// =============================================================================
+
+TEST_F(OptimizerTest, DefaultSimplificationsAreBitExact) {
+  const char *exprs[] = {"T*1",      "1*T",       "T/1",       "T-0",
+                         "T+(-0)",   "(-0)+T",    "T**1",      "T**0",
+                         "T*(-1)",   "-1*(-T)",   "-(-T)",     "+T",
+                         "T/4",      "T/0.5",     "T/2**(-3)", "T/2**1023",
+                         "(T**1)*1/8"};
+  OptimizerConfig config;
+  for (const char *expr : exprs) {
+    SCOPED_TRACE(expr);
+    auto expected = evalOverT(expr, nullptr);
+    auto actual = evalOverT(expr, &config);
+    EXPECT_TRUE(sameBits(expected, actual));
+  }
+}
+
+TEST_F(OptimizerTest, SimplifyRuleCounters) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP 1 DRAW(T*1 + T**0, "
+                       "-(-T)/4);");
+  ConstantFoldingPass folding(program->getExprPool());
+  AlgebraicSimplifyPass pass(OptimizerConfig(), program->getExprPool());
+  folding.run(program.get());
+  pass.run(program.get());
+
+  EXPECT_EQ(pass.getCounter("mul-one"), 1u);
+  EXPECT_EQ(pass.getCounter("pow-zero"), 1u);
+  EXPECT_EQ(pass.getCounter("double-negation"), 1u);
+  EXPECT_EQ(pass.getCounter("div-pow2"), 1u);
+  EXPECT_EQ(pass.getCounter("pow-expand"), 0u);
+
+  // -(-T)/4 -> T*0.25
+  auto *y = static_cast<BinaryExprNode *>(
+      program->getStatement(0)->getExpression(4));
+  ASSERT_EQ(y->getNodeType(), DrawASTNodeType::BinaryExpr);
+  EXPECT_EQ(y->getToken().keyword(), KeywordType::Mul);
+  EXPECT_EQ(y->getLeft()->getNodeType(), DrawASTNodeType::ParamExpr);
+  EXPECT_EQ(y->getRight()->value(), 0.25);
+}
+
+TEST_F(OptimizerTest, InexactRewritesAreOptIn) {
+  auto program = parse("SCALE IS (T**3, T/3);\nROT IS T+0;");
+  Optimizer(OptimizerConfig(), program->getExprPool())
+      .optimize(program.get());
+
+  auto *scale = program->getStatement(0);
+  EXPECT_EQ(scale->getExpression(0)->getToken().keyword(),
+            KeywordType::Power);
+  EXPECT_EQ(scale->getExpression(1)->getToken().keyword(), KeywordType::Div);
+  EXPECT_EQ(program->getStatement(1)->getExpression(0)->getNodeType(),
+            DrawASTNodeType::BinaryExpr);
+}
+
+TEST_F(OptimizerTest, OptInRewrites) {
+  auto program = parse("SCALE IS (T**3, T/3);\nROT IS T+0;");
+  OptimizerConfig config;
+  config.expandIntegerPowers = true;
+  config.reciprocalDivision = true;
+  config.ignoreSignedZeros = true;
+  Optimizer opt(config, program->getExprPool());
+  opt.optimize(program.get());
+
+  // T**3 -> (T*T)*T
+  auto *cube = static_cast<BinaryExprNode *>(
+      program->getStatement(0)->getExpression(0));
+  ASSERT_EQ(cube->getToken().keyword(), KeywordType::Mul);
+  auto *square = static_cast<BinaryExprNode *>(cube->getLeft());
+  ASSERT_EQ(square->getToken().keyword(), KeywordType::Mul);
+  EXPECT_EQ(square->getLeft(), square->getRight());
+  EXPECT_EQ(cube->getRight(), square->getLeft());
+
+  auto *div = static_cast<BinaryExprNode *>(
+      program->getStatement(0)->getExpression(1));
+  EXPECT_EQ(div->getToken().keyword(), KeywordType::Mul);
+  EXPECT_EQ(div->getRight()->value(), 1.0 / 3.0);
+
+  EXPECT_EQ(program->getStatement(1)->getExpression(0)->getNodeType(),
+            DrawASTNodeType::ParamExpr);
+}
+
+TEST_F(OptimizerTest, PowerExpansionRespectsLimit) {
+  auto program = parse("SCALE IS (T**4, T**5);");
+  OptimizerConfig config;
+  config.expandIntegerPowers = true;
+  config.maxPowerExponent = 4;
+  Optimizer(config, program->getExprPool()).optimize(program.get());
+
+  auto *stmt = program->getStatement(0);
+  EXPECT_EQ(stmt->getExpression(0)->getToken().keyword(), KeywordType::Mul);
+  EXPECT_EQ(stmt->getExpression(1)->getToken().keyword(), KeywordType::Power);
+}
+
+// =============================================================================
+// 公共子表达式消除测试
+// =============================================================================
+
+TEST_F(OptimizerTest, SharedSubexpressionsAreMemoized) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP 0.5 "
+                       "DRAW(cos(T*2)*3 + T, sin(T*2)*cos(T*2));");
+  CommonSubexprPass pass;
+  EXPECT_TRUE(pass.run(program.get()));
+
+  // T*2被cos和sin共用，cos(T*2)被x和y共用
+  EXPECT_EQ(pass.getCounter("memo-nodes"), 2u);
+  EXPECT_GT(pass.getCounter("saved-evals-per-sample"), 0u);
+  ASSERT_EQ(pass.getRemarks().size(), 1u);
+  EXPECT_EQ(pass.getRemarks()[0].rfind("[1:", 0), 0u);
+
+  auto *stmt = program->getStatement(0);
+  auto *y = static_cast<BinaryExprNode *>(stmt->getExpression(4));
+  ASSERT_EQ(y->getRight()->getNodeType(), DrawASTNodeType::MemoExpr);
+  auto *memo = static_cast<MemoExprNode *>(y->getRight());
+
+  // 同一T值下第二次求值命中缓存，T变化后重新计算
+  EvalContext ctx(0.25);
+  stmt->getExpression(3)->evaluate(ctx);
+  EXPECT_EQ(y->evaluate(ctx), std::sin(0.5) * std::cos(0.5));
+  EXPECT_EQ(memo->getHitCount(ctx), 1u);
+  ctx.t = 0.5;
+  EXPECT_EQ(y->evaluate(ctx), std::sin(1.0) * std::cos(1.0));
+  EXPECT_EQ(memo->getHitCount(ctx), 1u);
+
+  // 缓存属于求值上下文，另一个上下文从头计算
+  EvalContext other(0.25);
+  EXPECT_EQ(y->evaluate(other), std::sin(0.5) * std::cos(0.5));
+  EXPECT_EQ(memo->getHitCount(other), 0u);
+}
+
+TEST_F(OptimizerTest, StateSlotsAreReusedWithoutStaleStates) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP 1 DRAW(cos(T), sin(T));");
+  auto *stmt = program->getStatement(0);
+  EvalContext ctx(0.5);
+
+  auto first = std::make_shared<MemoExprNode>(stmt->getExpressionPtr(3));
+  size_t index = first->getSlot().index();
+  first->evaluate(ctx);
+  first->evaluate(ctx);
+  EXPECT_EQ(first->getHitCount(ctx), 1u);
+  first.reset();
+
+  // 回收的下标分给新节点；上下文中旧节点的缓存不会被新节点读到
+  auto second = std::make_shared<MemoExprNode>(stmt->getExpressionPtr(4));
+  EXPECT_EQ(second->getSlot().index(), index);
+  EXPECT_EQ(second->getHitCount(ctx), 0u);
+  EXPECT_EQ(second->evaluate(ctx), std::sin(0.5));
+  EXPECT_EQ(second->getHitCount(ctx), 0u);
+}
+
+TEST_F(OptimizerTest, CseIgnoresUnsharedAndNonForDraw) {
+  auto program = parse("SCALE IS (cos(T), cos(T));\n"
+                       "FOR T FROM 0 TO 1 STEP 1 DRAW(cos(T), sin(T));");
+  auto *scaleX = program->getStatement(0)->getExpression(0);
+  CommonSubexprPass pass;
+  EXPECT_FALSE(pass.run(program.get()));
+
+  EXPECT_EQ(program->getStatement(0)->getExpression(0), scaleX);
+  EXPECT_EQ(pass.getCounter("memo-nodes"), 0u);
+  EXPECT_TRUE(pass.getRemarks().empty());
+}
+
+// =============================================================================
+// 递推求值测试
+// =============================================================================
+
+namespace {
+
+const char *kRecurrenceSource =
+    "FOR T FROM 0 TO 20 STEP 0.01 "
+    "DRAW(cos(2*T+1)*3, T**3/100 - 2*T + 1 + sin(-T/2));";
+
+OptimizerConfig recurrenceConfig() {
+  OptimizerConfig config;
+  config.recurrences = true;
+  return config;
+}
+
+} // anonymous namespace
+
+TEST_F(OptimizerTest, RecurrencesAreOptIn) {
+  auto program = parse(kRecurrenceSource);
+  Optimizer opt(OptimizerConfig(), program->getExprPool());
+  opt.optimize(program.get());
+  for (size_t i = 0; i < opt.getPassCount(); ++i) {
+    EXPECT_STRNE(opt.getPass(i)->getName(), "recurrence");
+  }
+}
+
+TEST_F(OptimizerTest, RecognizesTrigOfAffineAndPolynomials) {
+  auto program = parse(kRecurrenceSource);
+  RecurrencePass pass(recurrenceConfig());
+  EXPECT_TRUE(pass.run(program.get()));
+
+  EXPECT_EQ(pass.getCounter("trig-recurrence"), 2u);
+  EXPECT_EQ(pass.getCounter("polynomial-recurrence"), 1u);
+  ASSERT_EQ(pass.getRemarks().size(), 1u);
+
+  // cos(2*T+1)*3：只包装cos(2*T+1)，系数为{b, a}
+  auto *x = program->getStatement(0)->getExpression(3);
+  ASSERT_EQ(x->getChild(0)->getNodeType(), DrawASTNodeType::RecurrenceExpr);
+  auto *trig = static_cast<RecurrenceExprNode *>(x->getChild(0));
+  EXPECT_EQ(trig->getKind(), RecurrenceKind::Cos);
+  EXPECT_EQ(trig->getCoefficients(), (std::vector<double>{1.0, 2.0}));
+
+  // T**3/100 - 2*T + 1
+  auto *y = program->getStatement(0)->getExpression(4);
+  ASSERT_EQ(y->getChild(0)->getNodeType(), DrawASTNodeType::RecurrenceExpr);
+  auto *poly = static_cast<RecurrenceExprNode *>(y->getChild(0));
+  EXPECT_EQ(poly->getKind(), RecurrenceKind::Polynomial);
+  EXPECT_EQ(poly->getCoefficients(),
+            (std::vector<double>{1.0, -2.0, 0.0, 0.01}));
+}
+
+TEST_F(OptimizerTest, RewriteAfterStatefulPassesKeepsNodes) {
+  // 在CSE和递推之后运行改写遍：缓存、递推节点围绕改写后的内部表达式重建
+  auto program = parse("FOR T FROM 0 TO 1 STEP 0.25 "
+                       "DRAW(sin(T*1)*cos(T*1), sin(T*1) + sin(2*T*1));");
+  RecurrencePass recurrence(recurrenceConfig());
+  CommonSubexprPass cse;
+  AlgebraicSimplifyPass simplify(OptimizerConfig(), program->getExprPool());
+  EXPECT_TRUE(recurrence.run(program.get()));
+  EXPECT_TRUE(cse.run(program.get()));
+  EXPECT_TRUE(simplify.run(program.get()));
+
+  auto *stmt = program->getStatement(0);
+  auto *x = static_cast<BinaryExprNode *>(stmt->getExpression(3));
+  auto *y = static_cast<BinaryExprNode *>(stmt->getExpression(4));
+  ASSERT_NE(x, nullptr);
+  ASSERT_NE(y, nullptr);
+  ASSERT_NE(x->getLeft(), nullptr);
+  ASSERT_NE(y->getRight(), nullptr);
+  EXPECT_EQ(x->getLeft()->getNodeType(), DrawASTNodeType::MemoExpr);
+  EXPECT_EQ(y->getRight()->getNodeType(), DrawASTNodeType::RecurrenceExpr);
+  auto *trig = static_cast<RecurrenceExprNode *>(y->getRight());
+  EXPECT_EQ(trig->getKind(), RecurrenceKind::Sin);
+  EXPECT_EQ(trig->getCoefficients(), (std::vector<double>{0.0, 2.0}));
+
+  EvalContext ctx;
+  for (double t : {0.0, 0.25, 0.5}) {
+    ctx.t = t;
+    EXPECT_EQ(x->evaluate(ctx), std::sin(t) * std::cos(t));
+    EXPECT_NEAR(y->evaluate(ctx), std::sin(t) + std::sin(2 * t), 1e-12);
+  }
+}
+
+TEST_F(OptimizerTest, RecurrenceRejectsNonUniformForms) {
+  auto program = parse("FOR T FROM 0 TO 1 STEP 0.1 "
+                       "DRAW(sin(T/(T+1)), T**5 + ln(T));");
+  OptimizerConfig config = recurrenceConfig();
+  config.maxRecurrenceDegree = 4;
+  RecurrencePass pass(config);
+  EXPECT_FALSE(pass.run(program.get()));
+  EXPECT_EQ(pass.getCounter("trig-recurrence"), 0u);
+  EXPECT_EQ(pass.getCounter("polynomial-recurrence"), 0u);
+}
+
+TEST_F(OptimizerTest, RecurrenceStaysCloseToExactEvaluation) {
+  auto expected = execute(kRecurrenceSource, false);
+  OptimizerConfig config = recurrenceConfig();
+  auto actual = execute(kRecurrenceSource, &config);
+
+  // y的量级约为80
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_NEAR(std::get<0>(actual[i]), std::get<0>(expected[i]), 1e-9);
+    EXPECT_NEAR(std::get<1>(actual[i]), std::get<1>(expected[i]), 1e-8);
+  }
+
+  // 大部分采样点走递推，每recurrenceResync步同步一次
+  auto *x = program_->getStatement(0)->getExpression(3);
+  auto *trig = static_cast<RecurrenceExprNode *>(x->getChild(0));
+  ASSERT_EQ(trig->getNodeType(), DrawASTNodeType::RecurrenceExpr);
+  size_t samples = actual.size();
+  const EvalContext &ctx = analyzer_->getEvalContext();
+  EXPECT_EQ(trig->getStepCount(ctx) + trig->getSyncCount(ctx), samples);
+  EXPECT_LE(trig->getSyncCount(ctx),
+            samples / config.recurrenceResync + 2);
+}
+
+TEST_F(OptimizerTest, RecurrenceResyncsOnNewLoop) {
+  // 两个循环共享同一个sin(T)节点（hash-consing），第二个循环从新的起点开始
+  const char *source = "FOR T FROM 0 TO 1 STEP 0.125 DRAW(T, sin(3*T));\n"
+                       "FOR T FROM 5 TO 6 STEP 0.25 DRAW(T, sin(3*T));";
+  auto expected = execute(source, false);
+  OptimizerConfig config = recurrenceConfig();
+  auto actual = execute(source, &config);
+
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_NEAR(std::get<1>(actual[i]), std::get<1>(expected[i]), 1e-12);
+  }
+}
+
+TEST_F(OptimizerTest, SharedProgramEvaluatesConcurrently) {
+  // 缓存节点和递推节点的状态在求值上下文中，
+  // 多个线程各用一个上下文求值同一棵树，结果与单线程逐位相同
+  auto program = parse("FOR T FROM 0 TO 20 STEP 0.01 "
+                       "DRAW(cos(2*T+1)*3 + sin(2*T+1), "
+                       "T**3/100 - 2*T + sin(2*T+1)*cos(2*T+1));");
+  OptimizerConfig config = recurrenceConfig();
+  Optimizer(config, program->getExprPool()).optimize(program.get());
+  auto *stmt = program->getStatement(0);
+  const ExpressionNode *x = stmt->getExpression(3);
+  const ExpressionNode *y = stmt->getExpression(4);
+
+  auto sweep = [&](std::vector<double> &out) {
+    EvalContext ctx;
+    for (int i = 0; i <= 2000; ++i) {
+      ctx.t = i * 0.01;
+      out.push_back(x->evaluate(ctx));
+      out.push_back(y->evaluate(ctx));
+    }
+  };
+  std::vector<double> expected;
+  sweep(expected);
+
+  constexpr int kThreads = 4;
+  std::vector<std::vector<double>> actual(kThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back(sweep, std::ref(actual[i]));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &values : actual) {
+    ASSERT_EQ(values.size(), expected.size());
+    EXPECT_EQ(std::memcmp(values.data(), expected.data(),
+                          expected.size() * sizeof(double)),
+              0);
+  }
+}
+
+TEST_F(OptimizerTest, RecurrenceLoopsStaySerial) {
+  // 递推节点依赖上一个采样点，开启多线程时这样的循环仍串行执行
+  const char *source = "FOR T FROM 0 TO 20 STEP 0.001 "
+                       "DRAW(cos(2*T+1)*3, T**3/100 - 2*T + sin(2*T+1));";
+  OptimizerConfig config = recurrenceConfig();
+  auto expected = execute(source, &config);
+  threads_ = 4;
+  auto actual = execute(source, &config);
+  EXPECT_EQ(analyzer_->getParallelLoopCount(), 0u);
+  EXPECT_EQ(actual, expected);
+
+  // 只有缓存节点的循环分块并行，结果与串行执行相同
+  actual = execute(source, true);
+  EXPECT_EQ(analyzer_->getParallelLoopCount(), 1u);
+  threads_ = 1;
+  expected = execute(source, true);
+  EXPECT_EQ(actual, expected);
+}
+
+namespace {
+
+// 嵌套的exp、ln、三角函数调用
+const char *kChebyshevSource =
+    "SCALE IS (20, 20);\n"
+    "FOR T FROM 0 TO 10 STEP 0.001 "
+    "DRAW(exp(sin(T))*cos(T/3), ln(2 + cos(T)*sin(2*T)));";
+
+OptimizerConfig chebyshevConfig() {
+  OptimizerConfig config;
+  config.chebyshev = true;
+  return config;
+}
+
+} // anonymous namespace
+
+TEST_F(OptimizerTest, ChebyshevIsOptIn) {
+  auto program = parse(kChebyshevSource);
+  Optimizer opt(OptimizerConfig(), program->getExprPool());
+  opt.optimize(program.get());
+  for (size_t i = 0; i < opt.getPassCount(); ++i) {
+    EXPECT_STRNE(opt.getPass(i)->getName(), "chebyshev");
+  }
+}
+
+TEST_F(OptimizerTest, ChebyshevStaysWithinPixelTolerance) {
+  auto expected = execute(kChebyshevSource, false);
+  OptimizerConfig config = chebyshevConfig();
+  auto actual = execute(kChebyshevSource, &config);
+
+  for (size_t i = 3; i <= 4; ++i) {
+    auto *expr = program_->getStatement(1)->getExpression(i);
+    ASSERT_EQ(expr->getNodeType(), DrawASTNodeType::ChebyshevExpr);
+    auto *cheb = static_cast<ChebyshevExprNode *>(expr);
+    EXPECT_EQ(cheb->getBounds().front(), 0.0);
+    EXPECT_EQ(cheb->getBounds().back(), 10.0);
+    EXPECT_EQ(cheb->getBounds().size(), cheb->getSegments().size() + 1);
+  }
+
+  // 设备坐标的误差不超过chebyshevTolerance个像素
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    double dx = std::get<0>(actual[i]) - std::get<0>(expected[i]);
+    double dy = std::get<1>(actual[i]) - std::get<1>(expected[i]);
+    EXPECT_LE(std::hypot(dx, dy), config.chebyshevTolerance);
+  }
+}
+
+TEST_F(OptimizerTest, ChebyshevFallsBackNearSingularity) {
+  // ln(T)在T = 0处为-inf，靠近0的段无法拟合
+  const char *source = "FOR T FROM 0 TO 4 STEP 0.001 "
+                       "DRAW(T, ln(T)*cos(T) + sin(T));";
+  auto expected = execute(source, false);
+  OptimizerConfig config = chebyshevConfig();
+  ChebyshevPass pass(config);
+  auto program = parse(source);
+  EXPECT_TRUE(pass.run(program.get()));
+  EXPECT_EQ(pass.getCounter("approximated-exprs"), 1u);
+  EXPECT_GT(pass.getCounter("chebyshev-segments"), 0u);
+  EXPECT_GT(pass.getCounter("exact-segments"), 0u);
+  ASSERT_EQ(pass.getRemarks().size(), 1u);
+
+  auto *y = static_cast<ChebyshevExprNode *>(
+      program->getStatement(0)->getExpression(4));
+  ASSERT_EQ(y->getNodeType(), DrawASTNodeType::ChebyshevExpr);
+  EXPECT_TRUE(y->getSegments().front().empty());
+  EXPECT_LE(y->getSegments().size(),
+            static_cast<size_t>(config.maxChebyshevSegments));
+
+  // 精确求值的段与原表达式逐位相同
+  auto actual = execute(source, &config);
+  ASSERT_EQ(actual.size(), expected.size());
+  EXPECT_EQ(std::get<1>(actual[0]), std::get<1>(expected[0]));
+  for (size_t i = 1; i < actual.size(); ++i) {
+    EXPECT_NEAR(std::get<1>(actual[i]), std::get<1>(expected[i]),
+                config.chebyshevTolerance);
+  }
+}
+
+TEST_F(OptimizerTest, ChebyshevChecksEverySample) {
+  // T = 5.003附近很窄的尖峰，只落在一个采样点上：检查点之外的特征也要满足容差
+  auto program = parse("SCALE IS (20, 20);\n"
+                       "FOR T FROM 0 TO 10 STEP 0.001 "
+                       "DRAW(T, exp(-((T-5.003)*10000)**2)*cos(T) + sin(T));");
+  OptimizerConfig config = chebyshevConfig();
+  ChebyshevPass pass(config);
+  EXPECT_TRUE(pass.run(program.get()));
+
+  auto *y = program->getStatement(1)->getExpression(4);
+  ASSERT_EQ(y->getNodeType(), DrawASTNodeType::ChebyshevExpr);
+  auto *inner = static_cast<ChebyshevExprNode *>(y)->getInner();
+  EvalContext ctx, exact;
+  double tolerance = config.chebyshevTolerance / 20 / 2;
+  for (double t = 0; t <= 10; t += 0.001) {
+    ctx.t = exact.t = t;
+    EXPECT_LE(std::fabs(y->evaluate(ctx) - inner->evaluate(exact)), tolerance)
+        << "T=" << t;
+  }
+}
+
+TEST_F(OptimizerTest, ChebyshevSkipsCheapOrUnknownRanges) {
+  // 单个函数调用不值得逼近；SCALE或循环范围含T时不知道容差或范围
+  auto program = parse("FOR T FROM 0 TO 10 STEP 0.01 DRAW(T, sin(T));\n"
+                       "SCALE IS (T, 1);\n"
+                       "FOR T FROM 0 TO 10 STEP 0.01 "
+                       "DRAW(exp(sin(T)), exp(cos(T)));");
+  ChebyshevPass pass(chebyshevConfig());
+  EXPECT_FALSE(pass.run(program.get()));
+  EXPECT_EQ(pass.getCounter("approximated-exprs"), 0u);
+}
+
+// =============================================================================
+// 无用语句删除测试
+// =============================================================================
+
+TEST_F(OptimizerTest, RemovesOverwrittenAndTrailingSettings) {
+  auto program = parse("COLOR IS (210, 105, 30);\n"
+                       "COLOR IS (128, 0, 128);\n"
+                       "ORIGIN IS (1, 2); SCALE IS (2, 2); ORIGIN IS (3, 4);\n"
+                       "FOR T FROM 0 TO 1 STEP 1 DRAW(T, T);\n"
+                       "ROT IS 1; SIZE IS 3;");
+  DeadStatementPass pass;
+  EXPECT_TRUE(pass.run(program.get()));
+  EXPECT_EQ(pass.getCounter("overwritten"), 2u);
+  EXPECT_EQ(pass.getCounter("trailing"), 2u);
+
+  ASSERT_EQ(program->getChildCount(), 4u);
+  EXPECT_EQ(program->getStatement(0)->getNodeType(),
+            DrawASTNodeType::ColorStmt);
+  EXPECT_EQ(program->getStatement(0)->getExpression(0)->value(), 128.0);
+  EXPECT_EQ(program->getStatement(1)->getNodeType(),
+            DrawASTNodeType::ScaleStmt);
+  EXPECT_EQ(program->getStatement(2)->getExpression(0)->value(), 3.0);
+  EXPECT_EQ(program->getStatement(3)->getNodeType(),
+            DrawASTNodeType::ForDrawStmt);
+
+  // 说明按源码顺序给出位置
+  const auto &remarks = pass.getRemarks();
+  ASSERT_EQ(remarks.size(), 4u);
+  EXPECT_NE(remarks[0].find("[1:"), std::string::npos);
+  EXPECT_NE(remarks[0].find("COLOR is overwritten"), std::string::npos);
+  EXPECT_NE(remarks[1].find("[3:"), std::string::npos);
+  EXPECT_NE(remarks[1].find("ORIGIN"), std::string::npos);
+  EXPECT_NE(remarks[3].find("SIZE has no FOR-DRAW after it"),
+            std::string::npos);
+}
+
+TEST_F(OptimizerTest, KeepsSettingsThatMayNotTakeEffect) {
+  // SIZE小于1时被忽略，不能删除它之前的SIZE
+  auto program = parse("SIZE IS 4; SIZE IS 0.5;\n"
+                       "FOR T FROM 0 TO 1 STEP 1 DRAW(T, T);");
+  DeadStatementPass pass;
+  EXPECT_FALSE(pass.run(program.get()));
+  EXPECT_EQ(program->getChildCount(), 3u);
+}
+
+TEST_F(OptimizerTest, DeadStatementRemovalDrawsSamePixels) {
+  const char *source = "COLOR IS RED; SIZE IS 2; COLOR IS (0, 0, 255);\n"
+                       "ROT IS PI; ROT IS 0; ORIGIN IS (10, 10);\n"
+                       "FOR T FROM 0 TO 5 STEP 0.5 DRAW(T, T*T);\n"
+                       "SIZE IS 3; ORIGIN IS (20, 0); SIZE IS 1;\n"
+                       "FOR T FROM 0 TO 5 STEP 0.5 DRAW(T, -T);\n"
+                       "COLOR IS GREEN;";
+  auto expected = execute(source, false);
+  OptimizerConfig config;
+  config.deadStatements = true;
+  auto actual = execute(source, &config);
+  EXPECT_EQ(program_->getChildCount(), 8u);
+  EXPECT_EQ(actual, expected);
+}
+
+// =============================================================================
+// 优化遍管理器测试
+// =============================================================================
+
+TEST_F(OptimizerTest, OptLevelPresets) {
+  auto names = [](const OptimizerConfig &config) {
+    Optimizer opt(config);
+    std::vector<std::string> result;
+    for (size_t i = 0; i < opt.getPassCount(); ++i) {
+      result.push_back(opt.getPass(i)->getName());
+    }
+    return result;
+  };
+
+  EXPECT_TRUE(names(OptimizerConfig::forLevel(0)).empty());
+  EXPECT_EQ(names(OptimizerConfig::forLevel(1)), names(OptimizerConfig()));
+  EXPECT_EQ(names(OptimizerConfig::forLevel(1)),
+            (std::vector<std::string>{"constant-folding",
+                                      "algebraic-simplify",
+                                      "common-subexpr"}));
+  EXPECT_EQ(names(OptimizerConfig::forLevel(2)),
+            (std::vector<std::string>{"dead-statement", "constant-folding",
+                                      "algebraic-simplify", "chebyshev",
+                                      "recurrence", "common-subexpr"}));
+  EXPECT_EQ(names(OptimizerConfig::forLevel(3)),
+            names(OptimizerConfig::forLevel(2)));
+}
+
+TEST_F(OptimizerTest, FingerprintDistinguishesResults) {
+  EXPECT_EQ(OptimizerConfig().fingerprint(),
+            OptimizerConfig::forLevel(1).fingerprint());
+  EXPECT_NE(OptimizerConfig::forLevel(1).fingerprint(),
+            OptimizerConfig::forLevel(2).fingerprint());
+
+  // 只改变舍入的选项也会改变结果
+  OptimizerConfig config;
+  config.reciprocalDivision = true;
+  EXPECT_NE(config.fingerprint(), OptimizerConfig().fingerprint());
+  config = OptimizerConfig();
+  config.chebyshevTolerance /= 2;
+  EXPECT_NE(config.fingerprint(), OptimizerConfig().fingerprint());
+
+  // 调试输出不影响结果
+  config = OptimizerConfig();
+  config.dumpAfterEachPass = true;
+  EXPECT_EQ(config.fingerprint(), OptimizerConfig().fingerprint());
+}
+
+TEST_F(OptimizerTest, PassStatsCountNodes) {
+  // ROT IS PI/2 + 0：5个表达式节点加语句和程序节点
+  auto program = parse("ROT IS PI/2 + 0;");
+  EXPECT_EQ(Optimizer::countNodes(program.get()), 7u);
+
+  Optimizer opt(OptimizerConfig(), program->getExprPool());
+  opt.optimize(program.get());
+  const auto &stats = opt.getStats();
+  ASSERT_EQ(stats.size(), opt.getPassCount());
+  EXPECT_EQ(stats[0].name, "constant-folding");
+  EXPECT_EQ(stats[0].nodesBefore, 7u);
+  EXPECT_EQ(stats[0].nodesAfter, 3u);
+  EXPECT_EQ(stats[0].changedRuns, 1u);
+  EXPECT_GE(stats[0].seconds, 0.0);
+  EXPECT_EQ(stats[1].nodesBefore, 3u);
+  EXPECT_EQ(stats[1].changedRuns, 0u);
+
+  // 逐条优化时累加各语句的节点数（折叠后每次为2个）
+  Optimizer perStmt(OptimizerConfig(), program->getExprPool());
+  perStmt.optimizeStatement(program->getStatement(0));
+  perStmt.optimizeStatement(program->getStatement(0));
+  EXPECT_EQ(perStmt.getStats()[0].nodesBefore, 4u);
+}
+
+TEST_F(OptimizerTest, DumpsTreeAfterEachPass) {
+  auto program = parse("ROT IS PI/2;");
+  OptimizerConfig config;
+  config.dumpAfterEachPass = true;
+  Optimizer opt(config, program->getExprPool());
+
+  testing::internal::CaptureStdout();
+  opt.optimize(program.get());
+  std::string output = testing::internal::GetCapturedStdout();
+  EXPECT_NE(output.find("*** after constant-folding ***"), std::string::npos);
+  EXPECT_NE(output.find("*** after common-subexpr ***"), std::string::npos);
+  EXPECT_NE(output.find("PROGRAM"), std::string::npos);
+}
+
+// =============================================================================
+// 执行结果一致性测试
+// =============================================================================
+
+TEST_F(OptimizerTest, OptimizedProgramDrawsSamePixels) {
+  auto expected = execute(kDrawSource, false);
+  auto actual = execute(kDrawSource, true);
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(actual, expected);
+}
+
+TEST_F(OptimizerTest, BytecodeMatchesOptimizedTreeWalker) {
+  // 缓存、递推和切比雪夫逼近节点在字节码中分别展开或按节点求值
+  const std::string source = std::string(kDrawSource) + kChebyshevSource +
+                             "\nFOR T FROM 0 TO 5 STEP 0.01 "
+                             "DRAW(sin(3*T)*T**2, cos(3*T)*T**2);";
+  for (int level = 1; level <= 2; ++level) {
+    OptimizerConfig config = OptimizerConfig::forLevel(level);
+    config.recurrences = true;
+    bytecode_ = false;
+    auto expected = execute(source, &config);
+    bytecode_ = true;
+    auto actual = execute(source, &config);
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(actual, expected);
+
+    // 含递推、逼近节点的循环不生成本地代码，其余循环生成
+    jit_ = true;
+    actual = execute(source, &config);
+    jit_ = false;
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST_F(OptimizerTest, OptimizeStatementMatchesWholeProgram) {
+  auto expected = execute(kDrawSource, false);
+
+  // 流式执行时逐条优化
+  resetAnalyzer();
+  auto lexer = createLexerFromString(kDrawSource, DFAType::HardCoded);
+  parser_ = std::make_unique<DrawLangParser>(lexer.release());
+  analyzer_->setParser(parser_.get());
+  std::unique_ptr<Optimizer> opt;
+  parser_->setStatementCallback([&](StatementNode *stmt) {
+    if (!opt) {
+      opt = std::make_unique<Optimizer>(OptimizerConfig(),
+                                        parser_->getExprPool());
+    }
+    opt->optimizeStatement(stmt);
+    analyzer_->runStatement(stmt);
+  });
+  parser_->parse();
+
+  EXPECT_EQ(pixels_, expected);
+}
+
+// =============================================================================
+// 主函数
+// =============================================================================
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -252,7 +252,8 @@ TEST_F(ParserTest, ParseConstantExpression) {
   ASSERT_NE(stmt, nullptr);
 
   // 验证 PI 的值正确
-  double value = stmt->getAngle();
+  EvalContext ctx;
+  double value = stmt->getAngle(ctx);
   EXPECT_NEAR(value, 3.1415926535897932, 1e-10);
 }
 
@@ -354,9 +355,10 @@ TEST_F(ParserTest, ForStatementExpressionValues) {
   ASSERT_NE(stmt, nullptr);
 
   // 验证起始值、结束值、步长
-  EXPECT_DOUBLE_EQ(stmt->getStart(), 0.0);
-  EXPECT_DOUBLE_EQ(stmt->getEnd(), 10.0);
-  EXPECT_DOUBLE_EQ(stmt->getStep(), 1.0);
+  EvalContext ctx;
+  EXPECT_DOUBLE_EQ(stmt->getStart(ctx), 0.0);
+  EXPECT_DOUBLE_EQ(stmt->getEnd(ctx), 10.0);
+  EXPECT_DOUBLE_EQ(stmt->getStep(ctx), 1.0);
 }
 
 TEST_F(ParserTest, ForStatementWithPIExpressions) {
@@ -371,16 +373,17 @@ TEST_F(ParserTest, ForStatementWithPIExpressions) {
   ASSERT_NE(stmt, nullptr);
 
   // 验证起始值
-  EXPECT_DOUBLE_EQ(stmt->getStart(), 0.0);
+  EvalContext ctx;
+  EXPECT_DOUBLE_EQ(stmt->getStart(ctx), 0.0);
 
   // 验证结束值 (2*PI)
   double expectedEnd = 2 * 3.1415926535897932;
-  EXPECT_NEAR(stmt->getEnd(), expectedEnd, 1e-10);
+  EXPECT_NEAR(stmt->getEnd(ctx), expectedEnd, 1e-10);
 
   // 验证步长 (PI/50)
   double expectedStep = 3.1415926535897932 / 50.0;
-  EXPECT_NEAR(stmt->getStep(), expectedStep, 1e-10);
-  EXPECT_GT(stmt->getStep(), 0.0); // 确保步长不为零
+  EXPECT_NEAR(stmt->getStep(ctx), expectedStep, 1e-10);
+  EXPECT_GT(stmt->getStep(ctx), 0.0); // 确保步长不为零
 }
 
 TEST_F(ParserTest, ForStatementDrawExpressions) {
@@ -416,6 +419,125 @@ TEST_F(ParserTest, ForStatementWithTrigFunctions) {
   EXPECT_EQ(stmt->getYExpr()->getNodeType(), DrawASTNodeType::FuncCallExpr);
 }
 
+// =============================================================================
+// 表达式hash-consing测试
+// =============================================================================
+
+TEST_F(ParserTest, HashConsSharesIdenticalSubtrees) {
+  auto parser = createParser(
+      "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));\n"
+      "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));");
+  auto ast = parser->parse();
+
+  ASSERT_NE(ast, nullptr);
+  ASSERT_EQ(ast->getChildCount(), 2u);
+  auto *first = dynamic_cast<ForDrawStmtNode *>(ast->getChild(0));
+  auto *second = dynamic_cast<ForDrawStmtNode *>(ast->getChild(1));
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+
+  // 两条语句中结构相同的表达式是同一个节点
+  EXPECT_EQ(first->getEndExpr(), second->getEndExpr());
+  EXPECT_EQ(first->getStepExpr(), second->getStepExpr());
+  EXPECT_EQ(first->getYExpr(), second->getYExpr());
+  // 同一语句中的T也被共享
+  EXPECT_EQ(first->getXExpr(), first->getYExpr()->getChild(0));
+
+  // PI/50同时出现在end和step中
+  EXPECT_EQ(first->getEndExpr()->getChild(1), first->getStepExpr());
+
+  ASSERT_NE(ast->getExprPool(), nullptr);
+  EXPECT_GT(ast->getExprPool()->getHitCount(), 0u);
+}
+
+TEST_F(ParserTest, HashConsKeepsDistinctSubtreesApart) {
+  auto parser = createParser("ORIGIN IS (T+1, T+2);\n"
+                             "SCALE IS (sin(T), cos(T));\n"
+                             "ROT IS 2-1;\n"
+                             "SIZE IS 1-2;");
+  auto ast = parser->parse();
+
+  ASSERT_NE(ast, nullptr);
+  auto *origin = dynamic_cast<OriginStmtNode *>(ast->getChild(0));
+  auto *scale = dynamic_cast<ScaleStmtNode *>(ast->getChild(1));
+  auto *rot = dynamic_cast<RotStmtNode *>(ast->getChild(2));
+  auto *size = dynamic_cast<SizeStmtNode *>(ast->getChild(3));
+  ASSERT_NE(origin, nullptr);
+  ASSERT_NE(scale, nullptr);
+  ASSERT_NE(rot, nullptr);
+  ASSERT_NE(size, nullptr);
+
+  EXPECT_NE(origin->getXExpr(), origin->getYExpr());
+  EXPECT_NE(scale->getExpression(0), scale->getExpression(1));
+  // 操作数顺序不同的表达式不能合并
+  EXPECT_NE(rot->getExpression(0), size->getExpression(0));
+  EvalContext ctx;
+  EXPECT_DOUBLE_EQ(rot->getAngle(ctx), 1.0);
+  EXPECT_DOUBLE_EQ(size->getSize(ctx), -1.0);
+}
+
+TEST_F(ParserTest, HashConsNodeIdsAreStable) {
+  const std::string source = "ORIGIN IS (cos(T)*2, sin(T)*2);\n"
+                             "FOR T FROM 0 TO 1 STEP 0.5 DRAW(cos(T), T**2);";
+  auto parserA = createParser(source);
+  auto parserB = createParser(source);
+  auto astA = parserA->parse();
+  auto astB = parserB->parse();
+
+  ASSERT_NE(astA->getExprPool(), nullptr);
+  ASSERT_NE(astB->getExprPool(), nullptr);
+  ASSERT_EQ(astA->getExprPool()->size(), astB->getExprPool()->size());
+
+  auto *forA = dynamic_cast<ForDrawStmtNode *>(astA->getChild(1));
+  auto *forB = dynamic_cast<ForDrawStmtNode *>(astB->getChild(1));
+  ASSERT_NE(forA, nullptr);
+  ASSERT_NE(forB, nullptr);
+  EXPECT_NE(forA->getXExpr()->getNodeId(), 0u);
+  EXPECT_EQ(forA->getXExpr()->getNodeId(), forB->getXExpr()->getNodeId());
+  EXPECT_EQ(forA->getYExpr()->getNodeId(), forB->getYExpr()->getNodeId());
+
+  // 通过id可以找回节点
+  auto *pool = astA->getExprPool();
+  EXPECT_EQ(pool->getNode(forA->getXExpr()->getNodeId()), forA->getXExpr());
+  EXPECT_EQ(pool->getNode(0), nullptr);
+}
+
+TEST_F(ParserTest, HashConsCanBeDisabled) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 1 DRAW(sin(T), sin(T));");
+  DrawParserConfig config;
+  config.hashConsExpressions = false;
+  parser->setConfig(config);
+  auto ast = parser->parse();
+
+  ASSERT_NE(ast, nullptr);
+  EXPECT_EQ(ast->getExprPool(), nullptr);
+  auto *stmt = dynamic_cast<ForDrawStmtNode *>(ast->getChild(0));
+  ASSERT_NE(stmt, nullptr);
+  EXPECT_NE(stmt->getXExpr(), stmt->getYExpr());
+  EXPECT_EQ(stmt->getXExpr()->getNodeId(), 0u);
+}
+
+TEST_F(ParserTest, TDependenceAnalysis) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 1 "
+                             "DRAW(sin(PI/7)*2 + T, -cos(2));");
+  auto ast = parser->parse();
+
+  ASSERT_NE(ast, nullptr);
+  auto *stmt = dynamic_cast<ForDrawStmtNode *>(ast->getChild(0));
+  ASSERT_NE(stmt, nullptr);
+  auto *x = stmt->getXExpr();
+  auto *invariant = static_cast<ExpressionNode *>(x->getChild(0));
+  auto *param = static_cast<ExpressionNode *>(x->getChild(1));
+
+  EXPECT_TRUE(x->dependsOnT());
+  EXPECT_FALSE(invariant->dependsOnT());
+  EXPECT_FALSE(static_cast<ExpressionNode *>(invariant->getChild(0))
+                   ->dependsOnT());
+  EXPECT_TRUE(param->dependsOnT());
+  EXPECT_FALSE(stmt->getYExpr()->dependsOnT());
+  EXPECT_FALSE(stmt->getStepExpr()->dependsOnT());
+}
+
 // =============================================================================
 // 错误处理测试
 // =============================================================================
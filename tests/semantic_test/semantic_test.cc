@@ -4,11 +4,17 @@
  */
 
 #include "DrawLangAST.hpp"
+#include "DrawLangBytecode.hpp"
+#include "DrawLangInterval.hpp"
+#include "DrawLangJit.hpp"
 #include "DrawLangParser.hpp"
 #include "DrawLangSemantic.hpp"
 #include "SimpleLexer.hpp"
 #include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <unistd.h>
 #include <vector>
 
 using namespace interpreter_exp;
@@ -58,6 +64,30 @@ protected:
       analyzer_->run(ast.get());
     }
   }
+
+  // 用新的语义分析器和指定配置执行源代码
+  void analyzeWithConfig(const std::string &source,
+                         const SemanticConfig &config) {
+    SetUp();
+    analyzer_->setConfig(config);
+    parseAndAnalyze(source);
+  }
+
+  // 逐点比较坐标和像素属性
+  static void expectSamePixels(
+      const std::vector<std::tuple<double, double, PixelAttribute>> &actual,
+      const std::vector<std::tuple<double, double, PixelAttribute>>
+          &expected) {
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      const auto &a = std::get<2>(actual[i]);
+      const auto &e = std::get<2>(expected[i]);
+      EXPECT_EQ(std::get<0>(actual[i]), std::get<0>(expected[i]));
+      EXPECT_EQ(std::get<1>(actual[i]), std::get<1>(expected[i]));
+      EXPECT_EQ(std::tie(a.r, a.g, a.b, a.size),
+                std::tie(e.r, e.g, e.b, e.size));
+    }
+  }
 };
 
 // =============================================================================
@@ -113,6 +143,22 @@ TEST_F(SemanticTest, CombinedTransformations) {
   EXPECT_DOUBLE_EQ(std::get<1>(drawnPixels_[0]), 110.0);
 }
 
+TEST_F(SemanticTest, LoopInvariantCoordinate) {
+  // x不依赖T，在循环入口求值一次；旋转的cos/sin同样只计算一次
+  parseAndAnalyze("ROT IS PI/6;\n"
+                  "FOR T FROM 0 TO 2 STEP 1 DRAW(sin(PI/7)*2, T);");
+
+  ASSERT_EQ(drawnPixels_.size(), 3u);
+  double x = std::sin(M_PI / 7) * 2;
+  double c = std::cos(M_PI / 6);
+  double s = std::sin(M_PI / 6);
+  for (size_t i = 0; i < drawnPixels_.size(); ++i) {
+    double t = static_cast<double>(i);
+    EXPECT_DOUBLE_EQ(std::get<0>(drawnPixels_[i]), x * c + t * s);
+    EXPECT_DOUBLE_EQ(std::get<1>(drawnPixels_[i]), t * c - x * s);
+  }
+}
+
 // =============================================================================
 // FOR 循环测试
 // =============================================================================
@@ -368,6 +414,991 @@ TEST_F(SemanticTest, OnlySettings) {
   EXPECT_EQ(drawnPixels_.size(), 0u);
 }
 
+// =============================================================================
+// 流式执行测试
+// =============================================================================
+
+TEST_F(SemanticTest, StreamingMatchesBatchExecution) {
+  const std::string source = "ORIGIN IS (100, 100);\n"
+                             "SCALE IS (50, 50);\n"
+                             "COLOR IS (0, 128, 255);\n"
+                             "FOR T FROM 0 TO 2*PI STEP PI/8 DRAW(cos(T), "
+                             "sin(T));\n"
+                             "ROT IS PI/4;\n"
+                             "SIZE IS 3;\n"
+                             "FOR T FROM 0 TO 1 STEP 0.1 DRAW(T, T**2);\n";
+
+  parseAndAnalyze(source);
+  auto expected = drawnPixels_;
+  drawnPixels_.clear();
+
+  analyzer_ = std::make_unique<DrawLangSemanticAnalyzer>();
+  analyzer_->setDrawCallback(
+      [this](double x, double y, const PixelAttribute &attr) {
+        drawnPixels_.emplace_back(x, y, attr);
+      });
+  auto parser = createParser(source);
+  analyzer_->setParser(parser.get());
+  parser->setStatementCallback(
+      [this](StatementNode *stmt) { analyzer_->runStatement(stmt); });
+  parser->parse();
+
+  ASSERT_EQ(drawnPixels_.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(std::get<0>(drawnPixels_[i]), std::get<0>(expected[i]));
+    EXPECT_EQ(std::get<1>(drawnPixels_[i]), std::get<1>(expected[i]));
+    EXPECT_EQ(std::get<2>(drawnPixels_[i]).b, std::get<2>(expected[i]).b);
+    EXPECT_EQ(std::get<2>(drawnPixels_[i]).size,
+              std::get<2>(expected[i]).size);
+  }
+}
+
+TEST_F(SemanticTest, StreamingExecutesBeforeParsingFinishes) {
+  auto parser = createParser("FOR T FROM 0 TO 2 STEP 1 DRAW(T, 0);\n"
+                             "FOR T FROM 0 TO 1 STEP 1 DRAW(T, 1);\n"
+                             "FOR T FROM 0 TO 3 STEP 1 DRAW(T, 2)");
+  analyzer_->setParser(parser.get());
+
+  // 每次回调时记录已绘制的点数
+  std::vector<size_t> pixelsBefore;
+  parser->setStatementCallback([&](StatementNode *stmt) {
+    pixelsBefore.push_back(drawnPixels_.size());
+    analyzer_->runStatement(stmt);
+  });
+  auto ast = parser->parse();
+
+  // 缺少分号的最后一条语句被丢弃，不会执行
+  ASSERT_EQ(pixelsBefore.size(), 2u);
+  EXPECT_EQ(pixelsBefore[0], 0u);
+  EXPECT_EQ(pixelsBefore[1], 3u);
+  EXPECT_EQ(drawnPixels_.size(), 5u);
+  EXPECT_EQ(ast->getChildCount(), 2u);
+}
+
+// =============================================================================
+// 循环融合测试
+// =============================================================================
+
+TEST_F(SemanticTest, FusedLoopsDrawSamePixels) {
+  // 三条范围相同的曲线，中间改变原点、颜色、大小和旋转，且曲线之间有重叠的点
+  const std::string source =
+      "SCALE IS (20, 20);\n"
+      "ORIGIN IS (20, 120);\n"
+      "COLOR IS RED;\n"
+      "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));\n"
+      "ORIGIN IS (20, 160);\n"
+      "COLOR IS BLUE;\n"
+      "SIZE IS 3;\n"
+      "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, sin(T));\n"
+      "ROT IS PI/6;\n"
+      "FOR T FROM 0 TO 2*PI+PI/50 STEP PI/50 DRAW(T, 2 - sin(T));\n"
+      "ORIGIN IS (T, T);\n"
+      "FOR T FROM 0 TO 1 STEP 0.5 DRAW(T, T);\n";
+
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  double expectedOriginX = analyzer_->getOriginX();
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 0u);
+
+  config.fuseLoops = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 3u);
+  expectSamePixels(drawnPixels_, expected);
+  // 循环结束后T的值也相同，ORIGIN IS (T, T)依赖它
+  EXPECT_EQ(analyzer_->getOriginX(), expectedOriginX);
+}
+
+TEST_F(SemanticTest, LoopsWithDifferentRangesAreNotFused) {
+  const std::string source = "FOR T FROM 0 TO 1 STEP 0.25 DRAW(T, 0);\n"
+                             "FOR T FROM 0 TO 1 STEP 0.5 DRAW(T, 1);\n"
+                             "FOR T FROM 0 TO 1 STEP 0.5 DRAW(T, 2);\n"
+                             "ORIGIN IS (T, 0);\n"
+                             "FOR T FROM 0 TO 1 STEP 0.5 DRAW(T, 3);\n"
+                             "FOR T FROM T TO 9 STEP 0.5 DRAW(T, 4);\n";
+
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+
+  config.fuseLoops = true;
+  analyzeWithConfig(source, config);
+  // 只有第2、3个循环可以融合：ORIGIN依赖T，最后一个循环的范围依赖T
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 2u);
+  expectSamePixels(drawnPixels_, expected);
+}
+
+TEST_F(SemanticTest, FusedLoopsShareBytecodeAndCulling) {
+  // 第二条曲线的后半段在画布之外，第三条与第一条共享sin(T)
+  const std::string source =
+      "SCALE IS (20, 20);\n"
+      "ORIGIN IS (20, 60);\n"
+      "FOR T FROM 0 TO 20 STEP 0.01 DRAW(T, sin(T));\n"
+      "COLOR IS BLUE;\n"
+      "FOR T FROM 0 TO 20 STEP 0.01 DRAW(T*T, cos(T));\n"
+      "SIZE IS 3;\n"
+      "FOR T FROM 0 TO 20 STEP 0.01 DRAW(T, sin(T)*2);\n";
+
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.canvasWidth = 200;
+  config.canvasHeight = 120;
+  config.fuseLoops = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  size_t expectedCulled = analyzer_->getCulledSampleCount();
+  EXPECT_GT(expectedCulled, 0u);
+
+  for (bool bytecode : {false, true}) {
+    SCOPED_TRACE(bytecode);
+    config.fuseLoops = true;
+    config.bytecode = bytecode;
+    analyzeWithConfig(source, config);
+    EXPECT_EQ(analyzer_->getFusedLoopCount(), 3u);
+    EXPECT_EQ(analyzer_->getCulledSampleCount(), expectedCulled);
+    expectSamePixels(drawnPixels_, expected);
+  }
+}
+
+TEST_F(SemanticTest, LoopsAreNotFusedAcrossPerLoopModes) {
+  const std::string source = "FOR T FROM 0 TO 1 STEP 0.25 DRAW(T, 0);\n"
+                             "FOR T FROM 0 TO 1 STEP 0.25 DRAW(T, 1);\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.jit = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 0u);
+
+  config.jit = false;
+  config.precision = Precision::Float;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 0u);
+
+  // 第一条曲线以外缓存的点数有上限：每条约10万个点，超过上限时不融合
+  const std::string large =
+      "FOR T FROM 0 TO 1 STEP 0.00001 DRAW(T, 0);\n"
+      "FOR T FROM 0 TO 1 STEP 0.00001 DRAW(T, 1);\n"
+      "FOR T FROM 0 TO 1 STEP 0.00001 DRAW(T, 2);\n";
+  config.precision = Precision::Double;
+  analyzeWithConfig(large, config);
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 0u);
+}
+
+// =============================================================================
+// 区间求值与画布剔除测试
+// =============================================================================
+
+TEST_F(SemanticTest, IntervalBoundsContainSampledValues) {
+  const char *exprs[] = {"sin(T)",        "cos(3*T+1)*2 - T", "T**2 - T",
+                         "T**3",          "exp(T/4)",        "abs(T-1)",
+                         "sqrt(T+10)",    "1/(T+5)",         "atan(T)*T",
+                         "ln(T+6)",       "2**T",            "tan(T/8)",
+                         "floor(T)/2"};
+  const double ranges[][2] = {{-3, -2}, {-1, 0.5}, {0, 3.2}, {1.4, 1.6}};
+  for (const char *text : exprs) {
+    SCOPED_TRACE(text);
+    auto parser = createParser(std::string("ROT IS ") + text + ";");
+    EvalContext ctx;
+    auto ast = parser->parse();
+    ASSERT_NE(ast, nullptr);
+    auto *expr = ast->getStatement(0)->getExpression(0);
+    for (const auto &range : ranges) {
+      Interval bound = evalInterval(expr, Interval(range[0], range[1]));
+      for (int i = 0; i <= 100; ++i) {
+        ctx.t = range[0] + (range[1] - range[0]) * i / 100;
+        double v = expr->evaluate(ctx);
+        EXPECT_LE(bound.lo, v) << "T=" << ctx.t;
+        EXPECT_GE(bound.hi, v) << "T=" << ctx.t;
+      }
+    }
+  }
+}
+
+TEST_F(SemanticTest, IntervalUnboundedCases) {
+  auto parser = createParser("ROT IS 1/T;\nROT IS ln(T);\nROT IS T**0.5;");
+  auto ast = parser->parse();
+  ASSERT_NE(ast, nullptr);
+  Interval t(-1.0, 1.0);
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_FALSE(
+        evalInterval(ast->getStatement(i)->getExpression(0), t).isBounded());
+  }
+  // 除数恒为0时结果为0
+  auto zero = createParser("ROT IS T/0;")->parse();
+  Interval r = evalInterval(zero->getStatement(0)->getExpression(0), t);
+  EXPECT_EQ(r.lo, 0.0);
+  EXPECT_EQ(r.hi, 0.0);
+}
+
+TEST_F(SemanticTest, OffCanvasSamplesAreCulled) {
+  // 放大后曲线的大部分落在200x200的画布之外
+  const std::string source = "ORIGIN IS (-50, 100);\n"
+                             "SCALE IS (100, 100);\n"
+                             "FOR T FROM 0 TO 20 STEP 0.001 "
+                             "DRAW(T, sin(T)*sin(T*3));\n";
+
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  EXPECT_EQ(analyzer_->getCulledSampleCount(), 0u);
+
+  config.canvasWidth = 200;
+  config.canvasHeight = 200;
+  analyzeWithConfig(source, config);
+  size_t culled = analyzer_->getCulledSampleCount();
+  EXPECT_GT(culled, expected.size() / 2);
+  EXPECT_EQ(drawnPixels_.size() + culled, expected.size());
+
+  // 绘制的点是原来的点按顺序去掉一部分，画布附近的点都被保留
+  size_t j = 0;
+  for (const auto &pixel : expected) {
+    double x = std::get<0>(pixel);
+    double y = std::get<1>(pixel);
+    if (j < drawnPixels_.size() && std::get<0>(drawnPixels_[j]) == x &&
+        std::get<1>(drawnPixels_[j]) == y) {
+      ++j;
+    } else {
+      EXPECT_TRUE(x < -1 || x > 201 || y < -1 || y > 201)
+          << "visible point (" << x << ", " << y << ") was culled";
+    }
+  }
+  EXPECT_EQ(j, drawnPixels_.size());
+}
+
+// =============================================================================
+// 自适应采样测试
+// =============================================================================
+
+TEST_F(SemanticTest, AdaptiveSamplingSkipsFlatSegments) {
+  // 平缓的曲线：固定步长下相邻点远小于一个像素
+  const std::string source = "FOR T FROM 0 TO 10 STEP 0.001 "
+                             "DRAW(T*5, sin(T)*5);\n";
+
+  SemanticConfig config;
+  config.adaptiveSampling = true;
+  analyzeWithConfig(source, config);
+  size_t fixed = analyzer_->getFixedStepSampleCount();
+  EXPECT_EQ(fixed, 10001u);
+  EXPECT_EQ(analyzer_->getAdaptiveSampleCount(), drawnPixels_.size());
+  EXPECT_LT(drawnPixels_.size() * 10, fixed);
+
+  // 首尾两点分别落在START和END上
+  ASSERT_GE(drawnPixels_.size(), 2u);
+  EXPECT_DOUBLE_EQ(std::get<0>(drawnPixels_.front()), 0.0);
+  EXPECT_DOUBLE_EQ(std::get<0>(drawnPixels_.back()), 50.0);
+  EXPECT_DOUBLE_EQ(std::get<1>(drawnPixels_.back()), std::sin(10.0) * 5);
+  for (size_t i = 1; i < drawnPixels_.size(); ++i) {
+    double dx = std::get<0>(drawnPixels_[i]) - std::get<0>(drawnPixels_[i - 1]);
+    double dy = std::get<1>(drawnPixels_[i]) - std::get<1>(drawnPixels_[i - 1]);
+    EXPECT_LE(std::hypot(dx, dy), 1.0);
+  }
+}
+
+TEST_F(SemanticTest, AdaptiveSamplingRefinesFastSegments) {
+  // 步长过大：固定步长下相邻点相距几十个像素
+  const std::string source = "SIZE IS 2;\n"
+                             "FOR T FROM 0 TO 2*PI STEP 0.5 "
+                             "DRAW(cos(T)*100, sin(T)*100);\n";
+
+  SemanticConfig config;
+  config.adaptiveSampling = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFixedStepSampleCount(), 13u);
+  EXPECT_GT(drawnPixels_.size(), 13u);
+
+  // 像素大小为2时允许相邻点相距2个像素
+  for (size_t i = 1; i < drawnPixels_.size(); ++i) {
+    double dx = std::get<0>(drawnPixels_[i]) - std::get<0>(drawnPixels_[i - 1]);
+    double dy = std::get<1>(drawnPixels_[i]) - std::get<1>(drawnPixels_[i - 1]);
+    EXPECT_LE(std::hypot(dx, dy), 2.0);
+  }
+}
+
+TEST_F(SemanticTest, AdaptiveSamplingLeavesTAsFixedStep) {
+  // 循环结束后的T与固定步长的循环相同
+  const std::string source = "FOR T FROM 0 TO 1 STEP 0.1 DRAW(T, T);\n"
+                             "ORIGIN IS (T, 0);\n"
+                             "FOR T FROM 0 TO 0 STEP 1 DRAW(0, 0);\n";
+
+  SemanticConfig config;
+  analyzeWithConfig(source, config);
+  double expected = std::get<0>(drawnPixels_.back());
+
+  config.adaptiveSampling = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(std::get<0>(drawnPixels_.back()), expected);
+}
+
+TEST_F(SemanticTest, AdaptiveSamplingPerStatement) {
+  const std::string source = "FOR T FROM 0 TO 10 STEP 0.001 DRAW(T, 0);\n"
+                             "FOR T FROM 0 TO 10 STEP 0.001 DRAW(T, 1);\n";
+
+  auto parser = createParser(source);
+  analyzer_->setParser(parser.get());
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  ASSERT_EQ(program->getChildCount(), 2u);
+  static_cast<ForDrawStmtNode *>(program->getStatement(1))
+      ->setAdaptiveSampling(true);
+  analyzer_->run(program.get());
+
+  // 只有第二条语句改为自适应采样
+  EXPECT_EQ(analyzer_->getFixedStepSampleCount(), 10001u);
+  EXPECT_EQ(drawnPixels_.size(), 10001u + analyzer_->getAdaptiveSampleCount());
+  EXPECT_LT(analyzer_->getAdaptiveSampleCount(), 100u);
+}
+
+// =============================================================================
+// 逆序绘制测试
+// =============================================================================
+
+namespace {
+
+// 按DrawLangUI的方式把回调收到的点画到画布上（白色背景）
+std::vector<uint32_t> rasterize(
+    const std::vector<std::tuple<double, double, PixelAttribute>> &pixels,
+    int width, int height) {
+  std::vector<uint32_t> canvas(static_cast<size_t>(width) * height,
+                               0xffffff);
+  for (const auto &[x, y, attr] : pixels) {
+    int size = std::max(1, static_cast<int>(attr.size));
+    int half = size / 2;
+    int ix = static_cast<int>(x);
+    int iy = static_cast<int>(y);
+    for (int py = iy - half; py <= iy + half; ++py) {
+      for (int px = ix - half; px <= ix + half; ++px) {
+        if (px >= 0 && px < width && py >= 0 && py < height) {
+          canvas[py * width + px] =
+              static_cast<uint32_t>(attr.r) << 16 |
+              static_cast<uint32_t>(attr.g) << 8 | attr.b;
+        }
+      }
+    }
+  }
+  return canvas;
+}
+
+} // anonymous namespace
+
+TEST_F(SemanticTest, ReverseOverdrawMatchesForwardImage) {
+  // 后面的曲线覆盖前面的曲线，部分点落在画布之外
+  const std::string source =
+      "ORIGIN IS (100, 100); SCALE IS (60, 60); SIZE IS 3;\n"
+      "FOR T FROM 0 TO 2*PI STEP 0.001 DRAW(cos(T), sin(T));\n"
+      "COLOR IS (0, 0, 255); SIZE IS 5;\n"
+      "FOR T FROM 0 TO 2*PI STEP 0.002 DRAW(cos(T), sin(T));\n"
+      "COLOR IS (0, 128, 0); SIZE IS 2; ROT IS 0.3;\n"
+      "FOR T FROM -3 TO 3 STEP 0.0005 DRAW(T, T*T/4 - 1);\n"
+      "ORIGIN IS (T*10, 50); SCALE IS (1, 1);\n"
+      "FOR T FROM 0 TO 10 STEP 1 DRAW(T, 0);\n";
+  const int width = 200;
+  const int height = 160;
+
+  SemanticConfig config;
+  config.canvasWidth = width;
+  config.canvasHeight = height;
+  analyzeWithConfig(source, config);
+  auto expected = rasterize(drawnPixels_, width, height);
+  size_t forwardCalls = drawnPixels_.size();
+
+  config.reverseOverdraw = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(rasterize(drawnPixels_, width, height), expected);
+  EXPECT_GT(analyzer_->getCoveredSampleCount(), 0u);
+  EXPECT_LT(drawnPixels_.size(), forwardCalls);
+}
+
+TEST_F(SemanticTest, ReverseOverdrawSkipsFullyCoveredRanges) {
+  // 第二条曲线画满整个画布，第一条曲线的所有点都被跳过
+  const std::string source =
+      "SIZE IS 7;\n"
+      "FOR T FROM 0 TO 40 STEP 0.01 DRAW(T, 20 + sin(T)*10);\n"
+      "COLOR IS (0, 0, 0);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 0);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 7);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 14);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 21);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 28);\n"
+      "FOR T FROM 0 TO 40 STEP 0.5 DRAW(T, 35);\n";
+
+  SemanticConfig config;
+  config.canvasWidth = 40;
+  config.canvasHeight = 40;
+  analyzeWithConfig(source, config);
+  auto expected = rasterize(drawnPixels_, 40, 40);
+
+  config.reverseOverdraw = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(rasterize(drawnPixels_, 40, 40), expected);
+  EXPECT_GE(analyzer_->getCoveredSampleCount(), 4001u);
+  for (const auto &pixel : drawnPixels_) {
+    EXPECT_EQ(std::get<2>(pixel).r, 0);
+  }
+}
+
+// =============================================================================
+// 字节码求值测试
+// =============================================================================
+
+TEST_F(SemanticTest, BytecodeDrawsSamePixels) {
+  // 覆盖各种运算、除数为0、一元运算、不依赖T的坐标和共享的子表达式
+  const std::string source =
+      "ORIGIN IS (100, 100); SCALE IS (30, 30); ROT IS PI/7;\n"
+      "FOR T FROM -PI TO PI STEP PI/100 DRAW(cos(T)*(2 - sin(T)), "
+      "sin(T)*(2 - sin(T)));\n"
+      "FOR T FROM 0 TO 3 STEP 0.01 DRAW(-T + T**2/(T - 1), "
+      "exp(-T)*abs(T - 1.5));\n"
+      "FOR T FROM 0 TO 2 STEP 0.125 DRAW(sin(PI/7)*2, +T);\n"
+      "FOR T FROM 1 TO 5 STEP 0.25 DRAW(ln(T)/(1 - 1), sqrt(T)**3);\n";
+
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  ASSERT_FALSE(expected.empty());
+
+  config.bytecode = true;
+  analyzeWithConfig(source, config);
+  expectSamePixels(drawnPixels_, expected);
+
+  // 自适应采样和画布剔除同样使用字节码求值
+  for (int mode = 0; mode < 2; ++mode) {
+    config.bytecode = false;
+    config.adaptiveSampling = mode == 0;
+    config.canvasWidth = mode == 1 ? 120 : 0;
+    config.canvasHeight = mode == 1 ? 120 : 0;
+    analyzeWithConfig(source, config);
+    expected = drawnPixels_;
+    config.bytecode = true;
+    analyzeWithConfig(source, config);
+    expectSamePixels(drawnPixels_, expected);
+  }
+}
+
+TEST_F(SemanticTest, BytecodeCompilation) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 0.1 "
+                             "DRAW(sin(T)*cos(PI/3) + sin(T), (T*2)*(T*2));");
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  auto *stmt = program->getStatement(0);
+  const ExpressionNode *x = stmt->getExpression(3);
+  const ExpressionNode *y = stmt->getExpression(4);
+
+  auto code = Bytecode::compile({x, y});
+  ASSERT_TRUE(code);
+  // sin(T)（两处共享）、常量cos(PI/3)、乘、加；2、T*2、平方
+  EXPECT_EQ(code->getInstructionCount(), 7u);
+  EXPECT_EQ(code->getResultCount(), 2u);
+  // T固定在r0，其余的值在最后一次使用后释放寄存器
+  EXPECT_LE(code->getRegisterCount(), 4u);
+
+  std::string text = code->disassemble();
+  EXPECT_NE(text.find("call SIN r0"), std::string::npos);
+  EXPECT_EQ(text.find("COS"), std::string::npos);
+  EXPECT_NE(text.find("results:"), std::string::npos);
+
+  for (double t : {0.0, 0.5, -3.25, 100.0}) {
+    EvalContext ctx(t);
+    double xy[2];
+    code->run(t, xy);
+    EXPECT_EQ(xy[0], x->evaluate(ctx));
+    EXPECT_EQ(xy[1], y->evaluate(ctx));
+  }
+
+  // 缺失的表达式按0求值
+  auto empty = Bytecode::compile({nullptr});
+  ASSERT_TRUE(empty);
+  double v = 1.0;
+  empty->run(0.0, &v);
+  EXPECT_EQ(v, 0.0);
+}
+
+TEST_F(SemanticTest, BytecodeBatchMatchesScalar) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 0.1 "
+                             "DRAW(-T**3/(T - 2) + sqrt(abs(T))*cos(T), "
+                             "1/T + exp(sin(T)*T));");
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  auto *stmt = program->getStatement(0);
+  auto code =
+      Bytecode::compile({stmt->getExpression(3), stmt->getExpression(4)});
+  ASSERT_TRUE(code);
+
+  // 跨越多个批次且不是批大小的整数倍，包括0、±2（除数为0）和非有限值
+  std::vector<double> ts;
+  for (int i = 0; i < 700; ++i) {
+    ts.push_back(-3.5 + i * 0.01);
+  }
+  ts.insert(ts.end(), {0.0, -0.0, 2.0, 1e300, -INFINITY, INFINITY});
+  // 算术指令按vecmath的指令集分派，各指令集的结果都与run()逐位相同
+  vecmath::Isa saved = vecmath::getIsa();
+  for (vecmath::Isa isa : {vecmath::Isa::Scalar, vecmath::Isa::SSE2,
+                           vecmath::Isa::AVX2}) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    SCOPED_TRACE(vecmath::isaName(isa));
+    std::vector<double> xs(ts.size()), ys(ts.size());
+    double *outs[2] = {xs.data(), ys.data()};
+    code->runBatch(ts.data(), ts.size(), outs);
+
+    for (size_t i = 0; i < ts.size(); ++i) {
+      double xy[2];
+      code->run(ts[i], xy);
+      // NaN只比较是否为NaN
+      if (std::isnan(xy[0])) {
+        EXPECT_TRUE(std::isnan(xs[i]));
+      } else {
+        EXPECT_EQ(xs[i], xy[0]) << "T=" << ts[i];
+      }
+      if (std::isnan(xy[1])) {
+        EXPECT_TRUE(std::isnan(ys[i]));
+      } else {
+        EXPECT_EQ(ys[i], xy[1]) << "T=" << ts[i];
+      }
+    }
+  }
+  vecmath::setIsa(saved);
+}
+
+TEST_F(SemanticTest, BytecodeFusesSinCos) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 0.1 "
+                             "DRAW(cos(T*3)*(2 - sin(T)), sin(T*3) + cos(T));");
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  auto *stmt = program->getStatement(0);
+  auto code =
+      Bytecode::compile({stmt->getExpression(3), stmt->getExpression(4)});
+  ASSERT_TRUE(code);
+
+  // T和T*3各有一对SIN、COS，合并为两条sincos
+  std::string text = code->disassemble();
+  size_t first = text.find("sincos");
+  ASSERT_NE(first, std::string::npos) << text;
+  EXPECT_NE(text.find("sincos", first + 1), std::string::npos) << text;
+  EXPECT_EQ(text.find("call"), std::string::npos) << text;
+
+  std::vector<double> ts;
+  for (int i = 0; i < 600; ++i) {
+    ts.push_back(-30.0 + i * 0.1);
+  }
+  std::vector<double> xs(ts.size()), ys(ts.size());
+  double *outs[2] = {xs.data(), ys.data()};
+  for (bool vectorMath : {false, true}) {
+    code->setVectorMath(vectorMath);
+    EXPECT_EQ(code->usesVectorMath(), vectorMath);
+    code->runBatch(ts.data(), ts.size(), outs);
+    for (size_t i = 0; i < ts.size(); ++i) {
+      double t = ts[i];
+      double x = std::cos(t * 3) * (2 - std::sin(t));
+      double y = std::sin(t * 3) + std::cos(t);
+      double xy[2];
+      code->run(t, xy);
+      EXPECT_EQ(xy[0], x);
+      EXPECT_EQ(xy[1], y);
+      if (vectorMath) {
+        // 向量实现的误差在几个ULP以内
+        EXPECT_NEAR(xs[i], x, 1e-14) << "T=" << t;
+        EXPECT_NEAR(ys[i], y, 1e-14) << "T=" << t;
+      } else {
+        EXPECT_EQ(xs[i], x) << "T=" << t;
+        EXPECT_EQ(ys[i], y) << "T=" << t;
+      }
+    }
+  }
+}
+
+// =============================================================================
+// 本地代码生成测试
+// =============================================================================
+
+TEST_F(SemanticTest, JitDrawsSamePixels) {
+  // 每条FOR-DRAW都有足够多的采样点，内层循环生成本地代码
+  const std::string source =
+      "ORIGIN IS (100, 100); SCALE IS (30, 30); ROT IS PI/7;\n"
+      "FOR T FROM -PI TO PI STEP PI/1000 DRAW(cos(T)*(2 - sin(T)), "
+      "sin(T)*(2 - sin(T)));\n"
+      "FOR T FROM 0 TO 3 STEP 0.001 DRAW(-T + T**2/(T - 1), "
+      "exp(-T)*abs(T - 1.5));\n"
+      "FOR T FROM 0 TO 2 STEP 0.001 DRAW(sin(PI/7)*2, -T);\n"
+      "FOR T FROM 1 TO 5 STEP 0.002 DRAW(ln(T)/(1 - 1), sqrt(T)**3);\n"
+      "ORIGIN IS (T, 0);\n"
+      "FOR T FROM 0 TO 1 STEP 0.5 DRAW(T, T);\n";
+
+  for (int canvas : {0, 120}) {
+    SemanticConfig config;
+    config.enableDebugOutput = false;
+    config.fuseLoops = false;
+    config.canvasWidth = canvas;
+    config.canvasHeight = canvas;
+    analyzeWithConfig(source, config);
+    auto expected = drawnPixels_;
+    ASSERT_FALSE(expected.empty());
+
+    config.jit = true;
+    analyzeWithConfig(source, config);
+    expectSamePixels(drawnPixels_, expected);
+    // 不支持的平台上退回字节码；最后一条语句的点数太少，不生成代码
+    EXPECT_EQ(analyzer_->getJitLoopCount(),
+              JitKernel::isSupported() ? 4u : 0u);
+  }
+  // 没有设置DRAWLANG_PERF_MAP时不写perf符号映射
+  if (!std::getenv("DRAWLANG_PERF_MAP")) {
+    EXPECT_FALSE(std::filesystem::exists(
+        "/tmp/perf-" + std::to_string(getpid()) + ".map"));
+  }
+}
+
+// =============================================================================
+// 单精度求值测试
+// =============================================================================
+
+TEST_F(SemanticTest, FloatPrecisionMode) {
+  // 第一条曲线单精度的误差远小于一个像素；第二条在10000附近求值，
+  // 单精度的舍入误差放大100000倍后有几十个像素
+  const std::string source =
+      "ORIGIN IS (400, 300); SCALE IS (100, 100);\n"
+      "FOR T FROM 0 TO 2*PI STEP PI/500 DRAW(cos(T)*(1 + sin(5*T)/4), "
+      "sin(T));\n"
+      "SCALE IS (100000, 1);\n"
+      "FOR T FROM 0 TO 1 STEP 0.01 DRAW((T + 10000) - 10000, T);\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  config.bytecode = true;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(analyzer_->getFloatLoopCount(), 0u);
+
+  config.precision = Precision::Auto;
+  config.checkFloat = true;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFloatLoopCount(), 1u);
+  EXPECT_LT(analyzer_->getFloatMaxError(), config.floatErrorPixels);
+  ASSERT_EQ(drawnPixels_.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(std::get<0>(drawnPixels_[i]), std::get<0>(expected[i]), 0.01);
+    EXPECT_NEAR(std::get<1>(drawnPixels_[i]), std::get<1>(expected[i]), 0.01);
+  }
+
+  // 强制单精度时两条都用单精度，检查能发现第二条的误差
+  config.precision = Precision::Float;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getFloatLoopCount(), 2u);
+  EXPECT_GT(analyzer_->getFloatMaxError(), 1.0);
+  EXPECT_EQ(drawnPixels_.size(), expected.size());
+}
+
+TEST_F(SemanticTest, BytecodeFloatBatchCloseToDouble) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 0.1 "
+                             "DRAW(T**2/(T - 2) + sqrt(abs(T))*cos(T), "
+                             "exp(sin(T)*T) - ln(abs(T) + 1));");
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  auto *stmt = program->getStatement(0);
+  auto code =
+      Bytecode::compile({stmt->getExpression(3), stmt->getExpression(4)});
+  ASSERT_TRUE(code);
+
+  std::vector<double> ts;
+  for (int i = 0; i < 700; ++i) {
+    ts.push_back(-3.5 + i * 0.01);
+  }
+  ts.push_back(2.0); // 除数为0
+  std::vector<double> xd(ts.size()), yd(ts.size());
+  std::vector<double> xs(ts.size()), ys(ts.size());
+  double *doubleOuts[2] = {xd.data(), yd.data()};
+  double *floatOuts[2] = {xs.data(), ys.data()};
+  code->runBatch(ts.data(), ts.size(), doubleOuts);
+  code->runBatchFloat(ts.data(), ts.size(), floatOuts);
+  for (size_t i = 0; i < ts.size(); ++i) {
+    // 单精度结果已舍入为float
+    EXPECT_EQ(xs[i], static_cast<float>(xs[i]));
+    EXPECT_NEAR(xs[i], xd[i], 1e-5 * (1 + std::fabs(xd[i]))) << "T=" << ts[i];
+    EXPECT_NEAR(ys[i], yd[i], 1e-5 * (1 + std::fabs(yd[i]))) << "T=" << ts[i];
+  }
+}
+
+// =============================================================================
+// 快速近似测试
+// =============================================================================
+
+TEST_F(SemanticTest, BytecodeFastMathPerCallSite) {
+  auto parser = createParser("FOR T FROM 0 TO 1 STEP 0.1 "
+                             "DRAW(sin(T*3) + cos(T*3), exp(T) - sqrt(T));");
+  auto program = parser->parse();
+  ASSERT_TRUE(program);
+  auto *stmt = program->getStatement(0);
+  auto code =
+      Bytecode::compile({stmt->getExpression(3), stmt->getExpression(4)});
+  ASSERT_TRUE(code);
+
+  // SinCos指令的两个结果各是一个调用位置
+  const auto &sites = code->getCallSites();
+  ASSERT_EQ(sites.size(), 4u);
+  const char *names[] = {"SIN", "COS", "EXP", "SQRT"};
+  for (size_t i = 0; i < sites.size(); ++i) {
+    EXPECT_STREQ(BuiltinFunctions::getName(sites[i].func), names[i]);
+    ASSERT_NE(sites[i].node, nullptr);
+    EXPECT_EQ(sites[i].node->getNodeType(), DrawASTNodeType::FuncCallExpr);
+  }
+  EXPECT_EQ(sites[0].instruction, sites[1].instruction);
+  EXPECT_TRUE(sites[1].second);
+
+  std::vector<double> ts;
+  for (int i = 0; i < 700; ++i) {
+    ts.push_back(i * 0.01);
+  }
+  std::vector<double> xd(ts.size()), yd(ts.size());
+  std::vector<double> xs(ts.size()), ys(ts.size());
+  double *exactOuts[2] = {xd.data(), yd.data()};
+  double *outs[2] = {xs.data(), ys.data()};
+  code->runBatch(ts.data(), ts.size(), exactOuts);
+
+  // 等级不同的SIN、COS分别计算；EXP保持精确，SQRT各等级都精确
+  using vecmath::Tier;
+  code->setFastMath({Tier::Coarse, Tier::Fine, std::nullopt, Tier::Coarse});
+  EXPECT_TRUE(code->usesFastMath());
+  code->runBatch(ts.data(), ts.size(), outs);
+  for (size_t i = 0; i < ts.size(); ++i) {
+    EXPECT_NEAR(xs[i], xd[i], 2.1e-5) << "T=" << ts[i];
+    EXPECT_EQ(ys[i], yd[i]) << "T=" << ts[i];
+  }
+
+  // 等级相同时合并计算
+  code->setFastMath({Tier::Medium, Tier::Medium, Tier::Medium, Tier::Medium});
+  code->runBatch(ts.data(), ts.size(), outs);
+  for (size_t i = 0; i < ts.size(); ++i) {
+    EXPECT_NEAR(xs[i], xd[i], 1e-7) << "T=" << ts[i];
+    EXPECT_NEAR(ys[i], yd[i], 2e-7 * std::exp(ts[i])) << "T=" << ts[i];
+  }
+
+  code->setFastMath({});
+  EXPECT_FALSE(code->usesFastMath());
+  code->runBatch(ts.data(), ts.size(), outs);
+  EXPECT_EQ(xs, xd);
+
+  // 扰动EXP的结果
+  code->runBatchPerturbed(ts.data(), ts.size(), outs, nullptr, 2, 1e-3, true);
+  for (size_t i = 0; i < ts.size(); ++i) {
+    EXPECT_EQ(xs[i], xd[i]);
+    EXPECT_NEAR(ys[i] - yd[i], std::exp(ts[i]) * 1e-3, 1e-12);
+  }
+}
+
+TEST_F(SemanticTest, FastMathTierWithinPixelBudget) {
+  // 比例依次放大：小比例下最便宜的等级就足够，比例越大需要的等级越高
+  const std::string source =
+      "SCALE IS (100, 100);\n"
+      "FOR T FROM 0 TO 2*PI STEP PI/500 DRAW(cos(T), sin(T));\n"
+      "SCALE IS (1000000, 1000000);\n"
+      "FOR T FROM 0 TO 2*PI STEP PI/500 DRAW(cos(T), sin(T));\n"
+      "SCALE IS (1000000000, 1);\n"
+      "FOR T FROM 0 TO 2 STEP 0.01 DRAW(exp(T), T);\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  config.bytecode = true;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  ASSERT_FALSE(expected.empty());
+  EXPECT_TRUE(analyzer_->getFastMathUses().empty());
+
+  config.fastMath = FastMath::Auto;
+  analyzeWithConfig(source, config);
+  const auto &uses = analyzer_->getFastMathUses();
+  ASSERT_EQ(uses.size(), 5u);
+  vecmath::Tier tiers[] = {vecmath::Tier::Coarse, vecmath::Tier::Coarse,
+                           vecmath::Tier::Medium, vecmath::Tier::Medium,
+                           vecmath::Tier::Fine};
+  double total[3] = {};
+  const char *functions[] = {"SIN", "COS", "SIN", "COS", "EXP"};
+  for (size_t i = 0; i < uses.size(); ++i) {
+    // 节点属于已经释放的程序，只检查是否记录
+    EXPECT_NE(uses[i].call, nullptr);
+    EXPECT_STREQ(uses[i].function, functions[i]);
+    EXPECT_TRUE(uses[i].approximated);
+    EXPECT_EQ(uses[i].tier, tiers[i]) << i << " " << uses[i].function;
+    total[i / 2] += uses[i].errorPixels;
+  }
+  for (double error : total) {
+    EXPECT_LT(error, config.fastMathErrorPixels);
+  }
+  ASSERT_EQ(drawnPixels_.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(std::get<0>(drawnPixels_[i]), std::get<0>(expected[i]), 0.5);
+    EXPECT_NEAR(std::get<1>(drawnPixels_[i]), std::get<1>(expected[i]), 0.5);
+  }
+
+  // 强制最便宜的等级时，大比例的曲线偏离超过一个像素
+  config.fastMath = FastMath::Coarse;
+  analyzeWithConfig(source, config);
+  ASSERT_EQ(drawnPixels_.size(), expected.size());
+  double worst = 0.0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    worst = std::max(worst, std::fabs(std::get<0>(drawnPixels_[i]) -
+                                      std::get<0>(expected[i])));
+  }
+  EXPECT_GT(worst, 1.0);
+}
+
+TEST_F(SemanticTest, FastMathUsesReportStatementLocation) {
+  // 两条语句中的sin(T)经hash-consing是同一个节点，记录的位置应分别为
+  // 各自所在的语句
+  const std::string source =
+      "FOR T FROM 0 TO 1 STEP 0.01 DRAW(T, sin(T));\n"
+      "SCALE IS (2, 2);\n"
+      "FOR T FROM 0 TO 2 STEP 0.01 DRAW(sin(T), T);\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  config.bytecode = true;
+  config.fastMath = FastMath::Coarse;
+  analyzeWithConfig(source, config);
+  const auto &uses = analyzer_->getFastMathUses();
+  ASSERT_EQ(uses.size(), 2u);
+  EXPECT_EQ(uses[0].call, uses[1].call);
+  EXPECT_EQ(uses[0].location.start.line, 1u);
+  EXPECT_EQ(uses[1].location.start.line, 3u);
+}
+
+// =============================================================================
+// 并行执行测试
+// =============================================================================
+
+TEST_F(SemanticTest, ParallelForDrawMatchesSerial) {
+  // 第一条FOR-DRAW的采样点足够多，分块并行求值；第二条太短，串行执行
+  const std::string source =
+      "ORIGIN IS (200, 150); SCALE IS (60, 60); ROT IS PI/5;\n"
+      "FOR T FROM 0 TO 40 STEP 1/512 DRAW(cos(T)*sin(3*T) + T/20, "
+      "sin(T)*sin(3*T) + ln(T));\n"
+      "COLOR IS (0, 0, 255);\n"
+      "FOR T FROM 0 TO 1 STEP 0.01 DRAW(T, T*T);\n";
+
+  // 树遍历、字节码、画布剔除、本地代码
+  for (int mode = 0; mode < 4; ++mode) {
+    SCOPED_TRACE(mode);
+    SemanticConfig config;
+    config.enableDebugOutput = false;
+    config.bytecode = mode == 1 || mode == 2;
+    config.jit = mode == 3;
+    config.canvasWidth = mode == 2 ? 300 : 0;
+    config.canvasHeight = mode == 2 ? 200 : 0;
+    analyzeWithConfig(source, config);
+    auto expected = drawnPixels_;
+    size_t culled = analyzer_->getCulledSampleCount();
+    ASSERT_GT(expected.size(), 1000u);
+    EXPECT_EQ(analyzer_->getParallelLoopCount(), 0u);
+
+    config.threads = 4;
+    analyzeWithConfig(source, config);
+    expectSamePixels(drawnPixels_, expected);
+    EXPECT_EQ(analyzer_->getParallelLoopCount(), 1u);
+    EXPECT_EQ(analyzer_->getCulledSampleCount(), culled);
+    if (mode == 2) {
+      EXPECT_GT(culled, 0u);
+    }
+  }
+}
+
+TEST_F(SemanticTest, ParallelStatementsMatchSerial) {
+  // 许多条互相重叠的短曲线，中间改变坐标变换和像素属性；
+  // 最后一条足够长，在语句任务中再分块并行求值
+  std::string source = "SCALE IS (40, 40);\n";
+  for (int i = 0; i < 24; ++i) {
+    auto n = [](int v) { return std::to_string(v); };
+    source += "ORIGIN IS (" + n(100 + 3 * i) + ", " + n(80 + 2 * i) +
+              "); ROT IS " + n(i) + "/7;\nCOLOR IS (" + n(10 * i) + ", " +
+              n(255 - 10 * i) + ", 0); SIZE IS " + n(1 + i % 3) +
+              ";\nFOR T FROM 0 TO 2*PI STEP 0.05 DRAW(cos(T) + " + n(i) +
+              "/10, sin(2*T));\n";
+  }
+  source += "FOR T FROM 0 TO 40 STEP 1/512 DRAW(sin(3*T), cos(5*T));\n";
+
+  for (int mode = 0; mode < 2; ++mode) {
+    SCOPED_TRACE(mode);
+    SemanticConfig config;
+    config.enableDebugOutput = false;
+    config.bytecode = mode == 1;
+    analyzeWithConfig(source, config);
+    auto expected = drawnPixels_;
+    double expectedT = analyzer_->getEvalContext().t;
+    EXPECT_EQ(analyzer_->getParallelStatementCount(), 0u);
+
+    config.threads = 4;
+    analyzeWithConfig(source, config);
+    expectSamePixels(drawnPixels_, expected);
+    EXPECT_EQ(analyzer_->getParallelStatementCount(), 25u);
+    EXPECT_EQ(analyzer_->getParallelLoopCount(), 1u);
+    // 循环结束后T的值与串行执行相同
+    EXPECT_EQ(analyzer_->getEvalContext().t, expectedT);
+  }
+}
+
+TEST_F(SemanticTest, ParallelStatementsBoundBufferedPixels) {
+  // 每条语句的点数远多于缓存上限，后面的语句要等前面的取走后才能继续
+  const std::string source =
+      "SCALE IS (4, 4);\n"
+      "FOR T FROM 0 TO 100 STEP 1/1024 DRAW(T, sin(T));\n"
+      "COLOR IS BLUE; SIZE IS 2;\n"
+      "FOR T FROM 0 TO 100 STEP 1/1024 DRAW(T, cos(T));\n"
+      "ROT IS 0.5;\n"
+      "FOR T FROM 0 TO 50 STEP 1/1024 DRAW(T, sin(2*T));\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  config.fuseLoops = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+  double expectedT = analyzer_->getEvalContext().t;
+
+  config.threads = 3;
+  analyzeWithConfig(source, config);
+  EXPECT_EQ(analyzer_->getParallelStatementCount(), 3u);
+  expectSamePixels(drawnPixels_, expected);
+  EXPECT_EQ(analyzer_->getEvalContext().t, expectedT);
+}
+
+TEST_F(SemanticTest, TDependentStatementsStaySerial) {
+  // 第一条循环结束后T为终值之后的值，ROT依赖它，不能按语句并行
+  const std::string source = "FOR T FROM 0 TO 1 STEP 0.1 DRAW(T, T);\n"
+                             "ROT IS T;\n"
+                             "FOR T FROM 0 TO 1 STEP 0.1 DRAW(T, 0);\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+
+  config.threads = 4;
+  analyzeWithConfig(source, config);
+  expectSamePixels(drawnPixels_, expected);
+  EXPECT_EQ(analyzer_->getParallelStatementCount(), 0u);
+}
+
+TEST_F(SemanticTest, FewSamplesFuseInsteadOfParallelStatements) {
+  // 总采样点数少于语句级并行的下限，多线程时仍然融合执行
+  const std::string source =
+      "FOR T FROM 0 TO 2*PI STEP 0.01 DRAW(100 + 50*cos(T), 100 + 50*sin(T));\n"
+      "COLOR IS BLUE;\n"
+      "FOR T FROM 0 TO 2*PI STEP 0.01 DRAW(100 + 30*cos(T), 100 + 30*sin(T));\n";
+  SemanticConfig config;
+  config.enableDebugOutput = false;
+  analyzeWithConfig(source, config);
+  auto expected = drawnPixels_;
+
+  config.threads = 4;
+  analyzeWithConfig(source, config);
+  expectSamePixels(drawnPixels_, expected);
+  EXPECT_EQ(analyzer_->getParallelStatementCount(), 0u);
+  EXPECT_EQ(analyzer_->getFusedLoopCount(), 2u);
+}
+
 // =============================================================================
 // 主函数
 // =============================================================================
@@ -0,0 +1,256 @@
+/**
+ * @file vecmath_test.cc
+ * @brief 内置函数向量实现单元测试：与libm比较误差，各指令集结果一致
+ */
+
+#include "DrawLangAST.hpp"
+#include "DrawLangVecMath.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace interpreter_exp;
+using namespace interpreter_exp::ast;
+
+namespace {
+
+// 把double映射为有序整数，相邻的double相差1（+0与-0相同）
+int64_t orderedBits(double value) {
+  int64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits < 0 ? -(bits & INT64_MAX) : bits;
+}
+
+bool sameBits(double a, double b) {
+  return std::memcmp(&a, &b, sizeof(double)) == 0 || (a != a && b != b);
+}
+
+// 测试输入：各函数的主要定义域、较大的参数、各种数量级，以及特殊值。
+// 个数不是向量宽度的整数倍，覆盖尾部的处理
+std::vector<double> sampleInputs() {
+  std::mt19937_64 rng(20240601);
+  std::uniform_real_distribution<double> unit(-1.0, 1.0);
+  std::uniform_real_distribution<double> exponent(-40.0, 40.0);
+  std::vector<double> xs;
+  for (int i = 0; i < 50000; ++i) {
+    xs.push_back(unit(rng));
+    xs.push_back(unit(rng) * 800.0);
+    xs.push_back(unit(rng) * std::pow(2.0, exponent(rng)));
+    xs.push_back((1.0 + unit(rng) * 1e-3) * (i % 2 ? 1.0 : -1.0));
+  }
+  xs.insert(xs.end(), {0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 2.5, -2.5,
+                       M_PI / 2, M_PI, 709.78, 710.0, -745.0, -746.0,
+                       1e6, -1e6, 1e300, -1e300, 5e-324, 2.2e-308,
+                       4503599627370495.5, 1e17, INFINITY, -INFINITY,
+                       NAN});
+  return xs;
+}
+
+const vecmath::Isa kAllIsas[] = {vecmath::Isa::Scalar, vecmath::Isa::SSE2,
+                                 vecmath::Isa::AVX2};
+
+class VecMathTest : public ::testing::Test {
+protected:
+  void SetUp() override { savedIsa_ = vecmath::getIsa(); }
+  void TearDown() override { vecmath::setIsa(savedIsa_); }
+
+private:
+  vecmath::Isa savedIsa_ = vecmath::Isa::Scalar;
+};
+
+} // anonymous namespace
+
+// 函数表与内置函数表一一对应
+TEST_F(VecMathTest, MatchesBuiltinTable) {
+  const auto &funcs = vecmath::functions();
+  ASSERT_EQ(funcs.size(), BuiltinFunctions::count());
+  for (size_t id = 0; id < funcs.size(); ++id) {
+    EXPECT_STREQ(funcs[id].name, BuiltinFunctions::getName(id));
+    EXPECT_EQ(funcs[id].scalar, BuiltinFunctions::getFunc(id));
+    EXPECT_EQ(vecmath::find(funcs[id].name), &funcs[id]);
+  }
+  EXPECT_EQ(vecmath::find("POW"), nullptr);
+  EXPECT_TRUE(vecmath::isSupported(vecmath::Isa::Scalar));
+}
+
+// 每个指令集上每个函数与libm之差不超过文档给出的上界，NaN的位置相同
+TEST_F(VecMathTest, UlpBoundAgainstLibm) {
+  std::vector<double> xs = sampleInputs();
+  std::vector<double> ys(xs.size());
+  for (vecmath::Isa isa : kAllIsas) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    for (const auto &info : vecmath::functions()) {
+      info.array(xs.data(), ys.data(), xs.size());
+      int64_t worst = 0;
+      double worstX = 0.0;
+      for (size_t i = 0; i < xs.size(); ++i) {
+        double expected = info.scalar(xs[i]);
+        if (std::isnan(expected) || std::isnan(ys[i])) {
+          EXPECT_EQ(std::isnan(expected), std::isnan(ys[i]))
+              << info.name << "(" << xs[i] << ") on "
+              << vecmath::isaName(isa);
+          continue;
+        }
+        int64_t ulp = std::llabs(orderedBits(expected) - orderedBits(ys[i]));
+        if (ulp > worst) {
+          worst = ulp;
+          worstX = xs[i];
+        }
+      }
+      EXPECT_LE(worst, info.maxUlp)
+          << info.name << " on " << vecmath::isaName(isa)
+          << ", worst at x=" << worstX;
+    }
+  }
+}
+
+// 精确的函数与libm逐位相同（包括-0的符号）
+TEST_F(VecMathTest, ExactFunctionsKeepSignOfZero) {
+  std::vector<double> xs = {-0.5, -0.0, 0.3, -0.7, -1.5, 0.0, 2.5, -2.5};
+  std::vector<double> ys(xs.size());
+  for (vecmath::Isa isa : kAllIsas) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    for (const char *name : {"CEIL", "FLOOR", "ABS", "SQRT"}) {
+      const auto *info = vecmath::find(name);
+      ASSERT_NE(info, nullptr);
+      info->array(xs.data(), ys.data(), xs.size());
+      for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_TRUE(sameBits(ys[i], info->scalar(xs[i])))
+            << name << "(" << xs[i] << ") on " << vecmath::isaName(isa);
+      }
+    }
+  }
+}
+
+// 融合的sincos与分别计算sin、cos逐位相同，输出可以覆盖输入
+TEST_F(VecMathTest, SincosMatchesSinAndCos) {
+  std::vector<double> xs = sampleInputs();
+  for (vecmath::Isa isa : kAllIsas) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    std::vector<double> sins(xs.size()), coss(xs.size());
+    vecmath::sin(xs.data(), sins.data(), xs.size());
+    vecmath::cos(xs.data(), coss.data(), xs.size());
+
+    std::vector<double> s = xs, c(xs.size());
+    vecmath::sincos(s.data(), s.data(), c.data(), s.size());
+    for (size_t i = 0; i < xs.size(); ++i) {
+      ASSERT_TRUE(sameBits(s[i], sins[i])) << "sin(" << xs[i] << ")";
+      ASSERT_TRUE(sameBits(c[i], coss[i])) << "cos(" << xs[i] << ")";
+    }
+  }
+}
+
+// SSE2与AVX2的实现逐位相同，且与元素在数组中的位置（是否在尾部）无关
+TEST_F(VecMathTest, IsasAgreeBitwise) {
+  if (!vecmath::isSupported(vecmath::Isa::SSE2) ||
+      !vecmath::isSupported(vecmath::Isa::AVX2)) {
+    GTEST_SKIP() << "SSE2 and AVX2 are not both available";
+  }
+  std::vector<double> xs = sampleInputs();
+  std::vector<double> sse(xs.size()), avx(xs.size()), shifted(xs.size());
+  for (const auto &info : vecmath::functions()) {
+    vecmath::setIsa(vecmath::Isa::SSE2);
+    info.array(xs.data(), sse.data(), xs.size());
+    vecmath::setIsa(vecmath::Isa::AVX2);
+    info.array(xs.data(), avx.data(), xs.size());
+    // 错开一个元素，原来在尾部的元素落入整向量
+    info.array(xs.data() + 1, shifted.data(), xs.size() - 1);
+    for (size_t i = 0; i < xs.size(); ++i) {
+      ASSERT_TRUE(sameBits(sse[i], avx[i]))
+          << info.name << "(" << xs[i] << ")";
+      if (i > 0) {
+        ASSERT_TRUE(sameBits(shifted[i - 1], avx[i]))
+            << info.name << "(" << xs[i] << ")";
+      }
+    }
+  }
+}
+
+// 快速近似的误差不超过各等级的上界，等级越高上界越小
+TEST_F(VecMathTest, FastTiersWithinErrorBound) {
+  std::vector<double> xs = sampleInputs();
+  std::vector<double> ys(xs.size());
+  for (vecmath::Isa isa : kAllIsas) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    for (const auto &info : vecmath::fastFunctions()) {
+      const auto *exact = vecmath::find(info.name);
+      ASSERT_NE(exact, nullptr);
+      info.array(xs.data(), ys.data(), xs.size());
+      double worst = 0.0;
+      double worstX = 0.0;
+      for (size_t i = 0; i < xs.size(); ++i) {
+        double expected = exact->scalar(xs[i]);
+        if (std::isnan(expected) || std::isnan(ys[i])) {
+          EXPECT_EQ(std::isnan(expected), std::isnan(ys[i]))
+              << info.name << "(" << xs[i] << ") on "
+              << vecmath::isaName(isa);
+          continue;
+        }
+        if (std::isinf(expected) || std::isinf(ys[i])) {
+          EXPECT_EQ(expected, ys[i]) << info.name << "(" << xs[i] << ")";
+          continue;
+        }
+        double error = std::fabs(ys[i] - expected);
+        if (info.relative) {
+          // 次正规数的结果只有绝对精度
+          if (std::fabs(expected) < 2.2250738585072014e-308) {
+            continue;
+          }
+          error /= std::fabs(expected);
+        }
+        if (error > worst) {
+          worst = error;
+          worstX = xs[i];
+        }
+      }
+      EXPECT_LE(worst, info.maxError)
+          << info.name << " " << vecmath::tierName(info.tier) << " on "
+          << vecmath::isaName(isa) << ", worst at x=" << worstX;
+    }
+  }
+
+  for (const char *name : {"SIN", "COS", "EXP", "LN", "SQRT"}) {
+    const auto *coarse = vecmath::findFast(name, vecmath::Tier::Coarse);
+    const auto *medium = vecmath::findFast(name, vecmath::Tier::Medium);
+    const auto *fine = vecmath::findFast(name, vecmath::Tier::Fine);
+    ASSERT_TRUE(coarse && medium && fine) << name;
+    EXPECT_GE(coarse->maxError, medium->maxError) << name;
+    EXPECT_GE(medium->maxError, fine->maxError) << name;
+  }
+  EXPECT_EQ(vecmath::findFast("TAN", vecmath::Tier::Coarse), nullptr);
+}
+
+// 快速近似的sincos与同一等级的SIN、COS逐位相同
+TEST_F(VecMathTest, FastSincosMatchesFastSinAndCos) {
+  std::vector<double> xs = sampleInputs();
+  std::vector<double> sins(xs.size()), coss(xs.size());
+  std::vector<double> s(xs.size()), c(xs.size());
+  for (vecmath::Isa isa : kAllIsas) {
+    if (!vecmath::setIsa(isa)) {
+      continue;
+    }
+    for (size_t k = 0; k < vecmath::kTierCount; ++k) {
+      auto tier = static_cast<vecmath::Tier>(k);
+      vecmath::findFast("SIN", tier)->array(xs.data(), sins.data(),
+                                            xs.size());
+      vecmath::findFast("COS", tier)->array(xs.data(), coss.data(),
+                                            xs.size());
+      vecmath::fastSincos(tier, xs.data(), s.data(), c.data(), xs.size());
+      for (size_t i = 0; i < xs.size(); ++i) {
+        ASSERT_TRUE(sameBits(s[i], sins[i])) << "sin(" << xs[i] << ")";
+        ASSERT_TRUE(sameBits(c[i], coss[i])) << "cos(" << xs[i] << ")";
+      }
+    }
+  }
+}